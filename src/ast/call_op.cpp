@@ -0,0 +1,24 @@
+//
+// Created by Mike Smith on 2021/3/15.
+//
+
+#include <unordered_map>
+
+#include <ast/call_op.h>
+
+namespace luisa::compute {
+
+std::optional<CallOp> call_op_from_name(std::string_view name) noexcept {
+    static const auto ops = [] {
+        std::unordered_map<std::string_view, CallOp> ops;
+        for (auto i = 1u; i < detail::call_op_infos.size(); i++) {
+            ops.emplace(detail::call_op_infos[i].name, static_cast<CallOp>(i));
+        }
+        return ops;
+    }();
+    if (auto iter = ops.find(name); iter != ops.cend()) { return iter->second; }
+    if (name.starts_with("make_")) { return CallOp::MAKE_VECTOR; }
+    return std::nullopt;
+}
+
+}// namespace luisa::compute
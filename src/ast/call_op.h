@@ -0,0 +1,178 @@
+//
+// Created by Mike Smith on 2021/3/15.
+//
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace luisa::compute {
+
+// Builtin functions, CUSTOM being calls to user callables.
+enum struct CallOp : uint32_t {
+
+    CUSTOM,
+
+    // element-wise math
+    ABS,
+    SQRT,
+    RSQRT,
+    SIN,
+    COS,
+    TAN,
+    ASIN,
+    ACOS,
+    ATAN,
+    EXP,
+    EXP2,
+    LOG,
+    LOG2,
+    FLOOR,
+    CEIL,
+    ROUND,
+    FRACT,
+    SATURATE,
+    MIN,
+    MAX,
+    POW,
+    ATAN2,
+    CLAMP,
+    LERP,
+    FMA,
+
+    // vector
+    LENGTH,
+    NORMALIZE,
+    DOT,
+    CROSS,
+    ALL,
+    ANY,
+    MAKE_VECTOR,
+
+    // resources
+    TEXTURE_READ,
+    TEXTURE_WRITE,
+    BINDLESS_BUFFER_READ,
+    BINDLESS_BUFFER_WRITE,
+    BINDLESS_TEXTURE_READ,
+
+    // atomic read-modify-writes, the first argument is the buffer element or shared variable
+    ATOMIC_EXCHANGE,
+    ATOMIC_COMPARE_EXCHANGE,
+    ATOMIC_FETCH_ADD,
+    ATOMIC_FETCH_SUB,
+    ATOMIC_FETCH_AND,
+    ATOMIC_FETCH_OR,
+    ATOMIC_FETCH_XOR,
+    ATOMIC_FETCH_MIN,
+    ATOMIC_FETCH_MAX,
+
+    // subgroup (warp) operations over the active threads of the caller's warp,
+    // after HLSL's WaveGetLaneCount, WaveActive*, WaveReadLane* and WavePrefixSum;
+    // ballots are 32-bit masks, so warps are at most 32 threads wide
+    WARP_SIZE,
+    WARP_LANE_ID,
+    WARP_ACTIVE_ALL,
+    WARP_ACTIVE_ANY,
+    WARP_ACTIVE_BALLOT,
+    WARP_READ_LANE,
+    WARP_READ_FIRST_ACTIVE_LANE,
+    WARP_ACTIVE_SUM,
+    WARP_PREFIX_SUM,// exclusive
+    WARP_INCLUSIVE_SUM
+};
+
+struct CallOpInfo {
+    static constexpr auto variadic = ~0u;
+    std::string_view name;
+    std::string_view signature;// T is the result type, S its scalar type, vecN any vector, and & an lvalue
+    uint32_t arity;
+    bool pure;        // the result only depends on the arguments, so calls may be folded or deduplicated
+    bool side_effects;// writes memory, so the call must be kept even if its result is unused
+    uint32_t cost;    // rough cost in ALU operations per component, for scheduling and inlining heuristics
+};
+
+namespace detail {
+
+inline constexpr std::array call_op_infos{
+    CallOpInfo{"callable", "T(...)", CallOpInfo::variadic, false, true, 0u},
+    CallOpInfo{"abs", "T(T)", 1u, true, false, 1u},
+    CallOpInfo{"sqrt", "T(T)", 1u, true, false, 4u},
+    CallOpInfo{"rsqrt", "T(T)", 1u, true, false, 4u},
+    CallOpInfo{"sin", "T(T)", 1u, true, false, 20u},
+    CallOpInfo{"cos", "T(T)", 1u, true, false, 20u},
+    CallOpInfo{"tan", "T(T)", 1u, true, false, 24u},
+    CallOpInfo{"asin", "T(T)", 1u, true, false, 24u},
+    CallOpInfo{"acos", "T(T)", 1u, true, false, 24u},
+    CallOpInfo{"atan", "T(T)", 1u, true, false, 24u},
+    CallOpInfo{"exp", "T(T)", 1u, true, false, 16u},
+    CallOpInfo{"exp2", "T(T)", 1u, true, false, 16u},
+    CallOpInfo{"log", "T(T)", 1u, true, false, 16u},
+    CallOpInfo{"log2", "T(T)", 1u, true, false, 16u},
+    CallOpInfo{"floor", "T(T)", 1u, true, false, 1u},
+    CallOpInfo{"ceil", "T(T)", 1u, true, false, 1u},
+    CallOpInfo{"round", "T(T)", 1u, true, false, 1u},
+    CallOpInfo{"fract", "T(T)", 1u, true, false, 2u},
+    CallOpInfo{"saturate", "T(T)", 1u, true, false, 1u},
+    CallOpInfo{"min", "T(T, T|S)", 2u, true, false, 1u},
+    CallOpInfo{"max", "T(T, T|S)", 2u, true, false, 1u},
+    CallOpInfo{"pow", "T(T, T|S)", 2u, true, false, 32u},
+    CallOpInfo{"atan2", "T(T, T|S)", 2u, true, false, 28u},
+    CallOpInfo{"clamp", "T(T, T|S, T|S)", 3u, true, false, 2u},
+    CallOpInfo{"lerp", "T(T, T, T|S)", 3u, true, false, 3u},
+    CallOpInfo{"fma", "T(T, T, T)", 3u, true, false, 1u},
+    CallOpInfo{"length", "S(vecN)", 1u, true, false, 6u},
+    CallOpInfo{"normalize", "vecN(vecN)", 1u, true, false, 10u},
+    CallOpInfo{"dot", "S(vecN, vecN)", 2u, true, false, 2u},
+    CallOpInfo{"cross", "float3(float3, float3)", 2u, true, false, 3u},
+    CallOpInfo{"all", "bool(vecN<bool>)", 1u, true, false, 1u},
+    CallOpInfo{"any", "bool(vecN<bool>)", 1u, true, false, 1u},
+    CallOpInfo{"make_vector", "vecN(S|vecM...)", CallOpInfo::variadic, true, false, 0u},
+    CallOpInfo{"texture_read", "vec4(texture, uint2|uint3)", 2u, false, false, 8u},
+    CallOpInfo{"texture_write", "void(texture, uint2|uint3, vec4)", 3u, false, true, 8u},
+    CallOpInfo{"bindless_buffer_read", "T(bindless_array, uint, int|uint)", 3u, false, false, 10u},
+    CallOpInfo{"bindless_buffer_write", "void(bindless_array, uint, int|uint, T)", 4u, false, true, 10u},
+    CallOpInfo{"bindless_texture_read", "float4(bindless_array, uint, uint2|uint3)", 3u, false, false, 12u},
+    CallOpInfo{"atomic_exchange", "S(S&, S)", 2u, false, true, 20u},
+    CallOpInfo{"atomic_compare_exchange", "S(S&, S, S)", 3u, false, true, 20u},
+    CallOpInfo{"atomic_fetch_add", "S(S&, S)", 2u, false, true, 20u},
+    CallOpInfo{"atomic_fetch_sub", "S(S&, S)", 2u, false, true, 20u},
+    CallOpInfo{"atomic_fetch_and", "S(S&, S)", 2u, false, true, 20u},
+    CallOpInfo{"atomic_fetch_or", "S(S&, S)", 2u, false, true, 20u},
+    CallOpInfo{"atomic_fetch_xor", "S(S&, S)", 2u, false, true, 20u},
+    CallOpInfo{"atomic_fetch_min", "S(S&, S)", 2u, false, true, 20u},
+    CallOpInfo{"atomic_fetch_max", "S(S&, S)", 2u, false, true, 20u},
+    CallOpInfo{"warp_size", "uint()", 0u, true, false, 0u},
+    CallOpInfo{"warp_lane_id", "uint()", 0u, false, false, 1u},
+    CallOpInfo{"warp_active_all", "bool(bool)", 1u, false, false, 4u},
+    CallOpInfo{"warp_active_any", "bool(bool)", 1u, false, false, 4u},
+    CallOpInfo{"warp_active_ballot", "uint(bool)", 1u, false, false, 4u},
+    CallOpInfo{"warp_read_lane", "T(T, uint)", 2u, false, false, 4u},
+    CallOpInfo{"warp_read_first_active_lane", "T(T)", 1u, false, false, 4u},
+    CallOpInfo{"warp_active_sum", "T(T)", 1u, false, false, 8u},
+    CallOpInfo{"warp_prefix_sum", "T(T)", 1u, false, false, 8u},
+    CallOpInfo{"warp_inclusive_sum", "T(T)", 1u, false, false, 8u}};
+
+static_assert(call_op_infos.size() == static_cast<size_t>(CallOp::WARP_INCLUSIVE_SUM) + 1u);
+
+}// namespace detail
+
+[[nodiscard]] constexpr const CallOpInfo &call_op_info(CallOp op) noexcept {
+    return detail::call_op_infos[static_cast<uint32_t>(op)];
+}
+
+[[nodiscard]] constexpr std::string_view to_string(CallOp op) noexcept { return call_op_info(op).name; }
+
+[[nodiscard]] constexpr auto is_atomic(CallOp op) noexcept {
+    return static_cast<uint32_t>(op) >= static_cast<uint32_t>(CallOp::ATOMIC_EXCHANGE) &&
+           static_cast<uint32_t>(op) <= static_cast<uint32_t>(CallOp::ATOMIC_FETCH_MAX);
+}
+
+// resolves builtin names, with make_<scalar><n> constructors mapping to MAKE_VECTOR;
+// "callable" is not a builtin name
+[[nodiscard]] std::optional<CallOp> call_op_from_name(std::string_view name) noexcept;
+
+}// namespace luisa::compute
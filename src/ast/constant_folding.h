@@ -0,0 +1,151 @@
+//
+// Created by Mike Smith on 2021/3/22.
+//
+
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <type_traits>
+
+#include <ast/expression.h>
+
+namespace luisa::compute::detail {
+
+template<typename T>
+[[nodiscard]] constexpr auto scalar_tag() noexcept {
+    if constexpr (std::is_same_v<T, bool>) {
+        return Type::Tag::BOOL;
+    } else if constexpr (std::is_same_v<T, float>) {
+        return Type::Tag::FLOAT;
+    } else if constexpr (std::is_same_v<T, int8_t> || std::is_same_v<T, char>) {
+        return Type::Tag::INT8;
+    } else if constexpr (std::is_same_v<T, uint8_t>) {
+        return Type::Tag::UINT8;
+    } else if constexpr (std::is_same_v<T, int16_t>) {
+        return Type::Tag::INT16;
+    } else if constexpr (std::is_same_v<T, uint16_t>) {
+        return Type::Tag::UINT16;
+    } else if constexpr (std::is_same_v<T, int32_t>) {
+        return Type::Tag::INT32;
+    } else {
+        static_assert(std::is_same_v<T, uint32_t>);
+        return Type::Tag::UINT32;
+    }
+}
+
+// matched structurally, as not every literal alternative is registered with Type::of
+template<typename T>
+struct LiteralTypeMatch {
+    [[nodiscard]] static bool of(const Type *type) noexcept { return type->tag() == scalar_tag<T>(); }
+};
+
+template<typename T, size_t N>
+struct LiteralTypeMatch<Vector<T, N>> {
+    [[nodiscard]] static bool of(const Type *type) noexcept {
+        return type->is_vector() && type->dimension() == N && type->element()->tag() == scalar_tag<T>();
+    }
+};
+
+template<size_t N>
+struct LiteralTypeMatch<Matrix<N>> {
+    [[nodiscard]] static bool of(const Type *type) noexcept { return type->is_matrix() && type->dimension() == N; }
+};
+
+template<typename T>
+[[nodiscard]] std::optional<LiteralExpr::Value> fold_unary(UnaryOp op, T x) noexcept {
+    switch (op) {
+        case UnaryOp::PLUS: return x;
+        case UnaryOp::MINUS:
+            if constexpr (std::is_same_v<T, bool>) {
+                return std::nullopt;
+            } else if constexpr (std::is_floating_point_v<T>) {
+                return -x;
+            } else {
+                return static_cast<T>(0u - static_cast<uint32_t>(x));
+            }
+        case UnaryOp::NOT:
+            if constexpr (std::is_same_v<T, bool>) { return !x; }
+            return std::nullopt;
+        case UnaryOp::BIT_NOT:
+            if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool>) { return static_cast<T>(~x); }
+            return std::nullopt;
+    }
+    return std::nullopt;
+}
+
+// mirrors the semantics of the backends: integer division by zero yields zero and shift amounts wrap
+template<typename T>
+[[nodiscard]] std::optional<LiteralExpr::Value> fold_binary(BinaryOp op, T a, T b) noexcept {
+    static constexpr auto is_bool = std::is_same_v<T, bool>;
+    static constexpr auto is_integer = std::is_integral_v<T> && !is_bool;
+    switch (op) {
+        case BinaryOp::AND: return a && b;
+        case BinaryOp::OR: return a || b;
+        case BinaryOp::LESS: return a < b;
+        case BinaryOp::GREATER: return a > b;
+        case BinaryOp::LESS_EQUAL: return a <= b;
+        case BinaryOp::GREATER_EQUAL: return a >= b;
+        case BinaryOp::EQUAL: return a == b;
+        case BinaryOp::NOT_EQUAL: return a != b;
+        default: break;
+    }
+    if constexpr (std::is_floating_point_v<T>) {
+        switch (op) {
+            case BinaryOp::ADD: return a + b;
+            case BinaryOp::SUB: return a - b;
+            case BinaryOp::MUL: return a * b;
+            case BinaryOp::DIV: return a / b;
+            case BinaryOp::MOD: return std::fmod(a, b);
+            default: break;
+        }
+    } else if constexpr (is_integer) {
+        // wrap around in unsigned arithmetic, as the backends do
+        auto ua = static_cast<uint32_t>(a);
+        auto ub = static_cast<uint32_t>(b);
+        auto shift = static_cast<uint32_t>(b) & (sizeof(T) * 8u - 1u);
+        switch (op) {
+            case BinaryOp::ADD: return static_cast<T>(ua + ub);
+            case BinaryOp::SUB: return static_cast<T>(ua - ub);
+            case BinaryOp::MUL: return static_cast<T>(ua * ub);
+            case BinaryOp::DIV:
+                if (std::is_signed_v<T> && a == std::numeric_limits<T>::min() && b == T(-1)) { return std::nullopt; }
+                return b == 0 ? T{0} : static_cast<T>(a / b);
+            case BinaryOp::MOD:
+                if (std::is_signed_v<T> && a == std::numeric_limits<T>::min() && b == T(-1)) { return std::nullopt; }
+                return b == 0 ? T{0} : static_cast<T>(a % b);
+            case BinaryOp::BIT_AND: return static_cast<T>(a & b);
+            case BinaryOp::BIT_OR: return static_cast<T>(a | b);
+            case BinaryOp::BIT_XOR: return static_cast<T>(a ^ b);
+            case BinaryOp::SHL: return static_cast<T>(ua << shift);
+            case BinaryOp::SHR: return static_cast<T>(a >> shift);
+            default: break;
+        }
+    } else {
+        switch (op) {
+            case BinaryOp::BIT_AND: return static_cast<bool>(a & b);
+            case BinaryOp::BIT_OR: return static_cast<bool>(a | b);
+            case BinaryOp::BIT_XOR: return static_cast<bool>(a ^ b);
+            default: break;
+        }
+    }
+    return std::nullopt;
+}
+
+template<typename To, typename From>
+[[nodiscard]] std::optional<LiteralExpr::Value> fold_cast(From x) noexcept {
+    if constexpr (std::is_floating_point_v<From> && std::is_integral_v<To> && !std::is_same_v<To, bool>) {
+        // out-of-range conversions are left to the backends
+        auto v = static_cast<double>(x);
+        if (!(v > static_cast<double>(std::numeric_limits<To>::min()) - 1.0 && v < static_cast<double>(std::numeric_limits<To>::max()) + 1.0)) {
+            return std::nullopt;
+        }
+    }
+    return static_cast<To>(x);
+}
+
+template<typename T>
+inline constexpr auto is_scalar_v = std::is_arithmetic_v<T>;
+
+}// namespace luisa::compute::detail
@@ -9,6 +9,8 @@
 #include <core/concepts.h>
 #include <core/data_types.h>
 #include <ast/variable.h>
+#include <ast/call_op.h>
+#include <ast/function.h>
 
 namespace luisa::compute {
 
@@ -36,6 +38,7 @@ class LiteralExpr;
 class RefExpr;
 class CallExpr;
 class CastExpr;
+class SelectExpr;
 
 struct ExprVisitor {
     virtual void visit(const UnaryExpr *) = 0;
@@ -46,6 +49,7 @@ struct ExprVisitor {
     virtual void visit(const RefExpr *) = 0;
     virtual void visit(const CallExpr *) = 0;
     virtual void visit(const CastExpr *) = 0;
+    virtual void visit(const SelectExpr *) = 0;
 };
 
 #define LUISA_MAKE_EXPRESSION_ACCEPT_VISITOR() \
@@ -180,14 +184,20 @@ public:
     using ArgumentList = std::span<const Expression *>;
 
 private:
-    std::string_view _name;
     ArgumentList _arguments;
+    const FunctionBuilder *_callable;
+    CallOp _op;
 
 public:
-    CallExpr(const Type *type, std::string_view name, ArgumentList args) noexcept
-        : Expression{type}, _name{name}, _arguments{args} {}
-    [[nodiscard]] auto name() const noexcept { return _name; }
+    CallExpr(const Type *type, CallOp op, ArgumentList args) noexcept
+        : Expression{type}, _arguments{args}, _callable{nullptr}, _op{op} {}
+    CallExpr(const Type *type, const FunctionBuilder *callable, ArgumentList args) noexcept
+        : Expression{type}, _arguments{args}, _callable{callable}, _op{CallOp::CUSTOM} {}
+    [[nodiscard]] auto op() const noexcept { return _op; }
+    [[nodiscard]] auto name() const noexcept { return to_string(_op); }
     [[nodiscard]] auto arguments() const noexcept { return _arguments; }
+    [[nodiscard]] auto is_builtin() const noexcept { return _op != CallOp::CUSTOM; }
+    [[nodiscard]] auto callable() const noexcept { return Function{*_callable}; }
     LUISA_MAKE_EXPRESSION_ACCEPT_VISITOR()
 };
 
@@ -211,6 +221,24 @@ public:
     LUISA_MAKE_EXPRESSION_ACCEPT_VISITOR()
 };
 
+// cond ? true_value : false_value, component-wise for bool vector conditions; which of the
+// values are evaluated is up to the backend, so neither should have side effects
+class SelectExpr : public Expression {
+
+private:
+    const Expression *_condition;
+    const Expression *_true_value;
+    const Expression *_false_value;
+
+public:
+    SelectExpr(const Type *type, const Expression *cond, const Expression *t, const Expression *f) noexcept
+        : Expression{type}, _condition{cond}, _true_value{t}, _false_value{f} {}
+    [[nodiscard]] auto condition() const noexcept { return _condition; }
+    [[nodiscard]] auto true_value() const noexcept { return _true_value; }
+    [[nodiscard]] auto false_value() const noexcept { return _false_value; }
+    LUISA_MAKE_EXPRESSION_ACCEPT_VISITOR()
+};
+
 #undef LUISA_MAKE_EXPRESSION_ACCEPT_VISITOR
 
 // make sure we can allocate them using arena...
@@ -222,5 +250,6 @@ static_assert(std::is_trivially_destructible_v<LiteralExpr>);
 static_assert(std::is_trivially_destructible_v<RefExpr>);
 static_assert(std::is_trivially_destructible_v<CallExpr>);
 static_assert(std::is_trivially_destructible_v<CastExpr>);
+static_assert(std::is_trivially_destructible_v<SelectExpr>);
 
 }// namespace luisa::compute
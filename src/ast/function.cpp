@@ -2,11 +2,180 @@
 // Created by Mike Smith on 2021/2/23.
 //
 
+#include <core/hash.h>
 #include <ast/function.h>
 #include <ast/function_builder.h>
 
 namespace luisa::compute {
 
+namespace detail {
+
+// Serializes the structure of a function into a word stream and hashes it.
+class FunctionHasher final : public ExprVisitor, public StmtVisitor {
+
+private:
+    std::vector<uint64_t> _words;
+
+    void _emit(uint64_t w) noexcept { _words.emplace_back(w); }
+    void _emit(const Type *type) noexcept { _emit(type == nullptr ? 0u : type->hash()); }
+    void _emit(Variable v) noexcept {
+        _emit(v.type());
+        _emit(static_cast<uint64_t>(v.tag()) << 32u | v.uid());
+    }
+    void _emit(const void *data, size_t size) noexcept {
+        _emit(size);
+        _emit(xxh3_hash64(data, size));
+    }
+    void _emit(const Expression *expr) noexcept {
+        if (expr == nullptr) {
+            _emit(0xffffffffu);
+        } else {
+            _emit(expr->type());
+            expr->accept(*this);
+        }
+    }
+    void _emit(const Statement *stmt) noexcept {
+        if (stmt == nullptr) {
+            _emit(0xffffffffu);
+        } else {
+            stmt->accept(*this);
+        }
+    }
+
+public:
+    void visit(const UnaryExpr *expr) override {
+        _emit(0x100u | static_cast<uint64_t>(expr->op()));
+        _emit(expr->operand());
+    }
+    void visit(const BinaryExpr *expr) override {
+        _emit(0x200u | static_cast<uint64_t>(expr->op()));
+        _emit(expr->lhs());
+        _emit(expr->rhs());
+    }
+    void visit(const MemberExpr *expr) override {
+        _emit(0x300u);
+        _emit(expr->member_index());
+        _emit(expr->self());
+    }
+    void visit(const AccessExpr *expr) override {
+        _emit(0x400u);
+        _emit(expr->range());
+        _emit(expr->index());
+    }
+    void visit(const LiteralExpr *expr) override {
+        _emit(0x500u | expr->value().index());
+        std::visit([this](auto &&v) noexcept { _emit(&v, sizeof(v)); }, expr->value());
+    }
+    void visit(const RefExpr *expr) override {
+        _emit(0x600u);
+        _emit(expr->variable());
+    }
+    void visit(const CallExpr *expr) override {
+        _emit(0x700u);
+        if (expr->is_builtin()) {
+            _emit(static_cast<uint64_t>(expr->op()));
+        } else {
+            _emit(expr->callable().hash());
+        }
+        _emit(expr->arguments().size());
+        for (auto arg : expr->arguments()) { _emit(arg); }
+    }
+    void visit(const CastExpr *expr) override {
+        _emit(0x800u | static_cast<uint64_t>(expr->op()));
+        _emit(expr->expression());
+    }
+    void visit(const SelectExpr *expr) override {
+        _emit(0x900u);
+        _emit(expr->condition());
+        _emit(expr->true_value());
+        _emit(expr->false_value());
+    }
+
+    void visit(const BreakStmt *) override { _emit(0x1000u); }
+    void visit(const ContinueStmt *) override { _emit(0x1100u); }
+    void visit(const SyncBlockStmt *) override { _emit(0x1c00u); }
+    void visit(const ForStmt *stmt) override {
+        _emit(0x1d00u);
+        _emit(static_cast<uint32_t>(stmt->unroll().mode()));
+        _emit(stmt->unroll().max_trip_count());
+        _emit(stmt->variable());
+        _emit(stmt->initializer());
+        _emit(stmt->condition());
+        _emit(stmt->step());
+        _emit(stmt->body());
+    }
+    void visit(const ReturnStmt *stmt) override {
+        _emit(0x1200u);
+        _emit(stmt->expression());
+    }
+    void visit(const ScopeStmt *stmt) override {
+        _emit(0x1300u);
+        _emit(stmt->statements().size());
+        for (auto s : stmt->statements()) { _emit(s); }
+    }
+    void visit(const DeclareStmt *stmt) override {
+        _emit(0x1400u);
+        _emit(stmt->variable());
+        _emit(stmt->initializer().size());
+        for (auto init : stmt->initializer()) { _emit(init); }
+    }
+    void visit(const IfStmt *stmt) override {
+        _emit(0x1500u);
+        _emit(stmt->condition());
+        _emit(stmt->true_branch());
+        _emit(stmt->false_branch());
+    }
+    void visit(const WhileStmt *stmt) override {
+        _emit(0x1600u);
+        _emit(stmt->condition());
+        _emit(stmt->body());
+    }
+    void visit(const ExprStmt *stmt) override {
+        _emit(0x1700u);
+        _emit(stmt->expression());
+    }
+    void visit(const SwitchStmt *stmt) override {
+        _emit(0x1800u);
+        _emit(stmt->expression());
+        _emit(stmt->body());
+    }
+    void visit(const SwitchCaseStmt *stmt) override {
+        _emit(0x1900u);
+        _emit(stmt->expression());
+        _emit(stmt->body());
+    }
+    void visit(const SwitchDefaultStmt *stmt) override {
+        _emit(0x1a00u);
+        _emit(stmt->body());
+    }
+    void visit(const AssignStmt *stmt) override {
+        _emit(0x1b00u | static_cast<uint64_t>(stmt->op()));
+        _emit(stmt->lhs());
+        _emit(stmt->rhs());
+    }
+
+    [[nodiscard]] uint64_t hash(Function f) noexcept {
+        _words.clear();
+        _emit(static_cast<uint64_t>(f.tag()));
+        // bindings contribute their variables only, handles and host pointers are launch-time data
+        for (auto v : f.builtin_variables()) { _emit(v); }
+        for (auto v : f.shared_variables()) { _emit(v); }
+        for (auto &&c : f.constant_variables()) {
+            _emit(c.variable);
+            _emit(c.data, c.variable.type()->size());
+        }
+        for (auto &&b : f.captured_buffers()) { _emit(b.variable); }
+        for (auto &&b : f.captured_textures()) { _emit(b.variable); }
+        for (auto &&b : f.captured_bindless_arrays()) { _emit(b.variable); }
+        for (auto &&b : f.captured_uniforms()) { _emit(b.variable); }
+        for (auto v : f.arguments()) { _emit(v); }
+        _emit(f.body());
+        return xxh3_hash64(_words.data(), _words.size() * sizeof(uint64_t));
+    }
+};
+
+}// namespace detail
+
 std::span<const Variable> Function::builtin_variables() const noexcept {
     return _builder.builtin_variables();
 }
@@ -27,6 +196,10 @@ std::span<const Function::TextureBinding> Function::captured_textures() const no
     return _builder.captured_textures();
 }
 
+std::span<const Function::BindlessArrayBinding> Function::captured_bindless_arrays() const noexcept {
+    return _builder.captured_bindless_arrays();
+}
+
 std::span<const Function::UniformBinding> Function::captured_uniforms() const noexcept {
     return _builder.captured_uniforms();
 }
@@ -35,6 +208,14 @@ std::span<const Variable> Function::arguments() const noexcept {
     return _builder.arguments();
 }
 
+std::span<const Variable> Function::written_resources() const noexcept {
+    return _builder.written_resources();
+}
+
+std::span<const std::shared_ptr<const FunctionBuilder>> Function::custom_callables() const noexcept {
+    return _builder.custom_callables();
+}
+
 Function::Tag Function::tag() const noexcept {
     return _builder.tag();
 }
@@ -43,4 +224,8 @@ const ScopeStmt *Function::body() const noexcept {
     return _builder.body();
 }
 
+uint64_t Function::hash() const noexcept {
+    return detail::FunctionHasher{}.hash(*this);
+}
+
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <span>
+#include <memory>
 #include <ast/variable.h>
 
 namespace luisa::compute {
@@ -24,7 +25,14 @@ public:
     };
 
     struct TextureBinding {
-        // TODO...
+        Variable variable;
+        uint64_t handle;
+        uint32_t level;
+    };
+
+    struct BindlessArrayBinding {
+        Variable variable;
+        uint64_t handle;
     };
 
     struct UniformBinding {
@@ -47,10 +55,19 @@ public:
     [[nodiscard]] std::span<const ConstantData> constant_variables() const noexcept;
     [[nodiscard]] std::span<const BufferBinding> captured_buffers() const noexcept;
     [[nodiscard]] std::span<const TextureBinding> captured_textures() const noexcept;
+    [[nodiscard]] std::span<const BindlessArrayBinding> captured_bindless_arrays() const noexcept;
     [[nodiscard]] std::span<const UniformBinding> captured_uniforms() const noexcept;
     [[nodiscard]] std::span<const Variable> arguments() const noexcept;
+    // buffers and bindless arrays stored to, directly, by atomics or through callables
+    [[nodiscard]] std::span<const Variable> written_resources() const noexcept;
+    [[nodiscard]] std::span<const std::shared_ptr<const FunctionBuilder>> custom_callables() const noexcept;
     [[nodiscard]] Tag tag() const noexcept;
     [[nodiscard]] const ScopeStmt *body() const noexcept;
+    [[nodiscard]] const FunctionBuilder &builder() const noexcept { return _builder; }
+
+    // Structural hash: equal for functions traced from the same code, regardless of
+    // which resources are bound or where captured uniforms live in host memory.
+    [[nodiscard]] uint64_t hash() const noexcept;
 };
 
 }// namespace luisa::compute
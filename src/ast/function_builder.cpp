@@ -2,6 +2,10 @@
 // Created by Mike Smith on 2020/12/2.
 //
 
+#include <cstring>
+#include <algorithm>
+
+#include <ast/constant_folding.h>
 #include "function_builder.h"
 
 namespace luisa::compute {
@@ -39,6 +43,10 @@ void FunctionBuilder::continue_() noexcept {
     _add(_arena.create<ContinueStmt>());
 }
 
+void FunctionBuilder::sync_block() noexcept {
+    _add(_arena.create<SyncBlockStmt>());
+}
+
 void FunctionBuilder::return_(const Expression *expr) noexcept {
     _add(_arena.create<ReturnStmt>(expr));
 }
@@ -55,6 +63,16 @@ void FunctionBuilder::while_(const Expression *cond, const Statement *body) noex
     _add(_arena.create<WhileStmt>(cond, body));
 }
 
+Variable FunctionBuilder::for_variable(const Type *type) noexcept {
+    return Variable{type, Variable::Tag::LOCAL, _next_variable_uid()};
+}
+
+void FunctionBuilder::for_(Variable variable, const Expression *init, const Expression *cond, const Expression *step,
+                           const Statement *body, LoopUnroll unroll) noexcept {
+    if (!variable.type()->is_scalar()) { LUISA_ERROR_WITH_LOCATION("Invalid induction variable type {}.", variable.type()->description()); }
+    _add(_arena.create<ForStmt>(variable, init, cond, step, body, unroll));
+}
+
 void FunctionBuilder::void_(const Expression *expr) noexcept {
     _add(_arena.create<ExprStmt>(expr));
 }
@@ -72,6 +90,7 @@ void FunctionBuilder::default_(const Statement *body) noexcept {
 }
 
 void FunctionBuilder::assign(AssignOp op, const Expression *lhs, const Expression *rhs) noexcept {
+    _mark_written(lhs);
     _add(_arena.create<AssignStmt>(op, lhs, rhs));
 }
 
@@ -155,16 +174,12 @@ Variable FunctionBuilder::_uniform_binding(const Type *type, const void *data) n
 }
 
 Variable FunctionBuilder::_buffer_binding(const Type *type, uint64_t handle, size_t offset_bytes) noexcept {
+    // views at different offsets are distinct bindings, as heap-allocated buffers share handles
     if (auto iter = std::find_if(
             _captured_buffers.cbegin(),
             _captured_buffers.cend(),
-            [handle](auto &&binding) { return binding.handle == handle; });
+            [handle, offset_bytes](auto &&binding) { return binding.handle == handle && binding.offset_bytes == offset_bytes; });
         iter != _captured_buffers.cend()) {
-        if (iter->offset_bytes != offset_bytes) {
-            LUISA_ERROR_WITH_LOCATION(
-                "Aliasing in implicitly captured buffer (handle = {}, original offset = {}, requested offset = {}).",
-                handle, iter->offset_bytes, offset_bytes);
-        }
         auto v = iter->variable;
         if (*v.type() != *type) {
             LUISA_ERROR_WITH_LOCATION(
@@ -178,11 +193,134 @@ Variable FunctionBuilder::_buffer_binding(const Type *type, uint64_t handle, siz
     return v;
 }
 
+Variable FunctionBuilder::texture(const Type *type) noexcept {
+    Variable v{type, Variable::Tag::TEXTURE, _next_variable_uid()};
+    _arguments.emplace_back(v);
+    return v;
+}
+
+const Type *FunctionBuilder::texture_type(PixelFormat format, uint32_t dimension) noexcept {
+    return Type::from(fmt::format("texture<{},{}>", dimension, pixel_format_read_type(format)));
+}
+
+Variable FunctionBuilder::_texture_binding(const Type *type, uint64_t handle, uint32_t level) noexcept {
+    if (auto iter = std::find_if(
+            _captured_textures.cbegin(),
+            _captured_textures.cend(),
+            [handle](auto &&binding) { return binding.handle == handle; });
+        iter != _captured_textures.cend()) {
+        if (iter->level != level) {
+            LUISA_ERROR_WITH_LOCATION(
+                "Aliasing in implicitly captured texture (handle = {}, original level = {}, requested level = {}).",
+                handle, iter->level, level);
+        }
+        auto v = iter->variable;
+        if (*v.type() != *type) {
+            LUISA_ERROR_WITH_LOCATION(
+                "Aliasing in implicitly captured texture (handle = {}, original type = {}, requested type = {}).",
+                handle, v.type()->description(), type->description());
+        }
+        return v;
+    }
+    Variable v{type, Variable::Tag::TEXTURE, _next_variable_uid()};
+    _captured_textures.emplace_back(TextureBinding{v, handle, level});
+    return v;
+}
+
+Variable FunctionBuilder::bindless_array() noexcept {
+    Variable v{Type::from("bindless_array"), Variable::Tag::BINDLESS_ARRAY, _next_variable_uid()};
+    _arguments.emplace_back(v);
+    return v;
+}
+
+Variable FunctionBuilder::_bindless_array_binding(uint64_t handle) noexcept {
+    if (auto iter = std::find_if(
+            _captured_bindless_arrays.cbegin(),
+            _captured_bindless_arrays.cend(),
+            [handle](auto &&binding) { return binding.handle == handle; });
+        iter != _captured_bindless_arrays.cend()) {
+        return iter->variable;
+    }
+    Variable v{Type::from("bindless_array"), Variable::Tag::BINDLESS_ARRAY, _next_variable_uid()};
+    _captured_bindless_arrays.emplace_back(BindlessArrayBinding{v, handle});
+    return v;
+}
+
+Variable FunctionBuilder::_rebind(Function function, Variable v) noexcept {
+    switch (v.tag()) {
+        case Variable::Tag::SHARED: return shared(v.type());
+        case Variable::Tag::CONSTANT:
+            for (auto &&c : function.constant_variables()) {
+                if (c.variable.uid() == v.uid()) {
+                    auto data = _arena.allocate<std::byte, 16u>(v.type()->size());
+                    std::memcpy(data, c.data, v.type()->size());
+                    return _constant(v.type(), data);
+                }
+            }
+            break;
+        case Variable::Tag::UNIFORM:
+            for (auto &&u : function.captured_uniforms()) {
+                if (u.variable.uid() == v.uid()) { return _uniform_binding(v.type(), u.data); }
+            }
+            break;
+        case Variable::Tag::BUFFER:
+            for (auto &&b : function.captured_buffers()) {
+                if (b.variable.uid() == v.uid()) { return _buffer_binding(v.type(), b.handle, b.offset_bytes); }
+            }
+            break;
+        case Variable::Tag::TEXTURE:
+            for (auto &&t : function.captured_textures()) {
+                if (t.variable.uid() == v.uid()) { return _texture_binding(v.type(), t.handle, t.level); }
+            }
+            break;
+        case Variable::Tag::BINDLESS_ARRAY:
+            for (auto &&a : function.captured_bindless_arrays()) {
+                if (a.variable.uid() == v.uid()) { return _bindless_array_binding(a.handle); }
+            }
+            break;
+        case Variable::Tag::THREAD_ID: return thread_id();
+        case Variable::Tag::BLOCK_ID: return block_id();
+        case Variable::Tag::DISPATCH_ID: return dispatch_id();
+        default: break;
+    }
+    LUISA_ERROR_WITH_LOCATION("Unknown variable #{} (tag = {}).", v.uid(), static_cast<uint32_t>(v.tag()));
+    return v;
+}
+
+// operations on literals are evaluated when built, so values known at trace time never reach the backends;
+// folded values are only kept if their type is the type of the expression
+const Expression *FunctionBuilder::_folded(const Type *type, std::optional<LiteralExpr::Value> value) noexcept {
+    if (!value || !std::visit([type](auto v) noexcept { return detail::LiteralTypeMatch<decltype(v)>::of(type); }, *value)) { return nullptr; }
+    return _literal(type, std::move(*value));
+}
+
 const Expression *FunctionBuilder::unary(const Type *type, UnaryOp op, const Expression *expr) noexcept {
+    if (auto x = dynamic_cast<const LiteralExpr *>(expr)) {
+        auto folded = std::visit([op](auto v) noexcept -> std::optional<LiteralExpr::Value> {
+            if constexpr (detail::is_scalar_v<decltype(v)>) { return detail::fold_unary(op, v); }
+            return std::nullopt;
+        }, x->value());
+        if (auto literal = _folded(type, folded)) { return literal; }
+    }
     return _arena.create<UnaryExpr>(type, op, expr);
 }
 
 const Expression *FunctionBuilder::binary(const Type *type, BinaryOp op, const Expression *lhs, const Expression *rhs) noexcept {
+    auto a = dynamic_cast<const LiteralExpr *>(lhs);
+    auto b = dynamic_cast<const LiteralExpr *>(rhs);
+    // short-circuits on a known lhs
+    if (a != nullptr && (op == BinaryOp::AND || op == BinaryOp::OR) &&
+        std::holds_alternative<bool>(a->value()) && type->tag() == Type::Tag::BOOL && rhs->type()->tag() == Type::Tag::BOOL) {
+        return std::get<bool>(a->value()) == (op == BinaryOp::AND) ? rhs : lhs;
+    }
+    if (a != nullptr && b != nullptr && a->value().index() == b->value().index()) {
+        auto folded = std::visit([op, b](auto x) noexcept -> std::optional<LiteralExpr::Value> {
+            using T = decltype(x);
+            if constexpr (detail::is_scalar_v<T>) { return detail::fold_binary(op, x, std::get<T>(b->value())); }
+            return std::nullopt;
+        }, a->value());
+        if (auto literal = _folded(type, folded)) { return literal; }
+    }
     return _arena.create<BinaryExpr>(type, op, lhs, rhs);
 }
 
@@ -194,22 +332,183 @@ const Expression *FunctionBuilder::access(const Type *type, const Expression *ra
     return _arena.create<AccessExpr>(type, range, index);
 }
 
-const Expression *FunctionBuilder::call(const Type *type, std::string_view func, std::span<const Expression *> args) noexcept {
-    ArenaString func_name{_arena, func};
+static void check_builtin_call(CallOp op, size_t argument_count) noexcept {
+    if (op == CallOp::CUSTOM) { LUISA_ERROR_WITH_LOCATION("Custom calls must be made to callables."); }
+    if (auto &&info = call_op_info(op); info.arity != CallOpInfo::variadic && info.arity != argument_count) {
+        LUISA_ERROR_WITH_LOCATION(
+            "Invalid argument count {} for builtin function {} with signature {}.",
+            argument_count, info.name, info.signature);
+    }
+}
+
+// records the buffer or bindless array an assigned or atomically updated expression lives in
+void FunctionBuilder::_mark_written(const Expression *expr) noexcept {
+    for (;;) {
+        if (auto access = dynamic_cast<const AccessExpr *>(expr)) {
+            expr = access->range();
+        } else if (auto member = dynamic_cast<const MemberExpr *>(expr)) {
+            expr = member->self();
+        } else {
+            break;
+        }
+    }
+    if (auto r = dynamic_cast<const RefExpr *>(expr)) {
+        auto v = r->variable();
+        auto resource = v.tag() == Variable::Tag::BUFFER || v.tag() == Variable::Tag::BINDLESS_ARRAY;
+        if (resource && std::none_of(_written_resources.cbegin(), _written_resources.cend(), [v](auto w) noexcept {
+                return w.uid() == v.uid();
+            })) {
+            _written_resources.emplace_back(v);
+        }
+    }
+}
+
+const Expression *FunctionBuilder::call(const Type *type, CallOp op, std::span<const Expression *> args) noexcept {
+    check_builtin_call(op, args.size());
+    if ((is_atomic(op) || op == CallOp::BINDLESS_BUFFER_WRITE) && !args.empty()) { _mark_written(args.front()); }
+    ArenaVector func_args{_arena, args};
+    return _arena.create<CallExpr>(type, op, func_args);
+}
+
+const Expression *FunctionBuilder::call(const Type *type, CallOp op, std::initializer_list<const Expression *> args) noexcept {
+    check_builtin_call(op, args.size());
+    if ((is_atomic(op) || op == CallOp::BINDLESS_BUFFER_WRITE) && args.size() != 0u) { _mark_written(*args.begin()); }
     ArenaVector func_args{_arena, args};
-    return _arena.create<CallExpr>(type, func_name, func_args);
+    return _arena.create<CallExpr>(type, op, func_args);
+}
+
+const Expression *FunctionBuilder::call(const Type *type, std::string_view func, std::span<const Expression *> args) noexcept {
+    auto op = call_op_from_name(func);
+    if (!op) { LUISA_ERROR_WITH_LOCATION("Unknown builtin function: {}.", func); }
+    return call(type, *op, args);
 }
 
 const Expression *FunctionBuilder::call(const Type *type, std::string_view func, std::initializer_list<const Expression *> args) noexcept {
-    ArenaString func_name{_arena, func};
+    auto op = call_op_from_name(func);
+    if (!op) { LUISA_ERROR_WITH_LOCATION("Unknown builtin function: {}.", func); }
+    return call(type, *op, args);
+}
+
+void FunctionBuilder::_use_callable(const std::shared_ptr<const FunctionBuilder> &callable, std::span<const Expression *const> args) noexcept {
+    if (callable->tag() != Tag::DEVICE) { LUISA_ERROR_WITH_LOCATION("Calling non-callable function."); }
+    if (callable.get() == this) { LUISA_ERROR_WITH_LOCATION("Recursive calls are not allowed."); }
+    // resources the callable writes through its parameters are written by the arguments passed in
+    auto params = callable->arguments();
+    auto written = callable->written_resources();
+    for (auto i = 0u; i < params.size() && i < args.size(); i++) {
+        if (std::any_of(written.begin(), written.end(), [p = params[i]](auto w) noexcept { return w.uid() == p.uid(); })) {
+            _mark_written(args[i]);
+        }
+    }
+    if (std::find(_custom_callables.cbegin(), _custom_callables.cend(), callable) == _custom_callables.cend()) {
+        _custom_callables.emplace_back(callable);
+    }
+}
+
+const Expression *FunctionBuilder::call(const Type *type, const std::shared_ptr<const FunctionBuilder> &callable, std::span<const Expression *> args) noexcept {
+    _use_callable(callable, args);
+    ArenaVector func_args{_arena, args};
+    return _arena.create<CallExpr>(type, callable.get(), func_args);
+}
+
+const Expression *FunctionBuilder::call(const Type *type, const std::shared_ptr<const FunctionBuilder> &callable, std::initializer_list<const Expression *> args) noexcept {
+    _use_callable(callable, {args.begin(), args.size()});
     ArenaVector func_args{_arena, args};
-    return _arena.create<CallExpr>(type, func_name, func_args);
+    return _arena.create<CallExpr>(type, callable.get(), func_args);
 }
 
 const Expression *FunctionBuilder::cast(const Type *type, CastOp op, const Expression *expr) noexcept {
+    if (auto x = dynamic_cast<const LiteralExpr *>(expr); x != nullptr && op == CastOp::STATIC) {
+        auto folded = std::visit([type](auto v) noexcept -> std::optional<LiteralExpr::Value> {
+            if constexpr (detail::is_scalar_v<decltype(v)>) {
+                switch (type->tag()) {
+                    case Type::Tag::BOOL: return detail::fold_cast<bool>(v);
+                    case Type::Tag::FLOAT: return detail::fold_cast<float>(v);
+                    case Type::Tag::INT8: return detail::fold_cast<int8_t>(v);
+                    case Type::Tag::UINT8: return detail::fold_cast<uint8_t>(v);
+                    case Type::Tag::INT16: return detail::fold_cast<int16_t>(v);
+                    case Type::Tag::UINT16: return detail::fold_cast<uint16_t>(v);
+                    case Type::Tag::INT32: return detail::fold_cast<int32_t>(v);
+                    case Type::Tag::UINT32: return detail::fold_cast<uint32_t>(v);
+                    default: break;
+                }
+            }
+            return std::nullopt;
+        }, x->value());
+        if (auto literal = _folded(type, folded)) { return literal; }
+    }
     return _arena.create<CastExpr>(type, op, expr);
 }
 
+const Expression *FunctionBuilder::select(const Type *type, const Expression *cond, const Expression *t, const Expression *f) noexcept {
+    auto c = cond->type();
+    auto valid_mask = c->tag() == Type::Tag::BOOL ||
+                      (c->is_vector() && c->element()->tag() == Type::Tag::BOOL &&
+                       type->is_vector() && type->dimension() == c->dimension());
+    if (!valid_mask || !(type->is_scalar() || type->is_vector())) {
+        LUISA_ERROR_WITH_LOCATION("Invalid select of {} on {}.", type->description(), c->description());
+    }
+    if (*t->type() != *type || *f->type() != *type) {
+        LUISA_ERROR_WITH_LOCATION("Invalid select of {} between {} and {}.", type->description(), t->type()->description(), f->type()->description());
+    }
+    if (auto literal = dynamic_cast<const LiteralExpr *>(cond); literal != nullptr && std::holds_alternative<bool>(literal->value())) {
+        return std::get<bool>(literal->value()) ? t : f;
+    }
+    return _arena.create<SelectExpr>(type, cond, t, f);
+}
+
+const Expression *FunctionBuilder::texture_read(const Expression *texture, const Expression *coord) noexcept {
+    auto type = Type::from(fmt::format("vector<{},4>", texture->type()->element()->description()));
+    return call(type, CallOp::TEXTURE_READ, {texture, coord});
+}
+
+void FunctionBuilder::texture_write(const Expression *texture, const Expression *coord, const Expression *value) noexcept {
+    void_(call(nullptr, CallOp::TEXTURE_WRITE, {texture, coord, value}));
+}
+
+const Expression *FunctionBuilder::bindless_buffer_read(const Type *elem, const Expression *array, const Expression *slot, const Expression *index) noexcept {
+    return call(elem, CallOp::BINDLESS_BUFFER_READ, {array, slot, index});
+}
+
+void FunctionBuilder::bindless_buffer_write(const Expression *array, const Expression *slot, const Expression *index, const Expression *value) noexcept {
+    void_(call(nullptr, CallOp::BINDLESS_BUFFER_WRITE, {array, slot, index, value}));
+}
+
+const Expression *FunctionBuilder::bindless_texture_read(const Expression *array, const Expression *slot, const Expression *coord) noexcept {
+    return call(Type::of<float4>(), CallOp::BINDLESS_TEXTURE_READ, {array, slot, coord});
+}
+
+// atomics are only meaningful on memory visible to other threads
+static const Type *check_atomic_call(CallOp op, const Expression *ref) noexcept {
+    if (!is_atomic(op)) { LUISA_ERROR_WITH_LOCATION("Builtin function {} is not atomic.", to_string(op)); }
+    auto type = ref->type()->is_atomic() ? ref->type()->element() : ref->type();
+    auto integral = type->tag() == Type::Tag::INT32 || type->tag() == Type::Tag::UINT32;
+    auto bitwise = op == CallOp::ATOMIC_FETCH_AND || op == CallOp::ATOMIC_FETCH_OR || op == CallOp::ATOMIC_FETCH_XOR;
+    if (!integral && (bitwise || type->tag() != Type::Tag::FLOAT)) {
+        LUISA_ERROR_WITH_LOCATION("Invalid type {} for atomic function {}.", ref->type()->description(), to_string(op));
+    }
+    for (auto e = ref;;) {
+        if (auto access = dynamic_cast<const AccessExpr *>(e)) {
+            if (access->range()->type()->is_buffer()) { return type; }
+            e = access->range();
+        } else if (auto member = dynamic_cast<const MemberExpr *>(e)) {
+            e = member->self();
+        } else {
+            if (auto r = dynamic_cast<const RefExpr *>(e); r != nullptr && r->variable().tag() == Variable::Tag::SHARED) { return type; }
+            LUISA_ERROR_WITH_LOCATION("Atomic function {} requires a buffer element or a shared variable.", to_string(op));
+        }
+    }
+}
+
+const Expression *FunctionBuilder::atomic(CallOp op, const Expression *ref, const Expression *value) noexcept {
+    if (op == CallOp::ATOMIC_COMPARE_EXCHANGE) { LUISA_ERROR_WITH_LOCATION("Use atomic_compare_exchange() for compare-and-swap."); }
+    return call(check_atomic_call(op, ref), op, {ref, value});
+}
+
+const Expression *FunctionBuilder::atomic_compare_exchange(const Expression *ref, const Expression *expected, const Expression *desired) noexcept {
+    return call(check_atomic_call(CallOp::ATOMIC_COMPARE_EXCHANGE, ref), CallOp::ATOMIC_COMPARE_EXCHANGE, {ref, expected, desired});
+}
+
 const Expression *FunctionBuilder::ref(Variable v) noexcept {
     return _arena.create<RefExpr>(v);
 }
@@ -6,10 +6,13 @@
 
 #include "function.h"
 #include <vector>
+#include <optional>
 #include <fmt/format.h>
 
 #include <core/memory.h>
 #include <runtime/buffer.h>
+#include <runtime/texture.h>
+#include <runtime/bindless_array.h>
 #include <ast/statement.h>
 #include <ast/variable.h>
 #include <ast/expression.h>
@@ -20,26 +23,38 @@ namespace luisa::compute {
 struct Statement;
 struct Expression;
 
+namespace detail {
+class FunctionSpecializer;
+class FunctionDifferentiator;
+}
+
 class FunctionBuilder {
 
+    friend class detail::FunctionSpecializer;
+    friend class detail::FunctionDifferentiator;
+
 public:
     using Tag = Function::Tag;
     using ConstantData = Function::ConstantData;
     using BufferBinding = Function::BufferBinding;
     using TextureBinding = Function::TextureBinding;
+    using BindlessArrayBinding = Function::BindlessArrayBinding;
     using UniformBinding = Function::UniformBinding;
 
 private:
     Arena _arena;
-    ScopeStmt *_body;
+    const ScopeStmt *_body;
     ArenaVector<ArenaVector<const Statement *>> _scope_stack;
     ArenaVector<Variable> _builtin_variables;
     ArenaVector<Variable> _shared_variables;
     ArenaVector<ConstantData> _constant_variables;
     ArenaVector<BufferBinding> _captured_buffers;
     ArenaVector<TextureBinding> _captured_textures;
+    ArenaVector<BindlessArrayBinding> _captured_bindless_arrays;
     ArenaVector<UniformBinding> _captured_uniforms;
     ArenaVector<Variable> _arguments;
+    ArenaVector<Variable> _written_resources;
+    std::vector<std::shared_ptr<const FunctionBuilder>> _custom_callables;
     Tag _tag;
     uint32_t _variable_counter{0u};
 
@@ -51,13 +66,19 @@ private:
     static FunctionBuilder *_pop() noexcept;
 
     void _add(const Statement *statement) noexcept;
+    void _use_callable(const std::shared_ptr<const FunctionBuilder> &callable, std::span<const Expression *const> args) noexcept;
+    void _mark_written(const Expression *expr) noexcept;
 
     [[nodiscard]] const Expression *_literal(const Type *type, LiteralExpr::Value value) noexcept;
+    [[nodiscard]] const Expression *_folded(const Type *type, std::optional<LiteralExpr::Value> value) noexcept;
     [[nodiscard]] Variable _constant(const Type *type, const void *data) noexcept;
     [[nodiscard]] Variable _builtin(Variable::Tag tag) noexcept;
     [[nodiscard]] Variable _uniform_binding(const Type *type, const void *data) noexcept;
     [[nodiscard]] Variable _buffer_binding(const Type *type, uint64_t handle, size_t offset_bytes) noexcept;
-    [[nodiscard]] Variable _texture_binding(const Type *type, uint64_t handle) noexcept;
+    [[nodiscard]] Variable _texture_binding(const Type *type, uint64_t handle, uint32_t level) noexcept;
+    [[nodiscard]] Variable _bindless_array_binding(uint64_t handle) noexcept;
+    // re-creates a variable captured by or built into another function in this one
+    [[nodiscard]] Variable _rebind(Function function, Variable v) noexcept;
 
 public:
     explicit FunctionBuilder(Tag tag) noexcept
@@ -68,12 +89,36 @@ public:
           _constant_variables{_arena},
           _captured_buffers{_arena},
           _captured_textures{_arena},
+          _captured_bindless_arrays{_arena},
           _captured_uniforms{_arena},
           _arguments{_arena},
+          _written_resources{_arena},
           _tag{tag} {}
 
     [[nodiscard]] static FunctionBuilder *current() noexcept;
 
+    // loops unrolled by default, and the most iterations a differentiated loop may take
+    static constexpr auto max_unrolled_trip_count = 16u;
+    // statements a fully unrolled loop may expand to, counting its body once per iteration
+    static constexpr auto max_fully_unrolled_statements = 1024u;
+
+    // re-traces the kernel with the given captured uniforms replaced by literals of their
+    // current host values, folding the expressions and branches that become constant
+    [[nodiscard]] static std::shared_ptr<FunctionBuilder> specialize(Function kernel, std::span<const Variable> uniforms) noexcept;
+    // re-traces the kernel with for loops of constant trip counts of up to max_trip_count
+    // iterations fully unrolled, besides those with explicit unroll hints
+    [[nodiscard]] static std::shared_ptr<FunctionBuilder> unroll(Function kernel, uint32_t max_trip_count = max_unrolled_trip_count) noexcept;
+    // re-traces the kernel with ifs whose branches only assign to locals replaced by selects,
+    // if evaluating both branches costs at most max_cost operations (see CallOpInfo::cost)
+    [[nodiscard]] static std::shared_ptr<FunctionBuilder> if_convert(Function kernel, uint32_t max_cost = 8u) noexcept;
+    // reverse-mode differentiation: the gradient kernel takes the arguments of the kernel followed by a gradient
+    // buffer for each float buffer argument, which holds the adjoints of the values stored to buffers written by
+    // the kernel and receives the gradients of those read from, accumulated with atomics. Values the gradients
+    // depend on are recomputed if that costs at most recompute_cost operations, otherwise they are kept in locals.
+    // Loops are unrolled, so they must take a constant number of iterations, at most max_unrolled_trip_count.
+    // Stores to other buffers holding floats, e.g. of vectors, are rejected, as their gradients would be lost
+    [[nodiscard]] static std::shared_ptr<FunctionBuilder> differentiate(Function kernel, uint32_t recompute_cost = 8u) noexcept;
+
     template<typename Def>
     void define(Def &&def) noexcept {
         if (_body != nullptr) { LUISA_ERROR_WITH_LOCATION("Multiple definition."); }
@@ -87,8 +132,11 @@ public:
     [[nodiscard]] auto constant_variables() const noexcept { return std::span{_constant_variables.data(), _constant_variables.size()}; }
     [[nodiscard]] auto captured_buffers() const noexcept { return std::span{_captured_buffers.data(), _captured_buffers.size()}; }
     [[nodiscard]] auto captured_textures() const noexcept { return std::span{_captured_textures.data(), _captured_textures.size()}; }
+    [[nodiscard]] auto captured_bindless_arrays() const noexcept { return std::span{_captured_bindless_arrays.data(), _captured_bindless_arrays.size()}; }
     [[nodiscard]] auto captured_uniforms() const noexcept { return std::span{_captured_uniforms.data(), _captured_uniforms.size()}; }
     [[nodiscard]] auto arguments() const noexcept { return std::span{_arguments.data(), _arguments.size()}; }
+    [[nodiscard]] auto written_resources() const noexcept { return std::span{_written_resources.data(), _written_resources.size()}; }
+    [[nodiscard]] auto custom_callables() const noexcept { return std::span{_custom_callables}; }
     [[nodiscard]] auto tag() const noexcept { return _tag; }
     [[nodiscard]] auto body() const noexcept { return _body; }
 
@@ -128,12 +176,22 @@ public:
         return _buffer_binding(Type::of<BufferView<T>>(), bv.handle(), bv.offset_bytes());
     }
 
-    [[nodiscard]] Variable texture_binding(const Type *type, uint64_t handle) noexcept;
+    [[nodiscard]] Variable texture_binding(TextureView tv) noexcept {
+        return _texture_binding(texture_type(tv.format(), tv.dimension()), tv.handle(), tv.level());
+    }
+
+    [[nodiscard]] Variable bindless_array_binding(const BindlessArray &array) noexcept {
+        return _bindless_array_binding(array.handle());
+    }
+
+    // texture<dimension,T>, where T is the scalar type returned by reads
+    [[nodiscard]] static const Type *texture_type(PixelFormat format, uint32_t dimension) noexcept;
 
     // explicit arguments
     [[nodiscard]] Variable uniform(const Type *type) noexcept;
     [[nodiscard]] Variable buffer(const Type *type) noexcept;
     [[nodiscard]] Variable texture(const Type *type) noexcept;
+    [[nodiscard]] Variable bindless_array() noexcept;
 
     // expressions
     template<typename T>
@@ -143,27 +201,54 @@ public:
     [[nodiscard]] const Expression *binary(const Type *type, BinaryOp op, const Expression *lhs, const Expression *rhs) noexcept;
     [[nodiscard]] const Expression *member(const Type *type, const Expression *self, size_t member_index) noexcept;
     [[nodiscard]] const Expression *access(const Type *type, const Expression *range, const Expression *index) noexcept;
+    [[nodiscard]] const Expression *call(const Type *type /* nullptr for void */, CallOp op, std::span<const Expression *> args) noexcept;
+    [[nodiscard]] const Expression *call(const Type *type /* nullptr for void */, CallOp op, std::initializer_list<const Expression *> args) noexcept;
+    // resolves the builtin by name once, when the call is built
     [[nodiscard]] const Expression *call(const Type *type /* nullptr for void */, std::string_view func, std::span<const Expression *> args) noexcept;
     [[nodiscard]] const Expression *call(const Type *type /* nullptr for void */, std::string_view func, std::initializer_list<const Expression *> args) noexcept;
+    [[nodiscard]] const Expression *call(const Type *type /* nullptr for void */, const std::shared_ptr<const FunctionBuilder> &callable, std::span<const Expression *> args) noexcept;
+    [[nodiscard]] const Expression *call(const Type *type /* nullptr for void */, const std::shared_ptr<const FunctionBuilder> &callable, std::initializer_list<const Expression *> args) noexcept;
     [[nodiscard]] const Expression *cast(const Type *type, CastOp op, const Expression *expr) noexcept;
+    [[nodiscard]] const Expression *select(const Type *type, const Expression *cond, const Expression *t, const Expression *f) noexcept;
+
+    // texture access, texel coordinates are uint2/uint3 and texels are 4-component vectors
+    [[nodiscard]] const Expression *texture_read(const Expression *texture, const Expression *coord) noexcept;
+    void texture_write(const Expression *texture, const Expression *coord, const Expression *value) noexcept;
+
+    // bindless access, slots are uint; textures in a bindless array are read as float4
+    [[nodiscard]] const Expression *bindless_buffer_read(const Type *elem, const Expression *array, const Expression *slot, const Expression *index) noexcept;
+    void bindless_buffer_write(const Expression *array, const Expression *slot, const Expression *index, const Expression *value) noexcept;
+    [[nodiscard]] const Expression *bindless_texture_read(const Expression *array, const Expression *slot, const Expression *coord) noexcept;
+
+    // atomics on int, uint or float buffer elements and shared variables, returning the old value
+    [[nodiscard]] const Expression *atomic(CallOp op, const Expression *ref, const Expression *value) noexcept;
+    [[nodiscard]] const Expression *atomic_compare_exchange(const Expression *ref, const Expression *expected, const Expression *desired) noexcept;
 
     // statements
     void break_() noexcept;
     void continue_() noexcept;
     void return_(const Expression *expr = nullptr /* nullptr for void */) noexcept;
+    void sync_block() noexcept;
 
     template<typename Body>
-    const Statement *scope(Body &&body) noexcept {
+    const ScopeStmt *scope(Body &&body) noexcept {
         _scope_stack.emplace_back(ArenaVector<const Statement *>(_arena));
         body();
         auto stmt = _arena.create<ScopeStmt>(_scope_stack.back());
         _scope_stack.pop_back();
         return stmt;
     }
+    // statements traced into the innermost scope so far, so that builders emitting a statement
+    // after tracing its parts can check that nothing else was traced in the meantime
+    [[nodiscard]] size_t scope_size() const noexcept { return _scope_stack.empty() ? 0u : _scope_stack.back().size(); }
 
     void if_(const Expression *cond, const Statement *true_branch) noexcept;
     void if_(const Expression *cond, const Statement *true_branch, const Statement *false_branch) noexcept;
     void while_(const Expression *cond, const Statement *body) noexcept;
+    // induction variables are declared by their loops, so they are created before the loop is built
+    [[nodiscard]] Variable for_variable(const Type *type) noexcept;
+    void for_(Variable variable, const Expression *init, const Expression *cond, const Expression *step,
+              const Statement *body, LoopUnroll unroll = ForStmt::unroll_auto) noexcept;
     void void_(const Expression *expr) noexcept;
     void switch_(const Expression *expr, const Statement *body) noexcept;
     void case_(const Expression *expr, const Statement *body) noexcept;
@@ -0,0 +1,750 @@
+//
+// Created by Mike Smith on 2021/3/23.
+//
+
+#include <map>
+#include <utility>
+#include <algorithm>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <ast/function_builder.h>
+#include <ast/speculation_cost.h>
+
+namespace luisa::compute {
+
+namespace detail {
+
+// Reverse-mode differentiation by re-tracing the kernel. The forward pass is replayed with the locals
+// of the kernel replaced by the values assigned to them, so every value the gradients depend on stays
+// available: branches are predicated and merged with selects, and loops are unrolled. The reverse pass
+// then walks the values backwards, branching on the predicates of the values it propagates through.
+// Values are recomputed where the reverse pass needs them, unless that is too expensive, in which case
+// they are checkpointed in locals; buffer loads are always checkpointed. Nothing is kept in shared memory.
+class FunctionDifferentiator final : public ExprVisitor, public StmtVisitor {
+
+private:
+    struct Node {
+        const Expression *expression;
+        const Expression *predicate;// nullptr on all threads
+    };
+
+    struct Load {
+        uint32_t buffer;
+        const Expression *index;
+    };
+
+    struct Store {
+        uint32_t buffer;
+        const Expression *index;
+        const Expression *value;
+        const Expression *predicate;
+    };
+
+    Function _kernel;
+    FunctionBuilder *_f;
+    uint32_t _recompute_cost;
+    std::unordered_map<uint32_t, Variable> _variables;
+    std::map<uint32_t, const Expression *> _values;// current values of the locals of the kernel
+    std::unordered_map<uint32_t, Variable> _gradients;// by the uids of the buffer arguments in _f
+    std::unordered_set<uint32_t> _read_buffers;
+    std::unordered_set<uint32_t> _written_buffers;
+    std::vector<Node> _nodes;// in the order they are computed, so operands come first
+    std::unordered_map<const Expression *, size_t> _node_indices;
+    std::unordered_map<const Expression *, const Expression *> _checkpoints;// values by the refs to their locals
+    std::unordered_map<const Expression *, Load> _loads;
+    std::vector<Store> _stores;
+    const Expression *_predicate{nullptr};
+    const Expression *_result{nullptr};
+
+    // reverse pass
+    std::unordered_set<const Expression *> _live;
+    std::unordered_map<const Expression *, Variable> _adjoint_locals;
+    std::unordered_map<const Expression *, const Expression *> _adjoints;// of values used once, in the same branch
+
+private:
+    [[nodiscard]] static bool _differentiable(const Type *type) noexcept {
+        return type != nullptr &&
+               (type->tag() == Type::Tag::FLOAT || (type->is_vector() && type->element()->tag() == Type::Tag::FLOAT));
+    }
+
+    [[nodiscard]] static bool _is_literal(const Expression *expr) noexcept {
+        return dynamic_cast<const LiteralExpr *>(expr) != nullptr;
+    }
+
+    // results depending on the other threads of the warp, whose adjoints would have to flow between lanes
+    [[nodiscard]] static bool _is_cross_lane(CallOp op) noexcept {
+        switch (op) {
+            case CallOp::WARP_ACTIVE_ALL:
+            case CallOp::WARP_ACTIVE_ANY:
+            case CallOp::WARP_ACTIVE_BALLOT:
+            case CallOp::WARP_READ_LANE:
+            case CallOp::WARP_READ_FIRST_ACTIVE_LANE:
+            case CallOp::WARP_ACTIVE_SUM:
+            case CallOp::WARP_PREFIX_SUM:
+            case CallOp::WARP_INCLUSIVE_SUM: return true;
+            default: return false;
+        }
+    }
+
+    const Expression *_register(const Expression *expr) noexcept {
+        if (_node_indices.try_emplace(expr, _nodes.size()).second) { _nodes.emplace_back(Node{expr, _predicate}); }
+        return expr;
+    }
+
+    // stores of other values carry no gradients and are dropped
+    [[nodiscard]] static bool _holds_float(const Type *type) noexcept {
+        if (type->is_structure()) {
+            auto members = type->members();
+            return std::any_of(members.begin(), members.end(), [](auto m) noexcept { return _holds_float(m); });
+        }
+        if (type->is_vector() || type->is_matrix() || type->is_array() || type->is_atomic()) { return _holds_float(type->element()); }
+        return type->tag() == Type::Tag::FLOAT;
+    }
+
+    [[nodiscard]] const Expression *_trace(const Expression *expr) noexcept {
+        expr->accept(*this);
+        return _register(_result);
+    }
+
+    [[nodiscard]] const Expression *_rewrite(const Expression *expr) noexcept { return _bind(_trace(expr)); }
+
+    // evaluates the value into a local, on the threads taking the current branch
+    [[nodiscard]] const Expression *_evaluate(const Expression *value) noexcept {
+        auto v = _predicate == nullptr ? _f->local(value->type(), {value}) : _f->local(value->type(), {});
+        if (_predicate != nullptr) {
+            _f->if_(_predicate, _f->scope([&] { _f->assign(AssignOp::ASSIGN, _f->ref(v), value); }));
+        }
+        return _register(_f->ref(v));
+    }
+
+    [[nodiscard]] const Expression *_checkpoint(const Expression *value) noexcept {
+        if (_is_literal(value) || dynamic_cast<const RefExpr *>(value) != nullptr) { return value; }
+        auto ref = _evaluate(value);
+        _checkpoints.emplace(ref, value);
+        return ref;
+    }
+
+    // keeps values symbolic if recomputing them where they are used, including by the
+    // partial derivatives of the values computed from them, is cheap enough
+    [[nodiscard]] const Expression *_bind(const Expression *value) noexcept {
+        auto cost = SpeculationCost{value}.cost();
+        return cost && *cost <= _recompute_cost ? value : _checkpoint(value);
+    }
+
+    [[nodiscard]] Variable _variable(Variable v) noexcept {
+        if (v.tag() == Variable::Tag::SHARED) { LUISA_ERROR_WITH_LOCATION("Shared variables cannot be differentiated."); }
+        if (auto iter = _variables.find(v.uid()); iter != _variables.cend()) { return iter->second; }
+        return _variables.emplace(v.uid(), _f->_rebind(_kernel, v)).first->second;
+    }
+
+    [[nodiscard]] static const Type *_vector_type(const Type *element, size_t n) noexcept {
+        return Type::from(fmt::format("vector<{},{}>", element->description(), n));
+    }
+
+    [[nodiscard]] const Expression *_broadcast(const Expression *scalar, const Type *type) noexcept {
+        std::vector<const Expression *> args(type->dimension(), scalar);
+        return _f->call(type, CallOp::MAKE_VECTOR, args);
+    }
+
+    // scalars are broadcast to the vectors they are combined with
+    [[nodiscard]] const Expression *_arithmetic(BinaryOp op, const Expression *lhs, const Expression *rhs) noexcept {
+        if (lhs->type()->is_vector() && rhs->type()->is_scalar()) { rhs = _broadcast(rhs, lhs->type()); }
+        if (lhs->type()->is_scalar() && rhs->type()->is_vector()) { lhs = _broadcast(lhs, rhs->type()); }
+        return _f->binary(lhs->type(), op, lhs, rhs);
+    }
+
+    [[nodiscard]] const Expression *_compare(BinaryOp op, const Expression *lhs, const Expression *rhs) noexcept {
+        if (lhs->type()->is_vector() && rhs->type()->is_scalar()) { rhs = _broadcast(rhs, lhs->type()); }
+        if (lhs->type()->is_scalar() && rhs->type()->is_vector()) { lhs = _broadcast(lhs, rhs->type()); }
+        auto type = lhs->type()->is_vector() ? _vector_type(Type::of<bool>(), lhs->type()->dimension()) : Type::of<bool>();
+        return _f->binary(type, op, lhs, rhs);
+    }
+
+    [[nodiscard]] const Expression *_add(const Expression *lhs, const Expression *rhs) noexcept { return _arithmetic(BinaryOp::ADD, lhs, rhs); }
+    [[nodiscard]] const Expression *_sub(const Expression *lhs, const Expression *rhs) noexcept { return _arithmetic(BinaryOp::SUB, lhs, rhs); }
+    [[nodiscard]] const Expression *_mul(const Expression *lhs, const Expression *rhs) noexcept { return _arithmetic(BinaryOp::MUL, lhs, rhs); }
+    [[nodiscard]] const Expression *_div(const Expression *lhs, const Expression *rhs) noexcept { return _arithmetic(BinaryOp::DIV, lhs, rhs); }
+    [[nodiscard]] const Expression *_neg(const Expression *x) noexcept { return _f->unary(x->type(), UnaryOp::MINUS, x); }
+    [[nodiscard]] const Expression *_scalar(float x) noexcept { return _f->literal(x); }
+    [[nodiscard]] const Expression *_call(CallOp op, const Expression *x) noexcept { return _f->call(x->type(), op, {x}); }
+
+    [[nodiscard]] const Expression *_zero(const Type *type) noexcept {
+        if (type->is_scalar()) { return _f->literal(0.0f); }
+        switch (type->dimension()) {
+            case 2u: return _f->literal(float2{});
+            case 3u: return _f->literal(float3{});
+            default: return _f->literal(float4{});
+        }
+    }
+
+    [[nodiscard]] const Expression *_select(const Expression *cond, const Expression *t, const Expression *f) noexcept {
+        if (t->type()->is_scalar() && f->type()->is_vector()) { t = _broadcast(t, f->type()); }
+        if (f->type()->is_scalar() && t->type()->is_vector()) { f = _broadcast(f, t->type()); }
+        if (cond->type()->is_vector() && t->type()->is_scalar()) {
+            t = _broadcast(t, _vector_type(t->type(), cond->type()->dimension()));
+            f = _broadcast(f, t->type());
+        }
+        return _f->select(t->type(), cond, t, f);
+    }
+
+    // the vector with x in the component at the index and zeros elsewhere
+    [[nodiscard]] const Expression *_component(const Type *type, const Expression *index, const Expression *x) noexcept {
+        std::vector<const Expression *> components;
+        components.reserve(type->dimension());
+        for (auto i = 0u; i < type->dimension(); i++) {
+            auto k = index->type()->tag() == Type::Tag::INT32 ? _f->literal(static_cast<int>(i)) : _f->literal(i);
+            components.emplace_back(_f->select(x->type(), _f->binary(Type::of<bool>(), BinaryOp::EQUAL, index, k), x, _f->literal(0.0f)));
+        }
+        return _f->call(type, CallOp::MAKE_VECTOR, components);
+    }
+
+    // sums up the components of adjoints of values broadcast from scalars, and broadcasts scalars to vectors
+    [[nodiscard]] const Expression *_fit(const Expression *x, const Type *type) noexcept {
+        if (type->is_scalar() && x->type()->is_vector()) {
+            auto sum = _f->member(type, x, 0u);
+            for (auto i = 1u; i < x->type()->dimension(); i++) { sum = _add(sum, _f->member(type, x, i)); }
+            return sum;
+        }
+        if (type->is_vector() && x->type()->is_scalar()) { return _broadcast(x, type); }
+        return x;
+    }
+
+    [[nodiscard]] std::vector<const Expression *> _operands(const Expression *expr) const noexcept {
+        std::vector<const Expression *> operands;
+        if (auto checkpoint = _checkpoints.find(expr); checkpoint != _checkpoints.cend()) {
+            operands.emplace_back(checkpoint->second);
+        } else if (auto unary = dynamic_cast<const UnaryExpr *>(expr)) {
+            operands.emplace_back(unary->operand());
+        } else if (auto binary = dynamic_cast<const BinaryExpr *>(expr)) {
+            operands.emplace_back(binary->lhs());
+            operands.emplace_back(binary->rhs());
+        } else if (auto member = dynamic_cast<const MemberExpr *>(expr)) {
+            operands.emplace_back(member->self());
+        } else if (auto access = dynamic_cast<const AccessExpr *>(expr); access != nullptr && access->range()->type()->is_vector()) {
+            operands.emplace_back(access->range());
+        } else if (auto call = dynamic_cast<const CallExpr *>(expr); call != nullptr && call_op_info(call->op()).pure) {
+            for (auto arg : call->arguments()) { operands.emplace_back(arg); }
+        } else if (auto cast = dynamic_cast<const CastExpr *>(expr)) {
+            operands.emplace_back(cast->expression());
+        } else if (auto select = dynamic_cast<const SelectExpr *>(expr)) {
+            operands.emplace_back(select->true_value());
+            operands.emplace_back(select->false_value());
+        }
+        std::erase_if(operands, [](auto x) noexcept { return !_differentiable(x->type()) || _is_literal(x); });
+        return operands;
+    }
+
+    void _accumulate(const Expression *expr, const Expression *adjoint) noexcept {
+        if (!_differentiable(expr->type()) || _is_literal(expr)) { return; }
+        adjoint = _fit(adjoint, expr->type());
+        if (auto local = _adjoint_locals.find(expr); local != _adjoint_locals.cend()) {
+            _f->assign(AssignOp::ADD_ASSIGN, _f->ref(local->second), adjoint);
+        } else if (auto [iter, first] = _adjoints.try_emplace(expr, adjoint); !first) {
+            iter->second = _add(iter->second, adjoint);
+        }
+    }
+
+    // chain rule through the operation computing the value, with its adjoint complete
+    void _propagate(const Expression *expr) noexcept {
+        auto adjoint = [this, expr]() noexcept -> const Expression * {
+            if (auto local = _adjoint_locals.find(expr); local != _adjoint_locals.cend()) { return _f->ref(local->second); }
+            auto iter = _adjoints.find(expr);
+            return iter == _adjoints.cend() ? nullptr : iter->second;
+        }();
+        if (adjoint == nullptr) { return; }
+        if (auto checkpoint = _checkpoints.find(expr); checkpoint != _checkpoints.cend()) {
+            _accumulate(checkpoint->second, adjoint);
+            return;
+        }
+        if (auto load = _loads.find(expr); load != _loads.cend()) {
+            if (auto gradient = _gradients.find(load->second.buffer); gradient != _gradients.cend()) {
+                auto element = _f->access(expr->type(), _f->ref(gradient->second), load->second.index);
+                _f->void_(_f->atomic(CallOp::ATOMIC_FETCH_ADD, element, adjoint));
+            }
+            return;
+        }
+        // adjoints used more than once are evaluated once
+        if (_operands(expr).size() > 1u && dynamic_cast<const RefExpr *>(adjoint) == nullptr) {
+            adjoint = _f->ref(_f->local(adjoint->type(), {adjoint}));
+        }
+        auto one = _scalar(1.0f);
+        if (auto unary = dynamic_cast<const UnaryExpr *>(expr)) {
+            if (unary->op() == UnaryOp::PLUS) { _accumulate(unary->operand(), adjoint); }
+            if (unary->op() == UnaryOp::MINUS) { _accumulate(unary->operand(), _neg(adjoint)); }
+        } else if (auto binary = dynamic_cast<const BinaryExpr *>(expr)) {
+            auto a = binary->lhs();
+            auto b = binary->rhs();
+            if (a->type()->is_matrix() || b->type()->is_matrix()) {
+                LUISA_ERROR_WITH_LOCATION("Matrix operations cannot be differentiated.");
+            }
+            switch (binary->op()) {
+                case BinaryOp::ADD:
+                    _accumulate(a, adjoint);
+                    _accumulate(b, adjoint);
+                    break;
+                case BinaryOp::SUB:
+                    _accumulate(a, adjoint);
+                    _accumulate(b, _neg(adjoint));
+                    break;
+                case BinaryOp::MUL:
+                    _accumulate(a, _mul(adjoint, b));
+                    _accumulate(b, _mul(adjoint, a));
+                    break;
+                case BinaryOp::DIV:
+                    _accumulate(a, _div(adjoint, b));
+                    _accumulate(b, _neg(_mul(adjoint, _div(expr, b))));
+                    break;
+                case BinaryOp::MOD:// a - trunc(a / b) * b
+                    _accumulate(a, adjoint);
+                    _accumulate(b, _neg(_mul(adjoint, _div(_sub(a, expr), b))));
+                    break;
+                default: break;
+            }
+        } else if (auto member = dynamic_cast<const MemberExpr *>(expr)) {
+            auto self = member->self();
+            _accumulate(self, _component(self->type(), _f->literal(static_cast<uint>(member->member_index())), adjoint));
+        } else if (auto access = dynamic_cast<const AccessExpr *>(expr); access != nullptr && access->range()->type()->is_vector()) {
+            _accumulate(access->range(), _component(access->range()->type(), access->index(), adjoint));
+        } else if (auto cast = dynamic_cast<const CastExpr *>(expr)) {
+            _accumulate(cast->expression(), adjoint);
+        } else if (auto select = dynamic_cast<const SelectExpr *>(expr)) {
+            auto zero = _zero(expr->type());
+            _accumulate(select->true_value(), _select(select->condition(), adjoint, zero));
+            _accumulate(select->false_value(), _select(select->condition(), zero, adjoint));
+        } else if (auto call = dynamic_cast<const CallExpr *>(expr)) {
+            auto args = call->arguments();
+            auto x = args.empty() ? nullptr : args[0];
+            auto y = args.size() < 2u ? nullptr : args[1];
+            auto z = args.size() < 3u ? nullptr : args[2];
+            auto zero = _zero(expr->type());
+            static constexpr auto ln2 = 0.69314718055994530942f;
+            switch (call->op()) {
+                case CallOp::ABS: _accumulate(x, _select(_compare(BinaryOp::LESS, x, _scalar(0.0f)), _neg(adjoint), adjoint)); break;
+                case CallOp::SQRT: _accumulate(x, _div(_mul(adjoint, _scalar(0.5f)), expr)); break;
+                case CallOp::RSQRT: _accumulate(x, _neg(_mul(_mul(adjoint, _scalar(0.5f)), _div(expr, x)))); break;
+                case CallOp::SIN: _accumulate(x, _mul(adjoint, _call(CallOp::COS, x))); break;
+                case CallOp::COS: _accumulate(x, _neg(_mul(adjoint, _call(CallOp::SIN, x)))); break;
+                case CallOp::TAN: _accumulate(x, _mul(adjoint, _add(_mul(expr, expr), one))); break;
+                case CallOp::ASIN: _accumulate(x, _div(adjoint, _call(CallOp::SQRT, _sub(one, _mul(x, x))))); break;
+                case CallOp::ACOS: _accumulate(x, _neg(_div(adjoint, _call(CallOp::SQRT, _sub(one, _mul(x, x)))))); break;
+                case CallOp::ATAN: _accumulate(x, _div(adjoint, _add(_mul(x, x), one))); break;
+                case CallOp::EXP: _accumulate(x, _mul(adjoint, expr)); break;
+                case CallOp::EXP2: _accumulate(x, _mul(adjoint, _mul(expr, _scalar(ln2)))); break;
+                case CallOp::LOG: _accumulate(x, _div(adjoint, x)); break;
+                case CallOp::LOG2: _accumulate(x, _div(adjoint, _mul(x, _scalar(ln2)))); break;
+                case CallOp::FRACT: _accumulate(x, adjoint); break;
+                case CallOp::SATURATE:
+                    _accumulate(x, _select(_compare(BinaryOp::LESS, x, _scalar(0.0f)), zero,
+                                           _select(_compare(BinaryOp::GREATER, x, one), zero, adjoint)));
+                    break;
+                case CallOp::MIN: {
+                    auto taken = _compare(BinaryOp::LESS_EQUAL, x, y);
+                    _accumulate(x, _select(taken, adjoint, zero));
+                    _accumulate(y, _select(taken, zero, adjoint));
+                    break;
+                }
+                case CallOp::MAX: {
+                    auto taken = _compare(BinaryOp::GREATER_EQUAL, x, y);
+                    _accumulate(x, _select(taken, adjoint, zero));
+                    _accumulate(y, _select(taken, zero, adjoint));
+                    break;
+                }
+                case CallOp::POW:
+                    _accumulate(x, _mul(_mul(adjoint, y), _f->call(x->type(), CallOp::POW, {x, _sub(y, one)})));
+                    _accumulate(y, _mul(_mul(adjoint, expr), _call(CallOp::LOG, x)));
+                    break;
+                case CallOp::ATAN2: {// atan2(x, y) = atan(x / y)
+                    auto r2 = _add(_mul(x, x), _mul(y, y));
+                    _accumulate(x, _div(_mul(adjoint, y), r2));
+                    _accumulate(y, _neg(_div(_mul(adjoint, x), r2)));
+                    break;
+                }
+                case CallOp::CLAMP: {
+                    auto below = _compare(BinaryOp::LESS, x, y);
+                    auto above = _compare(BinaryOp::GREATER, x, z);
+                    _accumulate(x, _select(below, zero, _select(above, zero, adjoint)));
+                    _accumulate(y, _select(below, adjoint, zero));
+                    _accumulate(z, _select(below, zero, _select(above, adjoint, zero)));
+                    break;
+                }
+                case CallOp::LERP:
+                    _accumulate(x, _mul(adjoint, _sub(one, z)));
+                    _accumulate(y, _mul(adjoint, z));
+                    _accumulate(z, _mul(adjoint, _sub(y, x)));
+                    break;
+                case CallOp::FMA:
+                    _accumulate(x, _mul(adjoint, y));
+                    _accumulate(y, _mul(adjoint, x));
+                    _accumulate(z, adjoint);
+                    break;
+                case CallOp::LENGTH: _accumulate(x, _mul(x, _div(adjoint, expr))); break;
+                case CallOp::NORMALIZE: {
+                    auto projected = _f->call(Type::of<float>(), CallOp::DOT, {adjoint, expr});
+                    auto length = _f->call(Type::of<float>(), CallOp::LENGTH, {x});
+                    _accumulate(x, _div(_sub(adjoint, _mul(expr, projected)), length));
+                    break;
+                }
+                case CallOp::DOT:
+                    _accumulate(x, _mul(y, adjoint));
+                    _accumulate(y, _mul(x, adjoint));
+                    break;
+                case CallOp::CROSS:
+                    _accumulate(x, _f->call(x->type(), CallOp::CROSS, {y, adjoint}));
+                    _accumulate(y, _f->call(x->type(), CallOp::CROSS, {adjoint, x}));
+                    break;
+                case CallOp::MAKE_VECTOR: {
+                    if (args.size() == 1u) {
+                        _accumulate(x, adjoint);
+                        break;
+                    }
+                    auto offset = 0u;
+                    for (auto arg : args) {
+                        auto type = arg->type();
+                        if (type->is_scalar()) {
+                            _accumulate(arg, _f->member(type, adjoint, offset++));
+                        } else {
+                            std::vector<const Expression *> components;
+                            for (auto i = 0u; i < type->dimension(); i++) { components.emplace_back(_f->member(type->element(), adjoint, offset++)); }
+                            _accumulate(arg, _f->call(type, CallOp::MAKE_VECTOR, components));
+                        }
+                    }
+                    break;
+                }
+                default: break;// floor, ceil and round are piecewise constant
+            }
+        }
+    }
+
+    void _reverse() noexcept {
+        // a value needs a local for its adjoint if it is used more than once, or by values in other branches
+        std::vector<size_t> runs(_nodes.size());
+        for (auto i = 1u; i < _nodes.size(); i++) {
+            runs[i] = runs[i - 1u] + (_nodes[i].predicate != _nodes[i - 1u].predicate);
+        }
+        std::unordered_map<const Expression *, uint32_t> uses;
+        std::unordered_set<const Expression *> shared;
+        auto use = [&](const Expression *expr, std::optional<size_t> run) noexcept {
+            _live.emplace(expr);
+            if (++uses[expr] > 1u || run != runs[_node_indices.at(expr)]) { shared.emplace(expr); }
+        };
+        for (auto &&s : _stores) {
+            if (!_differentiable(s.value->type()) || _is_literal(s.value)) { continue; }
+            // seeds on all threads are read where they are used
+            use(s.value, s.predicate == nullptr ? std::optional{runs[_node_indices.at(s.value)]} : std::nullopt);
+        }
+        for (auto i = _nodes.size(); i > 0u; i--) {
+            auto expr = _nodes[i - 1u].expression;
+            if (!_live.contains(expr)) { continue; }
+            for (auto operand : _operands(expr)) { use(operand, runs[i - 1u]); }
+        }
+        for (auto &&node : _nodes) {
+            if (shared.contains(node.expression)) {
+                _adjoint_locals.emplace(node.expression, _f->local(node.expression->type(), {_zero(node.expression->type())}));
+            }
+        }
+        for (auto &&s : _stores) {
+            if (!_live.contains(s.value)) { continue; }
+            auto seed = [&] {
+                auto gradient = _gradients.at(s.buffer);
+                _accumulate(s.value, _f->access(s.value->type(), _f->ref(gradient), s.index));
+            };
+            if (s.predicate == nullptr || !_adjoint_locals.contains(s.value)) {
+                seed();
+            } else {
+                _f->if_(s.predicate, _f->scope(seed));
+            }
+        }
+        for (auto end = _nodes.size(); end > 0u;) {
+            auto begin = end - 1u;
+            while (begin > 0u && runs[begin - 1u] == runs[end - 1u]) { begin--; }
+            if (std::any_of(_nodes.cbegin() + begin, _nodes.cbegin() + end, [this](auto &&n) noexcept { return _live.contains(n.expression); })) {
+                auto run = [&] {
+                    for (auto i = end; i > begin; i--) { _propagate(_nodes[i - 1u].expression); }
+                };
+                if (auto predicate = _nodes[begin].predicate; predicate == nullptr) {
+                    run();
+                } else {
+                    _f->if_(predicate, _f->scope(run));
+                }
+            }
+            end = begin;
+        }
+    }
+
+    void _assign(uint32_t uid, const Expression *value) noexcept {
+        _values.insert_or_assign(uid, _bind(_register(value)));
+    }
+
+public:
+    FunctionDifferentiator(Function kernel, FunctionBuilder *f, uint32_t recompute_cost) noexcept
+        : _kernel{kernel}, _f{f}, _recompute_cost{recompute_cost} {
+        for (auto arg : kernel.arguments()) {
+            auto mapped = [this, arg] {
+                switch (arg.tag()) {
+                    case Variable::Tag::BUFFER: return _f->buffer(arg.type());
+                    case Variable::Tag::TEXTURE: return _f->texture(arg.type());
+                    case Variable::Tag::BINDLESS_ARRAY: return _f->bindless_array();
+                    default: return _f->uniform(arg.type());
+                }
+            }();
+            _variables.emplace(arg.uid(), mapped);
+        }
+        for (auto arg : kernel.arguments()) {
+            if (arg.tag() == Variable::Tag::BUFFER && arg.type()->element()->tag() == Type::Tag::FLOAT) {
+                _gradients.emplace(_variables.at(arg.uid()).uid(), _f->buffer(arg.type()));
+            }
+        }
+    }
+
+    void differentiate() noexcept {
+        _kernel.body()->accept(*this);
+        for (auto buffer : _written_buffers) {
+            if (_read_buffers.contains(buffer)) {
+                LUISA_ERROR_WITH_LOCATION("Buffers both read and written cannot be differentiated.");
+            }
+        }
+        _reverse();
+    }
+
+    void visit(const UnaryExpr *expr) override {
+        _result = _f->unary(expr->type(), expr->op(), _rewrite(expr->operand()));
+    }
+
+    void visit(const BinaryExpr *expr) override {
+        auto lhs = _rewrite(expr->lhs());
+        _result = _f->binary(expr->type(), expr->op(), lhs, _rewrite(expr->rhs()));
+    }
+
+    void visit(const MemberExpr *expr) override {
+        _result = _f->member(expr->type(), _rewrite(expr->self()), expr->member_index());
+    }
+
+    void visit(const AccessExpr *expr) override {
+        auto range = _rewrite(expr->range());
+        auto index = _rewrite(expr->index());
+        auto access = _f->access(expr->type(), range, index);
+        if (!range->type()->is_buffer()) {
+            _result = access;
+            return;
+        }
+        _result = _evaluate(access);
+        if (auto buffer = dynamic_cast<const RefExpr *>(range)) {
+            _loads.emplace(_result, Load{buffer->variable().uid(), index});
+            _read_buffers.emplace(buffer->variable().uid());
+        }
+    }
+
+    void visit(const LiteralExpr *expr) override {
+        _result = _f->_literal(expr->type(), expr->value());
+    }
+
+    void visit(const RefExpr *expr) override {
+        auto v = expr->variable();
+        if (v.tag() != Variable::Tag::LOCAL) {
+            _result = _f->ref(_variable(v));
+        } else if (auto iter = _values.find(v.uid()); iter != _values.cend()) {
+            _result = iter->second;
+        } else {
+            LUISA_ERROR_WITH_LOCATION("Local #{} is used before its declaration.", v.uid());
+        }
+    }
+
+    // reads of textures and bindless arrays are constant
+    void visit(const CallExpr *expr) override {
+        if (!expr->is_builtin()) { LUISA_ERROR_WITH_LOCATION("Calls to callables cannot be differentiated."); }
+        auto &&info = call_op_info(expr->op());
+        if (info.side_effects || _is_cross_lane(expr->op())) {
+            LUISA_ERROR_WITH_LOCATION("Builtin function {} cannot be differentiated.", info.name);
+        }
+        std::vector<const Expression *> args;
+        args.reserve(expr->arguments().size());
+        for (auto arg : expr->arguments()) { args.emplace_back(_rewrite(arg)); }
+        auto call = _f->call(expr->type(), expr->op(), args);
+        _result = info.pure ? call : _evaluate(call);
+    }
+
+    void visit(const CastExpr *expr) override {
+        _result = _f->cast(expr->type(), expr->op(), _rewrite(expr->expression()));
+    }
+
+    void visit(const SelectExpr *expr) override {
+        auto condition = _rewrite(expr->condition());
+        auto t = _rewrite(expr->true_value());
+        _result = _f->select(expr->type(), condition, t, _rewrite(expr->false_value()));
+    }
+
+    void visit(const BreakStmt *) override { LUISA_ERROR_WITH_LOCATION("Break statements cannot be differentiated."); }
+    void visit(const ContinueStmt *) override { LUISA_ERROR_WITH_LOCATION("Continue statements cannot be differentiated."); }
+    void visit(const SyncBlockStmt *) override { LUISA_ERROR_WITH_LOCATION("Block barriers cannot be differentiated."); }
+    void visit(const ReturnStmt *) override { LUISA_ERROR_WITH_LOCATION("Return statements cannot be differentiated."); }
+    void visit(const WhileStmt *) override { LUISA_ERROR_WITH_LOCATION("While loops cannot be differentiated."); }
+    void visit(const SwitchStmt *) override { LUISA_ERROR_WITH_LOCATION("Switch statements cannot be differentiated."); }
+    void visit(const SwitchCaseStmt *) override {}
+    void visit(const SwitchDefaultStmt *) override {}
+
+    void visit(const ScopeStmt *stmt) override {
+        for (auto s : stmt->statements()) { s->accept(*this); }
+    }
+
+    void visit(const DeclareStmt *stmt) override {
+        auto v = stmt->variable();
+        auto type = v.type();
+        if (!type->is_scalar() && !type->is_vector()) {
+            LUISA_ERROR_WITH_LOCATION("Locals of type {} cannot be differentiated.", type->description());
+        }
+        auto init = stmt->initializer();
+        if (init.empty()) {
+            _values.insert_or_assign(v.uid(), _register(_f->ref(_f->local(type, {}))));
+        } else if (init.size() == 1u && *init.front()->type() == *type) {
+            _assign(v.uid(), _rewrite(init.front()));
+        } else if (type->is_vector()) {
+            std::vector<const Expression *> args;
+            for (auto e : init) { args.emplace_back(_rewrite(e)); }
+            _assign(v.uid(), _f->call(type, CallOp::MAKE_VECTOR, args));
+        } else {
+            _assign(v.uid(), _f->cast(type, CastOp::STATIC, _rewrite(init.front())));
+        }
+    }
+
+    // both branches are evaluated on the threads taking them and their values are merged
+    void visit(const IfStmt *stmt) override {
+        auto condition = _rewrite(stmt->condition());
+        if (auto literal = dynamic_cast<const LiteralExpr *>(condition);
+            literal != nullptr && std::holds_alternative<bool>(literal->value())) {
+            if (std::get<bool>(literal->value())) {
+                stmt->true_branch()->accept(*this);
+            } else if (stmt->false_branch() != nullptr) {
+                stmt->false_branch()->accept(*this);
+            }
+            return;
+        }
+        auto b = Type::of<bool>();
+        condition = _checkpoint(condition);
+        auto outer = _predicate;
+        auto values = _values;
+        _predicate = outer == nullptr ? condition : _checkpoint(_register(_f->binary(b, BinaryOp::AND, outer, condition)));
+        stmt->true_branch()->accept(*this);
+        auto taken = std::exchange(_values, values);
+        if (stmt->false_branch() != nullptr) {
+            _predicate = outer;
+            auto not_taken = _register(_f->unary(b, UnaryOp::NOT, condition));
+            _predicate = _checkpoint(outer == nullptr ? not_taken : _register(_f->binary(b, BinaryOp::AND, outer, not_taken)));
+            stmt->false_branch()->accept(*this);
+        }
+        _predicate = outer;
+        for (auto &&[uid, value] : values) {
+            auto t = taken.at(uid);
+            auto f = _values.at(uid);
+            if (t != f) { _assign(uid, _f->select(value->type(), condition, t, f)); }
+        }
+        std::erase_if(_values, [&values](auto &&v) noexcept { return !values.contains(v.first); });
+    }
+
+    // the iterations are unrolled, with the induction variable replaced by literals; the condition is
+    // only rebuilt with its bound traced to count them, and never reaches the gradient kernel
+    void visit(const ForStmt *stmt) override {
+        auto v = stmt->variable();
+        auto compare = dynamic_cast<const BinaryExpr *>(stmt->condition());
+        if (compare == nullptr) { LUISA_ERROR_WITH_LOCATION("Loops without constant trip counts cannot be differentiated."); }
+        auto init = _rewrite(stmt->initializer());
+        auto step = _trace(stmt->step());
+        auto bound = _trace(compare->rhs());
+        auto condition = _f->binary(compare->type(), compare->op(), compare->lhs(), bound);
+        auto trip_count = ForStmt::trip_count(v, init, condition, step);
+        auto first = dynamic_cast<const LiteralExpr *>(init);
+        auto stride = dynamic_cast<const LiteralExpr *>(step);
+        if (!trip_count || first == nullptr || stride == nullptr || first->value().index() != stride->value().index()) {
+            LUISA_ERROR_WITH_LOCATION("Loops without constant trip counts cannot be differentiated.");
+        }
+        if (*trip_count > FunctionBuilder::max_unrolled_trip_count) {
+            LUISA_ERROR_WITH_LOCATION("Loops of {} iterations cannot be differentiated (at most {}).",
+                                      *trip_count, FunctionBuilder::max_unrolled_trip_count);
+        }
+        auto value = init;
+        for (auto i = 0u; i < *trip_count; i++) {
+            _values.insert_or_assign(v.uid(), value);
+            stmt->body()->accept(*this);
+            if (_values.at(v.uid()) != value) { LUISA_ERROR_WITH_LOCATION("Induction variables cannot be assigned to."); }
+            value = _f->binary(v.type(), BinaryOp::ADD, value, step);
+        }
+        _values.erase(v.uid());
+    }
+
+    void visit(const ExprStmt *stmt) override { static_cast<void>(_rewrite(stmt->expression())); }
+
+    // stores are only recorded, as the gradient kernel does not write the outputs of the kernel
+    void visit(const AssignStmt *stmt) override {
+        auto lhs = stmt->lhs();
+        if (auto access = dynamic_cast<const AccessExpr *>(lhs); access != nullptr && access->range()->type()->is_buffer()) {
+            auto range = _rewrite(access->range());
+            auto index = _rewrite(access->index());
+            auto value = _rewrite(stmt->rhs());
+            auto buffer = dynamic_cast<const RefExpr *>(range);
+            if (buffer != nullptr && _gradients.contains(buffer->variable().uid())) {
+                if (stmt->op() != AssignOp::ASSIGN) {
+                    LUISA_ERROR_WITH_LOCATION("Read-modify-writes to buffers cannot be differentiated.");
+                }
+                _written_buffers.emplace(buffer->variable().uid());
+                _stores.emplace_back(Store{buffer->variable().uid(), index, value, _predicate});
+            } else if (_holds_float(range->type()->element())) {
+                LUISA_ERROR_WITH_LOCATION("Stores to buffers of {} cannot be differentiated.", range->type()->element()->description());
+            }
+            return;
+        }
+        // assignments to components of vectors assign the vectors with the components replaced
+        const Expression *component = nullptr;
+        auto root = lhs;
+        if (auto member = dynamic_cast<const MemberExpr *>(lhs)) {
+            component = _f->literal(static_cast<uint>(member->member_index()));
+            root = member->self();
+        } else if (auto access = dynamic_cast<const AccessExpr *>(lhs)) {
+            component = _rewrite(access->index());
+            root = access->range();
+        }
+        auto ref = dynamic_cast<const RefExpr *>(root);
+        if (ref == nullptr || ref->variable().tag() != Variable::Tag::LOCAL) {
+            LUISA_ERROR_WITH_LOCATION("Assignments to non-local variables cannot be differentiated.");
+        }
+        auto literal = component == nullptr ? nullptr : dynamic_cast<const LiteralExpr *>(component);
+        if (component != nullptr && literal == nullptr) {
+            LUISA_ERROR_WITH_LOCATION("Assignments to vector components by dynamic indices cannot be differentiated.");
+        }
+        auto uid = ref->variable().uid();
+        auto old = _values.at(uid);
+        auto index = literal == nullptr ? 0u : std::visit([](auto x) noexcept -> uint {
+            if constexpr (std::is_integral_v<decltype(x)>) { return static_cast<uint>(x); }
+            return 0u;
+        }, literal->value());
+        auto current = component == nullptr ? old : _register(_f->member(lhs->type(), old, index));
+        auto value = _rewrite(stmt->rhs());
+        if (stmt->op() != AssignOp::ASSIGN) {// compound assignments map to binary ops in the same order
+            auto op = static_cast<BinaryOp>(static_cast<uint32_t>(stmt->op()) - static_cast<uint32_t>(AssignOp::ADD_ASSIGN));
+            value = _register(_f->binary(lhs->type(), op, current, value));
+        }
+        if (component == nullptr) {
+            _assign(uid, value);
+            return;
+        }
+        std::vector<const Expression *> components;
+        for (auto i = 0u; i < old->type()->dimension(); i++) {
+            components.emplace_back(i == index ? value : _register(_f->member(lhs->type(), old, i)));
+        }
+        _assign(uid, _f->call(old->type(), CallOp::MAKE_VECTOR, components));
+    }
+};
+
+}// namespace detail
+
+std::shared_ptr<FunctionBuilder> FunctionBuilder::differentiate(Function kernel, uint32_t recompute_cost) noexcept {
+    if (kernel.tag() != Tag::KERNEL) { LUISA_ERROR_WITH_LOCATION("Differentiating non-kernel function."); }
+    auto f = std::make_shared<FunctionBuilder>(Tag::KERNEL);
+    f->define([&] {
+        detail::FunctionDifferentiator differentiator{kernel, f.get(), recompute_cost};
+        differentiator.differentiate();
+    });
+    return f;
+}
+
+}// namespace luisa::compute
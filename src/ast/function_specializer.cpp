@@ -0,0 +1,414 @@
+//
+// Created by Mike Smith on 2021/3/9.
+//
+
+#include <cstring>
+#include <optional>
+#include <unordered_map>
+
+#include <ast/function_builder.h>
+#include <ast/constant_folding.h>
+#include <ast/speculation_cost.h>
+
+namespace luisa::compute {
+
+namespace detail {
+
+template<size_t i = 0u>
+[[nodiscard]] std::optional<LiteralExpr::Value> make_literal_value(const Type *type, const void *data) noexcept {
+    if constexpr (i == std::variant_size_v<LiteralExpr::Value>) {
+        return std::nullopt;
+    } else {
+        using T = std::variant_alternative_t<i, LiteralExpr::Value>;
+        if (LiteralTypeMatch<T>::of(type)) {
+            T value;
+            std::memcpy(&value, data, sizeof(T));
+            return value;
+        }
+        return make_literal_value<i + 1u>(type, data);
+    }
+}
+
+// loops can only be unrolled if every iteration runs the body to its end and
+// the induction variable only changes through the step; also sizes the body
+class UnrollBlocker final : public StmtVisitor {
+
+private:
+    uint32_t _variable;
+    uint32_t _loop_depth{0u};
+    uint32_t _switch_depth{0u};
+    uint32_t _statement_count{0u};
+    bool _blocked{false};
+
+public:
+    explicit UnrollBlocker(const ForStmt *loop) noexcept : _variable{loop->variable().uid()} {
+        loop->body()->accept(*this);
+    }
+    [[nodiscard]] auto blocked() const noexcept { return _blocked; }
+    // statements in the body, with nested loop bodies counted once
+    [[nodiscard]] auto statement_count() const noexcept { return _statement_count; }
+    void visit(const BreakStmt *) override { _blocked |= _loop_depth == 0u && _switch_depth == 0u; }
+    void visit(const ContinueStmt *) override { _blocked |= _loop_depth == 0u; }
+    void visit(const SyncBlockStmt *) override {}
+    void visit(const ReturnStmt *) override {}
+    void visit(const ScopeStmt *stmt) override {
+        _statement_count += static_cast<uint32_t>(stmt->statements().size());
+        for (auto s : stmt->statements()) { s->accept(*this); }
+    }
+    void visit(const DeclareStmt *) override {}
+    void visit(const IfStmt *stmt) override {
+        stmt->true_branch()->accept(*this);
+        if (stmt->false_branch() != nullptr) { stmt->false_branch()->accept(*this); }
+    }
+    void visit(const WhileStmt *stmt) override {
+        _loop_depth++;
+        stmt->body()->accept(*this);
+        _loop_depth--;
+    }
+    void visit(const ForStmt *stmt) override {
+        _loop_depth++;
+        stmt->body()->accept(*this);
+        _loop_depth--;
+    }
+    void visit(const ExprStmt *) override {}
+    void visit(const SwitchStmt *stmt) override {
+        _switch_depth++;
+        stmt->body()->accept(*this);
+        _switch_depth--;
+    }
+    void visit(const SwitchCaseStmt *stmt) override { stmt->body()->accept(*this); }
+    void visit(const SwitchDefaultStmt *stmt) override { stmt->body()->accept(*this); }
+    void visit(const AssignStmt *stmt) override {
+        auto ref = dynamic_cast<const RefExpr *>(stmt->lhs());
+        _blocked |= ref != nullptr && ref->variable().uid() == _variable;
+    }
+};
+
+class FunctionSpecializer final : public ExprVisitor, public StmtVisitor {
+
+private:
+    Function _kernel;
+    FunctionBuilder *_f;
+    std::unordered_map<uint32_t, Variable> _variables;
+    std::unordered_map<uint32_t, LiteralExpr::Value> _literals;
+    uint32_t _unroll_limit;
+    uint32_t _if_conversion_cost;
+    const Expression *_result{nullptr};
+
+private:
+    [[nodiscard]] static const LiteralExpr *_as_literal(const Expression *expr) noexcept {
+        return dynamic_cast<const LiteralExpr *>(expr);
+    }
+
+    [[nodiscard]] const Expression *_rewrite(const Expression *expr) noexcept {
+        if (expr == nullptr) { return nullptr; }
+        expr->accept(*this);
+        return _result;
+    }
+
+    [[nodiscard]] const ScopeStmt *_rewrite_scope(const Statement *stmt) noexcept {
+        return _f->scope([this, stmt] { stmt->accept(*this); });
+    }
+
+    struct Assignment {
+        const Expression *lhs;
+        const Expression *rhs;
+    };
+
+    // rewrites the branch into plain assignments to scalars or vectors in locals, if it only consists of such
+    [[nodiscard]] bool _flatten(const Statement *branch, std::vector<Assignment> &assignments) noexcept {
+        if (branch == nullptr) { return true; }
+        auto scope = dynamic_cast<const ScopeStmt *>(branch);
+        if (scope == nullptr) { return false; }
+        for (auto s : scope->statements()) {
+            auto assign = dynamic_cast<const AssignStmt *>(s);
+            if (assign == nullptr) { return false; }
+            auto type = assign->lhs()->type();
+            if (!type->is_scalar() && !type->is_vector()) { return false; }
+            auto root = assign->lhs();
+            while (true) {
+                if (auto member = dynamic_cast<const MemberExpr *>(root)) {
+                    root = member->self();
+                } else if (auto access = dynamic_cast<const AccessExpr *>(root);
+                           access != nullptr && dynamic_cast<const LiteralExpr *>(access->index()) != nullptr) {
+                    root = access->range();
+                } else {
+                    break;
+                }
+            }
+            auto ref = dynamic_cast<const RefExpr *>(root);
+            if (ref == nullptr || ref->variable().tag() != Variable::Tag::LOCAL || _literals.contains(ref->variable().uid())) { return false; }
+            auto lhs = _rewrite(assign->lhs());
+            auto rhs = _rewrite(assign->rhs());
+            if (assign->op() != AssignOp::ASSIGN) {// compound assignments map to binary ops in the same order
+                auto op = static_cast<BinaryOp>(static_cast<uint32_t>(assign->op()) - static_cast<uint32_t>(AssignOp::ADD_ASSIGN));
+                rhs = _f->binary(type, op, lhs, rhs);
+            }
+            assignments.emplace_back(Assignment{lhs, rhs});
+        }
+        return true;
+    }
+
+    // converts if (c) { x = a; } else { y = b; } into x = c ? a : x; y = c ? y : b;
+    // the assignments of a branch leave the values as they are on threads not taking it,
+    // so later assignments, also of the other branch, see the right values
+    [[nodiscard]] bool _if_convert(const IfStmt *stmt, const Expression *condition) noexcept {
+        if (_if_conversion_cost == 0u) { return false; }
+        std::vector<Assignment> taken;
+        std::vector<Assignment> not_taken;
+        if (!_flatten(stmt->true_branch(), taken) || !_flatten(stmt->false_branch(), not_taken)) { return false; }
+        auto cost = 0u;
+        for (auto &&a : taken) {
+            auto c = SpeculationCost{a.rhs}.cost();
+            if (!c) { return false; }
+            cost += *c + 1u;
+        }
+        for (auto &&a : not_taken) {
+            auto c = SpeculationCost{a.rhs}.cost();
+            if (!c) { return false; }
+            cost += *c + 1u;
+        }
+        if (cost > _if_conversion_cost) { return false; }
+        // the assignments may change what the condition reads
+        condition = _f->ref(_f->local(condition->type(), {condition}));
+        for (auto &&a : taken) { _f->assign(AssignOp::ASSIGN, a.lhs, _f->select(a.lhs->type(), condition, a.rhs, a.lhs)); }
+        for (auto &&a : not_taken) { _f->assign(AssignOp::ASSIGN, a.lhs, _f->select(a.lhs->type(), condition, a.lhs, a.rhs)); }
+        return true;
+    }
+
+    [[nodiscard]] Variable _variable(Variable v) noexcept {
+        if (auto iter = _variables.find(v.uid()); iter != _variables.cend()) { return iter->second; }
+        return _variables.emplace(v.uid(), _f->_rebind(_kernel, v)).first->second;
+    }
+
+public:
+    FunctionSpecializer(Function kernel, FunctionBuilder *f, std::span<const Variable> uniforms,
+                        uint32_t unroll_limit, uint32_t if_conversion_cost) noexcept
+        : _kernel{kernel}, _f{f}, _unroll_limit{unroll_limit}, _if_conversion_cost{if_conversion_cost} {
+        for (auto u : uniforms) {
+            auto binding = std::find_if(
+                kernel.captured_uniforms().begin(), kernel.captured_uniforms().end(),
+                [u](auto &&b) noexcept { return b.variable.uid() == u.uid(); });
+            if (binding == kernel.captured_uniforms().end()) {
+                LUISA_ERROR_WITH_LOCATION("Variable #{} is not a captured uniform of the kernel.", u.uid());
+            }
+            auto value = make_literal_value(u.type(), binding->data);
+            if (!value) {
+                LUISA_ERROR_WITH_LOCATION("Uniforms of type {} cannot be specialized.", u.type()->description());
+            }
+            _literals.emplace(u.uid(), *value);
+        }
+        // explicit arguments keep their order
+        for (auto arg : kernel.arguments()) {
+            auto mapped = [this, arg] {
+                switch (arg.tag()) {
+                    case Variable::Tag::BUFFER: return _f->buffer(arg.type());
+                    case Variable::Tag::TEXTURE: return _f->texture(arg.type());
+                    case Variable::Tag::BINDLESS_ARRAY: return _f->bindless_array();
+                    default: return _f->uniform(arg.type());
+                }
+            }();
+            _variables.emplace(arg.uid(), mapped);
+        }
+    }
+
+    // the builder folds operations on literals, including those the rewrite turns into literals
+    void visit(const UnaryExpr *expr) override {
+        _result = _f->unary(expr->type(), expr->op(), _rewrite(expr->operand()));
+    }
+
+    void visit(const BinaryExpr *expr) override {
+        auto lhs = _rewrite(expr->lhs());
+        _result = _f->binary(expr->type(), expr->op(), lhs, _rewrite(expr->rhs()));
+    }
+
+    void visit(const MemberExpr *expr) override {
+        _result = _f->member(expr->type(), _rewrite(expr->self()), expr->member_index());
+    }
+
+    void visit(const AccessExpr *expr) override {
+        auto range = _rewrite(expr->range());
+        _result = _f->access(expr->type(), range, _rewrite(expr->index()));
+    }
+
+    void visit(const LiteralExpr *expr) override {
+        _result = _f->_literal(expr->type(), expr->value());
+    }
+
+    void visit(const RefExpr *expr) override {
+        auto v = expr->variable();
+        if (auto iter = _literals.find(v.uid()); iter != _literals.cend()) {
+            _result = _f->_literal(v.type(), iter->second);
+        } else {
+            _result = _f->ref(_variable(v));
+        }
+    }
+
+    void visit(const CallExpr *expr) override {
+        std::vector<const Expression *> args;
+        args.reserve(expr->arguments().size());
+        for (auto arg : expr->arguments()) { args.emplace_back(_rewrite(arg)); }
+        if (expr->is_builtin()) {
+            _result = _f->call(expr->type(), expr->op(), args);
+        } else {
+            auto callables = _kernel.custom_callables();
+            auto callable = std::find_if(callables.begin(), callables.end(), [expr](auto &&c) noexcept {
+                return c.get() == &expr->callable().builder();
+            });
+            _result = _f->call(expr->type(), *callable, args);
+        }
+    }
+
+    void visit(const CastExpr *expr) override {
+        _result = _f->cast(expr->type(), expr->op(), _rewrite(expr->expression()));
+    }
+
+    void visit(const SelectExpr *expr) override {
+        auto condition = _rewrite(expr->condition());
+        auto t = _rewrite(expr->true_value());
+        _result = _f->select(expr->type(), condition, t, _rewrite(expr->false_value()));
+    }
+
+    void visit(const BreakStmt *) override { _f->break_(); }
+    void visit(const ContinueStmt *) override { _f->continue_(); }
+    void visit(const SyncBlockStmt *) override { _f->sync_block(); }
+    void visit(const ReturnStmt *stmt) override { _f->return_(_rewrite(stmt->expression())); }
+
+    void visit(const ScopeStmt *stmt) override {
+        for (auto s : stmt->statements()) { s->accept(*this); }
+    }
+
+    void visit(const DeclareStmt *stmt) override {
+        std::vector<const Expression *> init;
+        init.reserve(stmt->initializer().size());
+        for (auto e : stmt->initializer()) { init.emplace_back(_rewrite(e)); }
+        // unrolled loop bodies declare their locals once per iteration
+        _variables.insert_or_assign(stmt->variable().uid(), _f->local(stmt->variable().type(), init));
+    }
+
+    // branches on constant conditions are replaced by the taken branch; locals are
+    // identified by their uids, so inlining the branch into the enclosing scope is safe
+    void visit(const IfStmt *stmt) override {
+        auto condition = _rewrite(stmt->condition());
+        if (auto literal = _as_literal(condition); literal != nullptr && std::holds_alternative<bool>(literal->value())) {
+            if (std::get<bool>(literal->value())) {
+                stmt->true_branch()->accept(*this);
+            } else if (stmt->false_branch() != nullptr) {
+                stmt->false_branch()->accept(*this);
+            }
+            return;
+        }
+        if (_if_convert(stmt, condition)) { return; }
+        auto true_branch = _rewrite_scope(stmt->true_branch());
+        if (stmt->false_branch() == nullptr) {
+            _f->if_(condition, true_branch);
+        } else {
+            _f->if_(condition, true_branch, _rewrite_scope(stmt->false_branch()));
+        }
+    }
+
+    void visit(const WhileStmt *stmt) override {
+        auto condition = _rewrite(stmt->condition());
+        if (auto literal = _as_literal(condition);
+            literal != nullptr && std::holds_alternative<bool>(literal->value()) && !std::get<bool>(literal->value())) { return; }
+        _f->while_(condition, _rewrite_scope(stmt->body()));
+    }
+
+    // unrolled iterations are inlined into the enclosing scope with the induction
+    // variable replaced by literals, which in turn fold the expressions depending on it
+    void visit(const ForStmt *stmt) override {
+        auto v = stmt->variable();
+        auto variable = _f->for_variable(v.type());
+        _variables.insert_or_assign(v.uid(), variable);
+        auto init = _rewrite(stmt->initializer());
+        auto condition = _rewrite(stmt->condition());
+        auto step = _rewrite(stmt->step());
+        auto trip_count = ForStmt::trip_count(variable, init, condition, step);
+        auto first = _as_literal(init);
+        auto stride = _as_literal(step);
+        auto unrollable = [&] {
+            if (!trip_count || first == nullptr || stride == nullptr || first->value().index() != stride->value().index() ||
+                !std::visit([v](auto x) noexcept { return LiteralTypeMatch<decltype(x)>::of(v.type()); }, first->value())) { return false; }
+            UnrollBlocker blocker{stmt};
+            if (blocker.blocked()) { return false; }
+            switch (stmt->unroll().mode()) {
+                case LoopUnroll::Mode::AUTO: return *trip_count <= _unroll_limit;
+                case LoopUnroll::Mode::NEVER: return false;
+                case LoopUnroll::Mode::FULL: return *trip_count * blocker.statement_count() <= FunctionBuilder::max_fully_unrolled_statements;
+                case LoopUnroll::Mode::UP_TO: return *trip_count <= stmt->unroll().max_trip_count();
+            }
+            return false;
+        };
+        if (unrollable()) {
+            auto value = first->value();
+            for (auto i = 0u; i < *trip_count; i++) {
+                _literals.insert_or_assign(v.uid(), value);
+                stmt->body()->accept(*this);
+                value = *std::visit([stride](auto x) noexcept -> std::optional<LiteralExpr::Value> {
+                    using T = decltype(x);
+                    if constexpr (is_scalar_v<T>) { return fold_binary(BinaryOp::ADD, x, std::get<T>(stride->value())); }
+                    return std::nullopt;
+                }, value);
+            }
+            _literals.erase(v.uid());
+            return;
+        }
+        _f->for_(variable, init, condition, step, _rewrite_scope(stmt->body()), stmt->unroll());
+    }
+
+    void visit(const ExprStmt *stmt) override { _f->void_(_rewrite(stmt->expression())); }
+
+    void visit(const SwitchStmt *stmt) override {
+        auto expr = _rewrite(stmt->expression());
+        _f->switch_(expr, _rewrite_scope(stmt->body()));
+    }
+
+    void visit(const SwitchCaseStmt *stmt) override {
+        auto expr = _rewrite(stmt->expression());
+        _f->case_(expr, _rewrite_scope(stmt->body()));
+    }
+
+    void visit(const SwitchDefaultStmt *stmt) override { _f->default_(_rewrite_scope(stmt->body())); }
+
+    void visit(const AssignStmt *stmt) override {
+        if (auto ref = dynamic_cast<const RefExpr *>(stmt->lhs()); ref != nullptr && _literals.contains(ref->variable().uid())) {
+            LUISA_ERROR_WITH_LOCATION("Assigning to specialized uniform #{}.", ref->variable().uid());
+        }
+        auto lhs = _rewrite(stmt->lhs());
+        _f->assign(stmt->op(), lhs, _rewrite(stmt->rhs()));
+    }
+};
+
+}// namespace detail
+
+std::shared_ptr<FunctionBuilder> FunctionBuilder::specialize(Function kernel, std::span<const Variable> uniforms) noexcept {
+    if (kernel.tag() != Tag::KERNEL) { LUISA_ERROR_WITH_LOCATION("Specializing non-kernel function."); }
+    auto f = std::make_shared<FunctionBuilder>(Tag::KERNEL);
+    f->define([&] {
+        detail::FunctionSpecializer specializer{kernel, f.get(), uniforms, 0u, 0u};
+        kernel.body()->accept(specializer);
+    });
+    return f;
+}
+
+std::shared_ptr<FunctionBuilder> FunctionBuilder::unroll(Function kernel, uint32_t max_trip_count) noexcept {
+    if (kernel.tag() != Tag::KERNEL) { LUISA_ERROR_WITH_LOCATION("Unrolling non-kernel function."); }
+    auto f = std::make_shared<FunctionBuilder>(Tag::KERNEL);
+    f->define([&] {
+        detail::FunctionSpecializer specializer{kernel, f.get(), {}, max_trip_count, 0u};
+        kernel.body()->accept(specializer);
+    });
+    return f;
+}
+
+std::shared_ptr<FunctionBuilder> FunctionBuilder::if_convert(Function kernel, uint32_t max_cost) noexcept {
+    if (kernel.tag() != Tag::KERNEL) { LUISA_ERROR_WITH_LOCATION("If-converting non-kernel function."); }
+    auto f = std::make_shared<FunctionBuilder>(Tag::KERNEL);
+    f->define([&] {
+        detail::FunctionSpecializer specializer{kernel, f.get(), {}, 0u, max_cost};
+        kernel.body()->accept(specializer);
+    });
+    return f;
+}
+
+}// namespace luisa::compute
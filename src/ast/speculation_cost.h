@@ -0,0 +1,66 @@
+//
+// Created by Mike Smith on 2021/3/23.
+//
+
+#pragma once
+
+#include <optional>
+
+#include <ast/call_op.h>
+#include <ast/expression.h>
+
+namespace luisa::compute::detail {
+
+// estimates the cost of evaluating an expression unconditionally, which is only
+// possible if it neither writes memory nor reads memory that may be out of bounds
+class SpeculationCost final : public ExprVisitor {
+
+private:
+    uint32_t _cost{0u};
+    bool _safe{true};
+
+public:
+    explicit SpeculationCost(const Expression *expr) noexcept { expr->accept(*this); }
+    [[nodiscard]] std::optional<uint32_t> cost() const noexcept {
+        if (!_safe) { return std::nullopt; }
+        return _cost;
+    }
+    void visit(const UnaryExpr *expr) override {
+        _cost++;
+        expr->operand()->accept(*this);
+    }
+    void visit(const BinaryExpr *expr) override {
+        _cost++;
+        expr->lhs()->accept(*this);
+        expr->rhs()->accept(*this);
+    }
+    void visit(const MemberExpr *expr) override { expr->self()->accept(*this); }
+    // indexing locals with literals stays in bounds
+    void visit(const AccessExpr *expr) override {
+        _safe &= !expr->range()->type()->is_buffer() && dynamic_cast<const LiteralExpr *>(expr->index()) != nullptr;
+        expr->range()->accept(*this);
+    }
+    void visit(const LiteralExpr *) override {}
+    void visit(const RefExpr *) override {}
+    // impure builtins, e.g. warp operations, depend on the threads taking the branch
+    void visit(const CallExpr *expr) override {
+        if (!expr->is_builtin() || !call_op_info(expr->op()).pure) {
+            _safe = false;
+            return;
+        }
+        _cost += call_op_info(expr->op()).cost;
+        for (auto arg : expr->arguments()) { arg->accept(*this); }
+    }
+    void visit(const CastExpr *expr) override {
+        _cost++;
+        expr->expression()->accept(*this);
+    }
+    void visit(const SelectExpr *expr) override {
+        _cost++;
+        expr->condition()->accept(*this);
+        expr->true_value()->accept(*this);
+        expr->false_value()->accept(*this);
+    }
+};
+
+}// namespace luisa::compute::detail
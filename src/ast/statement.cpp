@@ -0,0 +1,87 @@
+//
+// Created by Mike Smith on 2021/3/19.
+//
+
+#include <cstdint>
+#include <utility>
+
+#include <ast/expression.h>
+#include <ast/statement.h>
+
+namespace luisa::compute {
+
+namespace detail {
+
+[[nodiscard]] static std::optional<int64_t> integer_literal(const Expression *expr) noexcept {
+    auto literal = dynamic_cast<const LiteralExpr *>(expr);
+    if (literal == nullptr) { return std::nullopt; }
+    return std::visit(
+        [](auto v) noexcept -> std::optional<int64_t> {
+            using T = decltype(v);
+            if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool>) { return static_cast<int64_t>(v); }
+            return std::nullopt;
+        },
+        literal->value());
+}
+
+// the values of an integer type, or nothing for other types
+[[nodiscard]] static std::optional<std::pair<int64_t, int64_t>> integer_range(const Type *type) noexcept {
+    switch (type->tag()) {
+        case Type::Tag::INT8: return std::make_pair(int64_t{INT8_MIN}, int64_t{INT8_MAX});
+        case Type::Tag::UINT8: return std::make_pair(int64_t{0}, int64_t{UINT8_MAX});
+        case Type::Tag::INT16: return std::make_pair(int64_t{INT16_MIN}, int64_t{INT16_MAX});
+        case Type::Tag::UINT16: return std::make_pair(int64_t{0}, int64_t{UINT16_MAX});
+        case Type::Tag::INT32: return std::make_pair(int64_t{INT32_MIN}, int64_t{INT32_MAX});
+        case Type::Tag::UINT32: return std::make_pair(int64_t{0}, int64_t{UINT32_MAX});
+        default: return std::nullopt;
+    }
+}
+
+}// namespace detail
+
+std::optional<uint64_t> ForStmt::trip_count() const noexcept {
+    return trip_count(_variable, _initializer, _condition, _step);
+}
+
+std::optional<uint64_t> ForStmt::trip_count(Variable variable, const Expression *init, const Expression *cond, const Expression *step) noexcept {
+    auto compare = dynamic_cast<const BinaryExpr *>(cond);
+    if (compare == nullptr) { return std::nullopt; }
+    auto ref = dynamic_cast<const RefExpr *>(compare->lhs());
+    if (ref == nullptr || ref->variable().uid() != variable.uid()) { return std::nullopt; }
+    auto range = detail::integer_range(variable.type());
+    auto begin = detail::integer_literal(init);
+    auto stride = detail::integer_literal(step);
+    auto bound = detail::integer_literal(compare->rhs());
+    if (!range || !begin || !stride || !bound || *stride == 0) { return std::nullopt; }
+    // the literals hold at most 32-bit values, so the arithmetic below cannot overflow
+    auto [lo, hi] = *range;
+    auto s = *stride;
+    // iterations until the variable passes end, counting up when s > 0 and down otherwise; unknown if the
+    // value the variable takes on exit leaves its type's range, as it would wrap around and keep looping
+    auto until = [b = *begin, s, lo, hi](int64_t end) noexcept -> std::optional<uint64_t> {
+        auto n = s > 0 ? (b >= end ? 0 : (end - b + s - 1) / s) : (b <= end ? 0 : (b - end - s - 1) / -s);
+        if (auto exit = b + n * s; exit < lo || exit > hi) { return std::nullopt; }
+        return static_cast<uint64_t>(n);
+    };
+    switch (compare->op()) {
+        case BinaryOp::LESS:
+            if (s > 0) { return until(*bound); }
+            break;
+        case BinaryOp::LESS_EQUAL:
+            if (s > 0) { return until(*bound + 1); }
+            break;
+        case BinaryOp::GREATER:
+            if (s < 0) { return until(*bound); }
+            break;
+        case BinaryOp::GREATER_EQUAL:
+            if (s < 0) { return until(*bound - 1); }
+            break;
+        case BinaryOp::NOT_EQUAL:
+            if (*bound >= lo && *bound <= hi && (*bound - *begin) % s == 0 && (*bound - *begin) / s >= 0) { return static_cast<uint64_t>((*bound - *begin) / s); }
+            break;
+        default: break;
+    }
+    return std::nullopt;
+}
+
+}// namespace luisa::compute
@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include <optional>
+
 #include <core/concepts.h>
 #include <ast/variable.h>
 
@@ -24,6 +26,7 @@ public:
 
 struct BreakStmt;
 struct ContinueStmt;
+struct SyncBlockStmt;
 
 class ReturnStmt;
 
@@ -31,6 +34,7 @@ class ScopeStmt;
 class DeclareStmt;
 class IfStmt;
 class WhileStmt;
+class ForStmt;
 class ExprStmt;
 class SwitchStmt;
 class SwitchCaseStmt;
@@ -50,6 +54,8 @@ struct StmtVisitor {
     virtual void visit(const SwitchCaseStmt *) = 0;
     virtual void visit(const SwitchDefaultStmt *) = 0;
     virtual void visit(const AssignStmt *) = 0;
+    virtual void visit(const SyncBlockStmt *) = 0;
+    virtual void visit(const ForStmt *) = 0;
 };
 
 #define LUISA_MAKE_STATEMENT_ACCEPT_VISITOR() \
@@ -63,6 +69,12 @@ struct ContinueStmt : public Statement {
     LUISA_MAKE_STATEMENT_ACCEPT_VISITOR()
 };
 
+// waits until all threads of the block reach it, making their shared memory writes visible;
+// like on GPUs, every thread of the block must reach the same barrier, i.e. in uniform control flow
+struct SyncBlockStmt : public Statement {
+    LUISA_MAKE_STATEMENT_ACCEPT_VISITOR()
+};
+
 class ReturnStmt : public Statement {
 
 private:
@@ -81,7 +93,7 @@ private:
 
 public:
     explicit ScopeStmt(std::span<const Statement *> stmts) noexcept : _statements{stmts} {}
-    [[nodiscard]] auto statements() noexcept { return _statements; }
+    [[nodiscard]] auto statements() const noexcept { return _statements; }
     LUISA_MAKE_STATEMENT_ACCEPT_VISITOR()
 };
 
@@ -160,6 +172,75 @@ public:
     LUISA_MAKE_STATEMENT_ACCEPT_VISITOR()
 };
 
+// Unroll hint of a for loop: automatic() leaves it to the unrolling pass's own trip count
+// limit, never() keeps the loop, full() unrolls any constant trip count as long as the
+// unrolled body stays small (see FunctionBuilder::max_fully_unrolled_statements), and
+// up_to(n) unrolls constant trip counts of up to n iterations.
+class LoopUnroll {
+
+public:
+    enum struct Mode : uint32_t {
+        AUTO,
+        NEVER,
+        FULL,
+        UP_TO
+    };
+
+private:
+    Mode _mode;
+    uint32_t _max_trip_count;
+    constexpr LoopUnroll(Mode mode, uint32_t max_trip_count) noexcept : _mode{mode}, _max_trip_count{max_trip_count} {}
+
+public:
+    constexpr LoopUnroll() noexcept : LoopUnroll{Mode::AUTO, 0u} {}
+    [[nodiscard]] static constexpr LoopUnroll automatic() noexcept { return {}; }
+    [[nodiscard]] static constexpr LoopUnroll never() noexcept { return {Mode::NEVER, 0u}; }
+    [[nodiscard]] static constexpr LoopUnroll full() noexcept { return {Mode::FULL, 0u}; }
+    [[nodiscard]] static constexpr LoopUnroll up_to(uint32_t max_trip_count) noexcept { return {Mode::UP_TO, max_trip_count}; }
+    [[nodiscard]] constexpr auto mode() const noexcept { return _mode; }
+    [[nodiscard]] constexpr auto max_trip_count() const noexcept { return _max_trip_count; }
+};
+
+// A counted loop over an induction variable it declares: the variable starts at the
+// initializer, and the body runs while the condition holds, with the step added to the
+// variable after each iteration, including continued ones.
+class ForStmt : public Statement {
+
+public:
+    static constexpr auto unroll_auto = LoopUnroll::automatic();
+    static constexpr auto unroll_never = LoopUnroll::never();
+    static constexpr auto unroll_full = LoopUnroll::full();
+
+private:
+    Variable _variable;
+    const Expression *_initializer;
+    const Expression *_condition;
+    const Expression *_step;
+    const Statement *_body;
+    LoopUnroll _unroll;
+
+public:
+    ForStmt(Variable variable, const Expression *init, const Expression *cond,
+            const Expression *step, const Statement *body, LoopUnroll unroll) noexcept
+        : _variable{variable}, _initializer{init}, _condition{cond}, _step{step}, _body{body}, _unroll{unroll} {}
+    [[nodiscard]] auto variable() const noexcept { return _variable; }
+    [[nodiscard]] auto initializer() const noexcept { return _initializer; }
+    [[nodiscard]] auto condition() const noexcept { return _condition; }
+    [[nodiscard]] auto step() const noexcept { return _step; }
+    [[nodiscard]] auto body() const noexcept { return _body; }
+    [[nodiscard]] auto unroll() const noexcept { return _unroll; }
+
+    // known if the initializer and step are integer literals, and the condition compares
+    // the variable against an integer literal with <, <=, >, >= or !=, and the variable does
+    // not wrap around its type's range before the loop exits; whether the body
+    // assigns to the variable is not checked, so callers must rule that out themselves,
+    // e.g. with UnrollBlocker in the specializer or by re-checking as the differentiator does
+    [[nodiscard]] std::optional<uint64_t> trip_count() const noexcept;
+    [[nodiscard]] static std::optional<uint64_t> trip_count(
+        Variable variable, const Expression *init, const Expression *cond, const Expression *step) noexcept;
+    LUISA_MAKE_STATEMENT_ACCEPT_VISITOR()
+};
+
 class ExprStmt : public Statement {
 
 private:
@@ -148,6 +148,26 @@ const Type *Type::from(std::string_view description) noexcept {
             match('>');
             info._alignment = 8;// same as pointer...
             info._size = 8;
+        } else if (type_identifier == "texture"sv) {
+            info._tag = Tag::TEXTURE;
+            match('<');
+            info._element_count = read_number();
+            match(',');
+            data.members.emplace_back(from_desc_impl(s));
+            match('>');
+            if (info._element_count != 2 && info._element_count != 3) {
+                LUISA_ERROR_WITH_LOCATION("Invalid texture dimension: {}.", info._element_count);
+            }
+            auto elem = data.members.front();
+            if (elem->tag() != Tag::FLOAT && elem->tag() != Tag::INT32 && elem->tag() != Tag::UINT32) {
+                LUISA_ERROR_WITH_LOCATION("Invalid texture element: {}.", elem->description());
+            }
+            info._alignment = 8;
+            info._size = 8;
+        } else if (type_identifier == "bindless_array"sv) {
+            info._tag = Tag::BINDLESS_ARRAY;
+            info._alignment = 8;
+            info._size = 8;
         }
 
         auto description = s_copy.substr(0, s_copy.size() - s.size());
@@ -180,7 +200,7 @@ std::span<const Type *const> Type::members() const noexcept {
 }
 
 const Type *Type::element() const noexcept {
-    assert(is_array() || is_atomic() || is_vector() || is_matrix());
+    assert(is_array() || is_atomic() || is_vector() || is_matrix() || is_buffer() || is_texture());
     return _data->members.front();
 }
 
@@ -38,7 +38,8 @@ public:
         STRUCTURE,
 
         BUFFER,
-        // TODO: TEXTURE
+        TEXTURE,
+        BINDLESS_ARRAY
     };
 
 private:
@@ -68,7 +69,7 @@ public:
     [[nodiscard]] constexpr auto tag() const noexcept { return _tag; }
     [[nodiscard]] std::string_view description() const noexcept;
     [[nodiscard]] constexpr size_t dimension() const noexcept {
-        assert(is_array() || is_vector() || is_matrix());
+        assert(is_array() || is_vector() || is_matrix() || is_texture());
         return _element_count;
     }
 
@@ -85,6 +86,8 @@ public:
     [[nodiscard]] constexpr bool is_structure() const noexcept { return _tag == Tag::STRUCTURE; }
     [[nodiscard]] constexpr bool is_atomic() const noexcept { return _tag == Tag::ATOMIC; }
     [[nodiscard]] constexpr bool is_buffer() const noexcept { return _tag == Tag::BUFFER; }
+    [[nodiscard]] constexpr bool is_texture() const noexcept { return _tag == Tag::TEXTURE; }
+    [[nodiscard]] constexpr bool is_bindless_array() const noexcept { return _tag == Tag::BINDLESS_ARRAY; }
 };
 
 }// namespace luisa::compute
@@ -4,9 +4,11 @@
 
 #pragma once
 
+#include <array>
 #include <vector>
 #include <memory>
 #include <mutex>
+#include <cstddef>
 
 #include <fmt/format.h>
 
@@ -148,6 +150,20 @@ struct TypeDesc<BufferView<T>> {
     }
 };
 
+// accessors of the members of a structure, mixed into its DSL expressions as the base
+// StructureMembers<S, Expr<S>>, so that Expr<S>{...}.m() is the expression of member m
+template<typename S, typename Self>
+struct StructureMembers {};
+
+// the offsets of the members of a structure, in the order registered with LUISA_STRUCT,
+// identify the index of a member in its Type
+template<size_t N>
+[[nodiscard]] constexpr auto member_index(const std::array<size_t, N> &offsets, size_t offset) noexcept {
+    auto index = 0u;
+    while (offsets[index] != offset) { index++; }
+    return index;
+}
+
 }// namespace detail
 
 // struct
@@ -170,6 +186,24 @@ struct TypeDesc<BufferView<T>> {
     };                                                                                                   \
     }
 
+#define LUISA_STRUCTURE_MAP_MEMBER_TO_OFFSET(m) offsetof(This, m)
+#define LUISA_STRUCTURE_MAP_MEMBER_TO_ACCESSOR(m)                                                   \
+    [[nodiscard]] auto m() const noexcept {                                                         \
+        return Self::template _member<std::remove_cvref_t<decltype(std::declval<This>().m)>>(      \
+            static_cast<const Self *>(this)->expression(), member_index(_offsets, offsetof(This, m))); \
+    }
+
+#define LUISA_MAKE_STRUCTURE_MEMBERS_SPECIALIZATION(S, ...)                      \
+    namespace luisa::compute::detail {                                           \
+    template<typename Self>                                                      \
+    struct StructureMembers<S, Self> {                                           \
+        using This = S;                                                          \
+        static constexpr std::array _offsets{                                    \
+            LUISA_MAP_LIST(LUISA_STRUCTURE_MAP_MEMBER_TO_OFFSET, ##__VA_ARGS__)}; \
+        LUISA_MAP(LUISA_STRUCTURE_MAP_MEMBER_TO_ACCESSOR, ##__VA_ARGS__)         \
+    };                                                                           \
+    }
+
 template<typename T>
 const Type *Type::of() noexcept {
     static thread_local auto info = Type::from(detail::TypeDesc<std::remove_cvref_t<T>>::description());
@@ -178,4 +212,6 @@ const Type *Type::of() noexcept {
 
 }// namespace luisa::compute
 
-#define LUISA_STRUCT(...) LUISA_MAKE_STRUCTURE_TYPE_DESC_SPECIALIZATION(__VA_ARGS__)
+#define LUISA_STRUCT(...)                                      \
+    LUISA_MAKE_STRUCTURE_TYPE_DESC_SPECIALIZATION(__VA_ARGS__) \
+    LUISA_MAKE_STRUCTURE_MEMBERS_SPECIALIZATION(__VA_ARGS__)
@@ -23,7 +23,7 @@ public:
         // resources
         BUFFER,
         TEXTURE,
-        // TODO: Bindless Texture
+        BINDLESS_ARRAY,
 
         // builtins
         THREAD_ID,
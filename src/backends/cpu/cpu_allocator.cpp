@@ -0,0 +1,241 @@
+//
+// Created by Mike Smith on 2021/3/11.
+//
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#ifdef __linux__
+#include <sched.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#endif
+
+#include <array>
+#include <string>
+#include <thread>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+
+#include <core/logging.h>
+#include <core/platform.h>
+#include <backends/cpu/cpu_allocator.h>
+
+namespace luisa::compute::cpu {
+
+namespace detail {
+
+// parses sysfs cpu lists such as "0-3,8-11"
+[[nodiscard]] std::vector<uint32_t> parse_cpu_list(const std::string &list) noexcept {
+    std::vector<uint32_t> cpus;
+    size_t begin = 0u;
+    while (begin < list.size()) {
+        auto end = std::min(list.find(',', begin), list.size());
+        auto range = list.substr(begin, end - begin);
+        if (auto dash = range.find('-'); dash != std::string::npos) {
+            auto first = std::stoul(range.substr(0u, dash));
+            auto last = std::stoul(range.substr(dash + 1u));
+            for (auto c = first; c <= last; c++) { cpus.emplace_back(static_cast<uint32_t>(c)); }
+        } else if (!range.empty() && range != "\n") {
+            cpus.emplace_back(static_cast<uint32_t>(std::stoul(range)));
+        }
+        begin = end + 1u;
+    }
+    return cpus;
+}
+
+#ifdef __linux__
+// from <linux/mempolicy.h>, to avoid depending on libnuma
+enum : int {
+    MPOL_DEFAULT_ = 0,
+    MPOL_PREFERRED_ = 1,
+    MPOL_BIND_ = 2,
+    MPOL_INTERLEAVE_ = 3,
+    MPOL_LOCAL_ = 4
+};
+static constexpr auto max_numa_nodes = 1024u;
+using NodeMask = std::array<unsigned long, max_numa_nodes / (8u * sizeof(unsigned long))>;
+#endif
+
+}// namespace detail
+
+NumaTopology::NumaTopology() noexcept {
+#ifdef __linux__
+    for (auto node = 0u;; node++) {
+        std::ifstream file{std::filesystem::path{"/sys/devices/system/node"} / fmt::format("node{}", node) / "cpulist"};
+        std::string list;
+        if (!file || !std::getline(file, list)) { break; }
+        _node_cpus.emplace_back(detail::parse_cpu_list(list));
+    }
+#endif
+    if (_node_cpus.empty()) {
+        std::vector<uint32_t> cpus(std::max(std::thread::hardware_concurrency(), 1u));
+        for (auto i = 0u; i < cpus.size(); i++) { cpus[i] = i; }
+        _node_cpus.emplace_back(std::move(cpus));
+    }
+}
+
+const NumaTopology &NumaTopology::current() noexcept {
+    static NumaTopology topology;
+    return topology;
+}
+
+bool NumaTopology::pin_current_thread(uint32_t node) const noexcept {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu : cpus(node % node_count())) { CPU_SET(cpu, &set); }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+int NumaTopology::node_of(const void *address) noexcept {
+#ifdef __linux__
+    static constexpr auto MPOL_F_NODE = 1 << 0;
+    static constexpr auto MPOL_F_ADDR = 1 << 1;
+    auto node = -1;
+    if (syscall(SYS_get_mempolicy, &node, nullptr, 0ul, address, MPOL_F_NODE | MPOL_F_ADDR) != 0) { return -1; }
+    return node;
+#else
+    return -1;
+#endif
+}
+
+CPUAllocator::CPUAllocator(NumaPolicy policy, uint32_t node, HugePageMode huge_pages, size_t huge_page_threshold) noexcept
+    : _policy{policy}, _node{node}, _huge_pages{huge_pages}, _huge_page_threshold{huge_page_threshold} {
+    if (policy == NumaPolicy::BIND && node >= NumaTopology::current().node_count()) {
+        LUISA_WARNING_WITH_LOCATION(
+            "NUMA node {} does not exist ({} nodes), binding to node 0.",
+            node, NumaTopology::current().node_count());
+        _node = 0u;
+    }
+}
+
+CPUAllocator::~CPUAllocator() noexcept {
+    if (auto leaks = _mappings.size() + _file_mappings.size(); leaks != 0u) {
+        LUISA_WARNING_WITH_LOCATION("{} buffers leaked by CPU allocator.", leaks);
+    }
+}
+
+bool CPUAllocator::_place(void *p, size_t size) const noexcept {
+#ifdef __linux__
+    auto bind = [](void *p, size_t size, int mode, std::initializer_list<uint32_t> nodes) noexcept {
+        detail::NodeMask mask{};
+        for (auto n : nodes) { mask[n / (8u * sizeof(unsigned long))] |= 1ul << (n % (8u * sizeof(unsigned long))); }
+        auto mask_data = nodes.size() == 0u ? nullptr : mask.data();
+        return syscall(SYS_mbind, p, size, mode, mask_data, nodes.size() == 0u ? 0ul : detail::max_numa_nodes, 0u) == 0;
+    };
+    auto node_count = NumaTopology::current().node_count();
+    switch (_policy) {
+        case NumaPolicy::LOCAL: return bind(p, size, detail::MPOL_LOCAL_, {});
+        case NumaPolicy::BIND: return bind(p, size, detail::MPOL_BIND_, {_node});
+        case NumaPolicy::INTERLEAVE: {
+            detail::NodeMask mask{};
+            for (auto n = 0u; n < node_count; n++) { mask[n / (8u * sizeof(unsigned long))] |= 1ul << (n % (8u * sizeof(unsigned long))); }
+            return syscall(SYS_mbind, p, size, detail::MPOL_INTERLEAVE_, mask.data(), detail::max_numa_nodes, 0u) == 0;
+        }
+        case NumaPolicy::BLOCKED: {
+            auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            auto page_count = (size + page_size - 1u) / page_size;
+            for (auto n = 0u; n < node_count; n++) {
+                auto first = page_count * n / node_count;
+                auto last = page_count * (n + 1u) / node_count;
+                if (first == last) { continue; }
+                if (!bind(static_cast<std::byte *>(p) + first * page_size, (last - first) * page_size, detail::MPOL_BIND_, {n})) { return false; }
+            }
+            return true;
+        }
+        default: return true;
+    }
+#else
+    return false;
+#endif
+}
+
+void *CPUAllocator::allocate(size_t size, size_t alignment) noexcept {
+    auto huge = _huge_pages != HugePageMode::NONE && size >= _huge_page_threshold;
+    if (_policy != NumaPolicy::DEFAULT || huge) {// mappings are page-aligned
+        auto allocation = allocate_pages(size, huge ? _huge_pages : HugePageMode::NONE);
+        if (_policy != NumaPolicy::DEFAULT && !_place(allocation.data, allocation.size)) {
+            static std::once_flag warned;
+            std::call_once(warned, [] { LUISA_WARNING_WITH_LOCATION("Failed to apply NUMA policy, falling back to first touch."); });
+        }
+        std::scoped_lock lock{_mutex};
+        _mappings.emplace(allocation.data, allocation);
+        return allocation.data;
+    }
+    auto alloc_size = (std::max(size, alignment) + alignment - 1u) / alignment * alignment;
+    auto p = aligned_alloc(alignment, alloc_size);
+    if (p == nullptr) { LUISA_ERROR_WITH_LOCATION("Failed to allocate buffer with size {}.", size); }
+    return p;
+}
+
+#ifdef _WIN32
+
+void *CPUAllocator::map_file(const std::filesystem::path &path, size_t offset, size_t size) noexcept {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    auto map_offset = offset / info.dwAllocationGranularity * info.dwAllocationGranularity;
+    auto map_size = std::max(offset + size - map_offset, static_cast<size_t>(1u));
+    auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) { LUISA_ERROR_WITH_LOCATION("Failed to open file '{}'.", path.string()); }
+    auto mapping = CreateFileMappingW(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    auto base = mapping == nullptr ? nullptr : MapViewOfFile(mapping, FILE_MAP_COPY, static_cast<DWORD>(map_offset >> 32u), static_cast<DWORD>(map_offset), map_size);
+    if (mapping != nullptr) { CloseHandle(mapping); }// the view keeps the mapping alive
+    CloseHandle(file);
+    if (base == nullptr) { LUISA_ERROR_WITH_LOCATION("Failed to map {} bytes at offset {} of file '{}'.", size, offset, path.string()); }
+    auto p = static_cast<std::byte *>(base) + (offset - map_offset);
+    std::scoped_lock lock{_mutex};
+    _file_mappings.emplace(p, PageAllocation{base, map_size, HugePageMode::NONE});
+    return p;
+}
+
+static void unmap_file(PageAllocation mapping) noexcept { UnmapViewOfFile(mapping.data); }
+
+#else
+
+void *CPUAllocator::map_file(const std::filesystem::path &path, size_t offset, size_t size) noexcept {
+    auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    auto map_offset = offset / page_size * page_size;
+    auto map_size = std::max(offset + size - map_offset, static_cast<size_t>(1u));
+    auto fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) { LUISA_ERROR_WITH_LOCATION("Failed to open file '{}'.", path.string()); }
+    auto base = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, static_cast<off_t>(map_offset));
+    close(fd);// the mapping keeps the file alive
+    if (base == MAP_FAILED) { LUISA_ERROR_WITH_LOCATION("Failed to map {} bytes at offset {} of file '{}'.", size, offset, path.string()); }
+    auto p = static_cast<std::byte *>(base) + (offset - map_offset);
+    std::scoped_lock lock{_mutex};
+    _file_mappings.emplace(p, PageAllocation{base, map_size, HugePageMode::NONE});
+    return p;
+}
+
+static void unmap_file(PageAllocation mapping) noexcept { munmap(mapping.data, mapping.size); }
+
+#endif
+
+void CPUAllocator::free(void *p) noexcept {
+    {
+        std::scoped_lock lock{_mutex};
+        if (auto iter = _mappings.find(p); iter != _mappings.end()) {
+            free_pages(iter->second);
+            _mappings.erase(iter);
+            return;
+        }
+        if (auto iter = _file_mappings.find(p); iter != _file_mappings.end()) {
+            unmap_file(iter->second);
+            _file_mappings.erase(iter);
+            return;
+        }
+    }
+    aligned_free(p);
+}
+
+}// namespace luisa::compute::cpu
@@ -0,0 +1,81 @@
+//
+// Created by Mike Smith on 2021/3/11.
+//
+
+#pragma once
+
+#include <span>
+#include <mutex>
+#include <vector>
+#include <filesystem>
+#include <unordered_map>
+
+#include <core/concepts.h>
+#include <core/huge_pages.h>
+
+namespace luisa::compute::cpu {
+
+// Placement of buffer pages across NUMA nodes.
+enum struct NumaPolicy : uint32_t {
+    DEFAULT,   // first touch, i.e. the node of the thread that initializes the buffer
+    LOCAL,     // the node of the allocating thread
+    INTERLEAVE,// pages round-robin across all nodes
+    BIND,      // all pages on a single node
+    BLOCKED    // the i-th of n contiguous chunks on node i, matching CPUThreadPool's schedule
+};
+
+// CPUs of each NUMA node, read from sysfs on Linux and a single node elsewhere.
+class NumaTopology {
+
+private:
+    std::vector<std::vector<uint32_t>> _node_cpus;
+
+private:
+    NumaTopology() noexcept;
+
+public:
+    [[nodiscard]] static const NumaTopology &current() noexcept;
+    [[nodiscard]] auto node_count() const noexcept { return static_cast<uint32_t>(_node_cpus.size()); }
+    [[nodiscard]] std::span<const uint32_t> cpus(uint32_t node) const noexcept { return _node_cpus[node]; }
+    // pins the calling thread to the CPUs of the node, returns false if not supported
+    bool pin_current_thread(uint32_t node) const noexcept;
+    // the node holding the page at the address, or -1 if unknown
+    [[nodiscard]] static int node_of(const void *address) noexcept;
+};
+
+// Allocates buffer memory under a NUMA policy, backing allocations of at least
+// huge_page_threshold bytes with huge pages. Placed and huge allocations are mapped
+// directly from the OS so that their pages are fresh and not yet touched.
+class CPUAllocator : public concepts::Noncopyable {
+
+public:
+    static constexpr auto default_huge_page_threshold = static_cast<size_t>(2u * 1024u * 1024u);
+
+private:
+    NumaPolicy _policy;
+    uint32_t _node;
+    HugePageMode _huge_pages;
+    size_t _huge_page_threshold;
+    std::mutex _mutex;
+    std::unordered_map<void *, PageAllocation> _mappings;
+    std::unordered_map<void *, PageAllocation> _file_mappings;
+
+private:
+    [[nodiscard]] bool _place(void *p, size_t size) const noexcept;
+
+public:
+    explicit CPUAllocator(NumaPolicy policy = NumaPolicy::DEFAULT, uint32_t node = 0u,
+                          HugePageMode huge_pages = HugePageMode::NONE,
+                          size_t huge_page_threshold = default_huge_page_threshold) noexcept;
+    ~CPUAllocator() noexcept;
+    [[nodiscard]] auto policy() const noexcept { return _policy; }
+    [[nodiscard]] auto node() const noexcept { return _node; }
+    [[nodiscard]] auto huge_pages() const noexcept { return _huge_pages; }
+    [[nodiscard]] auto huge_page_threshold() const noexcept { return _huge_page_threshold; }
+    [[nodiscard]] void *allocate(size_t size, size_t alignment) noexcept;
+    // a private copy-on-write mapping of the file range, so writes never reach the file
+    [[nodiscard]] void *map_file(const std::filesystem::path &path, size_t offset, size_t size) noexcept;
+    void free(void *p) noexcept;
+};
+
+}// namespace luisa::compute::cpu
@@ -0,0 +1,37 @@
+//
+// Created by Mike Smith on 2021/3/5.
+//
+
+#include <core/logging.h>
+#include <backends/cpu/cpu_device.h>
+#include <backends/cpu/cpu_bindless_array.h>
+
+namespace luisa::compute::cpu {
+
+void CPUBindlessArray::update(std::span<const BindlessArrayUpdateCommand::Modification> modifications) noexcept {
+    using Kind = BindlessArrayUpdateCommand::Modification::Kind;
+    for (auto &&m : modifications) {
+        auto &slot = _slots[m.slot];
+        switch (m.kind) {
+            case Kind::EMPTY: slot = {}; break;
+            case Kind::BUFFER: slot = {CPUDevice::buffer(m.handle) + m.offset_bytes, nullptr, 0u}; break;
+            case Kind::TEXTURE: slot = {nullptr, CPUDevice::texture(m.handle), m.level}; break;
+        }
+    }
+}
+
+std::byte *CPUBindlessArray::buffer(uint32_t index) const noexcept {
+    if (index >= _slots.size() || _slots[index].buffer == nullptr) {
+        LUISA_ERROR_WITH_LOCATION("Bindless array slot {} does not hold a buffer.", index);
+    }
+    return _slots[index].buffer;
+}
+
+CPUTexture *CPUBindlessArray::texture(uint32_t index) const noexcept {
+    if (index >= _slots.size() || _slots[index].texture == nullptr) {
+        LUISA_ERROR_WITH_LOCATION("Bindless array slot {} does not hold a texture.", index);
+    }
+    return _slots[index].texture;
+}
+
+}// namespace luisa::compute::cpu
@@ -0,0 +1,38 @@
+//
+// Created by Mike Smith on 2021/3/5.
+//
+
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include <core/concepts.h>
+#include <runtime/bindless_array.h>
+#include <backends/cpu/cpu_texture.h>
+
+namespace luisa::compute::cpu {
+
+// Slots hold resolved addresses, so kernels index them with a single load.
+class CPUBindlessArray : public concepts::Noncopyable {
+
+public:
+    struct Slot {
+        std::byte *buffer{nullptr};
+        CPUTexture *texture{nullptr};
+        uint32_t level{0u};
+    };
+
+private:
+    std::vector<Slot> _slots;
+
+public:
+    explicit CPUBindlessArray(size_t size) noexcept : _slots(size) {}
+    void update(std::span<const BindlessArrayUpdateCommand::Modification> modifications) noexcept;
+    [[nodiscard]] auto size() const noexcept { return _slots.size(); }
+    [[nodiscard]] const Slot &slot(uint32_t index) const noexcept { return _slots[index]; }
+    [[nodiscard]] std::byte *buffer(uint32_t index) const noexcept;
+    [[nodiscard]] CPUTexture *texture(uint32_t index) const noexcept;
+};
+
+}// namespace luisa::compute::cpu
@@ -0,0 +1,816 @@
+//
+// Created by Mike Smith on 2021/3/6.
+//
+
+#include <cstring>
+#include <optional>
+#include <algorithm>
+#include <unordered_map>
+
+#include <core/logging.h>
+#include <ast/expression.h>
+#include <ast/statement.h>
+#include <ast/function_builder.h>
+#include <runtime/argument_layout.h>
+#include <backends/cpu/cpu_codegen.h>
+
+namespace luisa::compute::cpu {
+
+namespace detail {
+
+// An rvalue or lvalue: either the operand holding the value, or (if
+// indirect) the frame slot holding the per-lane address of the value.
+struct Value {
+    const Type *type;
+    Operand operand;
+    bool indirect;
+};
+
+[[nodiscard]] constexpr auto align(size_t x, size_t alignment) noexcept {
+    return (x + alignment - 1u) / alignment * alignment;
+}
+
+[[nodiscard]] inline auto is_arithmetic(const Type *t) noexcept {
+    return t != nullptr && (t->is_scalar() || t->is_vector() || t->is_matrix());
+}
+
+[[nodiscard]] inline Type::Tag scalar_kind(const Type *t) noexcept {
+    if (t->is_scalar()) { return t->tag(); }
+    if (t->is_vector()) { return t->element()->tag(); }
+    if (!t->is_matrix()) { LUISA_ERROR_WITH_LOCATION("Type {} is not arithmetic.", t->description()); }
+    return Type::Tag::FLOAT;
+}
+
+[[nodiscard]] inline uint32_t component_count(const Type *t) noexcept {
+    if (t->is_vector()) { return static_cast<uint32_t>(t->dimension()); }
+    if (t->is_matrix()) { return static_cast<uint32_t>(t->size() / sizeof(float)); }// columns with padding
+    return 1u;
+}
+
+[[nodiscard]] inline uint32_t scalar_size(Type::Tag kind) noexcept {
+    switch (kind) {
+        case Type::Tag::BOOL:
+        case Type::Tag::INT8:
+        case Type::Tag::UINT8: return 1u;
+        case Type::Tag::INT16:
+        case Type::Tag::UINT16: return 2u;
+        default: return 4u;
+    }
+}
+
+[[nodiscard]] inline Type::Tag common_kind(Type::Tag a, Type::Tag b) noexcept {
+    if (a == b) { return a; }
+    if (a == Type::Tag::FLOAT || b == Type::Tag::FLOAT) { return Type::Tag::FLOAT; }
+    if (a == Type::Tag::UINT32 || b == Type::Tag::UINT32) { return Type::Tag::UINT32; }
+    return Type::Tag::INT32;
+}
+
+[[nodiscard]] inline size_t member_offset(const Type *t, size_t index) noexcept {
+    if (t->is_vector()) { return index * t->element()->size(); }
+    if (!t->is_structure()) { LUISA_ERROR_WITH_LOCATION("Invalid member access on type {}.", t->description()); }
+    auto offset = static_cast<size_t>(0u);
+    auto members = t->members();
+    for (auto i = 0u; i < index; i++) { offset = align(offset, members[i]->alignment()) + members[i]->size(); }
+    return align(offset, members[index]->alignment());
+}
+
+[[nodiscard]] inline int64_t literal_integer(const LiteralExpr *literal) noexcept {
+    return std::visit(
+        [](auto v) noexcept -> int64_t {
+            using T = decltype(v);
+            if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool>) {
+                return static_cast<int64_t>(v);
+            } else {
+                LUISA_ERROR_WITH_LOCATION("Literal is not an integer.");
+                return 0;
+            }
+        },
+        literal->value());
+}
+
+[[nodiscard]] inline Operand operator+(Operand o, size_t offset) noexcept {
+    return Operand{o.space, static_cast<uint32_t>(o.offset + offset)};
+}
+
+class Codegen final : public ExprVisitor, public StmtVisitor {
+
+private:
+    struct Return {
+        const Type *type;
+        Operand slot;
+    };
+
+private:
+    std::vector<Instruction> _code;
+    std::vector<std::byte> _constants;
+    size_t _frame_size{CPUKernel::builtin_frame_size};
+    size_t _frame_top{CPUKernel::builtin_frame_size};
+    size_t _local_top{CPUKernel::builtin_frame_size};
+    size_t _shared_size{0u};
+    size_t _depth{0u};
+    size_t _max_depth{0u};
+    std::vector<std::unordered_map<uint32_t, Value>> _variables;
+    std::vector<Return> _returns;
+    Value _result{};
+
+private:
+    size_t _emit(Instruction inst) noexcept {
+        _code.emplace_back(inst);
+        return _code.size() - 1u;
+    }
+
+    void _patch(size_t jump) noexcept { _code[jump].imm = _code.size(); }
+
+    void _push(OpCode op, Operand a = {}) noexcept {
+        _emit(Instruction{.op = op, .a = a});
+        _max_depth = std::max(++_depth, _max_depth);
+    }
+
+    void _pop(OpCode op) noexcept {
+        _emit(Instruction{.op = op});
+        _depth--;
+    }
+
+    [[nodiscard]] Operand _allocate(size_t size) noexcept {
+        auto offset = align(_frame_top, CPUKernel::frame_alignment);
+        _frame_top = offset + size;
+        _frame_size = std::max(_frame_size, _frame_top);
+        return Operand{Space::FRAME, static_cast<uint32_t>(offset)};
+    }
+
+    [[nodiscard]] Operand _allocate(Type::Tag kind, uint32_t count) noexcept {
+        return _allocate((count == 3u ? 4u : count) * scalar_size(kind));
+    }
+
+    [[nodiscard]] Operand _constant(const void *data, size_t size) noexcept {
+        auto offset = align(_constants.size(), CPUKernel::frame_alignment);
+        _constants.resize(offset + size);
+        std::memcpy(_constants.data() + offset, data, size);
+        return Operand{Space::CONSTANT, static_cast<uint32_t>(offset)};
+    }
+
+    [[nodiscard]] Value _evaluate(const Expression *expr) noexcept {
+        expr->accept(*this);
+        return _result;
+    }
+
+    [[nodiscard]] Operand _load(Value v) noexcept {
+        if (!v.indirect) { return v.operand; }
+        auto dst = _allocate(v.type->size());
+        _emit(Instruction{.op = OpCode::LOAD, .count = static_cast<uint32_t>(v.type->size()), .dst = dst, .a = v.operand});
+        return dst;
+    }
+
+    [[nodiscard]] Operand _address(Value v) noexcept {
+        if (v.indirect) { return v.operand; }
+        auto dst = _allocate(sizeof(std::byte *));
+        _emit(Instruction{.op = OpCode::ADDRESS, .dst = dst, .a = v.operand});
+        return dst;
+    }
+
+    [[nodiscard]] Value _offset(Value v, size_t offset, const Type *type) noexcept {
+        if (!v.indirect) { return Value{type, v.operand + offset, false}; }
+        if (offset == 0u) { return Value{type, v.operand, true}; }
+        auto dst = _allocate(sizeof(std::byte *));
+        _emit(Instruction{.op = OpCode::ADDRESS_OFFSET, .dst = dst, .a = v.operand, .imm = offset});
+        return Value{type, dst, true};
+    }
+
+    [[nodiscard]] Operand _convert(Operand o, Type::Tag from, Type::Tag to, uint32_t count) noexcept {
+        if (from == to) { return o; }
+        auto dst = _allocate(to, count);
+        _emit(Instruction{.op = OpCode::CONVERT, .kind = from, .dst_kind = to, .count = count, .dst = dst, .a = o});
+        return dst;
+    }
+
+    // loads the value as count components of kind
+    [[nodiscard]] Operand _rvalue(Value v, Type::Tag kind) noexcept {
+        return _convert(_load(v), scalar_kind(v.type), kind, component_count(v.type));
+    }
+
+    [[nodiscard]] Operand _rvalue(const Expression *expr, Type::Tag kind) noexcept {
+        return _rvalue(_evaluate(expr), kind);
+    }
+
+    [[nodiscard]] static bool _writable(Value v) noexcept {
+        return v.indirect || v.operand.space == Space::FRAME || v.operand.space == Space::SHARED;
+    }
+
+    void _store(Value dst, Value src) noexcept {
+        if (!_writable(dst)) {
+            LUISA_ERROR_WITH_LOCATION("Assigning to read-only value of type {}.", dst.type->description());
+        }
+        auto value = is_arithmetic(dst.type) && is_arithmetic(src.type) ? _rvalue(src, scalar_kind(dst.type)) : _load(src);
+        auto size = static_cast<uint32_t>(dst.type->size());
+        _emit(Instruction{.op = dst.indirect ? OpCode::STORE : OpCode::MOVE, .count = size, .dst = dst.operand, .a = value});
+    }
+
+    // fills components of the vector at dst from scalars and vectors, or broadcasts a single scalar
+    void _compose(Operand dst, const Type *type, std::span<const Expression *const> args) noexcept {
+        auto kind = scalar_kind(type);
+        auto n = component_count(type);
+        auto size = scalar_size(kind);
+        if (args.size() == 1u && component_count(args.front()->type()) == 1u) {
+            auto value = _rvalue(args.front(), kind);
+            for (auto i = 0u; i < n; i++) { _emit(Instruction{.op = OpCode::MOVE, .count = size, .dst = dst + i * size, .a = value}); }
+            return;
+        }
+        auto i = 0u;
+        for (auto arg : args) {
+            auto count = component_count(arg->type());
+            if (i + count > n) { LUISA_ERROR_WITH_LOCATION("Too many components for {}.", type->description()); }
+            auto value = _rvalue(arg, kind);
+            _emit(Instruction{.op = OpCode::MOVE, .count = count * size, .dst = dst + i * size, .a = value});
+            i += count;
+        }
+    }
+
+    void _initialize(Operand dst, const Type *type, std::span<const Expression *const> init) noexcept {
+        auto size = static_cast<uint32_t>(type->size());
+        if (init.empty()) {
+            _emit(Instruction{.op = OpCode::ZERO, .count = size, .dst = dst});
+        } else if (init.size() == 1u && (*init.front()->type() == *type || (type->is_scalar() && init.front()->type()->is_scalar()))) {
+            _store(Value{type, dst, false}, _evaluate(init.front()));
+        } else if (type->is_vector()) {
+            _emit(Instruction{.op = OpCode::ZERO, .count = size, .dst = dst});
+            _compose(dst, type, init);
+        } else if (type->is_array() || type->is_matrix() || type->is_structure()) {
+            _emit(Instruction{.op = OpCode::ZERO, .count = size, .dst = dst});
+            for (auto i = 0u; i < init.size(); i++) {
+                auto [offset, member] = [type, i]() noexcept -> std::pair<size_t, const Type *> {
+                    if (type->is_structure()) { return {member_offset(type, i), type->members()[i]}; }
+                    if (type->is_array()) { return {i * type->element()->size(), type->element()}; }
+                    auto column = Type::from(fmt::format("vector<float,{}>", type->dimension()));
+                    return {i * column->size(), column};
+                }();
+                _store(Value{member, dst + offset, false}, _evaluate(init[i]));
+            }
+        } else {
+            LUISA_ERROR_WITH_LOCATION("Invalid initializer for type {}.", type->description());
+        }
+    }
+
+    [[nodiscard]] Operand _binary(BinaryOp op, Value lhs, Value rhs, const Type *type) noexcept {
+        if (op == BinaryOp::MUL && lhs.type->is_matrix() && (rhs.type->is_vector() || rhs.type->is_matrix())) {
+            auto a = _load(lhs);
+            auto b = _load(rhs);
+            auto dst = _allocate(type->size());
+            auto inst = rhs.type->is_vector() ? OpCode::MATRIX_VECTOR : OpCode::MATRIX_MATRIX;
+            _emit(Instruction{.op = inst, .count = static_cast<uint32_t>(lhs.type->dimension()), .dst = dst, .a = a, .b = b});
+            return dst;
+        }
+        auto lhs_kind = scalar_kind(lhs.type);
+        auto kind = op == BinaryOp::SHL || op == BinaryOp::SHR ? lhs_kind : common_kind(lhs_kind, scalar_kind(rhs.type));
+        auto lhs_count = component_count(lhs.type);
+        auto rhs_count = component_count(rhs.type);
+        auto count = std::max(lhs_count, rhs_count);
+        auto a = _rvalue(lhs, kind);
+        auto b = _rvalue(rhs, kind);
+        auto result_kind = static_cast<uint32_t>(op) >= static_cast<uint32_t>(BinaryOp::AND) ? Type::Tag::BOOL : kind;
+        auto dst = _allocate(result_kind, count);
+        auto flags = (lhs_count < count ? Instruction::broadcast_a : 0u) |
+                     (rhs_count < count ? Instruction::broadcast_b : 0u);
+        _emit(Instruction{.op = OpCode::BINARY, .sub = static_cast<uint32_t>(op), .kind = kind,
+                          .count = count, .flags = flags, .dst = dst, .a = a, .b = b});
+        return _convert(dst, result_kind, scalar_kind(type), count);
+    }
+
+    [[nodiscard]] Value _variable(Variable v) noexcept {
+        switch (v.tag()) {
+            case Variable::Tag::THREAD_ID: return Value{v.type(), {Space::FRAME, CPUKernel::thread_id_offset}, false};
+            case Variable::Tag::BLOCK_ID: return Value{v.type(), {Space::FRAME, CPUKernel::block_id_offset}, false};
+            case Variable::Tag::DISPATCH_ID: return Value{v.type(), {Space::FRAME, CPUKernel::dispatch_id_offset}, false};
+            default: break;
+        }
+        auto &&variables = _variables.back();
+        auto iter = variables.find(v.uid());
+        if (iter == variables.cend()) { LUISA_ERROR_WITH_LOCATION("Undefined variable #{}.", v.uid()); }
+        return iter->second;
+    }
+
+    [[nodiscard]] Operand _bindless_buffer_address(const CallExpr *expr, size_t element_size) noexcept {
+        auto args = expr->arguments();
+        auto array = _evaluate(args[0]);
+        auto slot = _rvalue(args[1], Type::Tag::UINT32);
+        auto index = _evaluate(args[2]);
+        auto dst = _allocate(sizeof(std::byte *));
+        _emit(Instruction{.op = OpCode::BINDLESS_BUFFER_ADDRESS, .kind = scalar_kind(index.type),
+                          .dst = dst, .a = array.operand, .b = slot, .c = _load(index), .imm = element_size});
+        return dst;
+    }
+
+    void _math(const CallExpr *expr, MathFunction f) noexcept {
+        auto args = expr->arguments();
+        auto reduce = f == MathFunction::LENGTH || f == MathFunction::NORMALIZE;
+        auto type = expr->type();
+        auto kind = scalar_kind(reduce ? args.front()->type() : type);
+        auto count = component_count(reduce ? args.front()->type() : type);
+        Operand operands[3]{};
+        auto flags = 0u;
+        for (auto i = 0u; i < args.size(); i++) {
+            operands[i] = _rvalue(args[i], kind);
+            if (component_count(args[i]->type()) < count) { flags |= 1u << i; }
+        }
+        auto dst = _allocate(type->size());
+        _emit(Instruction{.op = OpCode::MATH, .sub = static_cast<uint32_t>(f), .kind = kind, .count = count, .flags = flags,
+                          .dst = dst, .a = operands[0], .b = operands[1], .c = operands[2]});
+        _result = Value{type, dst, false};
+    }
+
+    [[nodiscard]] static std::optional<MathFunction> _math_function(CallOp op) noexcept {
+        switch (op) {
+            case CallOp::ABS: return MathFunction::ABS;
+            case CallOp::SQRT: return MathFunction::SQRT;
+            case CallOp::RSQRT: return MathFunction::RSQRT;
+            case CallOp::SIN: return MathFunction::SIN;
+            case CallOp::COS: return MathFunction::COS;
+            case CallOp::TAN: return MathFunction::TAN;
+            case CallOp::ASIN: return MathFunction::ASIN;
+            case CallOp::ACOS: return MathFunction::ACOS;
+            case CallOp::ATAN: return MathFunction::ATAN;
+            case CallOp::EXP: return MathFunction::EXP;
+            case CallOp::EXP2: return MathFunction::EXP2;
+            case CallOp::LOG: return MathFunction::LOG;
+            case CallOp::LOG2: return MathFunction::LOG2;
+            case CallOp::FLOOR: return MathFunction::FLOOR;
+            case CallOp::CEIL: return MathFunction::CEIL;
+            case CallOp::ROUND: return MathFunction::ROUND;
+            case CallOp::FRACT: return MathFunction::FRACT;
+            case CallOp::SATURATE: return MathFunction::SATURATE;
+            case CallOp::LENGTH: return MathFunction::LENGTH;
+            case CallOp::NORMALIZE: return MathFunction::NORMALIZE;
+            case CallOp::MIN: return MathFunction::MIN;
+            case CallOp::MAX: return MathFunction::MAX;
+            case CallOp::POW: return MathFunction::POW;
+            case CallOp::ATAN2: return MathFunction::ATAN2;
+            case CallOp::CLAMP: return MathFunction::CLAMP;
+            case CallOp::LERP: return MathFunction::LERP;
+            case CallOp::FMA: return MathFunction::FMA;
+            default: return std::nullopt;
+        }
+    }
+
+    [[nodiscard]] static std::optional<AtomicOp> _atomic_op(CallOp op) noexcept {
+        switch (op) {
+            case CallOp::ATOMIC_EXCHANGE: return AtomicOp::EXCHANGE;
+            case CallOp::ATOMIC_COMPARE_EXCHANGE: return AtomicOp::COMPARE_EXCHANGE;
+            case CallOp::ATOMIC_FETCH_ADD: return AtomicOp::ADD;
+            case CallOp::ATOMIC_FETCH_SUB: return AtomicOp::SUB;
+            case CallOp::ATOMIC_FETCH_AND: return AtomicOp::AND;
+            case CallOp::ATOMIC_FETCH_OR: return AtomicOp::OR;
+            case CallOp::ATOMIC_FETCH_XOR: return AtomicOp::XOR;
+            case CallOp::ATOMIC_FETCH_MIN: return AtomicOp::MIN;
+            case CallOp::ATOMIC_FETCH_MAX: return AtomicOp::MAX;
+            default: return std::nullopt;
+        }
+    }
+
+    void _atomic(const CallExpr *expr, AtomicOp op) noexcept {
+        auto args = expr->arguments();
+        auto ref = _evaluate(args[0]);
+        if (!_writable(ref)) {
+            LUISA_ERROR_WITH_LOCATION("Atomic operation on read-only value of type {}.", ref.type->description());
+        }
+        auto kind = expr->type()->tag();
+        auto address = _address(ref);
+        auto value = _rvalue(args[1], kind);
+        auto desired = op == AtomicOp::COMPARE_EXCHANGE ? _rvalue(args[2], kind) : Operand{};
+        auto dst = _allocate(kind, 1u);
+        _emit(Instruction{.op = OpCode::ATOMIC, .sub = static_cast<uint32_t>(op), .kind = kind, .count = 1u,
+                          .dst = dst, .a = address, .b = value, .c = desired});
+        _result = Value{expr->type(), dst, false};
+    }
+
+    [[nodiscard]] static std::optional<WarpOp> _warp_op(CallOp op) noexcept {
+        switch (op) {
+            case CallOp::WARP_LANE_ID: return WarpOp::LANE_ID;
+            case CallOp::WARP_ACTIVE_ALL: return WarpOp::ALL;
+            case CallOp::WARP_ACTIVE_ANY: return WarpOp::ANY;
+            case CallOp::WARP_ACTIVE_BALLOT: return WarpOp::BALLOT;
+            case CallOp::WARP_READ_LANE: return WarpOp::READ_LANE;
+            case CallOp::WARP_READ_FIRST_ACTIVE_LANE: return WarpOp::READ_FIRST_ACTIVE_LANE;
+            case CallOp::WARP_ACTIVE_SUM: return WarpOp::SUM;
+            case CallOp::WARP_PREFIX_SUM: return WarpOp::PREFIX_SUM;
+            case CallOp::WARP_INCLUSIVE_SUM: return WarpOp::INCLUSIVE_SUM;
+            default: return std::nullopt;
+        }
+    }
+
+    void _warp(const CallExpr *expr, WarpOp op) noexcept {
+        auto args = expr->arguments();
+        auto type = expr->type();
+        auto source = args.empty() ? type : args[0]->type();
+        auto kind = scalar_kind(source);
+        auto count = component_count(source);
+        if (!source->is_scalar() && !source->is_vector()) {
+            LUISA_ERROR_WITH_LOCATION("Invalid type {} for warp function {}.", source->description(), to_string(expr->op()));
+        }
+        auto a = args.empty() ? Operand{} : _rvalue(args[0], kind);
+        auto b = args.size() < 2u ? Operand{} : _rvalue(args[1], Type::Tag::UINT32);
+        auto dst = _allocate(type->size());
+        _emit(Instruction{.op = OpCode::WARP, .sub = static_cast<uint32_t>(op), .kind = kind, .count = count, .dst = dst, .a = a, .b = b});
+        _result = Value{type, dst, false};
+    }
+
+    void _builtin(const CallExpr *expr) noexcept {
+        auto op = expr->op();
+        auto args = expr->arguments();
+        auto type = expr->type();
+        if (auto f = _math_function(op)) {
+            _math(expr, *f);
+            return;
+        }
+        if (auto a = _atomic_op(op)) {
+            _atomic(expr, *a);
+            return;
+        }
+        if (auto w = _warp_op(op)) {
+            _warp(expr, *w);
+            return;
+        }
+        switch (op) {
+            case CallOp::DOT: {
+                auto kind = scalar_kind(args[0]->type());
+                auto a = _rvalue(args[0], kind);
+                auto b = _rvalue(args[1], kind);
+                auto dst = _allocate(type->size());
+                _emit(Instruction{.op = OpCode::DOT, .kind = kind, .count = component_count(args[0]->type()), .dst = dst, .a = a, .b = b});
+                _result = Value{type, dst, false};
+                break;
+            }
+            case CallOp::CROSS: {
+                auto a = _rvalue(args[0], Type::Tag::FLOAT);
+                auto b = _rvalue(args[1], Type::Tag::FLOAT);
+                auto dst = _allocate(type->size());
+                _emit(Instruction{.op = OpCode::CROSS, .kind = Type::Tag::FLOAT, .count = 3u, .dst = dst, .a = a, .b = b});
+                _result = Value{type, dst, false};
+                break;
+            }
+            case CallOp::ALL:
+            case CallOp::ANY: {
+                auto a = _rvalue(args[0], Type::Tag::BOOL);
+                auto dst = _allocate(type->size());
+                _emit(Instruction{.op = op == CallOp::ALL ? OpCode::ALL : OpCode::ANY, .kind = Type::Tag::BOOL,
+                                  .count = component_count(args[0]->type()), .dst = dst, .a = a});
+                _result = Value{type, dst, false};
+                break;
+            }
+            case CallOp::MAKE_VECTOR: {
+                if (!type->is_vector()) { LUISA_ERROR_WITH_LOCATION("Invalid vector constructor for type {}.", type->description()); }
+                auto dst = _allocate(type->size());
+                _compose(dst, type, args);
+                _result = Value{type, dst, false};
+                break;
+            }
+            case CallOp::TEXTURE_READ: {
+                auto texture = _evaluate(args[0]);
+                auto coord = _rvalue(args[1], Type::Tag::UINT32);
+                auto dst = _allocate(type->size());
+                _emit(Instruction{.op = OpCode::TEXTURE_READ, .kind = texture.type->element()->tag(),
+                                  .count = static_cast<uint32_t>(texture.type->dimension()), .dst = dst, .a = texture.operand, .b = coord});
+                _result = Value{type, dst, false};
+                break;
+            }
+            case CallOp::TEXTURE_WRITE: {
+                auto texture = _evaluate(args[0]);
+                auto kind = texture.type->element()->tag();
+                auto coord = _rvalue(args[1], Type::Tag::UINT32);
+                auto value = _rvalue(args[2], kind);
+                _emit(Instruction{.op = OpCode::TEXTURE_WRITE, .kind = kind, .count = static_cast<uint32_t>(texture.type->dimension()),
+                                  .dst = texture.operand, .a = coord, .b = value});
+                _result = Value{nullptr, {}, false};
+                break;
+            }
+            case CallOp::BINDLESS_BUFFER_READ:
+                _result = Value{type, _bindless_buffer_address(expr, type->size()), true};
+                break;
+            case CallOp::BINDLESS_BUFFER_WRITE: {
+                auto value_type = args[3]->type();
+                auto address = _bindless_buffer_address(expr, value_type->size());
+                _store(Value{value_type, address, true}, _evaluate(args[3]));
+                _result = Value{nullptr, {}, false};
+                break;
+            }
+            case CallOp::WARP_SIZE: {
+                auto size = CPUKernel::warp_size;
+                _result = Value{type, _constant(&size, sizeof(size)), false};
+                break;
+            }
+            case CallOp::BINDLESS_TEXTURE_READ: {
+                auto array = _evaluate(args[0]);
+                auto slot = _rvalue(args[1], Type::Tag::UINT32);
+                auto coord = _rvalue(args[2], Type::Tag::UINT32);
+                auto dst = _allocate(type->size());
+                _emit(Instruction{.op = OpCode::BINDLESS_TEXTURE_READ, .kind = Type::Tag::FLOAT, .count = component_count(args[2]->type()),
+                                  .dst = dst, .a = array.operand, .b = slot, .c = coord});
+                _result = Value{type, dst, false};
+                break;
+            }
+            default: LUISA_ERROR_WITH_LOCATION("Unsupported builtin function: {}.", to_string(op));
+        }
+    }
+
+    void _inline(const CallExpr *expr) noexcept {
+        auto f = expr->callable();
+        if (!f.captured_buffers().empty() || !f.captured_textures().empty() ||
+            !f.captured_bindless_arrays().empty() || !f.captured_uniforms().empty()) {
+            LUISA_ERROR_WITH_LOCATION("Callables with captured resources or uniforms are not supported.");
+        }
+        if (!f.shared_variables().empty()) { LUISA_ERROR_WITH_LOCATION("Shared variables are not supported in callables."); }
+        auto params = f.arguments();
+        auto args = expr->arguments();
+        if (params.size() != args.size()) {
+            LUISA_ERROR_WITH_LOCATION("Invalid argument count {} (expected {}).", args.size(), params.size());
+        }
+        std::unordered_map<uint32_t, Value> variables;
+        for (auto i = 0u; i < params.size(); i++) {
+            auto p = params[i];
+            auto arg = _evaluate(args[i]);
+            if (p.tag() == Variable::Tag::UNIFORM) {// passed by value
+                auto slot = _allocate(p.type()->size());
+                _store(Value{p.type(), slot, false}, arg);
+                variables.emplace(p.uid(), Value{p.type(), slot, false});
+            } else {// resources alias the caller's
+                variables.emplace(p.uid(), Value{p.type(), arg.operand, arg.indirect});
+            }
+        }
+        for (auto &&c : f.constant_variables()) {
+            auto type = c.variable.type();
+            variables.emplace(c.variable.uid(), Value{type, _constant(c.data, type->size()), false});
+        }
+        auto type = expr->type();
+        auto slot = type == nullptr ? Operand{} : _allocate(type->size());
+        auto frame_top = _frame_top;
+        auto local_top = _local_top;
+        _variables.emplace_back(std::move(variables));
+        _returns.emplace_back(Return{type, slot});
+        _push(OpCode::CALL_BEGIN);
+        f.body()->accept(*this);
+        _pop(OpCode::CALL_END);
+        _returns.pop_back();
+        _variables.pop_back();
+        _frame_top = frame_top;
+        _local_top = local_top;
+        _result = Value{type, slot, false};
+    }
+
+    // both values are evaluated, so the select stays branchless
+    [[nodiscard]] Operand _select(const Type *type, const Expression *cond, const Expression *t, const Expression *f) noexcept {
+        auto kind = scalar_kind(type);
+        auto count = component_count(type);
+        auto p = _rvalue(cond, Type::Tag::BOOL);
+        auto a = _rvalue(t, kind);
+        auto b = _rvalue(f, kind);
+        auto dst = _allocate(type->size());
+        auto flags = component_count(cond->type()) < count ? Instruction::broadcast_a : 0u;
+        _emit(Instruction{.op = OpCode::SELECT, .kind = kind, .count = count, .flags = flags, .dst = dst, .a = p, .b = a, .c = b});
+        return dst;
+    }
+
+    [[nodiscard]] Operand _condition(const Expression *expr) noexcept {
+        return _rvalue(expr, Type::Tag::BOOL);
+    }
+
+public:
+    void visit(const UnaryExpr *expr) override {
+        auto v = _evaluate(expr->operand());
+        auto kind = scalar_kind(v.type);
+        auto count = component_count(v.type);
+        auto a = _load(v);
+        auto result_kind = expr->op() == UnaryOp::NOT ? Type::Tag::BOOL : kind;
+        auto dst = _allocate(result_kind, count);
+        _emit(Instruction{.op = OpCode::UNARY, .sub = static_cast<uint32_t>(expr->op()), .kind = kind, .count = count, .dst = dst, .a = a});
+        _result = Value{expr->type(), _convert(dst, result_kind, scalar_kind(expr->type()), count), false};
+    }
+
+    void visit(const BinaryExpr *expr) override {
+        auto lhs = _evaluate(expr->lhs());
+        auto rhs = _evaluate(expr->rhs());
+        _result = Value{expr->type(), _binary(expr->op(), lhs, rhs, expr->type()), false};
+    }
+
+    void visit(const MemberExpr *expr) override {
+        auto self = _evaluate(expr->self());
+        _result = _offset(self, member_offset(self.type, expr->member_index()), expr->type());
+    }
+
+    void visit(const AccessExpr *expr) override {
+        auto range = _evaluate(expr->range());
+        auto stride = expr->type()->size();
+        if (!range.type->is_buffer()) {
+            if (auto literal = dynamic_cast<const LiteralExpr *>(expr->index())) {
+                _result = _offset(range, literal_integer(literal) * stride, expr->type());
+                return;
+            }
+        }
+        auto base = range.type->is_buffer() ? range.operand : _address(range);
+        auto index = _evaluate(expr->index());
+        auto dst = _allocate(sizeof(std::byte *));
+        _emit(Instruction{.op = OpCode::ADDRESS_INDEX, .kind = scalar_kind(index.type), .dst = dst, .a = base, .b = _load(index), .imm = stride});
+        _result = Value{expr->type(), dst, true};
+    }
+
+    void visit(const LiteralExpr *expr) override {
+        std::visit([this, expr](auto &&v) noexcept { _result = Value{expr->type(), _constant(&v, sizeof(v)), false}; }, expr->value());
+    }
+
+    void visit(const RefExpr *expr) override { _result = _variable(expr->variable()); }
+
+    void visit(const CallExpr *expr) override {
+        if (expr->is_builtin()) {
+            _builtin(expr);
+        } else {
+            _inline(expr);
+        }
+    }
+
+    void visit(const CastExpr *expr) override {
+        auto v = _evaluate(expr->expression());
+        if (expr->op() == CastOp::STATIC) {
+            auto a = _rvalue(v, scalar_kind(expr->type()));
+            _result = Value{expr->type(), a, false};
+        } else {// reinterpret the bytes in place
+            _result = Value{expr->type(), v.operand, v.indirect};
+        }
+    }
+
+    void visit(const SelectExpr *expr) override {
+        _result = Value{expr->type(), _select(expr->type(), expr->condition(), expr->true_value(), expr->false_value()), false};
+    }
+
+    void visit(const BreakStmt *) override { _emit(Instruction{.op = OpCode::BREAK}); }
+    void visit(const SyncBlockStmt *) override {}// lanes run in lockstep, see CPUKernel
+    void visit(const ContinueStmt *) override { _emit(Instruction{.op = OpCode::CONTINUE}); }
+
+    void visit(const ReturnStmt *stmt) override {
+        auto ret = _returns.back();
+        if (auto expr = stmt->expression(); expr != nullptr) {
+            if (ret.type == nullptr) { LUISA_ERROR_WITH_LOCATION("Returning a value from a void function."); }
+            auto value = is_arithmetic(ret.type) ? _rvalue(expr, scalar_kind(ret.type)) : _load(_evaluate(expr));
+            _emit(Instruction{.op = OpCode::RETURN, .count = static_cast<uint32_t>(ret.type->size()), .dst = ret.slot, .a = value});
+        } else {
+            _emit(Instruction{.op = OpCode::RETURN});
+        }
+    }
+
+    void visit(const ScopeStmt *stmt) override {
+        auto frame_top = _frame_top;
+        auto local_top = _local_top;
+        _local_top = _frame_top;
+        for (auto s : stmt->statements()) {
+            s->accept(*this);
+            _frame_top = _local_top;// temporaries die with their statement
+        }
+        _frame_top = frame_top;
+        _local_top = local_top;
+    }
+
+    void visit(const DeclareStmt *stmt) override {
+        auto v = stmt->variable();
+        auto slot = _allocate(v.type()->size());
+        _local_top = _frame_top;
+        _variables.back().emplace(v.uid(), Value{v.type(), slot, false});
+        _initialize(slot, v.type(), stmt->initializer());
+    }
+
+    void visit(const IfStmt *stmt) override {
+        auto cond = _condition(stmt->condition());
+        _push(OpCode::IF_BEGIN, cond);
+        auto skip = _emit(Instruction{.op = OpCode::JUMP_IF_NONE});
+        stmt->true_branch()->accept(*this);
+        if (auto false_branch = stmt->false_branch(); false_branch != nullptr) {
+            _patch(skip);
+            _emit(Instruction{.op = OpCode::IF_ELSE, .a = cond});
+            skip = _emit(Instruction{.op = OpCode::JUMP_IF_NONE});
+            false_branch->accept(*this);
+        }
+        _patch(skip);
+        _pop(OpCode::IF_END);
+    }
+
+    void visit(const WhileStmt *stmt) override {
+        _push(OpCode::LOOP_BEGIN);
+        auto head = _code.size();
+        auto frame_top = _frame_top;
+        auto cond = _condition(stmt->condition());
+        _emit(Instruction{.op = OpCode::LOOP_CONDITION, .a = cond});
+        auto exit = _emit(Instruction{.op = OpCode::JUMP_IF_NONE});
+        _frame_top = frame_top;
+        _push(OpCode::CONTINUE_BEGIN);
+        stmt->body()->accept(*this);
+        _pop(OpCode::CONTINUE_END);
+        _emit(Instruction{.op = OpCode::JUMP, .imm = head});
+        _patch(exit);
+        _pop(OpCode::LOOP_END);
+    }
+
+    // lowered as a while loop whose step runs after the continue point, so continued iterations advance too
+    void visit(const ForStmt *stmt) override {
+        auto frame_top = _frame_top;
+        auto local_top = _local_top;
+        auto v = stmt->variable();
+        Value variable{v.type(), _allocate(v.type()->size()), false};
+        _local_top = _frame_top;
+        _variables.back().insert_or_assign(v.uid(), variable);
+        _store(variable, _evaluate(stmt->initializer()));
+        _frame_top = _local_top;
+        _push(OpCode::LOOP_BEGIN);
+        auto head = _code.size();
+        auto cond = _condition(stmt->condition());
+        _emit(Instruction{.op = OpCode::LOOP_CONDITION, .a = cond});
+        auto exit = _emit(Instruction{.op = OpCode::JUMP_IF_NONE});
+        _frame_top = _local_top;
+        _push(OpCode::CONTINUE_BEGIN);
+        stmt->body()->accept(*this);
+        _pop(OpCode::CONTINUE_END);
+        auto step = _evaluate(stmt->step());
+        _store(variable, Value{v.type(), _binary(BinaryOp::ADD, variable, step, v.type()), false});
+        _frame_top = _local_top;
+        _emit(Instruction{.op = OpCode::JUMP, .imm = head});
+        _patch(exit);
+        _pop(OpCode::LOOP_END);
+        _frame_top = frame_top;
+        _local_top = local_top;
+    }
+
+    void visit(const ExprStmt *stmt) override { static_cast<void>(_evaluate(stmt->expression())); }
+
+    void visit(const SwitchStmt *stmt) override {
+        auto body = dynamic_cast<const ScopeStmt *>(stmt->body());
+        if (body == nullptr) { LUISA_ERROR_WITH_LOCATION("Switch body must be a scope."); }
+        auto value = _rvalue(stmt->expression(), Type::Tag::UINT32);
+        _push(OpCode::SWITCH_BEGIN);
+        // cases never fall through, so the default case can go last
+        const SwitchDefaultStmt *default_case = nullptr;
+        for (auto s : body->statements()) {
+            if (auto c = dynamic_cast<const SwitchCaseStmt *>(s)) {
+                auto literal = dynamic_cast<const LiteralExpr *>(c->expression());
+                if (literal == nullptr) { LUISA_ERROR_WITH_LOCATION("Switch case values must be literals."); }
+                auto x = static_cast<uint32_t>(literal_integer(literal));
+                _emit(Instruction{.op = OpCode::SWITCH_CASE, .a = value, .b = _constant(&x, sizeof(x))});
+                auto skip = _emit(Instruction{.op = OpCode::JUMP_IF_NONE});
+                c->body()->accept(*this);
+                _patch(skip);
+            } else if (auto d = dynamic_cast<const SwitchDefaultStmt *>(s)) {
+                default_case = d;
+            } else {
+                LUISA_ERROR_WITH_LOCATION("Invalid statement in switch body.");
+            }
+        }
+        if (default_case != nullptr) {
+            _emit(Instruction{.op = OpCode::SWITCH_DEFAULT});
+            auto skip = _emit(Instruction{.op = OpCode::JUMP_IF_NONE});
+            default_case->body()->accept(*this);
+            _patch(skip);
+        }
+        _pop(OpCode::SWITCH_END);
+    }
+
+    void visit(const SwitchCaseStmt *) override { LUISA_ERROR_WITH_LOCATION("Case outside of switch."); }
+    void visit(const SwitchDefaultStmt *) override { LUISA_ERROR_WITH_LOCATION("Default outside of switch."); }
+
+    void visit(const AssignStmt *stmt) override {
+        auto lhs = _evaluate(stmt->lhs());
+        auto rhs = _evaluate(stmt->rhs());
+        if (stmt->op() == AssignOp::ASSIGN) {
+            _store(lhs, rhs);
+        } else {// compound assignments map to binary ops in the same order
+            auto op = static_cast<BinaryOp>(static_cast<uint32_t>(stmt->op()) - static_cast<uint32_t>(AssignOp::ADD_ASSIGN));
+            auto value = _binary(op, lhs, rhs, lhs.type);
+            _store(lhs, Value{lhs.type, value, false});
+        }
+    }
+
+    [[nodiscard]] std::unique_ptr<CPUKernel> compile(Function kernel) noexcept {
+        std::unordered_map<uint32_t, Value> variables;
+        for (auto v : kernel.shared_variables()) {
+            auto offset = align(_shared_size, CPUKernel::frame_alignment);
+            _shared_size = offset + v.type()->size();
+            variables.emplace(v.uid(), Value{v.type(), {Space::SHARED, static_cast<uint32_t>(offset)}, false});
+        }
+        ArgumentLayout layout{kernel};
+        std::vector<uint32_t> buffer_arguments;
+        for (auto &&e : layout.entries()) {
+            variables.emplace(e.variable.uid(), Value{e.variable.type(), {Space::ARGUMENT, e.offset}, false});
+            if (e.variable.tag() == Variable::Tag::BUFFER) { buffer_arguments.emplace_back(e.offset); }
+        }
+        for (auto &&c : kernel.constant_variables()) {
+            auto type = c.variable.type();
+            variables.emplace(c.variable.uid(), Value{type, _constant(c.data, type->size()), false});
+        }
+        _variables.emplace_back(std::move(variables));
+        _returns.emplace_back(Return{nullptr, {}});
+        kernel.body()->accept(*this);
+        return std::make_unique<CPUKernel>(
+            std::move(_code), std::move(_constants), std::move(buffer_arguments), layout.size(),
+            align(_frame_size, CPUKernel::frame_alignment), _shared_size, _max_depth);
+    }
+};
+
+}// namespace detail
+
+std::unique_ptr<CPUKernel> CPUCodegen::compile(Function kernel) noexcept {
+    return detail::Codegen{}.compile(kernel);
+}
+
+}// namespace luisa::compute::cpu
@@ -0,0 +1,25 @@
+//
+// Created by Mike Smith on 2021/3/6.
+//
+
+#pragma once
+
+#include <memory>
+#include <string_view>
+
+#include <ast/function.h>
+#include <backends/cpu/cpu_kernel.h>
+
+namespace luisa::compute::cpu {
+
+// Lowers a kernel to CPUKernel instructions. Callables are inlined at their
+// call sites, and statements are scheduled over the block's execution mask.
+class CPUCodegen {
+
+public:
+    // identifies the backend and its instruction encoding in the kernel cache, bump it when codegen changes
+    static constexpr std::string_view cache_tag = "cpu-5";
+    [[nodiscard]] static std::unique_ptr<CPUKernel> compile(Function kernel) noexcept;
+};
+
+}// namespace luisa::compute::cpu
@@ -0,0 +1,89 @@
+//
+// Created by Mike Smith on 2021/3/4.
+//
+
+#include <cstring>
+
+#include <core/logging.h>
+#include <backends/cpu/cpu_stream.h>
+#include <backends/cpu/cpu_codegen.h>
+#include <backends/cpu/cpu_device.h>
+
+namespace luisa::compute::cpu {
+
+CPUDevice::CPUDevice(Context *context, CPUDeviceConfig config) noexcept
+    : Device{context},
+      _config{config},
+      _allocator{config.numa_policy, config.numa_node, config.huge_pages, config.huge_page_threshold},
+      _thread_pool{config.concurrency, config.pin_workers,
+                   config.numa_policy == NumaPolicy::BIND ? std::make_optional(_allocator.node()) : std::nullopt} {}
+
+void CPUDevice::_dispose_buffer(uint64_t handle) noexcept {
+    _allocator.free(buffer(handle));
+}
+
+uint64_t CPUDevice::_create_buffer(size_t size_bytes) noexcept {
+    return reinterpret_cast<uint64_t>(_allocator.allocate(size_bytes, buffer_alignment));
+}
+
+uint64_t CPUDevice::_create_buffer_with_data(size_t size_bytes, const void *data) noexcept {
+    auto handle = _create_buffer(size_bytes);
+    std::memcpy(buffer(handle), data, size_bytes);
+    return handle;
+}
+
+uint64_t CPUDevice::_create_buffer_from_file(const std::filesystem::path &path, size_t offset_bytes, size_t size_bytes) noexcept {
+    return reinterpret_cast<uint64_t>(_allocator.map_file(path, offset_bytes, size_bytes));
+}
+
+uint64_t CPUDevice::_create_texture(
+    PixelFormat format, uint32_t dimension,
+    uint32_t width, uint32_t height, uint32_t depth,
+    uint32_t mipmap_levels) noexcept {
+    auto texture = new CPUTexture{format, dimension, uint3{width, height, depth}, mipmap_levels};
+    return reinterpret_cast<uint64_t>(texture);
+}
+
+void CPUDevice::_dispose_texture(uint64_t handle) noexcept {
+    delete texture(handle);
+}
+
+uint64_t CPUDevice::_create_bindless_array(size_t size) noexcept {
+    return reinterpret_cast<uint64_t>(new CPUBindlessArray{size});
+}
+
+void CPUDevice::_dispose_bindless_array(uint64_t handle) noexcept {
+    delete bindless_array(handle);
+}
+
+uint64_t CPUDevice::_compile_kernel(Function kernel) noexcept {
+    // kernels live as long as the device, as compiled handles are cached by Device
+    auto compiled = CPUCodegen::compile(kernel);
+    auto handle = reinterpret_cast<uint64_t>(compiled.get());
+    std::scoped_lock lock{_kernel_mutex};
+    _kernels.emplace_back(std::move(compiled));
+    return handle;
+}
+
+std::string_view CPUDevice::_kernel_cache_tag() const noexcept {
+    return CPUCodegen::cache_tag;
+}
+
+std::vector<std::byte> CPUDevice::_serialize_kernel(uint64_t handle) noexcept {
+    return kernel(handle)->serialize();
+}
+
+std::optional<uint64_t> CPUDevice::_load_kernel(MappedFile file) noexcept {
+    auto loaded = CPUKernel::load(file.bytes());
+    if (loaded == nullptr) { return std::nullopt; }
+    auto handle = reinterpret_cast<uint64_t>(loaded.get());
+    std::scoped_lock lock{_kernel_mutex};
+    _kernels.emplace_back(std::move(loaded));
+    return handle;
+}
+
+std::unique_ptr<Stream> CPUDevice::create_stream() noexcept {
+    return std::make_unique<CPUStream>(this);
+}
+
+}// namespace luisa::compute::cpu
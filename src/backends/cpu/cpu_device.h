@@ -0,0 +1,73 @@
+//
+// Created by Mike Smith on 2021/3/4.
+//
+
+#pragma once
+
+#include <mutex>
+#include <memory>
+#include <vector>
+
+#include <runtime/device.h>
+#include <backends/cpu/cpu_texture.h>
+#include <backends/cpu/cpu_bindless_array.h>
+#include <backends/cpu/cpu_kernel.h>
+#include <backends/cpu/cpu_allocator.h>
+#include <backends/cpu/cpu_thread_pool.h>
+
+namespace luisa::compute::cpu {
+
+struct CPUDeviceConfig {
+    size_t concurrency{std::thread::hardware_concurrency()};
+    NumaPolicy numa_policy{NumaPolicy::DEFAULT};
+    uint32_t numa_node{0u};// for NumaPolicy::BIND
+    bool pin_workers{false};
+    HugePageMode huge_pages{HugePageMode::NONE};
+    size_t huge_page_threshold{CPUAllocator::default_huge_page_threshold};
+};
+
+// Buffers, textures, bindless arrays and kernels live in host memory, handles are their addresses.
+class CPUDevice : public Device {
+
+public:
+    static constexpr auto buffer_alignment = static_cast<size_t>(16u);
+
+private:
+    CPUDeviceConfig _config;
+    CPUAllocator _allocator;
+    std::mutex _kernel_mutex;
+    std::vector<std::unique_ptr<CPUKernel>> _kernels;
+    CPUThreadPool _thread_pool;
+    CompileService _compile_workers;// last, as queued compilations use the state above
+
+private:
+    void _dispose_buffer(uint64_t handle) noexcept override;
+    [[nodiscard]] uint64_t _create_buffer(size_t size_bytes) noexcept override;
+    [[nodiscard]] uint64_t _create_buffer_with_data(size_t size_bytes, const void *data) noexcept override;
+    [[nodiscard]] uint64_t _create_buffer_from_file(const std::filesystem::path &path, size_t offset_bytes, size_t size_bytes) noexcept override;
+    [[nodiscard]] uint64_t _create_texture(
+        PixelFormat format, uint32_t dimension,
+        uint32_t width, uint32_t height, uint32_t depth,
+        uint32_t mipmap_levels) noexcept override;
+    void _dispose_texture(uint64_t handle) noexcept override;
+    [[nodiscard]] uint64_t _create_bindless_array(size_t size) noexcept override;
+    void _dispose_bindless_array(uint64_t handle) noexcept override;
+    [[nodiscard]] uint64_t _compile_kernel(Function kernel) noexcept override;
+    [[nodiscard]] std::string_view _kernel_cache_tag() const noexcept override;
+    [[nodiscard]] std::vector<std::byte> _serialize_kernel(uint64_t handle) noexcept override;
+    [[nodiscard]] std::optional<uint64_t> _load_kernel(MappedFile file) noexcept override;
+    [[nodiscard]] CompileService *_compile_service() noexcept override { return &_compile_workers; }
+
+public:
+    explicit CPUDevice(Context *context = nullptr, CPUDeviceConfig config = {}) noexcept;
+    [[nodiscard]] std::unique_ptr<Stream> create_stream() noexcept override;
+    [[nodiscard]] auto &thread_pool() noexcept { return _thread_pool; }
+    [[nodiscard]] const auto &config() const noexcept { return _config; }
+
+    [[nodiscard]] static auto buffer(uint64_t handle) noexcept { return reinterpret_cast<std::byte *>(handle); }
+    [[nodiscard]] static auto texture(uint64_t handle) noexcept { return reinterpret_cast<CPUTexture *>(handle); }
+    [[nodiscard]] static auto bindless_array(uint64_t handle) noexcept { return reinterpret_cast<CPUBindlessArray *>(handle); }
+    [[nodiscard]] static auto kernel(uint64_t handle) noexcept { return reinterpret_cast<const CPUKernel *>(handle); }
+};
+
+}// namespace luisa::compute::cpu
@@ -0,0 +1,767 @@
+//
+// Created by Mike Smith on 2021/3/6.
+//
+
+#include <cmath>
+#include <atomic>
+#include <cstring>
+#include <algorithm>
+
+#include <core/logging.h>
+#include <ast/expression.h>
+#include <backends/cpu/cpu_texture.h>
+#include <backends/cpu/cpu_bindless_array.h>
+#include <backends/cpu/cpu_kernel.h>
+
+namespace luisa::compute::cpu {
+
+namespace detail {
+
+template<typename F>
+inline void with_scalar(Type::Tag kind, F &&f) noexcept {
+    switch (kind) {
+        case Type::Tag::BOOL: f.template operator()<bool>(); break;
+        case Type::Tag::FLOAT: f.template operator()<float>(); break;
+        case Type::Tag::INT8: f.template operator()<int8_t>(); break;
+        case Type::Tag::UINT8: f.template operator()<uint8_t>(); break;
+        case Type::Tag::INT16: f.template operator()<int16_t>(); break;
+        case Type::Tag::UINT16: f.template operator()<uint16_t>(); break;
+        case Type::Tag::INT32: f.template operator()<int32_t>(); break;
+        case Type::Tag::UINT32: f.template operator()<uint32_t>(); break;
+        default: LUISA_ERROR_WITH_LOCATION("Invalid scalar kind.");
+    }
+}
+
+class Executor {
+
+public:
+    enum struct Scope : uint32_t {
+        IF,
+        LOOP,
+        CONTINUE,
+        SWITCH,
+        FUNCTION
+    };
+
+    struct Entry {
+        Scope scope;
+        uint8_t *saved;
+        uint8_t *aux;
+    };
+
+private:
+    std::byte *_bases[4];
+    size_t _strides[4];
+    uint32_t _lanes;
+    uint8_t *_mask;
+    uint8_t *_mask_pool;
+    std::vector<Entry> _stack;
+
+private:
+    [[nodiscard]] std::byte *_address(Operand o, uint32_t lane) const noexcept {
+        auto space = static_cast<uint32_t>(o.space);
+        return _bases[space] + o.offset + lane * _strides[space];
+    }
+
+    template<typename T>
+    [[nodiscard]] T *_value(Operand o, uint32_t lane) const noexcept {
+        return reinterpret_cast<T *>(_address(o, lane));
+    }
+
+    template<typename F>
+    void _for_each_lane(F &&f) const noexcept {
+        for (auto l = 0u; l < _lanes; l++) {
+            if (_mask[l]) { f(l); }
+        }
+    }
+
+    [[nodiscard]] bool _none() const noexcept {
+        return std::none_of(_mask, _mask + _lanes, [](auto m) noexcept { return m != 0u; });
+    }
+
+    Entry &_push(Scope scope) noexcept {
+        auto depth = _stack.size();
+        auto saved = _mask_pool + depth * 2u * _lanes;
+        auto &&e = _stack.emplace_back(Entry{scope, saved, saved + _lanes});
+        std::memcpy(e.saved, _mask, _lanes);
+        return e;
+    }
+
+    void _pop_and_restore() noexcept {
+        std::memcpy(_mask, _stack.back().saved, _lanes);
+        _stack.pop_back();
+    }
+
+    template<typename T, typename R, typename F>
+    void _unary(const Instruction &inst, F f) const noexcept {
+        auto sa = (inst.flags & Instruction::broadcast_a) ? 0u : 1u;
+        _for_each_lane([&](auto l) noexcept {
+            auto d = _value<R>(inst.dst, l);
+            auto a = _value<const T>(inst.a, l);
+            for (auto i = 0u; i < inst.count; i++) { d[i] = static_cast<R>(f(a[i * sa])); }
+        });
+    }
+
+    template<typename T, typename R, typename F>
+    void _binary(const Instruction &inst, F f) const noexcept {
+        auto sa = (inst.flags & Instruction::broadcast_a) ? 0u : 1u;
+        auto sb = (inst.flags & Instruction::broadcast_b) ? 0u : 1u;
+        _for_each_lane([&](auto l) noexcept {
+            auto d = _value<R>(inst.dst, l);
+            auto a = _value<const T>(inst.a, l);
+            auto b = _value<const T>(inst.b, l);
+            for (auto i = 0u; i < inst.count; i++) { d[i] = static_cast<R>(f(a[i * sa], b[i * sb])); }
+        });
+    }
+
+    template<typename T, typename F>
+    void _ternary(const Instruction &inst, F f) const noexcept {
+        auto sa = (inst.flags & Instruction::broadcast_a) ? 0u : 1u;
+        auto sb = (inst.flags & Instruction::broadcast_b) ? 0u : 1u;
+        auto sc = (inst.flags & Instruction::broadcast_c) ? 0u : 1u;
+        _for_each_lane([&](auto l) noexcept {
+            auto d = _value<T>(inst.dst, l);
+            auto a = _value<const T>(inst.a, l);
+            auto b = _value<const T>(inst.b, l);
+            auto c = _value<const T>(inst.c, l);
+            for (auto i = 0u; i < inst.count; i++) { d[i] = static_cast<T>(f(a[i * sa], b[i * sb], c[i * sc])); }
+        });
+    }
+
+    template<typename T>
+    void _execute_unary(const Instruction &inst) const noexcept {
+        switch (static_cast<UnaryOp>(inst.sub)) {
+            case UnaryOp::PLUS: _unary<T, T>(inst, [](T x) noexcept { return x; }); break;
+            case UnaryOp::MINUS:
+                if constexpr (!std::is_same_v<T, bool>) { _unary<T, T>(inst, [](T x) noexcept { return -x; }); }
+                break;
+            case UnaryOp::NOT: _unary<T, bool>(inst, [](T x) noexcept { return !x; }); break;
+            case UnaryOp::BIT_NOT:
+                if constexpr (std::is_same_v<T, bool>) {
+                    _unary<T, T>(inst, [](T x) noexcept { return !x; });
+                } else if constexpr (std::is_integral_v<T>) {
+                    _unary<T, T>(inst, [](T x) noexcept { return ~x; });
+                }
+                break;
+        }
+    }
+
+    template<typename T>
+    void _execute_binary(const Instruction &inst) const noexcept {
+        static constexpr auto is_bool = std::is_same_v<T, bool>;
+        static constexpr auto is_integer = std::is_integral_v<T> && !is_bool;
+        switch (static_cast<BinaryOp>(inst.sub)) {
+            case BinaryOp::ADD:
+                if constexpr (!is_bool) { _binary<T, T>(inst, [](T a, T b) noexcept { return a + b; }); }
+                break;
+            case BinaryOp::SUB:
+                if constexpr (!is_bool) { _binary<T, T>(inst, [](T a, T b) noexcept { return a - b; }); }
+                break;
+            case BinaryOp::MUL:
+                if constexpr (!is_bool) { _binary<T, T>(inst, [](T a, T b) noexcept { return a * b; }); }
+                break;
+            case BinaryOp::DIV:
+                if constexpr (is_integer) {
+                    // integer division by zero yields zero instead of trapping the host
+                    _binary<T, T>(inst, [](T a, T b) noexcept { return b == 0 ? T{0} : static_cast<T>(a / b); });
+                } else if constexpr (!is_bool) {
+                    _binary<T, T>(inst, [](T a, T b) noexcept { return a / b; });
+                }
+                break;
+            case BinaryOp::MOD:
+                if constexpr (is_integer) {
+                    _binary<T, T>(inst, [](T a, T b) noexcept { return b == 0 ? T{0} : static_cast<T>(a % b); });
+                } else if constexpr (!is_bool) {
+                    _binary<T, T>(inst, [](T a, T b) noexcept { return std::fmod(a, b); });
+                }
+                break;
+            case BinaryOp::BIT_AND:
+                if constexpr (!std::is_floating_point_v<T>) { _binary<T, T>(inst, [](T a, T b) noexcept { return a & b; }); }
+                break;
+            case BinaryOp::BIT_OR:
+                if constexpr (!std::is_floating_point_v<T>) { _binary<T, T>(inst, [](T a, T b) noexcept { return a | b; }); }
+                break;
+            case BinaryOp::BIT_XOR:
+                if constexpr (!std::is_floating_point_v<T>) { _binary<T, T>(inst, [](T a, T b) noexcept { return a ^ b; }); }
+                break;
+            case BinaryOp::SHL:
+                if constexpr (is_integer) {
+                    _binary<T, T>(inst, [](T a, T b) noexcept { return a << (static_cast<uint32_t>(b) & (sizeof(T) * 8u - 1u)); });
+                }
+                break;
+            case BinaryOp::SHR:
+                if constexpr (is_integer) {
+                    _binary<T, T>(inst, [](T a, T b) noexcept { return a >> (static_cast<uint32_t>(b) & (sizeof(T) * 8u - 1u)); });
+                }
+                break;
+            case BinaryOp::AND: _binary<T, bool>(inst, [](T a, T b) noexcept { return a && b; }); break;
+            case BinaryOp::OR: _binary<T, bool>(inst, [](T a, T b) noexcept { return a || b; }); break;
+            case BinaryOp::LESS: _binary<T, bool>(inst, [](T a, T b) noexcept { return a < b; }); break;
+            case BinaryOp::GREATER: _binary<T, bool>(inst, [](T a, T b) noexcept { return a > b; }); break;
+            case BinaryOp::LESS_EQUAL: _binary<T, bool>(inst, [](T a, T b) noexcept { return a <= b; }); break;
+            case BinaryOp::GREATER_EQUAL: _binary<T, bool>(inst, [](T a, T b) noexcept { return a >= b; }); break;
+            case BinaryOp::EQUAL: _binary<T, bool>(inst, [](T a, T b) noexcept { return a == b; }); break;
+            case BinaryOp::NOT_EQUAL: _binary<T, bool>(inst, [](T a, T b) noexcept { return a != b; }); break;
+        }
+    }
+
+    template<typename T>
+    void _execute_math(const Instruction &inst) const noexcept {
+        using F = MathFunction;
+        auto f = static_cast<F>(inst.sub);
+        if constexpr (std::is_same_v<T, float>) {
+            switch (f) {
+                case F::ABS: _unary<T, T>(inst, [](T x) noexcept { return std::abs(x); }); return;
+                case F::SQRT: _unary<T, T>(inst, [](T x) noexcept { return std::sqrt(x); }); return;
+                case F::RSQRT: _unary<T, T>(inst, [](T x) noexcept { return 1.0f / std::sqrt(x); }); return;
+                case F::SIN: _unary<T, T>(inst, [](T x) noexcept { return std::sin(x); }); return;
+                case F::COS: _unary<T, T>(inst, [](T x) noexcept { return std::cos(x); }); return;
+                case F::TAN: _unary<T, T>(inst, [](T x) noexcept { return std::tan(x); }); return;
+                case F::ASIN: _unary<T, T>(inst, [](T x) noexcept { return std::asin(x); }); return;
+                case F::ACOS: _unary<T, T>(inst, [](T x) noexcept { return std::acos(x); }); return;
+                case F::ATAN: _unary<T, T>(inst, [](T x) noexcept { return std::atan(x); }); return;
+                case F::EXP: _unary<T, T>(inst, [](T x) noexcept { return std::exp(x); }); return;
+                case F::EXP2: _unary<T, T>(inst, [](T x) noexcept { return std::exp2(x); }); return;
+                case F::LOG: _unary<T, T>(inst, [](T x) noexcept { return std::log(x); }); return;
+                case F::LOG2: _unary<T, T>(inst, [](T x) noexcept { return std::log2(x); }); return;
+                case F::FLOOR: _unary<T, T>(inst, [](T x) noexcept { return std::floor(x); }); return;
+                case F::CEIL: _unary<T, T>(inst, [](T x) noexcept { return std::ceil(x); }); return;
+                case F::ROUND: _unary<T, T>(inst, [](T x) noexcept { return std::round(x); }); return;
+                case F::FRACT: _unary<T, T>(inst, [](T x) noexcept { return x - std::floor(x); }); return;
+                case F::SATURATE: _unary<T, T>(inst, [](T x) noexcept { return std::clamp(x, 0.0f, 1.0f); }); return;
+                case F::LENGTH:
+                    _for_each_lane([&](auto l) noexcept {
+                        auto a = _value<const T>(inst.a, l);
+                        auto sum = 0.0f;
+                        for (auto i = 0u; i < inst.count; i++) { sum += a[i] * a[i]; }
+                        *_value<T>(inst.dst, l) = std::sqrt(sum);
+                    });
+                    return;
+                case F::NORMALIZE:
+                    _for_each_lane([&](auto l) noexcept {
+                        auto a = _value<const T>(inst.a, l);
+                        auto sum = 0.0f;
+                        for (auto i = 0u; i < inst.count; i++) { sum += a[i] * a[i]; }
+                        auto s = 1.0f / std::sqrt(sum);
+                        auto d = _value<T>(inst.dst, l);
+                        for (auto i = 0u; i < inst.count; i++) { d[i] = a[i] * s; }
+                    });
+                    return;
+                case F::MIN: _binary<T, T>(inst, [](T a, T b) noexcept { return std::min(a, b); }); return;
+                case F::MAX: _binary<T, T>(inst, [](T a, T b) noexcept { return std::max(a, b); }); return;
+                case F::POW: _binary<T, T>(inst, [](T a, T b) noexcept { return std::pow(a, b); }); return;
+                case F::ATAN2: _binary<T, T>(inst, [](T a, T b) noexcept { return std::atan2(a, b); }); return;
+                case F::CLAMP: _ternary<T>(inst, [](T x, T lo, T hi) noexcept { return std::min(std::max(x, lo), hi); }); return;
+                case F::LERP: _ternary<T>(inst, [](T a, T b, T t) noexcept { return a + (b - a) * t; }); return;
+                case F::FMA: _ternary<T>(inst, [](T a, T b, T c) noexcept { return std::fma(a, b, c); }); return;
+            }
+        } else if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool>) {
+            switch (f) {
+                case F::ABS:
+                    if constexpr (std::is_signed_v<T>) {
+                        _unary<T, T>(inst, [](T x) noexcept { return x < 0 ? -x : x; });
+                    } else {
+                        _unary<T, T>(inst, [](T x) noexcept { return x; });
+                    }
+                    return;
+                case F::MIN: _binary<T, T>(inst, [](T a, T b) noexcept { return std::min(a, b); }); return;
+                case F::MAX: _binary<T, T>(inst, [](T a, T b) noexcept { return std::max(a, b); }); return;
+                case F::CLAMP: _ternary<T>(inst, [](T x, T lo, T hi) noexcept { return std::min(std::max(x, lo), hi); }); return;
+                default: break;
+            }
+        }
+        LUISA_ERROR_WITH_LOCATION("Invalid math function {} on scalar kind {}.", inst.sub, static_cast<uint32_t>(inst.kind));
+    }
+
+    // blocks run concurrently on the workers, so these are the only cross-thread accesses; they acquire
+    // and release, so that an atomic publishing a flag also publishes the plain stores before it
+    template<typename T>
+    void _execute_atomic(const Instruction &inst) const noexcept {
+        static constexpr auto order = std::memory_order_acq_rel;
+        _for_each_lane([&](auto l) noexcept {
+            std::atomic_ref<T> ref{**_value<T *>(inst.a, l)};
+            auto value = *_value<const T>(inst.b, l);
+            auto fetch = [&](auto f) noexcept {
+                auto old = ref.load(std::memory_order_acquire);
+                while (!ref.compare_exchange_weak(old, f(old, value), order)) {}
+                return old;
+            };
+            auto &&dst = *_value<T>(inst.dst, l);
+            switch (static_cast<AtomicOp>(inst.sub)) {
+                case AtomicOp::EXCHANGE: dst = ref.exchange(value, order); break;
+                case AtomicOp::COMPARE_EXCHANGE: {
+                    auto expected = value;
+                    ref.compare_exchange_strong(expected, *_value<const T>(inst.c, l), order);
+                    dst = expected;
+                    break;
+                }
+                case AtomicOp::ADD: dst = ref.fetch_add(value, order); break;
+                case AtomicOp::SUB: dst = ref.fetch_sub(value, order); break;
+                case AtomicOp::MIN: dst = fetch([](T a, T b) noexcept { return std::min(a, b); }); break;
+                case AtomicOp::MAX: dst = fetch([](T a, T b) noexcept { return std::max(a, b); }); break;
+                default:
+                    if constexpr (std::is_integral_v<T>) {
+                        switch (static_cast<AtomicOp>(inst.sub)) {
+                            case AtomicOp::AND: dst = ref.fetch_and(value, order); break;
+                            case AtomicOp::OR: dst = ref.fetch_or(value, order); break;
+                            case AtomicOp::XOR: dst = ref.fetch_xor(value, order); break;
+                            default: break;
+                        }
+                    }
+                    break;
+            }
+        });
+    }
+
+    template<typename T>
+    void _execute_warp(const Instruction &inst) const noexcept {
+        auto op = static_cast<WarpOp>(inst.sub);
+        for (auto base = 0u; base < _lanes; base += CPUKernel::warp_size) {
+            auto end = std::min(base + CPUKernel::warp_size, _lanes);
+            auto first = base;
+            while (first < end && !_mask[first]) { first++; }
+            if (first == end) { continue; }
+            auto warp_lanes = [&](auto f) noexcept {
+                for (auto l = base; l < end; l++) {
+                    if (_mask[l]) { f(l); }
+                }
+            };
+            switch (op) {
+                case WarpOp::LANE_ID:
+                    warp_lanes([&](auto l) noexcept { *_value<uint32_t>(inst.dst, l) = l - base; });
+                    break;
+                case WarpOp::ALL:
+                case WarpOp::ANY:
+                case WarpOp::BALLOT: {
+                    auto ballot = 0u;
+                    auto active = 0u;
+                    warp_lanes([&](auto l) noexcept {
+                        active |= 1u << (l - base);
+                        if (*_value<const bool>(inst.a, l)) { ballot |= 1u << (l - base); }
+                    });
+                    warp_lanes([&](auto l) noexcept {
+                        if (op == WarpOp::BALLOT) {
+                            *_value<uint32_t>(inst.dst, l) = ballot;
+                        } else {
+                            *_value<bool>(inst.dst, l) = op == WarpOp::ALL ? ballot == active : ballot != 0u;
+                        }
+                    });
+                    break;
+                }
+                case WarpOp::READ_LANE:
+                    warp_lanes([&](auto l) noexcept {
+                        auto source = base + *_value<const uint32_t>(inst.b, l) % CPUKernel::warp_size;
+                        std::memcpy(_address(inst.dst, l), _address(inst.a, std::min(source, end - 1u)), inst.count * sizeof(T));
+                    });
+                    break;
+                case WarpOp::READ_FIRST_ACTIVE_LANE:
+                    warp_lanes([&](auto l) noexcept { std::memcpy(_address(inst.dst, l), _address(inst.a, first), inst.count * sizeof(T)); });
+                    break;
+                case WarpOp::SUM:
+                case WarpOp::PREFIX_SUM:
+                case WarpOp::INCLUSIVE_SUM:
+                    if constexpr (!std::is_same_v<T, bool>) {
+                        T sum[4]{};
+                        warp_lanes([&](auto l) noexcept {
+                            auto a = _value<const T>(inst.a, l);
+                            auto d = _value<T>(inst.dst, l);
+                            for (auto i = 0u; i < inst.count; i++) {
+                                if (op == WarpOp::PREFIX_SUM) { d[i] = sum[i]; }
+                                sum[i] += a[i];
+                                if (op == WarpOp::INCLUSIVE_SUM) { d[i] = sum[i]; }
+                            }
+                        });
+                        if (op == WarpOp::SUM) {
+                            warp_lanes([&](auto l) noexcept { std::memcpy(_address(inst.dst, l), sum, inst.count * sizeof(T)); });
+                        }
+                    }
+                    break;
+            }
+        }
+    }
+
+    [[nodiscard]] static uint3 _coord(const uint32_t *c, uint32_t dimension) noexcept {
+        return uint3{c[0], c[1], dimension == 3u ? c[2] : 0u};
+    }
+
+    [[nodiscard]] int64_t _index(Type::Tag kind, Operand o, uint32_t lane) const noexcept {
+        auto p = _address(o, lane);
+        switch (kind) {
+            case Type::Tag::INT8: return *reinterpret_cast<const int8_t *>(p);
+            case Type::Tag::UINT8: return *reinterpret_cast<const uint8_t *>(p);
+            case Type::Tag::INT16: return *reinterpret_cast<const int16_t *>(p);
+            case Type::Tag::UINT16: return *reinterpret_cast<const uint16_t *>(p);
+            case Type::Tag::INT32: return *reinterpret_cast<const int32_t *>(p);
+            default: return *reinterpret_cast<const uint32_t *>(p);
+        }
+    }
+
+    // removes the lane from enclosing scopes up to (excluding) the one matching stop
+    template<typename Stop>
+    void _kill(uint32_t lane, Stop &&stop) noexcept {
+        _mask[lane] = 0u;
+        for (auto i = _stack.size(); i > 0u; i--) {
+            auto &&e = _stack[i - 1u];
+            if (stop(e)) { return; }
+            if (e.scope != Scope::CONTINUE) { e.saved[lane] = 0u; }
+        }
+    }
+
+public:
+    Executor(std::byte *frames, size_t frame_size, const std::byte *arguments, const std::byte *constants,
+             std::byte *shared, uint32_t lanes, uint8_t *mask, uint8_t *mask_pool, size_t max_depth) noexcept
+        : _bases{frames, const_cast<std::byte *>(arguments), const_cast<std::byte *>(constants), shared},
+          _strides{frame_size, 0u, 0u, 0u},
+          _lanes{lanes},
+          _mask{mask},
+          _mask_pool{mask_pool} { _stack.reserve(max_depth); }
+
+    void run(std::span<const Instruction> code) noexcept {
+        auto pc = static_cast<size_t>(0u);
+        while (pc < code.size()) {
+            auto &&inst = code[pc++];
+            switch (inst.op) {
+                case OpCode::ZERO:
+                    _for_each_lane([&](auto l) noexcept { std::memset(_address(inst.dst, l), 0, inst.count); });
+                    break;
+                case OpCode::MOVE:
+                    _for_each_lane([&](auto l) noexcept { std::memmove(_address(inst.dst, l), _address(inst.a, l), inst.count); });
+                    break;
+                case OpCode::LOAD:
+                    _for_each_lane([&](auto l) noexcept {
+                        std::memcpy(_address(inst.dst, l), *_value<std::byte *>(inst.a, l), inst.count);
+                    });
+                    break;
+                case OpCode::STORE:
+                    _for_each_lane([&](auto l) noexcept {
+                        std::memcpy(*_value<std::byte *>(inst.dst, l), _address(inst.a, l), inst.count);
+                    });
+                    break;
+                case OpCode::ADDRESS:
+                    _for_each_lane([&](auto l) noexcept { *_value<std::byte *>(inst.dst, l) = _address(inst.a, l); });
+                    break;
+                case OpCode::ADDRESS_OFFSET:
+                    _for_each_lane([&](auto l) noexcept {
+                        *_value<std::byte *>(inst.dst, l) = *_value<std::byte *>(inst.a, l) + inst.imm;
+                    });
+                    break;
+                case OpCode::ADDRESS_INDEX:
+                    _for_each_lane([&](auto l) noexcept {
+                        auto index = _index(inst.kind, inst.b, l);
+                        *_value<std::byte *>(inst.dst, l) = *_value<std::byte *>(inst.a, l) + index * static_cast<int64_t>(inst.imm);
+                    });
+                    break;
+                case OpCode::UNARY:
+                    with_scalar(inst.kind, [&]<typename T>() noexcept { _execute_unary<T>(inst); });
+                    break;
+                case OpCode::BINARY:
+                    with_scalar(inst.kind, [&]<typename T>() noexcept { _execute_binary<T>(inst); });
+                    break;
+                case OpCode::CONVERT:
+                    with_scalar(inst.kind, [&]<typename S>() noexcept {
+                        with_scalar(inst.dst_kind, [&]<typename D>() noexcept {
+                            _unary<S, D>(inst, [](S x) noexcept { return static_cast<D>(x); });
+                        });
+                    });
+                    break;
+                case OpCode::MATH:
+                    with_scalar(inst.kind, [&]<typename T>() noexcept { _execute_math<T>(inst); });
+                    break;
+                case OpCode::SELECT:
+                    with_scalar(inst.kind, [&]<typename T>() noexcept {
+                        auto sa = (inst.flags & Instruction::broadcast_a) ? 0u : 1u;
+                        _for_each_lane([&](auto l) noexcept {
+                            auto d = _value<T>(inst.dst, l);
+                            auto p = _value<const bool>(inst.a, l);
+                            auto t = _value<const T>(inst.b, l);
+                            auto f = _value<const T>(inst.c, l);
+                            for (auto i = 0u; i < inst.count; i++) { d[i] = p[i * sa] ? t[i] : f[i]; }
+                        });
+                    });
+                    break;
+                case OpCode::DOT:
+                    with_scalar(inst.kind, [&]<typename T>() noexcept {
+                        if constexpr (!std::is_same_v<T, bool>) {
+                            _for_each_lane([&](auto l) noexcept {
+                                auto a = _value<const T>(inst.a, l);
+                                auto b = _value<const T>(inst.b, l);
+                                T sum{0};
+                                for (auto i = 0u; i < inst.count; i++) { sum += a[i] * b[i]; }
+                                *_value<T>(inst.dst, l) = sum;
+                            });
+                        }
+                    });
+                    break;
+                case OpCode::CROSS:
+                    _for_each_lane([&](auto l) noexcept {
+                        auto a = *_value<const float3>(inst.a, l);
+                        auto b = *_value<const float3>(inst.b, l);
+                        *_value<float3>(inst.dst, l) = float3{a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+                    });
+                    break;
+                case OpCode::ALL:
+                    _for_each_lane([&](auto l) noexcept {
+                        auto a = _value<const bool>(inst.a, l);
+                        *_value<bool>(inst.dst, l) = std::all_of(a, a + inst.count, [](bool x) noexcept { return x; });
+                    });
+                    break;
+                case OpCode::ANY:
+                    _for_each_lane([&](auto l) noexcept {
+                        auto a = _value<const bool>(inst.a, l);
+                        *_value<bool>(inst.dst, l) = std::any_of(a, a + inst.count, [](bool x) noexcept { return x; });
+                    });
+                    break;
+                case OpCode::MATRIX_VECTOR:
+                    _for_each_lane([&](auto l) noexcept {
+                        auto m = _value<const float>(inst.a, l);// columns are padded to 4 floats
+                        auto v = _value<const float>(inst.b, l);
+                        float r[4]{};
+                        for (auto c = 0u; c < inst.count; c++) {
+                            for (auto i = 0u; i < inst.count; i++) { r[i] += m[c * 4u + i] * v[c]; }
+                        }
+                        std::memcpy(_address(inst.dst, l), r, inst.count * sizeof(float));
+                    });
+                    break;
+                case OpCode::MATRIX_MATRIX:
+                    _for_each_lane([&](auto l) noexcept {
+                        auto a = _value<const float>(inst.a, l);
+                        auto b = _value<const float>(inst.b, l);
+                        float r[16]{};
+                        for (auto c = 0u; c < inst.count; c++) {
+                            for (auto k = 0u; k < inst.count; k++) {
+                                for (auto i = 0u; i < inst.count; i++) { r[c * 4u + i] += a[k * 4u + i] * b[c * 4u + k]; }
+                            }
+                        }
+                        std::memcpy(_address(inst.dst, l), r, inst.count * 4u * sizeof(float));
+                    });
+                    break;
+                case OpCode::TEXTURE_READ:
+                    with_scalar(inst.kind, [&]<typename T>() noexcept {
+                        if constexpr (std::is_same_v<T, float> || std::is_same_v<T, int32_t> || std::is_same_v<T, uint32_t>) {
+                            _for_each_lane([&](auto l) noexcept {
+                                auto t = _value<const TextureArgument>(inst.a, l);
+                                auto coord = _coord(_value<const uint32_t>(inst.b, l), inst.count);
+                                *_value<Vector<T, 4>>(inst.dst, l) = t->texture->template read<T>(t->level, coord);
+                            });
+                        }
+                    });
+                    break;
+                case OpCode::TEXTURE_WRITE:
+                    with_scalar(inst.kind, [&]<typename T>() noexcept {
+                        if constexpr (std::is_same_v<T, float> || std::is_same_v<T, int32_t> || std::is_same_v<T, uint32_t>) {
+                            _for_each_lane([&](auto l) noexcept {
+                                auto t = _value<const TextureArgument>(inst.dst, l);
+                                auto coord = _coord(_value<const uint32_t>(inst.a, l), inst.count);
+                                t->texture->template write<T>(t->level, coord, *_value<const Vector<T, 4>>(inst.b, l));
+                            });
+                        }
+                    });
+                    break;
+                case OpCode::BINDLESS_BUFFER_ADDRESS:
+                    _for_each_lane([&](auto l) noexcept {
+                        auto array = *_value<const CPUBindlessArray *>(inst.a, l);
+                        auto slot = *_value<const uint32_t>(inst.b, l);
+                        auto index = _index(inst.kind, inst.c, l);
+                        *_value<std::byte *>(inst.dst, l) = array->buffer(slot) + index * static_cast<int64_t>(inst.imm);
+                    });
+                    break;
+                case OpCode::BINDLESS_TEXTURE_READ:
+                    _for_each_lane([&](auto l) noexcept {
+                        auto array = *_value<const CPUBindlessArray *>(inst.a, l);
+                        auto slot = *_value<const uint32_t>(inst.b, l);
+                        auto coord = _coord(_value<const uint32_t>(inst.c, l), inst.count);
+                        *_value<float4>(inst.dst, l) = array->texture(slot)->template read<float>(array->slot(slot).level, coord);
+                    });
+                    break;
+                case OpCode::ATOMIC:
+                    switch (inst.kind) {
+                        case Type::Tag::INT32: _execute_atomic<int32_t>(inst); break;
+                        case Type::Tag::UINT32: _execute_atomic<uint32_t>(inst); break;
+                        case Type::Tag::FLOAT: _execute_atomic<float>(inst); break;
+                        default: LUISA_ERROR_WITH_LOCATION("Invalid atomic kind {}.", static_cast<uint32_t>(inst.kind));
+                    }
+                    break;
+                case OpCode::WARP:
+                    with_scalar(inst.kind, [&]<typename T>() noexcept { _execute_warp<T>(inst); });
+                    break;
+                case OpCode::JUMP: pc = inst.imm; break;
+                case OpCode::JUMP_IF_NONE:
+                    if (_none()) { pc = inst.imm; }
+                    break;
+                case OpCode::IF_BEGIN:
+                    _push(Scope::IF);
+                    _for_each_lane([&](auto l) noexcept { _mask[l] = *_value<const bool>(inst.a, l); });
+                    break;
+                case OpCode::IF_ELSE: {
+                    auto saved = _stack.back().saved;
+                    for (auto l = 0u; l < _lanes; l++) { _mask[l] = saved[l] && !*_value<const bool>(inst.a, l); }
+                    break;
+                }
+                case OpCode::IF_END: _pop_and_restore(); break;
+                case OpCode::LOOP_BEGIN: _push(Scope::LOOP); break;
+                case OpCode::LOOP_CONDITION:
+                    _for_each_lane([&](auto l) noexcept { _mask[l] = *_value<const bool>(inst.a, l); });
+                    break;
+                case OpCode::CONTINUE_BEGIN: std::memset(_push(Scope::CONTINUE).aux, 0, _lanes); break;
+                case OpCode::CONTINUE_END: {
+                    auto continued = _stack.back().aux;
+                    for (auto l = 0u; l < _lanes; l++) { _mask[l] |= continued[l]; }
+                    _stack.pop_back();
+                    break;
+                }
+                case OpCode::LOOP_END: _pop_and_restore(); break;
+                case OpCode::SWITCH_BEGIN: {
+                    auto &&e = _push(Scope::SWITCH);
+                    std::memcpy(e.aux, _mask, _lanes);
+                    break;
+                }
+                case OpCode::SWITCH_CASE: {
+                    auto unmatched = _stack.back().aux;
+                    auto value = *_value<const uint32_t>(inst.b, 0u);
+                    for (auto l = 0u; l < _lanes; l++) {
+                        auto match = unmatched[l] && *_value<const uint32_t>(inst.a, l) == value;
+                        _mask[l] = match;
+                        if (match) { unmatched[l] = 0u; }
+                    }
+                    break;
+                }
+                case OpCode::SWITCH_DEFAULT: std::memcpy(_mask, _stack.back().aux, _lanes); break;
+                case OpCode::SWITCH_END: _pop_and_restore(); break;
+                case OpCode::CALL_BEGIN: _push(Scope::FUNCTION); break;
+                case OpCode::CALL_END: _pop_and_restore(); break;
+                case OpCode::BREAK:
+                    _for_each_lane([this](auto l) noexcept {
+                        _kill(l, [](auto &&e) noexcept { return e.scope == Scope::LOOP || e.scope == Scope::SWITCH; });
+                    });
+                    break;
+                case OpCode::CONTINUE:
+                    _for_each_lane([this](auto l) noexcept {
+                        _kill(l, [l](auto &&e) noexcept {
+                            if (e.scope != Scope::CONTINUE) { return false; }
+                            e.aux[l] = 1u;
+                            return true;
+                        });
+                    });
+                    break;
+                case OpCode::RETURN:
+                    _for_each_lane([&](auto l) noexcept {
+                        if (inst.count != 0u) { std::memmove(_address(inst.dst, l), _address(inst.a, l), inst.count); }
+                        _kill(l, [](auto &&e) noexcept { return e.scope == Scope::FUNCTION; });
+                    });
+                    break;
+            }
+        }
+    }
+};
+
+}// namespace detail
+
+CPUKernel::CPUKernel(std::vector<Instruction> code, std::vector<std::byte> constants, std::vector<uint32_t> buffer_arguments,
+                     size_t argument_size, size_t frame_size, size_t shared_size, size_t max_depth) noexcept
+    : _code{std::move(code)},
+      _constants{std::move(constants)},
+      _buffer_arguments{std::move(buffer_arguments)},
+      _argument_size{argument_size},
+      _frame_size{frame_size},
+      _shared_size{shared_size},
+      _max_depth{max_depth} {}
+
+namespace detail {
+
+struct KernelBlobHeader {
+    static constexpr auto magic_number = 0x4c4b5043u;// "CPKL"
+    static constexpr auto current_version = 5u;
+    uint32_t magic;
+    uint32_t version;
+    uint32_t instruction_size;
+    uint32_t max_depth;
+    uint64_t argument_size;
+    uint64_t frame_size;
+    uint64_t shared_size;
+    uint64_t code_count;
+    uint64_t buffer_argument_count;
+    uint64_t constants_size;
+};
+
+}// namespace detail
+
+std::vector<std::byte> CPUKernel::serialize() const noexcept {
+    detail::KernelBlobHeader header{
+        detail::KernelBlobHeader::magic_number,
+        detail::KernelBlobHeader::current_version,
+        static_cast<uint32_t>(sizeof(Instruction)),
+        static_cast<uint32_t>(_max_depth),
+        _argument_size, _frame_size, _shared_size,
+        _code.size(), _buffer_arguments.size(), _constants.size()};
+    auto code_size = _code.size() * sizeof(Instruction);
+    auto buffers_size = _buffer_arguments.size() * sizeof(uint32_t);
+    std::vector<std::byte> blob(sizeof(header) + code_size + buffers_size + _constants.size());
+    std::memcpy(blob.data(), &header, sizeof(header));
+    std::memcpy(blob.data() + sizeof(header), _code.data(), code_size);
+    std::memcpy(blob.data() + sizeof(header) + code_size, _buffer_arguments.data(), buffers_size);
+    std::memcpy(blob.data() + sizeof(header) + code_size + buffers_size, _constants.data(), _constants.size());
+    return blob;
+}
+
+std::unique_ptr<CPUKernel> CPUKernel::load(std::span<const std::byte> blob) noexcept {
+    detail::KernelBlobHeader header{};
+    if (blob.size() < sizeof(header)) { return nullptr; }
+    std::memcpy(&header, blob.data(), sizeof(header));
+    if (header.magic != detail::KernelBlobHeader::magic_number
+        || header.version != detail::KernelBlobHeader::current_version
+        || header.instruction_size != sizeof(Instruction)
+        || header.code_count > blob.size() / sizeof(Instruction)
+        || header.buffer_argument_count > blob.size() / sizeof(uint32_t)
+        || blob.size() != sizeof(header) + header.code_count * sizeof(Instruction)
+                              + header.buffer_argument_count * sizeof(uint32_t) + header.constants_size) {
+        return nullptr;
+    }
+    std::vector<Instruction> code(header.code_count);
+    std::vector<uint32_t> buffer_arguments(header.buffer_argument_count);
+    std::vector<std::byte> constants(header.constants_size);
+    auto code_size = code.size() * sizeof(Instruction);
+    auto buffers_size = buffer_arguments.size() * sizeof(uint32_t);
+    std::memcpy(code.data(), blob.data() + sizeof(header), code_size);
+    std::memcpy(buffer_arguments.data(), blob.data() + sizeof(header) + code_size, buffers_size);
+    std::memcpy(constants.data(), blob.data() + sizeof(header) + code_size + buffers_size, constants.size());
+    return std::make_unique<CPUKernel>(
+        std::move(code), std::move(constants), std::move(buffer_arguments),
+        header.argument_size, header.frame_size, header.shared_size, header.max_depth);
+}
+
+void CPUKernel::resolve_arguments(std::byte *arguments) const noexcept {
+    for (auto offset : _buffer_arguments) {
+        ArgumentLayout::BufferArgument buffer{};
+        std::memcpy(&buffer, arguments + offset, sizeof(buffer));
+        auto address = buffer.handle + buffer.offset_bytes;
+        std::memcpy(arguments + offset, &address, sizeof(address));
+    }
+}
+
+void CPUKernel::run(const std::byte *arguments, uint3 block_id, uint3 block_size, uint3 dispatch_size, Scratch &scratch) const noexcept {
+    auto lanes = block_size.x * block_size.y * block_size.z;
+    if (scratch._frames.size() < lanes * _frame_size) { scratch._frames.resize(lanes * _frame_size); }
+    auto mask_size = (1u + 2u * _max_depth) * lanes;
+    if (scratch._masks.size() < mask_size) { scratch._masks.resize(mask_size); }
+    // shared memory starts zeroed in every block
+    if (_shared_size != 0u) {
+        if (scratch._shared.size() < _shared_size) { scratch._shared.resize(_shared_size); }
+        std::memset(scratch._shared.data(), 0, _shared_size);
+    }
+    auto frames = scratch._frames.data();
+    auto mask = scratch._masks.data();
+    for (auto l = 0u; l < lanes; l++) {
+        uint3 tid{l % block_size.x, l / block_size.x % block_size.y, l / (block_size.x * block_size.y)};
+        uint3 did{block_id.x * block_size.x + tid.x, block_id.y * block_size.y + tid.y, block_id.z * block_size.z + tid.z};
+        auto frame = frames + l * _frame_size;
+        std::memcpy(frame + thread_id_offset, &tid, sizeof(uint3));
+        std::memcpy(frame + block_id_offset, &block_id, sizeof(uint3));
+        std::memcpy(frame + dispatch_id_offset, &did, sizeof(uint3));
+        mask[l] = did.x < dispatch_size.x && did.y < dispatch_size.y && did.z < dispatch_size.z;
+    }
+    detail::Executor executor{frames, _frame_size, arguments, _constants.data(), scratch._shared.data(),
+                              lanes, mask, mask + lanes, _max_depth};
+    executor.run(_code);
+}
+
+}// namespace luisa::compute::cpu
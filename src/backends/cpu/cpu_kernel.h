@@ -0,0 +1,189 @@
+//
+// Created by Mike Smith on 2021/3/6.
+//
+
+#pragma once
+
+#include <span>
+#include <memory>
+#include <vector>
+
+#include <core/concepts.h>
+#include <core/data_types.h>
+#include <ast/type.h>
+#include <runtime/argument_layout.h>
+
+namespace luisa::compute::cpu {
+
+class CPUTexture;
+
+// Values in FRAME space are private to each lane, while ARGUMENT, CONSTANT and
+// SHARED values are shared by all the lanes of a block.
+enum struct Space : uint32_t {
+    FRAME,
+    ARGUMENT,
+    CONSTANT,
+    SHARED
+};
+
+struct Operand {
+    Space space;
+    uint32_t offset;
+};
+
+enum struct OpCode : uint32_t {
+
+    // data movement, count is the size in bytes
+    ZERO,         // dst = 0
+    MOVE,         // dst = a
+    LOAD,         // dst = *a
+    STORE,        // *dst = a
+    ADDRESS,      // dst = &a
+    ADDRESS_OFFSET,// dst = a + imm
+    ADDRESS_INDEX,// dst = a + b * imm, b is an int or uint of kind
+
+    // arithmetic over count components of kind
+    UNARY,        // dst = op(a), sub is the UnaryOp
+    BINARY,       // dst = a op b, sub is the BinaryOp
+    CONVERT,      // dst (of dst_kind) = a (of kind)
+    MATH,         // dst = f(a[, b[, c]]), sub is the MathFunction
+    SELECT,       // dst = a ? b : c, a is a bool or a bool vector
+    DOT,          // dst = dot(a, b)
+    CROSS,        // dst = cross(a, b)
+    ALL,          // dst = all(a)
+    ANY,          // dst = any(a)
+    MATRIX_VECTOR,// dst = a * b, count is the dimension
+    MATRIX_MATRIX,// dst = a * b, count is the dimension
+
+    // resources
+    TEXTURE_READ,          // dst = read(a, b), kind of texels, count is the dimension
+    TEXTURE_WRITE,         // write(dst, a, b)
+    BINDLESS_BUFFER_ADDRESS,// dst = &buffer(a, b)[c], imm is the element size
+    BINDLESS_TEXTURE_READ, // dst = read(a, b, c), count is the dimension
+    ATOMIC,                // dst = op(*a, b[, c]) returning the old value, sub is the AtomicOp
+    WARP,                  // dst = op(a[, b]) across the active lanes of each warp, sub is the WarpOp
+
+    // structured control flow over the execution mask, imm is the jump target
+    JUMP,
+    JUMP_IF_NONE,
+    IF_BEGIN,   // a is the condition
+    IF_ELSE,    // a is the condition
+    IF_END,
+    LOOP_BEGIN,
+    LOOP_CONDITION,// a is the condition
+    CONTINUE_BEGIN,
+    CONTINUE_END,
+    LOOP_END,
+    SWITCH_BEGIN,
+    SWITCH_CASE,// a is the value, b is the case
+    SWITCH_DEFAULT,
+    SWITCH_END,
+    CALL_BEGIN,
+    CALL_END,
+    BREAK,
+    CONTINUE,
+    RETURN// dst = a if count != 0
+};
+
+enum struct MathFunction : uint32_t {
+    ABS, SQRT, RSQRT, SIN, COS, TAN, ASIN, ACOS, ATAN,
+    EXP, EXP2, LOG, LOG2, FLOOR, CEIL, ROUND, FRACT, SATURATE, LENGTH, NORMALIZE,
+    MIN, MAX, POW, ATAN2,
+    CLAMP, LERP, FMA
+};
+
+enum struct AtomicOp : uint32_t {
+    EXCHANGE, COMPARE_EXCHANGE, ADD, SUB, AND, OR, XOR, MIN, MAX
+};
+
+enum struct WarpOp : uint32_t {
+    LANE_ID, ALL, ANY, BALLOT, READ_LANE, READ_FIRST_ACTIVE_LANE, SUM, PREFIX_SUM, INCLUSIVE_SUM
+};
+
+struct Instruction {
+    OpCode op;
+    uint32_t sub;
+    Type::Tag kind;
+    Type::Tag dst_kind;
+    uint32_t count;
+    uint32_t flags;
+    Operand dst;
+    Operand a;
+    Operand b;
+    Operand c;
+    uint64_t imm;
+
+    static constexpr auto broadcast_a = 1u;
+    static constexpr auto broadcast_b = 2u;
+    static constexpr auto broadcast_c = 4u;
+};
+
+static_assert(std::is_trivially_copyable_v<Instruction>);
+
+// matches ArgumentLayout::TextureArgument, as texture handles are CPUTexture addresses
+struct TextureArgument {
+    CPUTexture *texture;
+    uint32_t level;
+};
+
+static_assert(sizeof(TextureArgument) == sizeof(ArgumentLayout::TextureArgument));
+
+// A kernel lowered to instructions that execute all threads of a block in
+// lockstep, one instruction over all active lanes at a time. Block barriers
+// thus need no instructions: the code between two barriers already runs as a
+// phase that every lane finishes before any lane moves on.
+class CPUKernel : public concepts::Noncopyable {
+
+public:
+    static constexpr auto frame_alignment = static_cast<size_t>(16u);
+    // builtin variables live at the start of each frame
+    static constexpr auto thread_id_offset = 0u;
+    static constexpr auto block_id_offset = 16u;
+    static constexpr auto dispatch_id_offset = 32u;
+    static constexpr auto builtin_frame_size = 48u;
+    // warps are runs of consecutive lanes, in the order of linear thread indices within the block
+    static constexpr auto warp_size = 32u;
+
+    // per-worker memory for running blocks
+    class Scratch {
+        friend class CPUKernel;
+        std::vector<std::byte> _frames;
+        std::vector<std::byte> _shared;
+        std::vector<uint8_t> _masks;
+    };
+
+private:
+    std::vector<Instruction> _code;
+    std::vector<std::byte> _constants;
+    std::vector<uint32_t> _buffer_arguments;// offsets of the buffer arguments in the block
+    size_t _argument_size;
+    size_t _frame_size;
+    size_t _shared_size;
+    size_t _max_depth;
+
+public:
+    CPUKernel(std::vector<Instruction> code, std::vector<std::byte> constants, std::vector<uint32_t> buffer_arguments,
+              size_t argument_size, size_t frame_size, size_t shared_size, size_t max_depth) noexcept;
+
+    [[nodiscard]] std::span<const Instruction> code() const noexcept { return _code; }
+    [[nodiscard]] std::span<const std::byte> constants() const noexcept { return _constants; }
+    [[nodiscard]] std::span<const uint32_t> buffer_arguments() const noexcept { return _buffer_arguments; }
+    [[nodiscard]] auto argument_size() const noexcept { return _argument_size; }
+    [[nodiscard]] auto frame_size() const noexcept { return _frame_size; }
+    [[nodiscard]] auto shared_size() const noexcept { return _shared_size; }
+    [[nodiscard]] auto max_depth() const noexcept { return _max_depth; }
+
+    // kernels hold no host addresses, so they can be persisted as flat blobs;
+    // load() returns nullptr if the blob is truncated or from another version
+    [[nodiscard]] std::vector<std::byte> serialize() const noexcept;
+    [[nodiscard]] static std::unique_ptr<CPUKernel> load(std::span<const std::byte> blob) noexcept;
+
+    // folds the byte offsets of the buffer arguments into their handles, which are addresses
+    void resolve_arguments(std::byte *arguments) const noexcept;
+
+    // runs one block, arguments are packed as described by the kernel's ArgumentLayout
+    // and resolved with resolve_arguments()
+    void run(const std::byte *arguments, uint3 block_id, uint3 block_size, uint3 dispatch_size, Scratch &scratch) const noexcept;
+};
+
+}// namespace luisa::compute::cpu
@@ -0,0 +1,72 @@
+//
+// Created by Mike Smith on 2021/3/4.
+//
+
+#include <cstring>
+
+#include <core/logging.h>
+
+#include <runtime/buffer.h>
+#include <runtime/texture.h>
+#include <runtime/bindless_array.h>
+#include <runtime/kernel.h>
+#include <backends/cpu/cpu_device.h>
+#include <backends/cpu/cpu_stream.h>
+
+namespace luisa::compute::cpu {
+
+void CPUStream::_dispatch(const BufferCopyCommand &command) {
+    std::memmove(CPUDevice::buffer(command.dst_handle()) + command.dst_offset(),
+                 CPUDevice::buffer(command.src_handle()) + command.src_offset(),
+                 command.size());
+}
+
+void CPUStream::_dispatch(const BufferUploadCommand &command) {
+    std::memcpy(CPUDevice::buffer(command.handle()) + command.offset(), command.data(), command.size());
+}
+
+void CPUStream::_dispatch(const BufferDownloadCommand &command) {
+    std::memcpy(command.data(), CPUDevice::buffer(command.handle()) + command.offset(), command.size());
+}
+
+void CPUStream::_dispatch(const TextureCopyCommand &command) {
+    CPUDevice::texture(command.dst_handle())->copy(
+        *CPUDevice::texture(command.src_handle()),
+        command.src_level(), command.dst_level(), command.size());
+}
+
+void CPUStream::_dispatch(const TextureUploadCommand &command) {
+    CPUDevice::texture(command.handle())->upload(
+        command.level(), command.offset(), command.size(), command.data());
+}
+
+void CPUStream::_dispatch(const TextureDownloadCommand &command) {
+    CPUDevice::texture(command.handle())->download(
+        command.level(), command.offset(), command.size(), command.data());
+}
+
+void CPUStream::_dispatch(const BindlessArrayUpdateCommand &command) {
+    CPUDevice::bindless_array(command.handle())->update(command.modifications());
+}
+
+void CPUStream::_dispatch(const KernelLaunchCommand &command) {
+    auto kernel = CPUDevice::kernel(command.handle());
+    auto arguments = command.arguments();
+    if (arguments.size() != kernel->argument_size()) {
+        LUISA_ERROR_WITH_LOCATION("Invalid argument block size {} (expected {}).", arguments.size(), kernel->argument_size());
+    }
+    _arguments.assign(arguments.begin(), arguments.end());
+    kernel->resolve_arguments(_arguments.data());
+    auto block_size = command.block_size();
+    auto dispatch_size = command.dispatch_size();
+    auto block_offset = command.block_offset();
+    auto block_count = command.block_count();
+    auto &&pool = _device->thread_pool();
+    _scratches.resize(pool.size());
+    pool.parallel_for(block_count.x * block_count.y * block_count.z, [&](uint32_t index, uint32_t worker) noexcept {
+        auto block_id = block_offset + uint3{index % block_count.x, index / block_count.x % block_count.y, index / (block_count.x * block_count.y)};
+        kernel->run(_arguments.data(), block_id, block_size, dispatch_size, _scratches[worker]);
+    });
+}
+
+}// namespace luisa::compute::cpu
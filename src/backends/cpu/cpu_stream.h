@@ -0,0 +1,40 @@
+//
+// Created by Mike Smith on 2021/3/4.
+//
+
+#pragma once
+
+#include <vector>
+
+#include <runtime/stream.h>
+#include <backends/cpu/cpu_kernel.h>
+
+namespace luisa::compute::cpu {
+
+class CPUDevice;
+
+// Executes commands synchronously on the calling thread, kernel blocks run
+// in parallel on the device's thread pool.
+class CPUStream : public Stream {
+
+private:
+    CPUDevice *_device;
+    std::vector<CPUKernel::Scratch> _scratches;
+    std::vector<std::byte> _arguments;
+
+private:
+    void _dispatch(const BufferCopyCommand &command) override;
+    void _dispatch(const BufferUploadCommand &command) override;
+    void _dispatch(const BufferDownloadCommand &command) override;
+    void _dispatch(const TextureCopyCommand &command) override;
+    void _dispatch(const TextureUploadCommand &command) override;
+    void _dispatch(const TextureDownloadCommand &command) override;
+    void _dispatch(const BindlessArrayUpdateCommand &command) override;
+    void _dispatch(const KernelLaunchCommand &command) override;
+
+public:
+    explicit CPUStream(CPUDevice *device) noexcept : _device{device} {}
+    [[nodiscard]] auto device() const noexcept { return _device; }
+};
+
+}// namespace luisa::compute::cpu
@@ -0,0 +1,191 @@
+//
+// Created by Mike Smith on 2021/3/4.
+//
+
+#include <cstring>
+#include <algorithm>
+
+#include <core/logging.h>
+#include <core/platform.h>
+#include <backends/cpu/cpu_texture.h>
+
+namespace luisa::compute::cpu {
+
+namespace detail {
+
+// maps the row-major index of a texel inside a tile to its Morton index
+[[nodiscard]] constexpr auto make_morton_table(uint32_t dimension) noexcept {
+    std::array<uint8_t, CPUTexture::tile_texel_count> table{};
+    for (auto i = 0u; i < CPUTexture::tile_texel_count; i++) {
+        auto m = 0u;
+        if (dimension == 2u) {
+            auto x = i & 7u;
+            auto y = i >> 3u;
+            for (auto b = 0u; b < 3u; b++) {
+                m |= ((x >> b) & 1u) << (2u * b);
+                m |= ((y >> b) & 1u) << (2u * b + 1u);
+            }
+        } else {
+            auto x = i & 3u;
+            auto y = (i >> 2u) & 3u;
+            auto z = i >> 4u;
+            for (auto b = 0u; b < 2u; b++) {
+                m |= ((x >> b) & 1u) << (3u * b);
+                m |= ((y >> b) & 1u) << (3u * b + 1u);
+                m |= ((z >> b) & 1u) << (3u * b + 2u);
+            }
+        }
+        table[i] = static_cast<uint8_t>(m);
+    }
+    return table;
+}
+
+constexpr auto morton_table_2d = make_morton_table(2u);
+constexpr auto morton_table_3d = make_morton_table(3u);
+
+}// namespace detail
+
+CPUTexture::CPUTexture(PixelFormat format, uint32_t dimension, uint3 size, uint32_t mip_levels) noexcept
+    : _format{format},
+      _storage{pixel_format_storage(format)},
+      _dimension{dimension},
+      _pixel_size{pixel_format_size(format)},
+      _channels{pixel_format_channel_count(format)} {
+
+    auto tile_extent = dimension == 2u ? uint3{8u, 8u, 1u} : uint3{4u, 4u, 4u};
+    _level_offsets.emplace_back(0u);
+    for (auto level = 0u; level < mip_levels; level++) {
+        uint3 s{std::max(size.x >> level, 1u), std::max(size.y >> level, 1u), std::max(size.z >> level, 1u)};
+        uint3 tiles{(s.x + tile_extent.x - 1u) / tile_extent.x,
+                    (s.y + tile_extent.y - 1u) / tile_extent.y,
+                    (s.z + tile_extent.z - 1u) / tile_extent.z};
+        auto level_bytes = static_cast<size_t>(tiles.x) * tiles.y * tiles.z * tile_texel_count * _pixel_size;
+        _level_sizes.emplace_back(s);
+        _level_tiles.emplace_back(tiles);
+        _level_offsets.emplace_back(_level_offsets.back() + level_bytes);
+    }
+    static constexpr auto alignment = static_cast<size_t>(64u);
+    auto alloc_size = (size_bytes() + alignment - 1u) / alignment * alignment;
+    _data = static_cast<std::byte *>(aligned_alloc(alignment, alloc_size));
+    if (_data == nullptr) { LUISA_ERROR_WITH_LOCATION("Failed to allocate {} bytes for texture.", alloc_size); }
+    std::memset(_data, 0, alloc_size);
+}
+
+CPUTexture::~CPUTexture() noexcept { aligned_free(_data); }
+
+size_t CPUTexture::texel_offset(uint32_t level, uint3 coord) const noexcept {
+    auto tiles = _level_tiles[level];
+    size_t tile_index;
+    uint32_t texel_index;
+    if (_dimension == 2u) {
+        tile_index = static_cast<size_t>(coord.y >> 3u) * tiles.x + (coord.x >> 3u);
+        texel_index = detail::morton_table_2d[((coord.y & 7u) << 3u) | (coord.x & 7u)];
+    } else {
+        tile_index = (static_cast<size_t>(coord.z >> 2u) * tiles.y + (coord.y >> 2u)) * tiles.x + (coord.x >> 2u);
+        texel_index = detail::morton_table_3d[((coord.z & 3u) << 4u) | ((coord.y & 3u) << 2u) | (coord.x & 3u)];
+    }
+    return _level_offsets[level] + (tile_index * tile_texel_count + texel_index) * _pixel_size;
+}
+
+void CPUTexture::upload(uint32_t level, uint3 offset, uint3 size, const void *data) noexcept {
+    auto src = static_cast<const std::byte *>(data);
+    for (auto z = 0u; z < size.z; z++) {
+        for (auto y = 0u; y < size.y; y++) {
+            for (auto x = 0u; x < size.x; x++) {
+                std::memcpy(texel(level, uint3{offset.x + x, offset.y + y, offset.z + z}), src, _pixel_size);
+                src += _pixel_size;
+            }
+        }
+    }
+}
+
+void CPUTexture::download(uint32_t level, uint3 offset, uint3 size, void *data) const noexcept {
+    auto dst = static_cast<std::byte *>(data);
+    for (auto z = 0u; z < size.z; z++) {
+        for (auto y = 0u; y < size.y; y++) {
+            for (auto x = 0u; x < size.x; x++) {
+                std::memcpy(dst, texel(level, uint3{offset.x + x, offset.y + y, offset.z + z}), _pixel_size);
+                dst += _pixel_size;
+            }
+        }
+    }
+}
+
+void CPUTexture::copy(const CPUTexture &source, uint32_t src_level, uint32_t dst_level, uint3 size) noexcept {
+    if (source._format != _format) { LUISA_ERROR_WITH_LOCATION("Copying between textures with different formats."); }
+    auto same_extent = [](uint3 a, uint3 b) noexcept { return a.x == b.x && a.y == b.y && a.z == b.z; };
+    if (source._dimension == _dimension &&
+        same_extent(size, _level_sizes[dst_level]) &&
+        same_extent(size, source._level_sizes[src_level])) {
+        // same tiling, copy the whole level at once
+        std::memcpy(_data + _level_offsets[dst_level],
+                    source._data + source._level_offsets[src_level],
+                    _level_offsets[dst_level + 1u] - _level_offsets[dst_level]);
+        return;
+    }
+    for (auto z = 0u; z < size.z; z++) {
+        for (auto y = 0u; y < size.y; y++) {
+            for (auto x = 0u; x < size.x; x++) {
+                uint3 coord{x, y, z};
+                std::memcpy(texel(dst_level, coord), source.texel(src_level, coord), _pixel_size);
+            }
+        }
+    }
+}
+
+template<typename T>
+T CPUTexture::_decode(const std::byte *p, uint32_t channel) const noexcept {
+    switch (_storage) {
+        case PixelStorage::UINT8: return static_cast<T>(reinterpret_cast<const uint8_t *>(p)[channel]);
+        case PixelStorage::UNORM8: {
+            auto v = reinterpret_cast<const uint8_t *>(p)[channel];
+            if constexpr (std::is_same_v<T, float>) { return static_cast<float>(v) * (1.0f / 255.0f); }
+            return static_cast<T>(v);
+        }
+        case PixelStorage::INT32: return static_cast<T>(reinterpret_cast<const int32_t *>(p)[channel]);
+        case PixelStorage::UINT32: return static_cast<T>(reinterpret_cast<const uint32_t *>(p)[channel]);
+        case PixelStorage::FLOAT32: return static_cast<T>(reinterpret_cast<const float *>(p)[channel]);
+    }
+    return T{};
+}
+
+template<typename T>
+void CPUTexture::_encode(std::byte *p, uint32_t channel, T value) const noexcept {
+    switch (_storage) {
+        case PixelStorage::UINT8: reinterpret_cast<uint8_t *>(p)[channel] = static_cast<uint8_t>(value); break;
+        case PixelStorage::UNORM8: {
+            if constexpr (std::is_same_v<T, float>) {
+                reinterpret_cast<uint8_t *>(p)[channel] = static_cast<uint8_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+            } else {
+                reinterpret_cast<uint8_t *>(p)[channel] = static_cast<uint8_t>(value);
+            }
+            break;
+        }
+        case PixelStorage::INT32: reinterpret_cast<int32_t *>(p)[channel] = static_cast<int32_t>(value); break;
+        case PixelStorage::UINT32: reinterpret_cast<uint32_t *>(p)[channel] = static_cast<uint32_t>(value); break;
+        case PixelStorage::FLOAT32: reinterpret_cast<float *>(p)[channel] = static_cast<float>(value); break;
+    }
+}
+
+template<typename T>
+Vector<T, 4> CPUTexture::read(uint32_t level, uint3 coord) const noexcept {
+    auto p = texel(level, coord);
+    Vector<T, 4> v{T{0}, T{0}, T{0}, T{1}};
+    for (auto c = 0u; c < _channels; c++) { v[c] = _decode<T>(p, c); }
+    return v;
+}
+
+template<typename T>
+void CPUTexture::write(uint32_t level, uint3 coord, Vector<T, 4> value) noexcept {
+    auto p = texel(level, coord);
+    for (auto c = 0u; c < _channels; c++) { _encode<T>(p, c, value[c]); }
+}
+
+template Vector<float, 4> CPUTexture::read<float>(uint32_t, uint3) const noexcept;
+template Vector<int, 4> CPUTexture::read<int>(uint32_t, uint3) const noexcept;
+template Vector<uint, 4> CPUTexture::read<uint>(uint32_t, uint3) const noexcept;
+template void CPUTexture::write<float>(uint32_t, uint3, Vector<float, 4>) noexcept;
+template void CPUTexture::write<int>(uint32_t, uint3, Vector<int, 4>) noexcept;
+template void CPUTexture::write<uint>(uint32_t, uint3, Vector<uint, 4>) noexcept;
+
+}// namespace luisa::compute::cpu
@@ -0,0 +1,70 @@
+//
+// Created by Mike Smith on 2021/3/4.
+//
+
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include <core/concepts.h>
+#include <core/data_types.h>
+#include <runtime/pixel_format.h>
+
+namespace luisa::compute::cpu {
+
+// Texels of each mip level are stored in tiles of 64 texels (8x8 for 2D,
+// 4x4x4 for 3D), tiles in row-major order and texels inside a tile in
+// Morton (Z-) order, so that neighbouring texels share cache lines.
+class CPUTexture : public concepts::Noncopyable {
+
+public:
+    static constexpr auto tile_texel_count = 64u;
+
+private:
+    std::byte *_data{nullptr};
+    PixelFormat _format;
+    PixelStorage _storage;
+    uint32_t _dimension;
+    uint32_t _pixel_size;
+    uint32_t _channels;
+    std::vector<uint3> _level_sizes;
+    std::vector<uint3> _level_tiles;
+    std::vector<size_t> _level_offsets;
+
+private:
+    template<typename T>
+    [[nodiscard]] T _decode(const std::byte *p, uint32_t channel) const noexcept;
+    template<typename T>
+    void _encode(std::byte *p, uint32_t channel, T value) const noexcept;
+
+public:
+    CPUTexture(PixelFormat format, uint32_t dimension, uint3 size, uint32_t mip_levels) noexcept;
+    CPUTexture(CPUTexture &&) noexcept = delete;
+    CPUTexture &operator=(CPUTexture &&) noexcept = delete;
+    ~CPUTexture() noexcept;
+
+    [[nodiscard]] auto format() const noexcept { return _format; }
+    [[nodiscard]] auto dimension() const noexcept { return _dimension; }
+    [[nodiscard]] auto pixel_size() const noexcept { return _pixel_size; }
+    [[nodiscard]] auto mip_levels() const noexcept { return static_cast<uint32_t>(_level_sizes.size()); }
+    [[nodiscard]] auto size(uint32_t level = 0u) const noexcept { return _level_sizes[level]; }
+    [[nodiscard]] auto size_bytes() const noexcept { return _level_offsets.back(); }
+
+    [[nodiscard]] size_t texel_offset(uint32_t level, uint3 coord) const noexcept;
+    [[nodiscard]] std::byte *texel(uint32_t level, uint3 coord) noexcept { return _data + texel_offset(level, coord); }
+    [[nodiscard]] const std::byte *texel(uint32_t level, uint3 coord) const noexcept { return _data + texel_offset(level, coord); }
+
+    // linear host data <-> tiled storage, host data is row-major with x fastest
+    void upload(uint32_t level, uint3 offset, uint3 size, const void *data) noexcept;
+    void download(uint32_t level, uint3 offset, uint3 size, void *data) const noexcept;
+    void copy(const CPUTexture &source, uint32_t src_level, uint32_t dst_level, uint3 size) noexcept;
+
+    // kernel access, T is one of float, int and uint
+    template<typename T>
+    [[nodiscard]] Vector<T, 4> read(uint32_t level, uint3 coord) const noexcept;
+    template<typename T>
+    void write(uint32_t level, uint3 coord, Vector<T, 4> value) noexcept;
+};
+
+}// namespace luisa::compute::cpu
@@ -0,0 +1,99 @@
+//
+// Created by Mike Smith on 2021/3/6.
+//
+
+#include <algorithm>
+
+#include <core/logging.h>
+#include <backends/cpu/cpu_allocator.h>
+#include <backends/cpu/cpu_thread_pool.h>
+
+namespace luisa::compute::cpu {
+
+CPUThreadPool::CPUThreadPool(size_t concurrency, bool pin_workers, std::optional<uint32_t> bound_node) noexcept {
+    auto worker_count = std::max(concurrency, static_cast<size_t>(1u)) - 1u;
+    auto &&topology = NumaTopology::current();
+    auto node_count = topology.node_count();
+    if (bound_node && *bound_node >= node_count) {
+        LUISA_WARNING_WITH_LOCATION("NUMA node {} does not exist ({} nodes), binding to node 0.", *bound_node, node_count);
+        bound_node = 0u;
+    }
+    // the caller is not pinned, but is counted on the last node
+    auto pool_size = static_cast<uint32_t>(worker_count + 1u);
+    auto node_of_worker = [&](uint32_t worker) noexcept {
+        return bound_node.value_or(static_cast<uint32_t>(static_cast<uint64_t>(worker) * node_count / pool_size));
+    };
+    _range_count = pin_workers && !bound_node ? std::min(node_count, pool_size) : 1u;
+    _ranges = std::make_unique<Range[]>(_range_count);
+    _worker_ranges.resize(pool_size, 0u);
+    if (_range_count > 1u) {
+        for (auto w = 0u; w < pool_size; w++) { _worker_ranges[w] = node_of_worker(w); }
+    }
+    _workers.reserve(worker_count);
+    for (auto i = 0u; i < worker_count; i++) {
+        auto node = pin_workers ? std::make_optional(node_of_worker(i)) : std::nullopt;
+        _workers.emplace_back([this, i, node, &topology] {
+            if (node && !topology.pin_current_thread(*node)) {
+                LUISA_WARNING_WITH_LOCATION("Failed to pin worker {} to NUMA node {}.", i, *node);
+            }
+            auto generation = 0u;
+            for (;;) {
+                {
+                    std::unique_lock lock{_mutex};
+                    _cv.wait(lock, [this, generation] { return _should_stop || _generation != generation; });
+                    if (_should_stop) { return; }
+                    generation = _generation;
+                }
+                _work(i);
+                std::scoped_lock lock{_mutex};
+                if (--_pending == 0u) { _done_cv.notify_one(); }
+            }
+        });
+    }
+}
+
+CPUThreadPool::~CPUThreadPool() noexcept {
+    {
+        std::scoped_lock lock{_mutex};
+        _should_stop = true;
+    }
+    _cv.notify_all();
+    for (auto &&worker : _workers) { worker.join(); }
+}
+
+void CPUThreadPool::_work(uint32_t worker) noexcept {
+    auto home = _worker_ranges[worker];
+    for (auto r = 0u; r < _range_count; r++) {
+        auto &&range = _ranges[(home + r) % _range_count];
+        for (auto i = range.next.fetch_add(1u, std::memory_order_relaxed); i < range.end;
+             i = range.next.fetch_add(1u, std::memory_order_relaxed)) {
+            (*_task)(i, worker);
+        }
+    }
+}
+
+void CPUThreadPool::parallel_for(uint32_t count, const Task &task) noexcept {
+    if (count == 0u) { return; }
+    std::scoped_lock dispatch_lock{_dispatch_mutex};
+    if (_workers.empty() || count == 1u) {
+        for (auto i = 0u; i < count; i++) { task(i, 0u); }
+        return;
+    }
+    {
+        std::scoped_lock lock{_mutex};
+        _task = &task;
+        for (auto r = 0u; r < _range_count; r++) {
+            auto begin = static_cast<uint32_t>(static_cast<uint64_t>(count) * r / _range_count);
+            _ranges[r].next.store(begin, std::memory_order_relaxed);
+            _ranges[r].end = static_cast<uint32_t>(static_cast<uint64_t>(count) * (r + 1u) / _range_count);
+        }
+        _pending = static_cast<uint32_t>(_workers.size());
+        _generation++;
+    }
+    _cv.notify_all();
+    _work(static_cast<uint32_t>(_workers.size()));
+    std::unique_lock lock{_mutex};
+    _done_cv.wait(lock, [this] { return _pending == 0u; });
+}
+
+}// namespace luisa::compute::cpu
@@ -0,0 +1,67 @@
+//
+// Created by Mike Smith on 2021/3/6.
+//
+
+#pragma once
+
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <optional>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+#include <core/concepts.h>
+
+namespace luisa::compute::cpu {
+
+// Runs parallel_for() tasks on a fixed set of workers, the calling thread
+// joining in as the last worker. Tasks from different threads are serialized.
+//
+// With pinned workers, each worker is bound to a NUMA node and the index space
+// is split into one contiguous range per node; workers drain their own node's
+// range before stealing from the others, so that block i mostly runs on the
+// node holding the i-th chunk of a NumaPolicy::BLOCKED buffer.
+class CPUThreadPool : public concepts::Noncopyable {
+
+public:
+    using Task = std::function<void(uint32_t /* index */, uint32_t /* worker */)>;
+
+    struct alignas(64) Range {
+        std::atomic<uint32_t> next{0u};
+        uint32_t end{0u};
+    };
+
+private:
+    std::vector<std::thread> _workers;
+    std::vector<uint32_t> _worker_ranges;
+    std::unique_ptr<Range[]> _ranges;
+    uint32_t _range_count{1u};
+    std::mutex _dispatch_mutex;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::condition_variable _done_cv;
+    const Task *_task{nullptr};
+    uint32_t _generation{0u};
+    uint32_t _pending{0u};
+    bool _should_stop{false};
+
+private:
+    void _work(uint32_t worker) noexcept;
+
+public:
+    // bound_node pins all workers to a single node instead of spreading them across nodes
+    explicit CPUThreadPool(
+        size_t concurrency = std::thread::hardware_concurrency(),
+        bool pin_workers = false, std::optional<uint32_t> bound_node = std::nullopt) noexcept;
+    ~CPUThreadPool() noexcept;
+    [[nodiscard]] auto size() const noexcept { return _workers.size() + 1u; }
+    [[nodiscard]] auto range_count() const noexcept { return _range_count; }
+    // index of the node-local range the worker drains first
+    [[nodiscard]] auto worker_range(uint32_t worker) const noexcept { return _worker_ranges[worker]; }
+    void parallel_for(uint32_t count, const Task &task) noexcept;
+};
+
+}// namespace luisa::compute::cpu
@@ -0,0 +1,187 @@
+//
+// Created by Mike Smith on 2021/3/12.
+//
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include <atomic>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include <core/logging.h>
+#include <core/huge_pages.h>
+
+namespace luisa {
+
+namespace detail {
+
+struct HugePageCounters {
+    std::atomic<uint64_t> requests{0u};
+    std::atomic<uint64_t> explicit_hits{0u};
+    std::atomic<uint64_t> transparent_hits{0u};
+    std::atomic<uint64_t> fallbacks{0u};
+    std::atomic<uint64_t> huge_bytes{0u};
+    std::atomic<uint64_t> requested_bytes{0u};
+};
+
+[[nodiscard]] static HugePageCounters &huge_page_counters() noexcept {
+    static HugePageCounters counters;
+    return counters;
+}
+
+[[nodiscard]] static constexpr auto round_up(size_t size, size_t granularity) noexcept {
+    return (std::max(size, static_cast<size_t>(1u)) + granularity - 1u) / granularity * granularity;
+}
+
+static constexpr auto huge_page_size_2m = static_cast<size_t>(2u * 1024u * 1024u);
+static constexpr auto huge_page_size_1g = static_cast<size_t>(1024u * 1024u * 1024u);
+
+static void record(HugePageMode requested, const PageAllocation &allocation) noexcept {
+    if (requested == HugePageMode::NONE) { return; }
+    auto &&counters = huge_page_counters();
+    counters.requests.fetch_add(1u, std::memory_order_relaxed);
+    counters.requested_bytes.fetch_add(allocation.size, std::memory_order_relaxed);
+    switch (allocation.mode) {
+        case HugePageMode::NONE: counters.fallbacks.fetch_add(1u, std::memory_order_relaxed); return;
+        case HugePageMode::TRANSPARENT: counters.transparent_hits.fetch_add(1u, std::memory_order_relaxed); break;
+        default: counters.explicit_hits.fetch_add(1u, std::memory_order_relaxed); break;
+    }
+    counters.huge_bytes.fetch_add(allocation.size, std::memory_order_relaxed);
+}
+
+}// namespace detail
+
+#ifdef _WIN32
+
+// Windows has no transparent huge pages, and large pages need SeLockMemoryPrivilege
+PageAllocation allocate_pages(size_t size, HugePageMode mode) noexcept {
+    PageAllocation allocation;
+    if (mode != HugePageMode::NONE) {
+        if (auto large_page_size = GetLargePageMinimum(); large_page_size != 0u) {
+            auto alloc_size = detail::round_up(size, large_page_size);
+            if (auto p = VirtualAlloc(nullptr, alloc_size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE); p != nullptr) {
+                allocation = {p, alloc_size, HugePageMode::EXPLICIT_2M};
+            }
+        }
+    }
+    if (allocation.data == nullptr) {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        auto alloc_size = detail::round_up(size, info.dwPageSize);
+        auto p = VirtualAlloc(nullptr, alloc_size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        if (p == nullptr) { LUISA_ERROR_WITH_LOCATION("Failed to allocate pages with size {}.", size); }
+        allocation = {p, alloc_size, HugePageMode::NONE};
+    }
+    detail::record(mode, allocation);
+    return allocation;
+}
+
+void free_pages(PageAllocation allocation) noexcept {
+    if (allocation.data != nullptr) { VirtualFree(allocation.data, 0u, MEM_RELEASE); }
+}
+
+size_t huge_page_resident_bytes(const void *) noexcept { return 0u; }
+
+#else
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+PageAllocation allocate_pages(size_t size, HugePageMode mode) noexcept {
+    PageAllocation allocation;
+#ifdef MAP_HUGETLB
+    if (mode == HugePageMode::EXPLICIT_2M || mode == HugePageMode::EXPLICIT_1G) {
+        auto is_1g = mode == HugePageMode::EXPLICIT_1G;
+        auto alloc_size = detail::round_up(size, is_1g ? detail::huge_page_size_1g : detail::huge_page_size_2m);
+        auto flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | ((is_1g ? 30 : 21) << MAP_HUGE_SHIFT);
+        if (auto p = mmap(nullptr, alloc_size, PROT_READ | PROT_WRITE, flags, -1, 0); p != MAP_FAILED) {
+            allocation = {p, alloc_size, mode};
+        }
+    }
+#endif
+#ifdef MADV_HUGEPAGE
+    if (allocation.data == nullptr && mode != HugePageMode::NONE) {
+        // over-map and trim so that the range starts on a huge page boundary,
+        // otherwise the kernel cannot back its head with a huge page
+        auto alloc_size = detail::round_up(size, detail::huge_page_size_2m);
+        auto map_size = alloc_size + detail::huge_page_size_2m;
+        if (auto p = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0); p != MAP_FAILED) {
+            auto address = reinterpret_cast<uintptr_t>(p);
+            auto aligned = detail::round_up(address, detail::huge_page_size_2m);
+            if (auto head = aligned - address; head != 0u) { munmap(p, head); }
+            if (auto tail = map_size - (aligned - address) - alloc_size; tail != 0u) {
+                munmap(reinterpret_cast<void *>(aligned + alloc_size), tail);
+            }
+            auto data = reinterpret_cast<void *>(aligned);
+            allocation = {data, alloc_size, madvise(data, alloc_size, MADV_HUGEPAGE) == 0 ? HugePageMode::TRANSPARENT : HugePageMode::NONE};
+        }
+    }
+#endif
+    if (allocation.data == nullptr) {
+        auto alloc_size = detail::round_up(size, static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+        auto p = mmap(nullptr, alloc_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) { LUISA_ERROR_WITH_LOCATION("Failed to allocate pages with size {}.", size); }
+        allocation = {p, alloc_size, HugePageMode::NONE};
+    }
+    detail::record(mode, allocation);
+    return allocation;
+}
+
+void free_pages(PageAllocation allocation) noexcept {
+    if (allocation.data != nullptr) { munmap(allocation.data, allocation.size); }
+}
+
+size_t huge_page_resident_bytes(const void *address) noexcept {
+    std::ifstream smaps{"/proc/self/smaps"};
+    auto target = reinterpret_cast<uintptr_t>(address);
+    auto in_range = false;
+    auto bytes = static_cast<size_t>(0u);
+    for (std::string line; std::getline(smaps, line);) {
+        unsigned long begin = 0u;
+        unsigned long end = 0u;
+        if (std::sscanf(line.c_str(), "%lx-%lx ", &begin, &end) == 2 && line.find(':') > line.find(' ')) {
+            if (in_range) { break; }// next mapping
+            in_range = target >= begin && target < end;
+        } else if (in_range) {
+            for (auto field : {"AnonHugePages:", "Private_Hugetlb:", "Shared_Hugetlb:"}) {
+                if (line.starts_with(field)) { bytes += std::stoull(line.substr(std::strlen(field))) * 1024u; }
+            }
+        }
+    }
+    return bytes;
+}
+
+#endif
+
+HugePageStatistics huge_page_statistics() noexcept {
+    auto &&counters = detail::huge_page_counters();
+    HugePageStatistics statistics;
+    statistics.requests = counters.requests.load(std::memory_order_relaxed);
+    statistics.explicit_hits = counters.explicit_hits.load(std::memory_order_relaxed);
+    statistics.transparent_hits = counters.transparent_hits.load(std::memory_order_relaxed);
+    statistics.fallbacks = counters.fallbacks.load(std::memory_order_relaxed);
+    statistics.huge_bytes = counters.huge_bytes.load(std::memory_order_relaxed);
+    statistics.requested_bytes = counters.requested_bytes.load(std::memory_order_relaxed);
+    return statistics;
+}
+
+void reset_huge_page_statistics() noexcept {
+    auto &&counters = detail::huge_page_counters();
+    counters.requests = 0u;
+    counters.explicit_hits = 0u;
+    counters.transparent_hits = 0u;
+    counters.fallbacks = 0u;
+    counters.huge_bytes = 0u;
+    counters.requested_bytes = 0u;
+}
+
+}// namespace luisa
@@ -0,0 +1,50 @@
+//
+// Created by Mike Smith on 2021/3/12.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace luisa {
+
+enum struct HugePageMode : uint32_t {
+    NONE,       // regular pages
+    TRANSPARENT,// regular mapping advised for transparent huge pages
+    EXPLICIT_2M,// pre-reserved 2 MiB huge pages (hugetlbfs or large pages on Windows)
+    EXPLICIT_1G // pre-reserved 1 GiB huge pages
+};
+
+// A fresh page-aligned mapping. Explicit huge pages fall back to transparent ones and then
+// to regular pages when the system has none reserved, and mode records what was obtained.
+struct PageAllocation {
+    void *data{nullptr};
+    size_t size{0u};// mapped size, rounded up to the page size
+    HugePageMode mode{HugePageMode::NONE};
+};
+
+struct HugePageStatistics {
+    uint64_t requests{0u};  // allocations that asked for huge pages
+    uint64_t explicit_hits{0u};
+    uint64_t transparent_hits{0u};
+    uint64_t fallbacks{0u};// served with regular pages
+    uint64_t huge_bytes{0u};
+    uint64_t requested_bytes{0u};
+    [[nodiscard]] auto hit_rate() const noexcept {
+        return requests == 0u ? 0.0 : static_cast<double>(explicit_hits + transparent_hits) / static_cast<double>(requests);
+    }
+};
+
+[[nodiscard]] PageAllocation allocate_pages(size_t size, HugePageMode mode = HugePageMode::NONE) noexcept;
+void free_pages(PageAllocation allocation) noexcept;
+
+// process-wide counters of allocate_pages() calls that asked for huge pages
+[[nodiscard]] HugePageStatistics huge_page_statistics() noexcept;
+void reset_huge_page_statistics() noexcept;
+
+// bytes of the mapping containing the address that are actually backed by huge pages,
+// as reported by the OS after the pages have been touched (Linux only, 0 elsewhere)
+[[nodiscard]] size_t huge_page_resident_bytes(const void *address) noexcept;
+
+}// namespace luisa
@@ -0,0 +1,74 @@
+//
+// Created by Mike Smith on 2021/3/7.
+//
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <utility>
+#include <core/mapped_file.h>
+
+namespace luisa {
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::filesystem::path &path) noexcept {
+    auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) { return; }
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+        if (auto mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr); mapping != nullptr) {
+            _data = static_cast<const std::byte *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            _size = _data == nullptr ? 0u : static_cast<size_t>(size.QuadPart);
+            CloseHandle(mapping);// the view keeps the mapping alive
+        }
+    }
+    CloseHandle(file);
+}
+
+void MappedFile::_unmap() noexcept {
+    if (_data != nullptr) { UnmapViewOfFile(_data); }
+}
+
+#else
+
+MappedFile::MappedFile(const std::filesystem::path &path) noexcept {
+    auto fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) { return; }
+    struct stat s {};
+    if (fstat(fd, &s) == 0 && s.st_size > 0) {
+        if (auto p = mmap(nullptr, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0); p != MAP_FAILED) {
+            _data = static_cast<const std::byte *>(p);
+            _size = static_cast<size_t>(s.st_size);
+        }
+    }
+    close(fd);// the mapping keeps the file alive
+}
+
+void MappedFile::_unmap() noexcept {
+    if (_data != nullptr) { munmap(const_cast<std::byte *>(_data), _size); }
+}
+
+#endif
+
+MappedFile::MappedFile(MappedFile &&another) noexcept
+    : _data{std::exchange(another._data, nullptr)},
+      _size{std::exchange(another._size, 0u)} {}
+
+MappedFile &MappedFile::operator=(MappedFile &&rhs) noexcept {
+    if (&rhs != this) {
+        _unmap();
+        _data = std::exchange(rhs._data, nullptr);
+        _size = std::exchange(rhs._size, 0u);
+    }
+    return *this;
+}
+
+}// namespace luisa
@@ -0,0 +1,37 @@
+//
+// Created by Mike Smith on 2021/3/7.
+//
+
+#pragma once
+
+#include <span>
+#include <filesystem>
+
+#include <core/concepts.h>
+
+namespace luisa {
+
+// A read-only memory mapping of a whole file, invalid if the file could not be mapped.
+class MappedFile : public concepts::Noncopyable {
+
+private:
+    const std::byte *_data{nullptr};
+    size_t _size{0u};
+
+private:
+    void _unmap() noexcept;
+
+public:
+    MappedFile() noexcept = default;
+    explicit MappedFile(const std::filesystem::path &path) noexcept;
+    MappedFile(MappedFile &&another) noexcept;
+    MappedFile &operator=(MappedFile &&rhs) noexcept;
+    ~MappedFile() noexcept { _unmap(); }
+
+    [[nodiscard]] auto valid() const noexcept { return _data != nullptr; }
+    [[nodiscard]] auto data() const noexcept { return _data; }
+    [[nodiscard]] auto size() const noexcept { return _size; }
+    [[nodiscard]] auto bytes() const noexcept { return std::span{_data, _size}; }
+};
+
+}// namespace luisa
@@ -12,6 +12,7 @@
 #include <core/concepts.h>
 #include <core/logging.h>
 #include <core/mathematics.h>
+#include <core/huge_pages.h>
 
 namespace luisa {
 
@@ -19,21 +20,29 @@ class Arena : public concepts::Noncopyable {
 
 public:
     static constexpr auto block_size = static_cast<size_t>(256ul * 1024ul);
+    static constexpr auto huge_block_size = static_cast<size_t>(2ul * 1024ul * 1024ul);
 
 private:
     std::vector<std::byte *> _blocks;
+    std::vector<PageAllocation> _huge_blocks;
     uint64_t _ptr{0ul};
+    std::byte *_end{nullptr};
     size_t _total{0ul};
+    HugePageMode _huge_pages{HugePageMode::NONE};
 
 public:
     Arena() noexcept = default;
+    // blocks are mapped with huge pages and grow to huge_block_size
+    explicit Arena(HugePageMode huge_pages) noexcept : _huge_pages{huge_pages} {}
     Arena(Arena &&) noexcept = default;
     Arena &operator=(Arena &&) noexcept = default;
     ~Arena() noexcept {
         for (auto p : _blocks) { aligned_free(p); }
+        for (auto block : _huge_blocks) { free_pages(block); }
     }
 
     [[nodiscard]] auto total_size() const noexcept { return _total; }
+    [[nodiscard]] auto huge_pages() const noexcept { return _huge_pages; }
 
     template<typename T = std::byte, size_t alignment = alignof(T)>
     [[nodiscard]] auto allocate(size_t n = 1u) {
@@ -43,14 +52,23 @@ public:
 
         auto byte_size = n * size;
         auto aligned_p = reinterpret_cast<std::byte *>((_ptr + alignment - 1u) / alignment * alignment);
-        if (_blocks.empty() || aligned_p + byte_size > _blocks.back() + block_size) {
+        if ((_blocks.empty() && _huge_blocks.empty()) || aligned_p + byte_size > _end) {
             static constexpr auto alloc_alignment = std::max(alignment, sizeof(void *));
             static_assert((alloc_alignment & (alloc_alignment - 1u)) == 0, "Alignment should be power of two.");
-            auto alloc_size = (std::max(block_size, byte_size) + alloc_alignment - 1u) / alloc_alignment * alloc_alignment;
-            aligned_p = static_cast<std::byte *>(aligned_alloc(alloc_alignment, alloc_size));
-            if (aligned_p == nullptr) { LUISA_ERROR_WITH_LOCATION("Failed to allocate memory: size = {}, alignment = {}, count = {}", size, alignment, n); }
-            _blocks.emplace_back(aligned_p);
-            _total += alloc_size;
+            if (_huge_pages == HugePageMode::NONE) {
+                auto alloc_size = (std::max(block_size, byte_size) + alloc_alignment - 1u) / alloc_alignment * alloc_alignment;
+                aligned_p = static_cast<std::byte *>(aligned_alloc(alloc_alignment, alloc_size));
+                if (aligned_p == nullptr) { LUISA_ERROR_WITH_LOCATION("Failed to allocate memory: size = {}, alignment = {}, count = {}", size, alignment, n); }
+                _blocks.emplace_back(aligned_p);
+                _end = aligned_p + alloc_size;
+                _total += alloc_size;
+            } else {// mappings are page-aligned
+                auto block = allocate_pages(std::max(huge_block_size, byte_size), _huge_pages);
+                aligned_p = static_cast<std::byte *>(block.data);
+                _huge_blocks.emplace_back(block);
+                _end = aligned_p + block.size;
+                _total += block.size;
+            }
         }
         _ptr = reinterpret_cast<uint64_t>(aligned_p + byte_size);
         return reinterpret_cast<T *>(aligned_p);
@@ -4,6 +4,9 @@
 
 #pragma once
 
+#include <array>
+#include <optional>
+
 #include <ast/function_builder.h>
 
 namespace luisa::compute::dsl {
@@ -16,6 +19,17 @@ class Var;
 
 namespace detail {
 
+template<typename T>
+struct is_buffer_view : std::false_type {};
+
+template<typename T>
+struct is_buffer_view<BufferView<T>> : std::true_type {
+    using element_type = T;
+};
+
+template<typename T>
+constexpr auto is_buffer_view_v = is_buffer_view<T>::value;
+
 template<typename T>
 class ExprBase {
 
@@ -24,18 +38,49 @@ private:
 
 public:
     explicit constexpr ExprBase(const Expression *expr) noexcept : _expression{expr} {}
-    constexpr ExprBase(const Var<T> &variable) noexcept
-        : _expression{FunctionBuilder::current()->ref(variable.variable())} {}
+    ExprBase(T literal) noexcept requires concepts::Native<T>
+        : _expression{FunctionBuilder::current()->literal(literal)} {}
     constexpr ExprBase(ExprBase &&) noexcept = default;
     constexpr ExprBase(const ExprBase &) noexcept = default;
     [[nodiscard]] constexpr auto expression() const noexcept { return _expression; }
 
+    // the value if it is known at trace time, i.e. the expression has been folded to a literal
+    [[nodiscard]] std::optional<T> host_value() const noexcept {
+        if (auto literal = dynamic_cast<const LiteralExpr *>(_expression)) {
+            return std::visit([](auto v) noexcept -> std::optional<T> {
+                if constexpr (std::is_same_v<decltype(v), T>) { return v; }
+                return std::nullopt;
+            }, literal->value());
+        }
+        return std::nullopt;
+    }
+
+#define LUISA_MAKE_EXPR_UNARY_OP(op, op_concept_name, op_tag_name)                          \
+    template<typename X = T>                                                                \
+    requires concepts::op_concept_name<X> [[nodiscard]] auto operator op() const noexcept { \
+        using R = std::remove_cvref_t<decltype(op std::declval<X>())>;                      \
+        return Expr<R>{FunctionBuilder::current()->unary(                                   \
+            Type::of<R>(), UnaryOp::op_tag_name, this->expression())};                      \
+    }
+#define LUISA_MAKE_EXPR_UNARY_OP_FROM_TUPLE(op) LUISA_MAKE_EXPR_UNARY_OP op
+    LUISA_MAP(LUISA_MAKE_EXPR_UNARY_OP_FROM_TUPLE,
+              (+, Plus, PLUS),
+              (-, Minus, MINUS),
+              (!, Not, NOT),
+              (~, BitNot, BIT_NOT))
+#undef LUISA_MAKE_EXPR_UNARY_OP
+#undef LUISA_MAKE_EXPR_UNARY_OP_FROM_TUPLE
+
 #define LUISA_MAKE_EXPR_BINARY_OP(op, op_concept_name, op_tag_name)                                                  \
     template<typename U>                                                                                             \
     requires concepts::op_concept_name<T, U> [[nodiscard]] auto operator op(Expr<U> rhs) const noexcept { \
-        return Expr{FunctionBuilder::current()->binary(                                                              \
-            Type::of(std::declval<T>() op std::declval<U>()),                                                        \
-            BinaryOp::op_tag_name, this->expression(), rhs.expression())};                                           \
+        using R = std::remove_cvref_t<decltype(std::declval<T>() op std::declval<U>())>;                             \
+        return Expr<R>{FunctionBuilder::current()->binary(                                                          \
+            Type::of<R>(), BinaryOp::op_tag_name, this->expression(), rhs.expression())};                            \
+    }                                                                                                                \
+    template<concepts::Native U>                                                                                     \
+    requires concepts::op_concept_name<T, U> [[nodiscard]] auto operator op(U rhs) const noexcept {       \
+        return this->operator op(Expr<U>{rhs});                                                                      \
     }
 #define LUISA_MAKE_EXPR_BINARY_OP_FROM_TUPLE(op) LUISA_MAKE_EXPR_BINARY_OP op
     LUISA_MAP(LUISA_MAKE_EXPR_BINARY_OP_FROM_TUPLE,
@@ -61,12 +106,20 @@ public:
 #undef LUISA_MAKE_EXPR_BINARY_OP_FROM_TUPLE
 
     template<typename U>
-    requires concepts::Access<T, U> [[nodiscard]] auto operator[](Expr<U> index) const noexcept {
-        return Expr{FunctionBuilder::current()->access(
-            Type::of(std::declval<T>()[std::declval<U>()]),
-            this->expression(), index.expression())};
+    requires(!is_buffer_view_v<T>) && concepts::Access<T, U> [[nodiscard]] auto operator[](Expr<U> index) const noexcept {
+        using R = std::remove_cvref_t<decltype(std::declval<T>()[std::declval<U>()])>;
+        return Expr<R>{FunctionBuilder::current()->access(Type::of<R>(), this->expression(), index.expression())};
+    }
+
+    template<typename U>
+    requires is_buffer_view_v<T> && std::is_integral_v<U> [[nodiscard]] auto operator[](Expr<U> index) const noexcept {
+        using R = typename is_buffer_view<T>::element_type;
+        return Expr<R>{FunctionBuilder::current()->access(Type::of<R>(), this->expression(), index.expression())};
     }
 
+    template<concepts::Native U>
+    [[nodiscard]] auto operator[](U index) const noexcept { return (*this)[Expr<U>{index}]; }
+
     void operator=(const ExprBase &rhs) const noexcept {
         FunctionBuilder::current()->assign(AssignOp::ASSIGN, this->expression(), rhs.expression());
     }
@@ -79,6 +132,10 @@ public:
     template<typename U>                                                                                 \
     requires concepts::op_concept_name<T, U> void operator op(Expr<U> rhs) const noexcept {   \
         FunctionBuilder::current()->assign(AssignOp::op_tag_name, this->expression(), rhs.expression()); \
+    }                                                                                                    \
+    template<concepts::Native U>                                                                         \
+    requires concepts::op_concept_name<T, U> void operator op(U rhs) const noexcept {         \
+        this->operator op(Expr<U>{rhs});                                                                 \
     }
 #define LUISA_MAKE_EXPR_ASSIGN_OP_FROM_TUPLE(op) LUISA_MAKE_EXPR_ASSIGN_OP op
     LUISA_MAP(LUISA_MAKE_EXPR_ASSIGN_OP_FROM_TUPLE,
@@ -97,15 +154,65 @@ public:
 #undef LUISA_MAKE_EXPR_ASSIGN_OP_FROM_TUPLE
 };
 
+template<typename T>
+[[nodiscard]] inline auto member(const Expression *self, size_t index) noexcept {
+    return Expr<T>{FunctionBuilder::current()->member(Type::of<T>(), self, index)};
+}
+
 }// namespace detail
 
+// structures registered with LUISA_STRUCT get accessors named after their members, e.g. p.position(),
+// which build the member expressions when called and can be assigned to
 template<typename T>
-class Expr : public detail::ExprBase<T> {
+class Expr : public detail::ExprBase<T>, public compute::detail::StructureMembers<T, Expr<T>> {
+
+private:
+    friend struct compute::detail::StructureMembers<T, Expr<T>>;
+    template<typename M>
+    [[nodiscard]] static auto _member(const Expression *self, size_t index) noexcept { return detail::member<M>(self, index); }
 
+public:
     using detail::ExprBase<T>::ExprBase;
     using detail::ExprBase<T>::operator=;
+    // declared, so that the implicit copy and move assignments, which would bind native
+    // values through the converting constructor, do not compete with operator=(U)
+    Expr(const Expr &) noexcept = default;
+    void operator=(const Expr &rhs) const noexcept { detail::ExprBase<T>::operator=(rhs); }
 };
 
+// vectors expose their components through accessors, e.g. v.x(), which can be assigned to,
+// and swizzles to build vectors of their components, e.g. v.swizzle<2, 1, 0>()
+#define LUISA_MAKE_VECTOR_EXPR_MEMBER(m, i) \
+    [[nodiscard]] auto m() const noexcept { return detail::member<T>(this->expression(), i); }
+
+#define LUISA_MAKE_VECTOR_EXPR(N, ...)                                                                     \
+    template<typename T>                                                                                   \
+    class Expr<Vector<T, N>> : public detail::ExprBase<Vector<T, N>> {                                     \
+                                                                                                           \
+    public:                                                                                                \
+        using detail::ExprBase<Vector<T, N>>::ExprBase;                                                    \
+        using detail::ExprBase<Vector<T, N>>::operator=;                                                   \
+        Expr(const Expr &) noexcept = default;                                                             \
+        void operator=(const Expr &rhs) const noexcept { detail::ExprBase<Vector<T, N>>::operator=(rhs); } \
+        __VA_ARGS__                                                                                        \
+                                                                                                           \
+        template<size_t... i>                                                                              \
+        requires(sizeof...(i) >= 2u && sizeof...(i) <= 4u && ((i < N) && ...))                            \
+            [[nodiscard]] auto swizzle() const noexcept {                                                  \
+            using R = Vector<T, sizeof...(i)>;                                                             \
+            auto f = FunctionBuilder::current();                                                           \
+            return Expr<R>{f->call(Type::of<R>(), CallOp::MAKE_VECTOR,                                     \
+                                   {f->member(Type::of<T>(), this->expression(), i)...})};                 \
+        }                                                                                                  \
+    };
+
+LUISA_MAKE_VECTOR_EXPR(2, LUISA_MAKE_VECTOR_EXPR_MEMBER(x, 0u) LUISA_MAKE_VECTOR_EXPR_MEMBER(y, 1u))
+LUISA_MAKE_VECTOR_EXPR(3, LUISA_MAKE_VECTOR_EXPR_MEMBER(x, 0u) LUISA_MAKE_VECTOR_EXPR_MEMBER(y, 1u) LUISA_MAKE_VECTOR_EXPR_MEMBER(z, 2u))
+LUISA_MAKE_VECTOR_EXPR(4, LUISA_MAKE_VECTOR_EXPR_MEMBER(x, 0u) LUISA_MAKE_VECTOR_EXPR_MEMBER(y, 1u) LUISA_MAKE_VECTOR_EXPR_MEMBER(z, 2u) LUISA_MAKE_VECTOR_EXPR_MEMBER(w, 3u))
+
+#undef LUISA_MAKE_VECTOR_EXPR
+#undef LUISA_MAKE_VECTOR_EXPR_MEMBER
+
 // deduction guides
 template<typename T>
 Expr(Expr<T>) -> Expr<T>;
@@ -0,0 +1,427 @@
+//
+// Created by Mike Smith on 2021/3/24.
+//
+
+#pragma once
+
+#include <array>
+#include <limits>
+#include <algorithm>
+#include <memory>
+
+#include <core/logging.h>
+#include <runtime/buffer.h>
+#include <runtime/kernel.h>
+#include <runtime/stream.h>
+#include <dsl/syntax.h>
+
+namespace luisa::compute::dsl {
+
+// Device-wide primitives over buffers, built from kernels that are compiled once when the
+// primitive is constructed. Scratch memory is allocated up front for inputs of up to
+// `capacity` elements, and commands are enqueued on the given stream.
+
+namespace detail {
+
+static constexpr auto primitive_block_size = 256u;
+static constexpr auto primitive_warp_count = primitive_block_size / 32u;// warps of 32 lanes, as on the CPU backend
+
+[[nodiscard]] inline auto primitive_tile_count(size_t n, size_t tile_size = primitive_block_size) noexcept {
+    return static_cast<uint>((n + tile_size - 1u) / tile_size);
+}
+
+inline void check_primitive_size(size_t n, size_t capacity) noexcept {
+    if (n > capacity) { LUISA_ERROR_WITH_LOCATION("Input with {} elements exceeds the capacity of {}.", n, capacity); }
+}
+
+[[nodiscard]] inline auto check_primitive_capacity(size_t capacity) noexcept {
+    if (capacity > std::numeric_limits<uint>::max() - primitive_block_size) {
+        LUISA_ERROR_WITH_LOCATION("Capacity {} is too large for 32-bit dispatch indices.", capacity);
+    }
+    return std::max(capacity, static_cast<size_t>(1u));
+}
+
+template<typename T>
+struct BlockPrefixSum {
+    Expr<T> prefix;// exclusive
+    Expr<T> total;
+};
+
+// prefix sums of x over the threads of a primitive block, which must all be active: each warp scans
+// its values, and the first warp scans the warp totals
+template<typename T>
+[[nodiscard]] inline BlockPrefixSum<T> block_prefix_sum(Expr<T> x) noexcept {
+    auto tid = thread_id().x();
+    auto warp = tid / 32u;
+    auto totals = shared<std::array<T, primitive_warp_count + 1u>>();
+    auto prefix = warp_prefix_sum(x);
+    auto sum = warp_active_sum(x);
+    if_(warp_lane_id() == 0u, [&] { totals[warp] = sum; });
+    sync_block();
+    if_(tid < primitive_warp_count, [&] {
+        Var t = totals[tid];
+        auto offset = warp_prefix_sum(Expr<T>{t});
+        auto total = warp_active_sum(Expr<T>{t});
+        totals[tid] = offset;
+        if_(tid == 0u, [&] { totals[primitive_warp_count] = total; });
+    });
+    sync_block();
+    Var offset = totals[warp] + prefix;
+    Var total = totals[primitive_warp_count];
+    return {offset, total};
+}
+
+// zeroes the first n elements
+[[nodiscard]] inline auto make_clear_kernel(Device *device) noexcept {
+    return Kernel<BufferView<uint>, uint>{device, [](Expr<BufferView<uint>> buffer, Expr<uint> n) noexcept {
+        auto i = dispatch_id().x();
+        if_(i < n, [&] { buffer[i] = 0u; });
+    }};
+}
+
+}// namespace detail
+
+enum struct ReduceOp : uint32_t {
+    SUM,
+    MIN,
+    MAX
+};
+
+// Reduces tiles of 2048 elements to one partial per block, over as many passes as it takes to get
+// down to a single value.
+template<typename T>
+class DeviceReduce : public concepts::Noncopyable {
+
+public:
+    static constexpr auto items_per_thread = 8u;
+    static constexpr auto tile_size = detail::primitive_block_size * items_per_thread;
+
+private:
+    size_t _capacity;
+    Kernel<BufferView<T>, BufferView<T>, uint> _reduce;
+    std::array<Buffer<T>, 2u> _partials;
+
+private:
+    [[nodiscard]] static auto _identity(ReduceOp op) noexcept {
+        switch (op) {
+            case ReduceOp::MIN: return std::numeric_limits<T>::max();
+            case ReduceOp::MAX: return std::numeric_limits<T>::lowest();
+            default: return T{};
+        }
+    }
+
+    [[nodiscard]] static Expr<T> _combine(ReduceOp op, Expr<T> a, Expr<T> b) noexcept {
+        if (op == ReduceOp::SUM) { return a + b; }
+        return Expr<T>{FunctionBuilder::current()->call(
+            Type::of<T>(), op == ReduceOp::MIN ? CallOp::MIN : CallOp::MAX, {a.expression(), b.expression()})};
+    }
+
+public:
+    DeviceReduce(Device *device, size_t capacity, ReduceOp op = ReduceOp::SUM) noexcept
+        : _capacity{detail::check_primitive_capacity(capacity)},
+          _reduce{device, [op](Expr<BufferView<T>> input, Expr<BufferView<T>> output, Expr<uint> n) noexcept {
+              static constexpr auto block_size = detail::primitive_block_size;
+              auto tid = thread_id().x();
+              auto base = block_id().x() * tile_size + tid;
+              Var acc = _identity(op);
+              for (auto k = 0u; k < items_per_thread; k++) {
+                  auto i = base + k * block_size;
+                  if_(i < n, [&] { acc = _combine(op, acc, input[i]); });
+              }
+              auto tile = shared<std::array<T, block_size>>();
+              tile[tid] = acc;
+              sync_block();
+              for (auto stride = block_size / 2u; stride != 0u; stride /= 2u) {
+                  if_(tid < stride, [&] { tile[tid] = _combine(op, tile[tid], tile[tid + stride]); });
+                  sync_block();
+              }
+              if_(tid == 0u, [&] { output[block_id().x()] = tile[0u]; });
+          }},
+          _partials{Buffer<T>{device, detail::primitive_tile_count(_capacity, tile_size)},
+                    Buffer<T>{device, detail::primitive_tile_count(detail::primitive_tile_count(_capacity, tile_size), tile_size)}} {}
+
+    [[nodiscard]] auto capacity() const noexcept { return _capacity; }
+
+    // writes the reduction of the input to result[0], the identity of the operation if the input is empty
+    void operator()(Stream &stream, BufferView<T> input, BufferView<T> result) noexcept {
+        detail::check_primitive_size(input.size(), _capacity);
+        auto source = input;
+        auto count = input.size();
+        for (auto pass = 0u; count > tile_size; pass++) {
+            auto blocks = detail::primitive_tile_count(count, tile_size);
+            auto partials = _partials[pass % 2u].view().subview(0u, blocks);
+            stream << _reduce(source, partials, static_cast<uint>(count)).dispatch(blocks * detail::primitive_block_size);
+            source = partials;
+            count = blocks;
+        }
+        stream << _reduce(source, result, static_cast<uint>(count)).dispatch(detail::primitive_block_size);
+    }
+};
+
+// Single-pass prefix sums with decoupled look-back: each block publishes the sum of its tile as soon
+// as it is known, and the inclusive prefix once it has summed the tiles before it, stopping at the
+// first tile whose inclusive prefix is already published. Tiles are numbered in the order blocks
+// start, so the tiles a block waits on belong to blocks that are already running. Each thread scans
+// a run of consecutive elements, so that a block prefix sum and a look-back serve a whole tile.
+template<typename T>
+class DeviceScan : public concepts::Noncopyable {
+
+public:
+    static constexpr auto items_per_thread = 8u;
+    static constexpr auto tile_size = detail::primitive_block_size * items_per_thread;
+    static constexpr auto aggregate_ready = 1u;
+    static constexpr auto prefix_ready = 2u;
+
+private:
+    size_t _capacity;
+    Kernel<BufferView<uint>, uint> _clear;
+    Kernel<BufferView<T>, BufferView<T>, BufferView<uint>, BufferView<T>, uint, uint> _scan;
+    Buffer<uint> _status;// the tile counter, followed by the status of each tile
+    Buffer<T> _partials; // the aggregate and the inclusive prefix of each tile
+
+private:
+    void _run(Stream &stream, BufferView<T> input, BufferView<T> output, bool inclusive) noexcept {
+        auto n = input.size();
+        detail::check_primitive_size(n, _capacity);
+        if (output.size() < n) { LUISA_ERROR_WITH_LOCATION("Output with {} elements is smaller than input with {}.", output.size(), n); }
+        if (n == 0u) { return; }
+        auto tiles = detail::primitive_tile_count(n, tile_size);
+        stream << _clear(_status, tiles + 1u).dispatch(tiles + 1u)
+               << _scan(input, output, _status, _partials, static_cast<uint>(n), inclusive ? 1u : 0u)
+                      .dispatch(tiles * detail::primitive_block_size);
+    }
+
+public:
+    DeviceScan(Device *device, size_t capacity) noexcept
+        : _capacity{detail::check_primitive_capacity(capacity)},
+          _clear{detail::make_clear_kernel(device)},
+          _scan{device, [](Expr<BufferView<T>> input, Expr<BufferView<T>> output, Expr<BufferView<uint>> status,
+                           Expr<BufferView<T>> partials, Expr<uint> n, Expr<uint> inclusive) noexcept {
+              auto tid = thread_id().x();
+              auto ticket = shared<std::array<uint, 1u>>();
+              if_(tid == 0u, [&] { ticket[0u] = atomic_fetch_add(status[0u], 1u); });
+              sync_block();
+              Var tile = ticket[0u];
+              auto base = tile * tile_size + tid * items_per_thread;
+              Var<T> x;
+              for (auto k = 0u; k < items_per_thread; k++) {
+                  if_(base + k < n, [&] { x += input[base + k]; });
+              }
+              auto sums = detail::block_prefix_sum(Expr<T>{x});
+              auto carry = shared<std::array<T, 1u>>();
+              if_(tid == 0u, [&] {
+                  Var aggregate = sums.total;
+                  if_(tile == 0u, [&] {
+                      partials[1u] = aggregate;
+                      static_cast<void>(atomic_exchange(status[1u], prefix_ready));
+                  }).else_([&] {
+                      partials[tile * 2u] = aggregate;
+                      static_cast<void>(atomic_exchange(status[tile + 1u], aggregate_ready));
+                  });
+                  // status[j] and partials[2j - 2, 2j) belong to tile j - 1
+                  Var<T> exclusive;
+                  Var j = tile;
+                  while_(j > 0u, [&] {
+                      auto s = atomic_fetch_or(status[j], 0u);
+                      if_(s == prefix_ready, [&] {
+                          exclusive += partials[j * 2u - 1u];
+                          j = 0u;
+                      }).elif_(s == aggregate_ready, [&] {
+                          exclusive += partials[j * 2u - 2u];
+                          j -= 1u;
+                      });
+                  });
+                  if_(tile != 0u, [&] {
+                      partials[tile * 2u + 1u] = exclusive + aggregate;
+                      static_cast<void>(atomic_exchange(status[tile + 1u], prefix_ready));
+                  });
+                  carry[0u] = exclusive;
+              });
+              sync_block();
+              // each element is read before it is written, so the output may be the input
+              Var prefix = carry[0u] + sums.prefix;
+              for (auto k = 0u; k < items_per_thread; k++) {
+                  auto i = base + k;
+                  if_(i < n, [&] {
+                      Var y = input[i];
+                      output[i] = select(inclusive != 0u, prefix + y, Expr<T>{prefix});
+                      prefix += y;
+                  });
+              }
+          }},
+          _status{device, detail::primitive_tile_count(_capacity, tile_size) + 1u},
+          _partials{device, detail::primitive_tile_count(_capacity, tile_size) * 2u} {}
+
+    [[nodiscard]] auto capacity() const noexcept { return _capacity; }
+
+    // output[i] = input[0] + ... + input[i - 1], output may be the input
+    void exclusive(Stream &stream, BufferView<T> input, BufferView<T> output) noexcept { _run(stream, input, output, false); }
+    // output[i] = input[0] + ... + input[i], output may be the input
+    void inclusive(Stream &stream, BufferView<T> input, BufferView<T> output) noexcept { _run(stream, input, output, true); }
+};
+
+// Stable least-significant-digit radix sort of 32-bit unsigned keys, optionally carrying values along,
+// 4 bits per pass. Each pass counts the digits of each tile, scans the counts laid out digit by digit
+// to get where the tiles put their elements of each digit, and scatters the elements by their ranks
+// within their tiles. The ranks come from a single block prefix sum over 16 one-hot 8-bit counters
+// packed in a uint4, which cannot overflow as a tile has fewer than 256 elements before any other.
+template<typename Value = uint>
+class DeviceRadixSort : public concepts::Noncopyable {
+
+public:
+    static constexpr auto tile_size = detail::primitive_block_size;
+    static constexpr auto radix_bits = 4u;
+    static constexpr auto radix = 1u << radix_bits;
+    static constexpr auto pass_count = 32u / radix_bits;
+
+private:
+    size_t _capacity;
+    Kernel<BufferView<uint>, BufferView<uint>, uint, uint> _histogram;
+    Kernel<BufferView<uint>, BufferView<uint>, BufferView<uint>, uint, uint> _scatter_keys;
+    Kernel<BufferView<uint>, BufferView<uint>, BufferView<Value>, BufferView<Value>, BufferView<uint>, uint, uint> _scatter_pairs;
+    DeviceScan<uint> _scan;
+    Buffer<uint> _offsets;
+    Buffer<uint> _keys;
+    std::unique_ptr<Buffer<Value>> _values;// allocated by the first key-value sort
+
+private:
+    // the rank of each key among the keys of the same digit in its tile, then move(slot) moves the element
+    template<typename Move>
+    static void _rank_and_scatter(Expr<BufferView<uint>> keys_in, Expr<BufferView<uint>> keys_out,
+                                  Expr<BufferView<uint>> offsets, Expr<uint> n, Expr<uint> shift, Move &&move) noexcept {
+        auto i = dispatch_id().x();
+        auto tile_count = (n + tile_size - 1u) / tile_size;
+        Var<uint> key;
+        Var<uint> digit;
+        Var<uint4> one_hot;
+        if_(i < n, [&] {
+            key = keys_in[i];
+            digit = (key >> shift) & (radix - 1u);
+            one_hot[digit / 4u] = Expr<uint>{1u} << digit % 4u * 8u;
+        });
+        auto ranks = detail::block_prefix_sum(Expr<uint4>{one_hot});
+        if_(i < n, [&] {
+            Var slot = offsets[digit * tile_count + block_id().x()] + ((ranks.prefix[digit / 4u] >> digit % 4u * 8u) & 0xffu);
+            keys_out[slot] = key;
+            move(i, Expr<uint>{slot});
+        });
+    }
+
+    void _sort(Stream &stream, BufferView<uint> keys, BufferView<Value> *values) noexcept {
+        auto n = keys.size();
+        detail::check_primitive_size(n, _capacity);
+        if (n == 0u) { return; }
+        if (values != nullptr && values->size() < n) {
+            LUISA_ERROR_WITH_LOCATION("Values with {} elements are fewer than the {} keys.", values->size(), n);
+        }
+        auto tiles = detail::primitive_tile_count(n);
+        auto offsets = _offsets.view().subview(0u, tiles * radix);
+        std::array key_buffers{keys, _keys.view().subview(0u, n)};
+        for (auto pass = 0u; pass < pass_count; pass++) {
+            auto shift = pass * radix_bits;
+            auto keys_in = key_buffers[pass % 2u];
+            auto keys_out = key_buffers[1u - pass % 2u];
+            stream << _histogram(keys_in, offsets, static_cast<uint>(n), shift).dispatch(tiles * tile_size);
+            _scan.exclusive(stream, offsets, offsets);
+            if (values == nullptr) {
+                stream << _scatter_keys(keys_in, keys_out, offsets, static_cast<uint>(n), shift).dispatch(tiles * tile_size);
+            } else {
+                std::array value_buffers{*values, _values->view().subview(0u, n)};
+                stream << _scatter_pairs(keys_in, keys_out, value_buffers[pass % 2u], value_buffers[1u - pass % 2u],
+                                         offsets, static_cast<uint>(n), shift)
+                              .dispatch(tiles * tile_size);
+            }
+        }
+    }
+
+public:
+    DeviceRadixSort(Device *device, size_t capacity) noexcept
+        : _capacity{detail::check_primitive_capacity(capacity)},
+          _histogram{device, [](Expr<BufferView<uint>> keys, Expr<BufferView<uint>> counts, Expr<uint> n, Expr<uint> shift) noexcept {
+              auto tid = thread_id().x();
+              auto i = dispatch_id().x();
+              auto histogram = shared<std::array<uint, radix>>();
+              if_(tid < radix, [&] { histogram[tid] = 0u; });
+              sync_block();
+              if_(i < n, [&] { static_cast<void>(atomic_fetch_add(histogram[(keys[i] >> shift) & (radix - 1u)], 1u)); });
+              sync_block();
+              if_(tid < radix, [&] { counts[tid * ((n + tile_size - 1u) / tile_size) + block_id().x()] = histogram[tid]; });
+          }},
+          _scatter_keys{device, [](Expr<BufferView<uint>> keys_in, Expr<BufferView<uint>> keys_out,
+                                   Expr<BufferView<uint>> offsets, Expr<uint> n, Expr<uint> shift) noexcept {
+              _rank_and_scatter(keys_in, keys_out, offsets, n, shift, [](Expr<uint>, Expr<uint>) noexcept {});
+          }},
+          _scatter_pairs{device, [](Expr<BufferView<uint>> keys_in, Expr<BufferView<uint>> keys_out,
+                                    Expr<BufferView<Value>> values_in, Expr<BufferView<Value>> values_out,
+                                    Expr<BufferView<uint>> offsets, Expr<uint> n, Expr<uint> shift) noexcept {
+              _rank_and_scatter(keys_in, keys_out, offsets, n, shift, [&](Expr<uint> i, Expr<uint> slot) noexcept {
+                  values_out[slot] = values_in[i];
+              });
+          }},
+          _scan{device, detail::primitive_tile_count(_capacity) * radix},
+          _offsets{device, detail::primitive_tile_count(_capacity) * radix},
+          _keys{device, _capacity} {}
+
+    [[nodiscard]] auto capacity() const noexcept { return _capacity; }
+
+    // sorts the keys in place, ascending
+    void sort(Stream &stream, BufferView<uint> keys) noexcept { _sort(stream, keys, nullptr); }
+
+    // sorts the keys in place, ascending, moving values[i] along with keys[i]; equal keys keep their order
+    void sort(Stream &stream, BufferView<uint> keys, BufferView<Value> values) noexcept {
+        if (_values == nullptr) { _values = std::make_unique<Buffer<Value>>(keys.device(), _capacity); }
+        _sort(stream, keys, &values);
+    }
+};
+
+// Stream compaction: keeps the elements for which a predicate holds, in their order, by scanning
+// the predicate and scattering the kept elements to their prefix counts.
+template<typename T>
+class DeviceCompaction : public concepts::Noncopyable {
+
+private:
+    size_t _capacity;
+    Kernel<BufferView<T>, BufferView<uint>, uint> _flag;
+    Kernel<BufferView<T>, BufferView<uint>, BufferView<T>, BufferView<uint>, uint> _scatter;
+    DeviceScan<uint> _scan;
+    Buffer<uint> _offsets;
+
+public:
+    // keep(x) is traced into the kernels, returning an Expr<bool> for an element x
+    template<typename Keep>
+    requires std::invocable<Keep, Expr<T>>
+    DeviceCompaction(Device *device, size_t capacity, Keep &&keep) noexcept
+        : _capacity{detail::check_primitive_capacity(capacity)},
+          _flag{device, [&keep](Expr<BufferView<T>> input, Expr<BufferView<uint>> flags, Expr<uint> n) noexcept {
+              auto i = dispatch_id().x();
+              if_(i < n, [&] { flags[i] = select(Expr<bool>{keep(input[i])}, Expr<uint>{1u}, Expr<uint>{0u}); });
+          }},
+          _scatter{device, [&keep](Expr<BufferView<T>> input, Expr<BufferView<uint>> offsets,
+                                   Expr<BufferView<T>> output, Expr<BufferView<uint>> count, Expr<uint> n) noexcept {
+              auto i = dispatch_id().x();
+              if_(i < n, [&] {
+                  Var x = input[i];
+                  if_(Expr<bool>{keep(Expr<T>{x})}, [&] { output[offsets[i] - 1u] = x; });
+              });
+              if_(i == 0u && n == 0u, [&] { count[0u] = 0u; });
+              if_(i + 1u == n, [&] { count[0u] = offsets[i]; });
+          }},
+          _scan{device, _capacity},
+          _offsets{device, _capacity} {}
+
+    [[nodiscard]] auto capacity() const noexcept { return _capacity; }
+
+    // writes the kept elements to the front of the output and their number to count[0]
+    void operator()(Stream &stream, BufferView<T> input, BufferView<T> output, BufferView<uint> count) noexcept {
+        auto n = input.size();
+        detail::check_primitive_size(n, _capacity);
+        if (output.size() < n) { LUISA_ERROR_WITH_LOCATION("Output with {} elements is smaller than input with {}.", output.size(), n); }
+        auto offsets = _offsets.view().subview(0u, n);
+        auto threads = std::max(detail::primitive_tile_count(n), 1u) * detail::primitive_block_size;
+        stream << _flag(input, offsets, static_cast<uint>(n)).dispatch(threads);
+        _scan.inclusive(stream, offsets, offsets);
+        stream << _scatter(input, offsets, output, count, static_cast<uint>(n)).dispatch(threads);
+    }
+};
+
+}// namespace luisa::compute::dsl
@@ -4,11 +4,295 @@
 
 #pragma once
 
+#include <vector>
+#include <optional>
+#include <functional>
+
 #include <dsl/var.h>
 #include <dsl/expr.h>
 
 namespace luisa::compute::dsl {
 
+[[nodiscard]] inline auto thread_id() noexcept {
+    auto f = FunctionBuilder::current();
+    return Expr<uint3>{f->ref(f->thread_id())};
+}
+
+[[nodiscard]] inline auto block_id() noexcept {
+    auto f = FunctionBuilder::current();
+    return Expr<uint3>{f->ref(f->block_id())};
+}
+
+[[nodiscard]] inline auto dispatch_id() noexcept {
+    auto f = FunctionBuilder::current();
+    return Expr<uint3>{f->ref(f->dispatch_id())};
+}
+
+// memory shared by the threads of a block, e.g. shared<std::array<float, 256>>()
+template<typename T>
+[[nodiscard]] inline auto shared() noexcept {
+    auto f = FunctionBuilder::current();
+    return Expr<T>{f->ref(f->shared(Type::of<T>()))};
+}
+
+inline void sync_block() noexcept { FunctionBuilder::current()->sync_block(); }
+
+namespace detail {
+
+// The if statement is emitted when the builder goes away, i.e. after its elif_ and else_ branches, so
+// the builder must stay a temporary: it cannot be moved, its branches can only be chained onto it, and
+// tracing other statements while it is alive, e.g. by naming it, is an error, as they would end up before the if.
+class IfStmtBuilder {
+
+private:
+    struct Branch {
+        const Expression *condition;
+        const ScopeStmt *body;
+    };
+    std::vector<Branch> _branches;
+    const ScopeStmt *_otherwise{nullptr};
+    bool _resolved{false};// a branch known to be taken at trace time has been recorded
+    bool _has_else{false};
+    size_t _scope_size{0u};
+
+    static void _emit(Branch branch, const ScopeStmt *otherwise) noexcept {
+        auto f = FunctionBuilder::current();
+        if (otherwise == nullptr) {
+            f->if_(branch.condition, branch.body);
+        } else {
+            f->if_(branch.condition, branch.body, otherwise);
+        }
+    }
+
+    // branches whose conditions are known at trace time are resolved on the host: a taken branch
+    // preceded by no dynamic ones is traced inline, otherwise it becomes the else branch
+    template<typename Body>
+    void _branch(std::optional<bool> taken, const Expression *cond, Body &&body) noexcept {
+        auto f = FunctionBuilder::current();
+        if (!taken) {
+            if (!_resolved) { _branches.emplace_back(Branch{cond, f->scope(std::forward<Body>(body))}); }
+        } else if (*taken && !_resolved) {
+            if (_branches.empty()) {
+                std::invoke(std::forward<Body>(body));
+            } else {
+                _otherwise = f->scope(std::forward<Body>(body));
+            }
+            _resolved = true;
+        }
+        _scope_size = f->scope_size();
+    }
+
+public:
+    template<typename Body>
+    IfStmtBuilder(Expr<bool> cond, Body &&body) noexcept {
+        _branch(cond.host_value(), cond.expression(), std::forward<Body>(body));
+    }
+    IfStmtBuilder(IfStmtBuilder &&) noexcept = delete;
+    IfStmtBuilder &operator=(IfStmtBuilder &&) noexcept = delete;
+    ~IfStmtBuilder() noexcept {
+        auto f = FunctionBuilder::current();
+        if (f->scope_size() != _scope_size) { LUISA_ERROR_WITH_LOCATION("Statements traced while an if statement is being built."); }
+        if (_branches.empty()) { return; }
+        auto otherwise = _otherwise;
+        for (auto i = _branches.size() - 1u; i > 0u; i--) {
+            otherwise = f->scope([&] { _emit(_branches[i], otherwise); });
+        }
+        _emit(_branches.front(), otherwise);
+    }
+    // the condition is evaluated only if the previous ones do not hold,
+    // unless it binds values to locals, e.g. with atomics or warp operations
+    template<typename Body>
+    IfStmtBuilder &&elif_(Expr<bool> cond, Body &&body) && noexcept {
+        _branch(cond.host_value(), cond.expression(), std::forward<Body>(body));
+        return std::move(*this);
+    }
+    template<typename Body>
+    void else_(Body &&body) && noexcept {
+        if (_has_else) { LUISA_ERROR_WITH_LOCATION("Multiple else branches."); }
+        _has_else = true;
+        _branch(true, nullptr, std::forward<Body>(body));
+    }
+};
+
+// cases never fall through, the switch statement is emitted when the builder goes away,
+// which therefore must stay a temporary just like IfStmtBuilder
+class SwitchStmtBuilder {
+
+private:
+    const Expression *_value;
+    std::vector<std::pair<const Expression *, const ScopeStmt *>> _cases;
+    const ScopeStmt *_default{nullptr};
+    size_t _scope_size;
+
+public:
+    explicit SwitchStmtBuilder(const Expression *value) noexcept
+        : _value{value}, _scope_size{FunctionBuilder::current()->scope_size()} {}
+    SwitchStmtBuilder(SwitchStmtBuilder &&) noexcept = delete;
+    SwitchStmtBuilder &operator=(SwitchStmtBuilder &&) noexcept = delete;
+    ~SwitchStmtBuilder() noexcept {
+        auto f = FunctionBuilder::current();
+        if (f->scope_size() != _scope_size) { LUISA_ERROR_WITH_LOCATION("Statements traced while a switch statement is being built."); }
+        f->switch_(_value, f->scope([&] {
+            for (auto [value, body] : _cases) { f->case_(value, body); }
+            if (_default != nullptr) { f->default_(_default); }
+        }));
+    }
+    template<concepts::Native T, typename Body>
+    requires std::is_integral_v<T>
+    SwitchStmtBuilder &&case_(T value, Body &&body) && noexcept {
+        auto f = FunctionBuilder::current();
+        _cases.emplace_back(f->literal(value), f->scope(std::forward<Body>(body)));
+        return std::move(*this);
+    }
+    template<typename Body>
+    SwitchStmtBuilder &&default_(Body &&body) && noexcept {
+        if (_default != nullptr) { LUISA_ERROR_WITH_LOCATION("Multiple default cases."); }
+        _default = FunctionBuilder::current()->scope(std::forward<Body>(body));
+        return std::move(*this);
+    }
+};
+
+}// namespace detail
+
+// if_(x > 0.0f, [&] { ... }).elif_(x < 0.0f, [&] { ... }).else_([&] { ... });
+template<typename Body>
+requires std::invocable<Body>
+inline auto if_(Expr<bool> cond, Body &&body) noexcept {
+    return detail::IfStmtBuilder{cond, std::forward<Body>(body)};
+}
+
+// the condition is evaluated before every iteration
+template<typename Body>
+requires std::invocable<Body>
+inline void while_(Expr<bool> cond, Body &&body) noexcept {
+    if (cond.host_value() == false) { return; }
+    auto f = FunctionBuilder::current();
+    f->while_(cond.expression(), f->scope(std::forward<Body>(body)));
+}
+
+// switch_(x).case_(0, [&] { ... }).case_(1, [&] { ... }).default_([&] { ... });
+template<typename T>
+requires std::is_integral_v<T>
+inline auto switch_(Expr<T> value) noexcept { return detail::SwitchStmtBuilder{value.expression()}; }
+
+inline void break_() noexcept { FunctionBuilder::current()->break_(); }
+inline void continue_() noexcept { FunctionBuilder::current()->continue_(); }
+inline void return_() noexcept { FunctionBuilder::current()->return_(nullptr); }
 
+// for (i = begin; i < end; i += step) body(i), with an unroll hint (see ForStmt); the condition is always
+// i < end, so loops only count up, and steps known at trace time not to be positive are rejected
+template<typename T, typename Body>
+requires std::invocable<Body, Expr<T>>
+inline void for_(Expr<T> begin, Expr<T> end, Expr<T> step, Body &&body, LoopUnroll unroll = ForStmt::unroll_auto) noexcept {
+    if (auto s = step.host_value(); s && !(*s > static_cast<T>(0))) { LUISA_ERROR_WITH_LOCATION("Loops with non-positive steps never reach their ends."); }
+    auto f = FunctionBuilder::current();
+    auto v = f->for_variable(Type::of<T>());
+    auto cond = f->binary(Type::of<bool>(), BinaryOp::LESS, f->ref(v), end.expression());
+    f->for_(v, begin.expression(), cond, step.expression(), f->scope([&] { body(Expr<T>{f->ref(v)}); }), unroll);
+}
+
+template<typename T, typename Body>
+requires std::invocable<Body, Expr<T>>
+inline void for_(Expr<T> begin, Expr<T> end, Body &&body, LoopUnroll unroll = ForStmt::unroll_auto) noexcept {
+    for_(begin, end, Expr<T>{static_cast<T>(1)}, std::forward<Body>(body), unroll);
+}
+
+template<concepts::Native T, typename Body>
+requires std::invocable<Body, Expr<T>>
+inline void for_(T begin, Expr<T> end, Body &&body, LoopUnroll unroll = ForStmt::unroll_auto) noexcept {
+    for_(Expr<T>{begin}, end, std::forward<Body>(body), unroll);
+}
+
+template<concepts::Native T, typename Body>
+requires std::invocable<Body, Expr<T>>
+inline void for_(T begin, T end, Body &&body, LoopUnroll unroll = ForStmt::unroll_auto) noexcept {
+    for_(Expr<T>{begin}, Expr<T>{end}, std::forward<Body>(body), unroll);
+}
 
+// cond ? t : f without branching, so both values may be evaluated
+template<typename T>
+[[nodiscard]] inline auto select(Expr<bool> cond, Expr<T> t, Expr<T> f) noexcept {
+    return Expr<T>{FunctionBuilder::current()->select(Type::of<T>(), cond.expression(), t.expression(), f.expression())};
 }
+
+// component-wise with a vector mask
+template<typename T, size_t N>
+[[nodiscard]] inline auto select(Expr<Vector<bool, N>> cond, Expr<Vector<T, N>> t, Expr<Vector<T, N>> f) noexcept {
+    return Expr<Vector<T, N>>{FunctionBuilder::current()->select(Type::of<Vector<T, N>>(), cond.expression(), t.expression(), f.expression())};
+}
+
+namespace detail {
+
+// binds the result of a call to a local, so that the call executes exactly once where it is
+// written, with the execution mask at that point, no matter where and how often it is used
+template<typename T>
+[[nodiscard]] inline auto bind(const Expression *call) noexcept {
+    auto f = FunctionBuilder::current();
+    return Expr<T>{f->ref(f->local(call->type(), {call}))};
+}
+
+}// namespace detail
+
+// atomics on buffer elements and shared variables, returning the old value
+#define LUISA_MAKE_DSL_ATOMIC(func, op)                                                              \
+    template<typename T>                                                                             \
+    inline auto func(Expr<T> ref, Expr<T> value) noexcept {                                          \
+        return detail::bind<T>(                                                                      \
+            FunctionBuilder::current()->atomic(CallOp::op, ref.expression(), value.expression()));   \
+    }                                                                                                \
+    template<typename T, concepts::Native U>                                                         \
+    inline auto func(Expr<T> ref, U value) noexcept { return func(ref, Expr<T>{static_cast<T>(value)}); }
+LUISA_MAKE_DSL_ATOMIC(atomic_exchange, ATOMIC_EXCHANGE)
+LUISA_MAKE_DSL_ATOMIC(atomic_fetch_add, ATOMIC_FETCH_ADD)
+LUISA_MAKE_DSL_ATOMIC(atomic_fetch_sub, ATOMIC_FETCH_SUB)
+LUISA_MAKE_DSL_ATOMIC(atomic_fetch_and, ATOMIC_FETCH_AND)
+LUISA_MAKE_DSL_ATOMIC(atomic_fetch_or, ATOMIC_FETCH_OR)
+LUISA_MAKE_DSL_ATOMIC(atomic_fetch_xor, ATOMIC_FETCH_XOR)
+LUISA_MAKE_DSL_ATOMIC(atomic_fetch_min, ATOMIC_FETCH_MIN)
+LUISA_MAKE_DSL_ATOMIC(atomic_fetch_max, ATOMIC_FETCH_MAX)
+#undef LUISA_MAKE_DSL_ATOMIC
+
+template<typename T>
+inline auto atomic_compare_exchange(Expr<T> ref, Expr<T> expected, Expr<T> desired) noexcept {
+    return detail::bind<T>(FunctionBuilder::current()->atomic_compare_exchange(
+        ref.expression(), expected.expression(), desired.expression()));
+}
+
+// warp (subgroup) operations over the active threads of a warp
+[[nodiscard]] inline auto warp_size() noexcept {
+    return Expr<uint>{FunctionBuilder::current()->call(Type::of<uint>(), CallOp::WARP_SIZE, {})};
+}
+
+[[nodiscard]] inline auto warp_lane_id() noexcept {
+    return detail::bind<uint>(FunctionBuilder::current()->call(Type::of<uint>(), CallOp::WARP_LANE_ID, {}));
+}
+
+#define LUISA_MAKE_DSL_WARP_VOTE(func, op, R)                                          \
+    [[nodiscard]] inline auto func(Expr<bool> predicate) noexcept {                   \
+        return detail::bind<R>(FunctionBuilder::current()->call(                      \
+            Type::of<R>(), CallOp::op, {predicate.expression()}));                    \
+    }
+LUISA_MAKE_DSL_WARP_VOTE(warp_active_all, WARP_ACTIVE_ALL, bool)
+LUISA_MAKE_DSL_WARP_VOTE(warp_active_any, WARP_ACTIVE_ANY, bool)
+LUISA_MAKE_DSL_WARP_VOTE(warp_active_ballot, WARP_ACTIVE_BALLOT, uint)
+#undef LUISA_MAKE_DSL_WARP_VOTE
+
+#define LUISA_MAKE_DSL_WARP_REDUCE(func, op)                                           \
+    template<typename T>                                                              \
+    [[nodiscard]] inline auto func(Expr<T> x) noexcept {                              \
+        return detail::bind<T>(FunctionBuilder::current()->call(                      \
+            Type::of<T>(), CallOp::op, {x.expression()}));                            \
+    }
+LUISA_MAKE_DSL_WARP_REDUCE(warp_read_first_active_lane, WARP_READ_FIRST_ACTIVE_LANE)
+LUISA_MAKE_DSL_WARP_REDUCE(warp_active_sum, WARP_ACTIVE_SUM)
+LUISA_MAKE_DSL_WARP_REDUCE(warp_prefix_sum, WARP_PREFIX_SUM)
+LUISA_MAKE_DSL_WARP_REDUCE(warp_inclusive_sum, WARP_INCLUSIVE_SUM)
+#undef LUISA_MAKE_DSL_WARP_REDUCE
+
+template<typename T>
+[[nodiscard]] inline auto warp_read_lane(Expr<T> x, Expr<uint> lane) noexcept {
+    return detail::bind<T>(FunctionBuilder::current()->call(
+        Type::of<T>(), CallOp::WARP_READ_LANE, {x.expression(), lane.expression()}));
+}
+
+}// namespace luisa::compute::dsl
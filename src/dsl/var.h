@@ -8,16 +8,92 @@
 
 namespace luisa::compute::dsl {
 
+namespace detail {
+
+template<typename T>
+struct expr_value {
+    using type = T;
+};
+
+template<typename T>
+struct expr_value<Expr<T>> {
+    using type = T;
+};
+
+template<typename T>
+struct expr_value<Var<T>> {
+    using type = T;
+};
+
+template<typename T>
+using expr_value_t = typename expr_value<std::remove_cvref_t<T>>::type;
+
+template<typename T>
+[[nodiscard]] inline const Expression *extract_expression(T &&v) noexcept {
+    if constexpr (concepts::Native<std::remove_cvref_t<T>>) {
+        return FunctionBuilder::current()->literal(v);
+    } else {
+        return v.expression();
+    }
+}
+
+}// namespace detail
+
+// A local variable, declared where it is constructed. Copies declare new locals,
+// while assignments, also from other variables, assign to this one.
 template<typename T>
-class Var {
+class Var : public Expr<T> {
 
 private:
-    Variable _variable;
+    [[nodiscard]] static const Expression *_declare(std::initializer_list<const Expression *> init) noexcept {
+        auto f = FunctionBuilder::current();
+        return f->ref(f->local(Type::of<T>(), init));
+    }
 
 public:
-    Var(Var &&) noexcept = delete;
-    Var &operator=(Var &&) noexcept = delete;
-    
+    // zero-initialized
+    Var() noexcept : Expr<T>{_declare({})} {}
+
+    // initialized like T from the values of expressions, variables and native values,
+    // e.g. components of vectors or members of structures
+    template<typename... Args>
+    requires(sizeof...(Args) > 0u) && std::is_constructible_v<T, detail::expr_value_t<Args>...>
+    Var(Args &&...args) noexcept : Expr<T>{_declare({detail::extract_expression(std::forward<Args>(args))...})} {}
+
+    Var(const Var &other) noexcept : Expr<T>{_declare({other.expression()})} {}
+    Var(Var &&) noexcept = default;
+
+    Var &operator=(const Var &rhs) noexcept {
+        detail::ExprBase<T>::operator=(rhs);
+        return *this;
+    }
+    Var &operator=(Var &&rhs) noexcept {
+        detail::ExprBase<T>::operator=(rhs);
+        return *this;
+    }
+    using Expr<T>::operator=;
+    // expressions and native values are assigned directly, rather than through a Var constructed from them
+    Var &operator=(const Expr<T> &rhs) noexcept {
+        detail::ExprBase<T>::operator=(rhs);
+        return *this;
+    }
+    template<concepts::Native U>
+    requires concepts::Assign<T, U> Var &operator=(U rhs) noexcept {
+        detail::ExprBase<T>::operator=(Expr<U>{rhs});
+        return *this;
+    }
+
+    [[nodiscard]] auto variable() const noexcept { return static_cast<const RefExpr *>(this->expression())->variable(); }
 };
 
-}
+// deduction guides
+template<typename T>
+Var(Expr<T>) -> Var<T>;
+
+template<typename T>
+Var(const Var<T> &) -> Var<T>;
+
+template<concepts::Native T>
+Var(T) -> Var<T>;
+
+}// namespace luisa::compute::dsl
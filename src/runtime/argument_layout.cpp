@@ -0,0 +1,44 @@
+//
+// Created by Mike Smith on 2021/3/7.
+//
+
+#include <core/logging.h>
+#include <runtime/argument_layout.h>
+
+namespace luisa::compute {
+
+const ArgumentLayout::Entry &ArgumentLayout::_add(Variable v) noexcept {
+    auto [size, align] = [v]() noexcept -> std::pair<size_t, size_t> {
+        switch (v.tag()) {
+            case Variable::Tag::BUFFER: return {sizeof(BufferArgument), alignof(BufferArgument)};
+            case Variable::Tag::BINDLESS_ARRAY: return {sizeof(uint64_t), alignof(uint64_t)};
+            case Variable::Tag::TEXTURE: return {sizeof(TextureArgument), alignof(TextureArgument)};
+            case Variable::Tag::UNIFORM: return {v.type()->size(), v.type()->alignment()};
+            default: LUISA_ERROR_WITH_LOCATION("Invalid argument tag {}.", static_cast<uint32_t>(v.tag()));
+        }
+        return {0u, 1u};
+    }();
+    auto offset = (_size + align - 1u) / align * align;
+    _size = offset + size;
+    return _entries.emplace_back(Entry{v, static_cast<uint32_t>(offset), static_cast<uint32_t>(size)});
+}
+
+ArgumentLayout::ArgumentLayout(Function kernel) noexcept {
+    for (auto &&b : kernel.captured_buffers()) { _add(b.variable); }
+    for (auto &&t : kernel.captured_textures()) { _add(t.variable); }
+    for (auto &&a : kernel.captured_bindless_arrays()) { _add(a.variable); }
+    for (auto &&u : kernel.captured_uniforms()) {
+        auto &&e = _add(u.variable);
+        _uniform_captures.emplace_back(UniformCapture{u.data, e.offset, e.size});
+    }
+    _capture_count = _entries.size();
+    for (auto v : kernel.arguments()) { _add(v); }
+    _size = (_size + alignment - 1u) / alignment * alignment;
+    _captures.resize(_size);
+    auto entry = _entries.cbegin();
+    for (auto &&b : kernel.captured_buffers()) { encode_buffer(_captures.data() + (entry++)->offset, b.handle, b.offset_bytes); }
+    for (auto &&t : kernel.captured_textures()) { encode_texture(_captures.data() + (entry++)->offset, t.handle, t.level); }
+    for (auto &&a : kernel.captured_bindless_arrays()) { encode_bindless_array(_captures.data() + (entry++)->offset, a.handle); }
+}
+
+}// namespace luisa::compute
@@ -0,0 +1,86 @@
+//
+// Created by Mike Smith on 2021/3/7.
+//
+
+#pragma once
+
+#include <span>
+#include <vector>
+#include <cstring>
+
+#include <core/concepts.h>
+#include <ast/function.h>
+
+namespace luisa::compute {
+
+// Launch arguments are packed into one block, laid out once per kernel in the
+// order of captured buffers, textures, bindless arrays and uniforms, followed
+// by the explicit arguments. Buffers are encoded as {handle, offset in bytes},
+// textures as {handle, level}, bindless arrays as handles and uniforms as their
+// bytes; backends turn the pairs into whatever their kernels address.
+class ArgumentLayout {
+
+public:
+    static constexpr auto alignment = static_cast<size_t>(16u);
+
+    struct Entry {
+        Variable variable;
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    struct BufferArgument {
+        uint64_t handle;
+        uint64_t offset_bytes;
+    };
+
+    struct TextureArgument {
+        uint64_t handle;
+        uint32_t level;
+    };
+
+private:
+    struct UniformCapture {
+        const void *data;
+        uint32_t offset;
+        uint32_t size;
+    };
+
+private:
+    std::vector<Entry> _entries;
+    std::vector<std::byte> _captures;// the block with captured resources encoded
+    std::vector<UniformCapture> _uniform_captures;
+    size_t _size{0u};
+    size_t _capture_count{0u};
+
+private:
+    const Entry &_add(Variable v) noexcept;
+
+public:
+    explicit ArgumentLayout(Function kernel) noexcept;
+    [[nodiscard]] auto size() const noexcept { return _size; }
+    [[nodiscard]] std::span<const Entry> entries() const noexcept { return _entries; }
+    [[nodiscard]] auto capture_count() const noexcept { return _capture_count; }
+
+    // captured uniforms are read from host memory at every launch
+    void encode_captures(std::byte *block) const noexcept {
+        std::memcpy(block, _captures.data(), _size);
+        for (auto &&u : _uniform_captures) { std::memcpy(block + u.offset, u.data, u.size); }
+    }
+
+    static void encode_buffer(std::byte *p, uint64_t handle, size_t offset_bytes) noexcept {
+        BufferArgument buffer{handle, offset_bytes};
+        std::memcpy(p, &buffer, sizeof(buffer));
+    }
+
+    static void encode_texture(std::byte *p, uint64_t handle, uint32_t level) noexcept {
+        TextureArgument texture{handle, level};
+        std::memcpy(p, &texture, sizeof(texture));
+    }
+
+    static void encode_bindless_array(std::byte *p, uint64_t handle) noexcept {
+        std::memcpy(p, &handle, sizeof(handle));
+    }
+};
+
+}// namespace luisa::compute
@@ -0,0 +1,145 @@
+//
+// Created by Mike Smith on 2021/3/5.
+//
+
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include <core/logging.h>
+#include <core/concepts.h>
+#include <runtime/device.h>
+#include <runtime/buffer.h>
+#include <runtime/texture.h>
+
+namespace luisa::compute {
+
+class BindlessArrayUpdateCommand {
+
+public:
+    struct Modification {
+        enum struct Kind : uint32_t {
+            EMPTY,
+            BUFFER,
+            TEXTURE
+        };
+        uint32_t slot;
+        Kind kind;
+        uint64_t handle;
+        size_t offset_bytes;// for buffers
+        uint32_t level;     // for textures
+    };
+
+private:
+    uint64_t _handle;
+    std::vector<Modification> _modifications;
+
+private:
+    friend class BindlessArray;
+    friend class CompositeStream;
+    BindlessArrayUpdateCommand(uint64_t handle, std::vector<Modification> modifications) noexcept
+        : _handle{handle}, _modifications{std::move(modifications)} {}
+
+public:
+    [[nodiscard]] auto handle() const noexcept { return _handle; }
+    [[nodiscard]] std::span<const Modification> modifications() const noexcept { return _modifications; }
+};
+
+// A fixed-size table of buffer and texture views that kernels index
+// dynamically. Kernels bind the array once, and update() only ships the
+// slots changed since the last update to the device.
+class BindlessArray : public concepts::Noncopyable {
+
+public:
+    using Slot = BindlessArrayUpdateCommand::Modification;
+
+private:
+    Device *_device;
+    uint64_t _handle;
+    std::vector<Slot> _slots;
+    std::vector<uint32_t> _dirty_slots;
+    std::vector<bool> _dirty;
+
+private:
+    void _set(Slot slot) noexcept {
+        if (slot.slot >= _slots.size()) {
+            LUISA_ERROR_WITH_LOCATION("Bindless array slot {} out of range [0, {}).", slot.slot, _slots.size());
+        }
+        _slots[slot.slot] = slot;
+        if (!_dirty[slot.slot]) {
+            _dirty[slot.slot] = true;
+            _dirty_slots.emplace_back(slot.slot);
+        }
+    }
+
+public:
+    BindlessArray(Device *device, size_t size) noexcept
+        : _device{device},
+          _handle{device->_create_bindless_array(size)},
+          _dirty(size, false) {
+        _slots.reserve(size);
+        for (auto i = 0u; i < size; i++) {
+            _slots.emplace_back(Slot{i, Slot::Kind::EMPTY, 0u, 0u, 0u});
+        }
+    }
+
+    BindlessArray(BindlessArray &&another) noexcept
+        : _device{another._device},
+          _handle{another._handle},
+          _slots{std::move(another._slots)},
+          _dirty_slots{std::move(another._dirty_slots)},
+          _dirty{std::move(another._dirty)} { another._device = nullptr; }
+
+    BindlessArray &operator=(BindlessArray &&rhs) noexcept {
+        if (&rhs != this) {
+            if (_device != nullptr) { _device->_dispose_bindless_array(_handle); }
+            _device = rhs._device;
+            _handle = rhs._handle;
+            _slots = std::move(rhs._slots);
+            _dirty_slots = std::move(rhs._dirty_slots);
+            _dirty = std::move(rhs._dirty);
+            rhs._device = nullptr;
+        }
+        return *this;
+    }
+
+    ~BindlessArray() noexcept {
+        if (_device != nullptr /* not moved */) { _device->_dispose_bindless_array(_handle); }
+    }
+
+    [[nodiscard]] auto device() const noexcept { return _device; }
+    [[nodiscard]] auto handle() const noexcept { return _handle; }
+    [[nodiscard]] auto size() const noexcept { return _slots.size(); }
+    [[nodiscard]] auto dirty_count() const noexcept { return _dirty_slots.size(); }
+    [[nodiscard]] const Slot &slot(size_t index) const noexcept { return _slots[index]; }
+
+    template<typename T>
+    BindlessArray &emplace(uint32_t slot, BufferView<T> view) noexcept {
+        _set(Slot{slot, Slot::Kind::BUFFER, view.handle(), view.offset_bytes(), 0u});
+        return *this;
+    }
+
+    BindlessArray &emplace(uint32_t slot, TextureView view) noexcept {
+        _set(Slot{slot, Slot::Kind::TEXTURE, view.handle(), 0u, view.level()});
+        return *this;
+    }
+
+    BindlessArray &remove(uint32_t slot) noexcept {
+        _set(Slot{slot, Slot::Kind::EMPTY, 0u, 0u, 0u});
+        return *this;
+    }
+
+    [[nodiscard]] auto update() noexcept {
+        std::vector<Slot> modifications;
+        modifications.reserve(_dirty_slots.size());
+        for (auto s : _dirty_slots) {
+            modifications.emplace_back(_slots[s]);
+            _dirty[s] = false;
+        }
+        _dirty_slots.clear();
+        return BindlessArrayUpdateCommand{_handle, std::move(modifications)};
+    }
+};
+
+}// namespace luisa::compute
@@ -9,6 +9,7 @@
 #include <limits>
 #include <span>
 #include <utility>
+#include <filesystem>
 #include <type_traits>
 
 #include <core/logging.h>
@@ -16,6 +17,7 @@
 #include <core/data_types.h>
 
 #include <runtime/device.h>
+#include <runtime/buffer_heap.h>
 
 namespace luisa::compute {
 
@@ -32,6 +34,17 @@ private:
     Device *_device;
     uint64_t _handle;
     size_t _size;
+    BufferHeap *_heap{nullptr};
+    size_t _offset_bytes{0u};
+
+private:
+    void _dispose() noexcept {
+        if (_heap != nullptr) {
+            _heap->free({_handle, _offset_bytes, _size * sizeof(T)});
+        } else {
+            _device->_dispose_buffer(_handle);
+        }
+    }
 
 public:
     Buffer(Device *device, size_t size) noexcept
@@ -44,29 +57,56 @@ public:
           _handle{device->_create_buffer_with_data(span.size_bytes(), span.data())},
           _size{span.size()} {}
 
+    // elements [offset, offset + size) of a binary file, clamped to the end of the file
+    Buffer(Device *device, const std::filesystem::path &path,
+           size_t offset = 0u, size_t size = std::numeric_limits<size_t>::max()) noexcept
+        : _device{device}, _handle{}, _size{} {
+        std::error_code error;
+        auto file_size = std::filesystem::file_size(path, error);
+        if (error) { LUISA_ERROR_WITH_LOCATION("Failed to open file '{}': {}.", path.string(), error.message()); }
+        auto file_elements = static_cast<size_t>(file_size / sizeof(T));
+        if (offset > file_elements) {
+            LUISA_ERROR_WITH_LOCATION(
+                "Offset {} is out of range for file '{}' with {} elements.",
+                offset, path.string(), file_elements);
+        }
+        _size = std::min(size, file_elements - offset);
+        _handle = device->_create_buffer_from_file(path, offset * sizeof(T), _size * sizeof(T));
+    }
+
+    // sub-allocated from the heap, viewed as (handle, offset) into a backing block
+    Buffer(BufferHeap &heap, size_t size) noexcept
+        : _device{heap.device()}, _handle{}, _size{size}, _heap{&heap} {
+        auto allocation = heap.allocate(size * sizeof(T));
+        _handle = allocation.handle;
+        _offset_bytes = allocation.offset_bytes;
+    }
+
     Buffer(Buffer &&another) noexcept
         : _device{another._device},
           _handle{another._handle},
-          _size{another._handle} { another._device = nullptr; }
+          _size{another._size},
+          _heap{another._heap},
+          _offset_bytes{another._offset_bytes} { another._device = nullptr; }
 
     Buffer &operator=(Buffer &&rhs) noexcept {
         if (&rhs != this) {
-            _device->_dispose_buffer(_handle);
+            if (_device != nullptr) { _dispose(); }
             _device = rhs._device;
             _handle = rhs._handle;
-            _size = rhs._handle;
+            _size = rhs._size;
+            _heap = rhs._heap;
+            _offset_bytes = rhs._offset_bytes;
             rhs._device = nullptr;
         }
         return *this;
     }
 
     ~Buffer() noexcept {
-        if (_device != nullptr /* not moved */) {
-            _device->_dispose_buffer(_handle);
-        }
+        if (_device != nullptr /* not moved */) { _dispose(); }
     }
 
-    [[nodiscard]] auto view() const noexcept { return BufferView<T>{_device, _handle, 0u, _size}; }
+    [[nodiscard]] auto view() const noexcept { return BufferView<T>{_device, _handle, _offset_bytes, _size}; }
 
     template<typename Index>
     [[nodiscard]] decltype(auto) operator[](Index &&index) const noexcept { return view()[std::forward<Index>(index)]; }
@@ -87,6 +127,9 @@ private:
     const void *_data;
 
 private:
+    template<typename> friend class BufferView;
+    friend class Device;
+    friend class CompositeStream;
     BufferUploadCommand(uint64_t handle, size_t offset_bytes, size_t size_bytes, const void *data) noexcept
         : _handle{handle}, _offset{offset_bytes}, _size{size_bytes}, _data{data} {}
 
@@ -106,6 +149,8 @@ private:
     void *_data;
 
 private:
+    template<typename> friend class BufferView;
+    friend class CompositeStream;
     BufferDownloadCommand(uint64_t handle, size_t offset_bytes, size_t size_bytes, void *data) noexcept
         : _handle{handle}, _offset{offset_bytes}, _size{size_bytes}, _data{data} {}
 
@@ -126,6 +171,8 @@ private:
     size_t _size;
 
 private:
+    template<typename> friend class BufferView;
+    friend class CompositeStream;
     BufferCopyCommand(uint64_t src, uint64_t dst, size_t src_offset, size_t dst_offset, size_t size) noexcept
         : _src_handle{src}, _dst_handle{dst}, _src_offset{src_offset}, _dst_offset{dst_offset}, _size{size} {}
 
@@ -157,6 +204,7 @@ private:
 
 protected:
     friend class Buffer<T>;
+    friend class TransientHeap;
     BufferView(Device *device, uint64_t handle, size_t offset_bytes, size_t size) noexcept
         : _device{device}, _handle{handle}, _offset_bytes{offset_bytes}, _size{size} {
         if (_offset_bytes % alignof(T) != 0u) {
@@ -176,7 +224,7 @@ public:
     [[nodiscard]] auto size_bytes() const noexcept { return _size * sizeof(T); }
 
     [[nodiscard]] auto subview(size_t offset_elements, size_t size_elements) const noexcept {
-        if (size_elements * sizeof(T) + offset_elements > _size) {
+        if (offset_elements + size_elements > _size) {
             LUISA_ERROR_WITH_LOCATION(
                 "Subview (with offset_elements = {}, size_elements = {}) overflows buffer view (with size_elements = {}).",
                 offset_elements, size_elements, _size);
@@ -201,14 +249,14 @@ public:
                 "Invalid host pointer {} for elements with alignment {}.",
                 fmt::ptr(data), alignof(T));
         }
-        BufferDownloadCommand{_handle, offset_bytes(), size_bytes(), data};
+        return BufferDownloadCommand{_handle, offset_bytes(), size_bytes(), data};
     }
 
-    [[nodiscard]] auto upload(const T *data) {
+    [[nodiscard]] auto upload(const T *data) const {
         return BufferUploadCommand{this->handle(), this->offset_bytes(), this->size_bytes(), data};
     }
 
-    [[nodiscard]] auto copy(BufferView<T> source) {
+    [[nodiscard]] auto copy(BufferView<T> source) const {
         if (source.device() != this->device()) {
             LUISA_ERROR_WITH_LOCATION("Incompatible buffer views created on different devices.");
         }
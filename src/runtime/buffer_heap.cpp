@@ -0,0 +1,153 @@
+//
+// Created by Mike Smith on 2021/3/2.
+//
+
+#include <bit>
+#include <algorithm>
+
+#include <core/logging.h>
+#include <core/mathematics.h>
+#include <runtime/buffer_heap.h>
+
+namespace luisa::compute {
+
+BufferHeap::BufferHeap(Device *device, size_t block_size) noexcept
+    : _device{device},
+      _block_size{next_pow2(std::max(block_size, min_allocation_size))},
+      _max_order{static_cast<uint32_t>(std::countr_zero(_block_size / min_allocation_size))} {}
+
+BufferHeap::~BufferHeap() noexcept {
+    for (auto &&block : _blocks) { _device->_dispose_buffer(block.handle); }
+    for (auto [handle, size] : _dedicated) { _device->_dispose_buffer(handle); }
+}
+
+uint32_t BufferHeap::_order(size_t size_bytes) const noexcept {
+    auto n = next_pow2(std::max(size_bytes, min_allocation_size));
+    return static_cast<uint32_t>(std::countr_zero(n / min_allocation_size));
+}
+
+size_t BufferHeap::_create_block() noexcept {
+    auto index = _blocks.size();
+    auto &&block = _blocks.emplace_back(Block{_device->_create_buffer(_block_size), 0u, {}});
+    block.free_lists.resize(_max_order + 1u);
+    block.free_lists.back().emplace(0u);
+    _block_indices.emplace(block.handle, index);
+    LUISA_VERBOSE_WITH_LOCATION(
+        "Created backing block #{} (handle = {}, size = {}) for buffer heap.",
+        index, block.handle, _block_size);
+    return index;
+}
+
+void BufferHeap::_dispose_block(size_t index) noexcept {
+    auto handle = _blocks[index].handle;
+    _device->_dispose_buffer(handle);
+    _block_indices.erase(handle);
+    if (index + 1u != _blocks.size()) {
+        _blocks[index] = std::move(_blocks.back());
+        _block_indices[_blocks[index].handle] = index;
+    }
+    _blocks.pop_back();
+}
+
+bool BufferHeap::_try_allocate(Block &block, uint32_t order, size_t &offset) noexcept {
+    auto k = order;
+    while (k <= _max_order && block.free_lists[k].empty()) { k++; }
+    if (k > _max_order) { return false; }
+    auto &&free_list = block.free_lists[k];
+    auto p = *free_list.cbegin();
+    free_list.erase(free_list.cbegin());
+    while (k > order) {// split down, keeping the lower half
+        k--;
+        block.free_lists[k].emplace(p + _order_size(k));
+    }
+    block.allocated_bytes += _order_size(order);
+    offset = p;
+    return true;
+}
+
+BufferHeap::Allocation BufferHeap::allocate(size_t size_bytes) noexcept {
+    if (size_bytes == 0u) { LUISA_ERROR_WITH_LOCATION("Allocating empty buffer from heap."); }
+    auto order = _order(size_bytes);
+    std::scoped_lock lock{_mutex};
+    if (order > _max_order) {
+        auto handle = _device->_create_buffer(size_bytes);
+        _dedicated.emplace(handle, size_bytes);
+        return Allocation{handle, 0u, size_bytes};
+    }
+    size_t offset = 0u;
+    auto iter = std::find_if(_blocks.begin(), _blocks.end(), [&](auto &&block) noexcept {
+        return _try_allocate(block, order, offset);
+    });
+    auto index = static_cast<size_t>(iter - _blocks.begin());
+    if (iter == _blocks.end()) {
+        index = _create_block();
+        if (!_try_allocate(_blocks[index], order, offset)) {
+            LUISA_ERROR_WITH_LOCATION("Failed to allocate {} bytes from a fresh heap block.", size_bytes);
+        }
+    }
+    _allocation_count++;
+    _requested_bytes += size_bytes;
+    return Allocation{_blocks[index].handle, offset, size_bytes};
+}
+
+void BufferHeap::free(Allocation allocation) noexcept {
+    std::scoped_lock lock{_mutex};
+    if (auto iter = _dedicated.find(allocation.handle); iter != _dedicated.end()) {
+        _device->_dispose_buffer(allocation.handle);
+        _dedicated.erase(iter);
+        return;
+    }
+    auto index_iter = _block_indices.find(allocation.handle);
+    if (index_iter == _block_indices.end()) {
+        LUISA_ERROR_WITH_LOCATION(
+            "Freeing buffer (handle = {}) not allocated from this heap.",
+            allocation.handle);
+    }
+    auto index = index_iter->second;
+    auto &&block = _blocks[index];
+    auto order = _order(allocation.size_bytes);
+    auto offset = allocation.offset_bytes;
+    block.allocated_bytes -= _order_size(order);
+    while (order < _max_order) {// merge with free buddies
+        auto &&free_list = block.free_lists[order];
+        auto buddy = free_list.find(offset ^ _order_size(order));
+        if (buddy == free_list.end()) { break; }
+        offset = std::min(offset, *buddy);
+        free_list.erase(buddy);
+        order++;
+    }
+    block.free_lists[order].emplace(offset);
+    _allocation_count--;
+    _requested_bytes -= allocation.size_bytes;
+
+    // keep a single empty block around for reuse, release the others
+    if (block.allocated_bytes == 0u &&
+        std::count_if(_blocks.cbegin(), _blocks.cend(), [](auto &&b) noexcept { return b.allocated_bytes == 0u; }) > 1) {
+        _dispose_block(index);
+    }
+}
+
+BufferHeap::Statistics BufferHeap::statistics() const noexcept {
+    std::scoped_lock lock{_mutex};
+    Statistics stats{};
+    stats.block_count = _blocks.size();
+    stats.dedicated_count = _dedicated.size();
+    stats.allocation_count = _allocation_count;
+    stats.reserved_bytes = _blocks.size() * _block_size;
+    stats.requested_bytes = _requested_bytes;
+    for (auto &&block : _blocks) {
+        stats.allocated_bytes += block.allocated_bytes;
+        for (auto order = _max_order + 1u; order != 0u; order--) {
+            if (!block.free_lists[order - 1u].empty()) {
+                stats.largest_free_bytes = std::max(stats.largest_free_bytes, _order_size(order - 1u));
+                break;
+            }
+        }
+    }
+    stats.free_bytes = stats.reserved_bytes - stats.allocated_bytes;
+    stats.internal_fragmentation = stats.allocated_bytes == 0u ? 0.0 : 1.0 - static_cast<double>(stats.requested_bytes) / static_cast<double>(stats.allocated_bytes);
+    stats.external_fragmentation = stats.free_bytes == 0u ? 0.0 : 1.0 - static_cast<double>(stats.largest_free_bytes) / static_cast<double>(stats.free_bytes);
+    return stats;
+}
+
+}// namespace luisa::compute
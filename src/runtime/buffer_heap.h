@@ -0,0 +1,86 @@
+//
+// Created by Mike Smith on 2021/3/2.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <vector>
+#include <unordered_map>
+
+#include <core/concepts.h>
+#include <runtime/device.h>
+
+namespace luisa::compute {
+
+// Buddy allocator that sub-allocates small buffers from large backing
+// buffers created by the device, so that thousands of small Buffer<T>s
+// only cost a handful of device allocations.
+class BufferHeap : public concepts::Noncopyable {
+
+public:
+    static constexpr auto min_allocation_size = static_cast<size_t>(256u);
+    static constexpr auto default_block_size = static_cast<size_t>(64ul * 1024ul * 1024ul);
+
+    struct Allocation {
+        uint64_t handle;
+        size_t offset_bytes;
+        size_t size_bytes;
+    };
+
+    struct Statistics {
+        size_t block_count;         // backing buffers owned by the heap
+        size_t dedicated_count;     // requests too large for a block, allocated directly
+        size_t allocation_count;    // live sub-allocations
+        size_t reserved_bytes;      // total size of the backing buffers
+        size_t requested_bytes;     // sum of the sizes asked for by live sub-allocations
+        size_t allocated_bytes;     // sum of the power-of-two blocks handed out
+        size_t free_bytes;          // reserved_bytes - allocated_bytes
+        size_t largest_free_bytes;  // largest single free block
+        double internal_fragmentation;// 1 - requested / allocated
+        double external_fragmentation;// 1 - largest_free / free
+    };
+
+private:
+    struct Block {
+        uint64_t handle;
+        size_t allocated_bytes;
+        std::vector<std::set<size_t>> free_lists;// free offsets, indexed by order
+    };
+
+private:
+    Device *_device;
+    size_t _block_size;
+    uint32_t _max_order;
+    std::vector<Block> _blocks;
+    std::unordered_map<uint64_t, size_t> _block_indices;
+    std::unordered_map<uint64_t, size_t> _dedicated;
+    size_t _allocation_count{0u};
+    size_t _requested_bytes{0u};
+    mutable std::mutex _mutex;
+
+private:
+    [[nodiscard]] uint32_t _order(size_t size_bytes) const noexcept;
+    [[nodiscard]] size_t _order_size(uint32_t order) const noexcept { return min_allocation_size << order; }
+    [[nodiscard]] size_t _create_block() noexcept;
+    [[nodiscard]] bool _try_allocate(Block &block, uint32_t order, size_t &offset) noexcept;
+    void _dispose_block(size_t index) noexcept;
+
+public:
+    explicit BufferHeap(Device *device, size_t block_size = default_block_size) noexcept;
+    BufferHeap(BufferHeap &&) noexcept = delete;
+    BufferHeap &operator=(BufferHeap &&) noexcept = delete;
+    ~BufferHeap() noexcept;
+
+    [[nodiscard]] auto device() const noexcept { return _device; }
+    [[nodiscard]] auto block_size() const noexcept { return _block_size; }
+
+    [[nodiscard]] Allocation allocate(size_t size_bytes) noexcept;
+    void free(Allocation allocation) noexcept;
+    [[nodiscard]] Statistics statistics() const noexcept;
+};
+
+}// namespace luisa::compute
@@ -0,0 +1,54 @@
+//
+// Created by Mike Smith on 2021/3/8.
+//
+
+#include <algorithm>
+
+#include <runtime/compile_service.h>
+
+namespace luisa::compute {
+
+void CompileService::enqueue(std::function<void()> task) noexcept {
+    {
+        std::scoped_lock lock{_mutex};
+        if (!_stopping) {
+            _queue.emplace_back(std::move(task));
+            if (_workers.empty()) {
+                auto worker_count = std::clamp(std::thread::hardware_concurrency() / 2u, 1u, 4u);
+                for (auto i = 0u; i < worker_count; i++) {
+                    _workers.emplace_back([this] {
+                        for (;;) {
+                            std::function<void()> task;
+                            {
+                                std::unique_lock lock{_mutex};
+                                _cv.wait(lock, [this] { return _stopping || !_queue.empty(); });
+                                if (_queue.empty()) { return; }
+                                task = std::move(_queue.front());
+                                _queue.pop_front();
+                            }
+                            task();
+                        }
+                    });
+                }
+            }
+            task = nullptr;
+        }
+    }
+    if (task) {
+        task();
+    } else {
+        _cv.notify_one();
+    }
+}
+
+CompileService::~CompileService() noexcept {
+    {
+        std::scoped_lock lock{_mutex};
+        _stopping = true;
+    }
+    _cv.notify_all();
+    // workers drain the queue before exiting, so no future is left unsatisfied
+    for (auto &&worker : _workers) { worker.join(); }
+}
+
+}// namespace luisa::compute
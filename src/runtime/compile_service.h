@@ -0,0 +1,37 @@
+//
+// Created by Mike Smith on 2021/3/8.
+//
+
+#pragma once
+
+#include <mutex>
+#include <deque>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+#include <core/concepts.h>
+
+namespace luisa::compute {
+
+// Background workers for Device::compile_async, spawned on the first request. Backends own
+// the service as their last-declared member, so it is destroyed, draining the queue and
+// joining the workers, before the state the queued compilations call into.
+class CompileService : public concepts::Noncopyable {
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::deque<std::function<void()>> _queue;
+    std::vector<std::thread> _workers;
+    bool _stopping{false};
+
+public:
+    CompileService() noexcept = default;
+    ~CompileService() noexcept;
+    // runs the task on a worker, or on the calling thread once the service is shutting down
+    void enqueue(std::function<void()> task) noexcept;
+};
+
+}// namespace luisa::compute
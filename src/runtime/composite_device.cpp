@@ -0,0 +1,349 @@
+//
+// Created by Mike Smith on 2021/3/10.
+//
+
+#include <cstring>
+#include <algorithm>
+
+#include <core/logging.h>
+#include <ast/function.h>
+#include <runtime/buffer.h>
+#include <runtime/texture.h>
+#include <runtime/bindless_array.h>
+#include <runtime/kernel.h>
+#include <runtime/composite_device.h>
+
+namespace luisa::compute {
+
+CompositeDevice::CompositeDevice(std::vector<Device *> children, Context *context) noexcept
+    : Device{context}, _children{std::move(children)} {
+    if (_children.empty()) { LUISA_ERROR_WITH_LOCATION("Composite device without children."); }
+}
+
+uint64_t CompositeDevice::_create_buffer(size_t size_bytes) noexcept {
+    // replicas must start out equal to the shadow, or the gather would mistake garbage for writes
+    std::vector<std::byte> zeros(size_bytes);
+    return _create_buffer_with_data(size_bytes, zeros.data());
+}
+
+uint64_t CompositeDevice::_create_buffer_with_data(size_t size_bytes, const void *data) noexcept {
+    auto buffer = std::make_unique<BufferReplicas>();
+    buffer->shadow.resize(size_bytes);
+    std::memcpy(buffer->shadow.data(), data, size_bytes);
+    for (auto child : _children) { buffer->handles.emplace_back(child->_create_buffer_with_data(size_bytes, data)); }
+    std::scoped_lock lock{_mutex};
+    _buffers.emplace_back(std::move(buffer));
+    return _buffers.size();// non-zero, as bindless arrays mark empty slots with 0
+}
+
+void CompositeDevice::_dispose_buffer(uint64_t handle) noexcept {
+    std::unique_ptr<BufferReplicas> buffer;
+    {
+        std::scoped_lock lock{_mutex};
+        buffer = std::move(_buffers[handle - 1u]);
+    }
+    for (auto i = 0u; i < _children.size(); i++) { _children[i]->_dispose_buffer(buffer->handles[i]); }
+}
+
+uint64_t CompositeDevice::_create_texture(
+    PixelFormat format, uint32_t dimension,
+    uint32_t width, uint32_t height, uint32_t depth,
+    uint32_t mipmap_levels) noexcept {
+    auto texture = std::make_unique<TextureReplicas>();
+    for (auto child : _children) {
+        texture->handles.emplace_back(child->_create_texture(format, dimension, width, height, depth, mipmap_levels));
+    }
+    std::scoped_lock lock{_mutex};
+    _textures.emplace_back(std::move(texture));
+    return _textures.size() - 1u;
+}
+
+void CompositeDevice::_dispose_texture(uint64_t handle) noexcept {
+    std::unique_ptr<TextureReplicas> texture;
+    {
+        std::scoped_lock lock{_mutex};
+        texture = std::move(_textures[handle]);
+    }
+    for (auto i = 0u; i < _children.size(); i++) { _children[i]->_dispose_texture(texture->handles[i]); }
+}
+
+uint64_t CompositeDevice::_create_bindless_array(size_t size) noexcept {
+    auto array = std::make_unique<BindlessArrayReplicas>();
+    array->buffers.resize(size, 0u);
+    for (auto child : _children) { array->handles.emplace_back(child->_create_bindless_array(size)); }
+    std::scoped_lock lock{_mutex};
+    _bindless_arrays.emplace_back(std::move(array));
+    return _bindless_arrays.size() - 1u;
+}
+
+void CompositeDevice::_dispose_bindless_array(uint64_t handle) noexcept {
+    std::unique_ptr<BindlessArrayReplicas> array;
+    {
+        std::scoped_lock lock{_mutex};
+        array = std::move(_bindless_arrays[handle]);
+    }
+    for (auto i = 0u; i < _children.size(); i++) { _children[i]->_dispose_bindless_array(array->handles[i]); }
+}
+
+uint64_t CompositeDevice::_compile_kernel(Function kernel) noexcept {
+    auto replicas = std::make_unique<KernelReplicas>();
+    replicas->layout = std::make_unique<ArgumentLayout>(kernel);
+    auto entries = replicas->layout->entries();
+    auto written = kernel.written_resources();
+    for (auto i = 0u; i < entries.size(); i++) {
+        if (std::any_of(written.begin(), written.end(), [v = entries[i].variable](auto w) noexcept { return w.uid() == v.uid(); })) {
+            replicas->written.emplace_back(i);
+        }
+    }
+    for (auto child : _children) { replicas->handles.emplace_back(child->compile(kernel)); }
+    std::scoped_lock lock{_mutex};
+    _kernels.emplace_back(std::move(replicas));
+    return _kernels.size() - 1u;
+}
+
+std::unique_ptr<Stream> CompositeDevice::create_stream() noexcept {
+    return std::make_unique<CompositeStream>(this);
+}
+
+CompositeDevice::BufferReplicas &CompositeDevice::buffer(uint64_t handle) const noexcept {
+    std::scoped_lock lock{_mutex};
+    return *_buffers[handle - 1u];
+}
+
+CompositeDevice::TextureReplicas &CompositeDevice::texture(uint64_t handle) const noexcept {
+    std::scoped_lock lock{_mutex};
+    return *_textures[handle];
+}
+
+CompositeDevice::BindlessArrayReplicas &CompositeDevice::bindless_array(uint64_t handle) const noexcept {
+    std::scoped_lock lock{_mutex};
+    return *_bindless_arrays[handle];
+}
+
+const CompositeDevice::KernelReplicas &CompositeDevice::kernel(uint64_t handle) const noexcept {
+    std::scoped_lock lock{_mutex};
+    return *_kernels[handle];
+}
+
+CompositeStream::CompositeStream(CompositeDevice *device) noexcept
+    : _device{device} {
+    for (auto child : device->children()) { _streams.emplace_back(child->create_stream()); }
+    for (auto i = 1u; i < _streams.size(); i++) {
+        _workers.emplace_back([this, i] { _work(i); });
+    }
+}
+
+CompositeStream::~CompositeStream() noexcept {
+    {
+        std::scoped_lock lock{_worker_mutex};
+        _stopping = true;
+    }
+    _worker_cv.notify_all();
+    for (auto &&worker : _workers) { worker.join(); }
+}
+
+// submits the child's partition of each launch round, if the launch was split that far
+void CompositeStream::_work(size_t child) noexcept {
+    for (auto round = static_cast<uint64_t>(0u);;) {
+        KernelLaunchCommand *launch = nullptr;
+        {
+            std::unique_lock lock{_worker_mutex};
+            _worker_cv.wait(lock, [this, round] { return _stopping || _round != round; });
+            if (_stopping) { return; }
+            round = _round;
+            // children without a partition must not touch the launches, which may be gone when they wake up
+            if (child < _partition_count) { launch = &(*_launches)[child]; }
+        }
+        if (launch != nullptr) {
+            *_streams[child] << std::move(*launch);
+            std::scoped_lock lock{_worker_mutex};
+            if (--_remaining == 0u) { _done_cv.notify_one(); }
+        }
+    }
+}
+
+void CompositeStream::_dispatch(const BufferCopyCommand &command) {
+    auto &&src = _device->buffer(command.src_handle());
+    auto &&dst = _device->buffer(command.dst_handle());
+    std::memmove(dst.shadow.data() + command.dst_offset(), src.shadow.data() + command.src_offset(), command.size());
+    for (auto i = 0u; i < _streams.size(); i++) {
+        *_streams[i] << BufferCopyCommand{src.handles[i], dst.handles[i], command.src_offset(), command.dst_offset(), command.size()};
+    }
+}
+
+void CompositeStream::_dispatch(const BufferUploadCommand &command) {
+    auto &&buffer = _device->buffer(command.handle());
+    std::memcpy(buffer.shadow.data() + command.offset(), command.data(), command.size());
+    for (auto i = 0u; i < _streams.size(); i++) {
+        *_streams[i] << BufferUploadCommand{buffer.handles[i], command.offset(), command.size(), command.data()};
+    }
+}
+
+void CompositeStream::_dispatch(const BufferDownloadCommand &command) {
+    auto &&buffer = _device->buffer(command.handle());
+    std::memcpy(command.data(), buffer.shadow.data() + command.offset(), command.size());
+}
+
+void CompositeStream::_dispatch(const TextureCopyCommand &command) {
+    auto &&src = _device->texture(command.src_handle());
+    auto &&dst = _device->texture(command.dst_handle());
+    for (auto i = 0u; i < _streams.size(); i++) {
+        *_streams[i] << TextureCopyCommand{src.handles[i], dst.handles[i], command.src_level(), command.dst_level(), command.size()};
+    }
+}
+
+void CompositeStream::_dispatch(const TextureUploadCommand &command) {
+    auto &&texture = _device->texture(command.handle());
+    for (auto i = 0u; i < _streams.size(); i++) {
+        *_streams[i] << TextureUploadCommand{texture.handles[i], command.level(), command.offset(), command.size(), command.data()};
+    }
+}
+
+void CompositeStream::_dispatch(const TextureDownloadCommand &command) {
+    auto &&texture = _device->texture(command.handle());
+    *_streams.front() << TextureDownloadCommand{texture.handles.front(), command.level(), command.offset(), command.size(), command.data()};
+}
+
+void CompositeStream::_dispatch(const BindlessArrayUpdateCommand &command) {
+    auto &&array = _device->bindless_array(command.handle());
+    for (auto &&m : command.modifications()) {
+        array.buffers[m.slot] = m.kind == BindlessArrayUpdateCommand::Modification::Kind::BUFFER ? m.handle : 0u;
+    }
+    for (auto i = 0u; i < _streams.size(); i++) {
+        std::vector<BindlessArrayUpdateCommand::Modification> modifications{command.modifications().begin(), command.modifications().end()};
+        for (auto &&m : modifications) {
+            using Kind = BindlessArrayUpdateCommand::Modification::Kind;
+            if (m.kind == Kind::BUFFER) {
+                m.handle = _device->buffer(m.handle).handles[i];
+            } else if (m.kind == Kind::TEXTURE) {
+                m.handle = _device->texture(m.handle).handles[i];
+            }
+        }
+        *_streams[i] << BindlessArrayUpdateCommand{array.handles[i], std::move(modifications)};
+    }
+}
+
+void CompositeStream::_dispatch(const KernelLaunchCommand &command) {
+
+    auto &&kernel = _device->kernel(command.handle());
+    auto arguments = command.arguments();
+
+    // buffers the kernel writes, directly or through bindless arrays
+    std::vector<uint64_t> buffers;
+    for (auto index : kernel.written) {
+        auto &&e = kernel.layout->entries()[index];
+        uint64_t value;
+        std::memcpy(&value, arguments.data() + e.offset, sizeof(value));
+        if (e.variable.tag() == Variable::Tag::BUFFER) {
+            buffers.emplace_back(value);
+        } else if (e.variable.tag() == Variable::Tag::BINDLESS_ARRAY) {
+            for (auto b : _device->bindless_array(value).buffers) {
+                if (b != 0u) { buffers.emplace_back(b); }
+            }
+        }
+    }
+    std::sort(buffers.begin(), buffers.end());
+    buffers.erase(std::unique(buffers.begin(), buffers.end()), buffers.end());
+
+    // split the blocks along the outermost axis with more than one block
+    auto block_offset = command.block_offset();
+    auto block_count = command.block_count();
+    auto axis = block_count.z > 1u ? 2u : (block_count.y > 1u ? 1u : 0u);
+    auto partition_count = std::min(static_cast<uint32_t>(_streams.size()), block_count[axis]);
+    std::vector<size_t> children;
+    std::vector<KernelLaunchCommand> launches;
+    for (auto i = 0u; i < partition_count; i++) {
+        auto begin = block_count[axis] * i / partition_count;
+        auto end = block_count[axis] * (i + 1u) / partition_count;
+        KernelLaunchCommand launch{kernel.handles[i], arguments.size()};
+        auto block = launch._arguments();
+        std::memcpy(block, arguments.data(), arguments.size());
+        for (auto &&e : kernel.layout->entries()) {
+            auto p = block + e.offset;
+            switch (e.variable.tag()) {
+                case Variable::Tag::BUFFER: {
+                    ArgumentLayout::BufferArgument buffer{};
+                    std::memcpy(&buffer, p, sizeof(buffer));
+                    ArgumentLayout::encode_buffer(p, _device->buffer(buffer.handle).handles[i], buffer.offset_bytes);
+                    break;
+                }
+                case Variable::Tag::TEXTURE: {
+                    ArgumentLayout::TextureArgument texture{};
+                    std::memcpy(&texture, p, sizeof(texture));
+                    ArgumentLayout::encode_texture(p, _device->texture(texture.handle).handles[i], texture.level);
+                    break;
+                }
+                case Variable::Tag::BINDLESS_ARRAY: {
+                    uint64_t value;
+                    std::memcpy(&value, p, sizeof(value));
+                    ArgumentLayout::encode_bindless_array(p, _device->bindless_array(value).handles[i]);
+                    break;
+                }
+                default: break;
+            }
+        }
+        launch._dispatch_size = command.dispatch_size();
+        launch._block_size = command.block_size();
+        launch._block_offset = block_offset;
+        launch._block_count = block_count;
+        launch._block_offset[axis] += begin;
+        launch._block_count[axis] = end - begin;
+        launches.emplace_back(std::move(launch));
+        children.emplace_back(i);
+    }
+
+    if (launches.size() == 1u) {
+        *_streams.front() << std::move(launches.front());
+    } else {
+        {
+            std::scoped_lock lock{_worker_mutex};
+            _launches = &launches;
+            _partition_count = launches.size();
+            _remaining = launches.size() - 1u;
+            _round++;
+        }
+        _worker_cv.notify_all();
+        *_streams.front() << std::move(launches.front());
+        std::unique_lock lock{_worker_mutex};
+        _done_cv.wait(lock, [this] { return _remaining == 0u; });
+        _launches = nullptr;
+        _partition_count = 0u;
+    }
+    for (auto b : buffers) { _gather(_device->buffer(b), children); }
+}
+
+// merges the bytes each child changed into the shadow and broadcasts the changed ranges;
+// the replicas are still downloaded in full, as only they know which bytes were written
+void CompositeStream::_gather(CompositeDevice::BufferReplicas &buffer, std::span<const size_t> children) noexcept {
+    static constexpr auto range_gap = static_cast<size_t>(256u);// changes closer than this share an upload
+    auto size = buffer.shadow.size();
+    auto merged = buffer.shadow;
+    std::vector<uint8_t> dirty(size, 0u);
+    std::vector<std::byte> replica(size);
+    for (auto i : children) {
+        *_streams[i] << BufferDownloadCommand{buffer.handles[i], 0u, size, replica.data()};
+        for (auto j = 0u; j < size; j++) {
+            if (replica[j] != buffer.shadow[j]) {
+                merged[j] = replica[j];
+                dirty[j] = 1u;
+            }
+        }
+    }
+    buffer.shadow = std::move(merged);
+    std::vector<std::pair<size_t, size_t>> ranges;
+    for (auto j = static_cast<size_t>(0u); j < size; j++) {
+        if (!dirty[j]) { continue; }
+        if (ranges.empty() || j > ranges.back().second + range_gap) {
+            ranges.emplace_back(j, j + 1u);
+        } else {
+            ranges.back().second = j + 1u;
+        }
+    }
+    for (auto i = 0u; i < _streams.size(); i++) {
+        for (auto [begin, end] : ranges) {
+            *_streams[i] << BufferUploadCommand{buffer.handles[i], begin, end - begin, buffer.shadow.data() + begin};
+        }
+    }
+}
+
+}// namespace luisa::compute
@@ -0,0 +1,120 @@
+//
+// Created by Mike Smith on 2021/3/10.
+//
+
+#pragma once
+
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <condition_variable>
+
+#include <runtime/device.h>
+#include <runtime/argument_layout.h>
+
+namespace luisa::compute {
+
+// Runs each dispatch on several child devices at once, splitting its blocks into
+// contiguous ranges along the outermost non-trivial axis.
+//
+// Buffers are replicated on every child and kept coherent through a host shadow:
+// after a launch, the bytes each child changed in the buffers the kernel writes are gathered
+// into the shadow and broadcast back, so kernels must write disjoint bytes across
+// partitions (atomics shared across partitions are not supported). Textures are
+// replicated too, but kernel writes to them are not gathered, and downloads read
+// the first child's copy.
+class CompositeDevice : public Device {
+
+public:
+    struct BufferReplicas {
+        std::vector<uint64_t> handles;
+        std::vector<std::byte> shadow;
+    };
+
+    struct TextureReplicas {
+        std::vector<uint64_t> handles;
+    };
+
+    struct BindlessArrayReplicas {
+        std::vector<uint64_t> handles;
+        std::vector<uint64_t> buffers;// composite buffer handle in each slot, 0 if none
+    };
+
+    struct KernelReplicas {
+        std::vector<uint64_t> handles;
+        std::unique_ptr<ArgumentLayout> layout;
+        std::vector<uint32_t> written;// layout entries of the buffers and bindless arrays the kernel writes
+    };
+
+private:
+    std::vector<Device *> _children;
+    mutable std::mutex _mutex;
+    std::vector<std::unique_ptr<BufferReplicas>> _buffers;
+    std::vector<std::unique_ptr<TextureReplicas>> _textures;
+    std::vector<std::unique_ptr<BindlessArrayReplicas>> _bindless_arrays;
+    std::vector<std::unique_ptr<KernelReplicas>> _kernels;
+    CompileService _compile_workers;// last, as queued compilations use the state above
+
+private:
+    void _dispose_buffer(uint64_t handle) noexcept override;
+    [[nodiscard]] uint64_t _create_buffer(size_t size_bytes) noexcept override;
+    [[nodiscard]] uint64_t _create_buffer_with_data(size_t size_bytes, const void *data) noexcept override;
+    [[nodiscard]] uint64_t _create_texture(
+        PixelFormat format, uint32_t dimension,
+        uint32_t width, uint32_t height, uint32_t depth,
+        uint32_t mipmap_levels) noexcept override;
+    void _dispose_texture(uint64_t handle) noexcept override;
+    [[nodiscard]] uint64_t _create_bindless_array(size_t size) noexcept override;
+    void _dispose_bindless_array(uint64_t handle) noexcept override;
+    [[nodiscard]] uint64_t _compile_kernel(Function kernel) noexcept override;
+    [[nodiscard]] CompileService *_compile_service() noexcept override { return &_compile_workers; }
+
+public:
+    explicit CompositeDevice(std::vector<Device *> children, Context *context = nullptr) noexcept;
+    [[nodiscard]] std::unique_ptr<Stream> create_stream() noexcept override;
+
+    [[nodiscard]] std::span<Device *const> children() const noexcept { return _children; }
+    [[nodiscard]] BufferReplicas &buffer(uint64_t handle) const noexcept;
+    [[nodiscard]] TextureReplicas &texture(uint64_t handle) const noexcept;
+    [[nodiscard]] BindlessArrayReplicas &bindless_array(uint64_t handle) const noexcept;
+    [[nodiscard]] const KernelReplicas &kernel(uint64_t handle) const noexcept;
+};
+
+class CompositeStream : public Stream {
+
+private:
+    CompositeDevice *_device;
+    std::vector<std::unique_ptr<Stream>> _streams;
+
+    // one worker per child but the first, whose partition runs on the calling thread
+    std::vector<std::thread> _workers;
+    std::mutex _worker_mutex;
+    std::condition_variable _worker_cv;
+    std::condition_variable _done_cv;
+    std::vector<KernelLaunchCommand> *_launches{nullptr};// only valid for children below _partition_count
+    size_t _partition_count{0u};
+    uint64_t _round{0u};
+    size_t _remaining{0u};
+    bool _stopping{false};
+
+private:
+    void _dispatch(const BufferCopyCommand &command) override;
+    void _dispatch(const BufferUploadCommand &command) override;
+    void _dispatch(const BufferDownloadCommand &command) override;
+    void _dispatch(const TextureCopyCommand &command) override;
+    void _dispatch(const TextureUploadCommand &command) override;
+    void _dispatch(const TextureDownloadCommand &command) override;
+    void _dispatch(const BindlessArrayUpdateCommand &command) override;
+    void _dispatch(const KernelLaunchCommand &command) override;
+
+    void _gather(CompositeDevice::BufferReplicas &buffer, std::span<const size_t> children) noexcept;
+    void _work(size_t child) noexcept;
+
+public:
+    explicit CompositeStream(CompositeDevice *device) noexcept;
+    ~CompositeStream() noexcept override;
+    [[nodiscard]] auto device() const noexcept { return _device; }
+};
+
+}// namespace luisa::compute
@@ -2,10 +2,99 @@
 // Created by Mike Smith on 2021/2/2.
 //
 
-#include "context.h"
+#include <atomic>
+#include <random>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+
+#include <core/logging.h>
+#include <runtime/context.h>
 
 namespace luisa::compute {
 
+Context::Context(std::filesystem::path cache_directory, size_t cache_capacity) noexcept
+    : _cache_directory{std::move(cache_directory)},
+      _cache_capacity{cache_capacity} {
+    std::error_code error;
+    std::filesystem::create_directories(_cache_directory, error);
+    if (error) {
+        LUISA_WARNING_WITH_LOCATION(
+            "Failed to create cache directory '{}', kernel cache disabled: {}.",
+            _cache_directory.string(), error.message());
+        _cache_directory.clear();
+    }
+}
+
+MappedFile Context::load_cache(std::string_view key) noexcept {
+    if (!cache_enabled()) { return {}; }
+    auto path = _cache_directory / key;
+    MappedFile file{path};
+    if (!file.valid()) {
+        _cache_miss_count++;
+        return file;
+    }
+    // the modification time doubles as the last access time for eviction
+    std::error_code error;
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+    _cache_hit_count++;
+    return file;
+}
 
+void Context::store_cache(std::string_view key, std::span<const std::byte> data) noexcept {
+    if (!cache_enabled() || data.empty()) { return; }
+    auto path = _cache_directory / key;
+    // write to a unique temporary file and rename, so readers never see partial entries;
+    // the random nonce keeps processes sharing the cache directory apart
+    static const auto nonce = (static_cast<uint64_t>(std::random_device{}()) << 32u) | std::random_device{}();
+    static std::atomic<uint64_t> serial{0u};
+    auto temp_path = path;
+    temp_path += fmt::format(".{:016x}.{:x}.tmp", nonce, serial.fetch_add(1u, std::memory_order_relaxed));
+    {
+        std::ofstream file{temp_path, std::ios::binary | std::ios::trunc};
+        file.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+        if (!file) {
+            LUISA_WARNING_WITH_LOCATION("Failed to write cache entry '{}'.", temp_path.string());
+            return;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temp_path, path, error);
+    if (error) {
+        LUISA_WARNING_WITH_LOCATION("Failed to commit cache entry '{}': {}.", path.string(), error.message());
+        std::filesystem::remove(temp_path, error);
+        return;
+    }
+    _evict();
+}
 
+void Context::_evict() noexcept {
+    struct Entry {
+        std::filesystem::path path;
+        std::filesystem::file_time_type time;
+        size_t size;
+    };
+    std::scoped_lock lock{_cache_mutex};
+    std::vector<Entry> entries;
+    auto total_size = static_cast<size_t>(0u);
+    std::error_code error;
+    for (auto &&item : std::filesystem::directory_iterator{_cache_directory, error}) {
+        if (!item.is_regular_file(error) || item.path().extension() == ".tmp") { continue; }
+        auto size = item.file_size(error);
+        auto time = item.last_write_time(error);
+        if (error) { continue; }
+        entries.emplace_back(Entry{item.path(), time, size});
+        total_size += size;
+    }
+    if (total_size <= _cache_capacity) { return; }
+    std::sort(entries.begin(), entries.end(), [](auto &&lhs, auto &&rhs) noexcept { return lhs.time < rhs.time; });
+    for (auto &&e : entries) {
+        if (total_size <= _cache_capacity) { break; }
+        if (std::filesystem::remove(e.path, error)) {
+            total_size -= e.size;
+            _cache_eviction_count++;
+        }
+    }
 }
+
+}// namespace luisa::compute
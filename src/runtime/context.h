@@ -4,10 +4,51 @@
 
 #pragma once
 
+#include <span>
+#include <mutex>
+#include <atomic>
+#include <filesystem>
+#include <string_view>
+
+#include <core/concepts.h>
+#include <core/mapped_file.h>
+
 namespace luisa::compute {
 
-class Context {
+// Holds state shared by devices, currently the persistent kernel cache: a
+// directory of compiled kernels named by their keys. Entries are written
+// atomically and evicted least-recently-used first when the directory
+// grows beyond the capacity. Without a cache directory, caching is disabled.
+class Context : public concepts::Noncopyable {
+
+public:
+    static constexpr auto default_cache_capacity = static_cast<size_t>(1024u * 1024u * 1024u);
+
+private:
+    std::filesystem::path _cache_directory;
+    size_t _cache_capacity{default_cache_capacity};
+    std::mutex _cache_mutex;
+    std::atomic<size_t> _cache_hit_count{0u};
+    std::atomic<size_t> _cache_miss_count{0u};
+    std::atomic<size_t> _cache_eviction_count{0u};
+
+private:
+    void _evict() noexcept;
+
+public:
+    Context() noexcept = default;
+    explicit Context(std::filesystem::path cache_directory, size_t cache_capacity = default_cache_capacity) noexcept;
+
+    [[nodiscard]] const auto &cache_directory() const noexcept { return _cache_directory; }
+    [[nodiscard]] auto cache_capacity() const noexcept { return _cache_capacity; }
+    [[nodiscard]] auto cache_enabled() const noexcept { return !_cache_directory.empty(); }
+    [[nodiscard]] auto cache_hit_count() const noexcept { return _cache_hit_count.load(); }
+    [[nodiscard]] auto cache_miss_count() const noexcept { return _cache_miss_count.load(); }
+    [[nodiscard]] auto cache_eviction_count() const noexcept { return _cache_eviction_count.load(); }
 
+    // returns an invalid mapping on misses
+    [[nodiscard]] MappedFile load_cache(std::string_view key) noexcept;
+    void store_cache(std::string_view key, std::span<const std::byte> data) noexcept;
 };
 
-}
+}// namespace luisa::compute
@@ -2,4 +2,141 @@
 // Created by Mike Smith on 2020/12/2.
 //
 
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+
 #include "device.h"
+#include <ast/function.h>
+#include <ast/function_builder.h>
+#include <runtime/context.h>
+#include <runtime/buffer.h>
+
+namespace luisa::compute {
+
+uint64_t Device::compile(Function kernel) noexcept {
+    if (kernel.tag() != Function::Tag::KERNEL) { LUISA_ERROR_WITH_LOCATION("Compiling non-kernel function."); }
+    auto hash = kernel.hash();
+    std::promise<uint64_t> promise;
+    std::shared_future<uint64_t> pending;
+    {
+        std::scoped_lock lock{_kernel_cache_mutex};
+        if (auto iter = _kernel_cache.find(hash); iter != _kernel_cache.cend()) {
+            pending = iter->second;
+        } else {
+            _kernel_cache.emplace(hash, promise.get_future().share());
+        }
+    }
+    // identical kernels being compiled elsewhere are waited for rather than compiled twice
+    if (pending.valid()) { return pending.get(); }
+    auto handle = _compile_or_load_kernel(kernel, hash);
+    promise.set_value(handle);
+    return handle;
+}
+
+std::shared_future<uint64_t> Device::compile_async(std::shared_ptr<const FunctionBuilder> kernel) noexcept {
+    Function function{*kernel};
+    if (function.tag() != Function::Tag::KERNEL) { LUISA_ERROR_WITH_LOCATION("Compiling non-kernel function."); }
+    auto hash = function.hash();
+    auto promise = std::make_shared<std::promise<uint64_t>>();
+    std::shared_future<uint64_t> future;
+    {
+        std::scoped_lock lock{_kernel_cache_mutex};
+        if (auto iter = _kernel_cache.find(hash); iter != _kernel_cache.cend()) { return iter->second; }
+        future = _kernel_cache.emplace(hash, promise->get_future().share()).first->second;
+    }
+    auto task = [this, kernel = std::move(kernel), hash, promise, enqueue_time = std::chrono::steady_clock::now()] {
+        _compile_queue_latency.record(std::chrono::steady_clock::now() - enqueue_time);
+        promise->set_value(_compile_or_load_kernel(Function{*kernel}, hash));
+    };
+    if (auto service = _compile_service()) {
+        service->enqueue(std::move(task));
+    } else {
+        task();
+    }
+    return future;
+}
+
+uint64_t Device::_create_buffer_from_file(const std::filesystem::path &path, size_t offset_bytes, size_t size_bytes) noexcept {
+    std::ifstream file{path, std::ios::binary};
+    if (!file) { LUISA_ERROR_WITH_LOCATION("Failed to open file '{}'.", path.string()); }
+    auto handle = _create_buffer(size_bytes);
+    auto chunk_count = (size_bytes + file_upload_chunk_size - 1u) / file_upload_chunk_size;
+    std::array<std::vector<std::byte>, 2u> staging;
+    auto read_chunk = [&](size_t index) noexcept {
+        auto offset = index * file_upload_chunk_size;
+        auto &&chunk = staging[index % 2u];
+        chunk.resize(std::min(file_upload_chunk_size, size_bytes - offset));
+        file.seekg(static_cast<std::streamoff>(offset_bytes + offset));
+        file.read(reinterpret_cast<char *>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+        if (static_cast<size_t>(file.gcount()) != chunk.size()) {
+            LUISA_ERROR_WITH_LOCATION("Failed to read {} bytes at offset {} from file '{}'.", chunk.size(), offset_bytes + offset, path.string());
+        }
+    };
+    auto stream = create_stream();
+    if (chunk_count != 0u) { read_chunk(0u); }
+    for (auto i = static_cast<size_t>(0u); i < chunk_count; i++) {
+        std::future<void> next;
+        if (i + 1u < chunk_count) { next = std::async(std::launch::async, read_chunk, i + 1u); }
+        *stream << BufferUploadCommand{handle, i * file_upload_chunk_size, staging[i % 2u].size(), staging[i % 2u].data()};
+        if (next.valid()) { next.wait(); }
+    }
+    return handle;
+}
+
+std::optional<uint64_t> Device::_compile_fallback_kernel(Function) noexcept {
+    return std::nullopt;
+}
+
+std::optional<uint64_t> Device::compile_fallback(Function kernel) noexcept {
+    return _compile_fallback_kernel(kernel);
+}
+
+uint64_t Device::_compile_or_load_kernel(Function kernel, uint64_t hash) noexcept {
+    auto profiler = this->profiler();
+    auto begin = profiler == nullptr ? Profiler::Duration{} : profiler->now();
+    auto t0 = std::chrono::steady_clock::now();
+    auto handle = _compile_or_load_kernel_untimed(kernel, hash);
+    _compile_latency.record(std::chrono::steady_clock::now() - t0);
+    if (profiler != nullptr) { profiler->record_compilation(_profiler_lane, handle, begin); }
+    return handle;
+}
+
+void Device::set_profiler(Profiler *profiler, std::string name) noexcept {
+    if (profiler != nullptr) {
+        _profiler_lane = profiler->add_lane(std::move(name));
+        profiler->_track(this);
+    }
+    if (auto old = _profiler.exchange(profiler, std::memory_order_acq_rel);
+        old != nullptr && old != profiler) { old->_forget(this); }
+}
+
+uint64_t Device::_compile_or_load_kernel_untimed(Function kernel, uint64_t hash) noexcept {
+    auto tag = _kernel_cache_tag();
+    if (_context == nullptr || !_context->cache_enabled() || tag.empty()) {
+        LUISA_VERBOSE_WITH_LOCATION("Compiling kernel with hash {:016x}.", hash);
+        return _compile_kernel(kernel);
+    }
+    auto key = fmt::format("{}-{:016x}.bin", tag, hash);
+    if (auto file = _context->load_cache(key); file.valid()) {
+        if (auto handle = _load_kernel(std::move(file))) {
+            LUISA_VERBOSE_WITH_LOCATION("Loaded kernel '{}' from cache.", key);
+            return *handle;
+        }
+        LUISA_WARNING_WITH_LOCATION("Ignoring invalid kernel cache entry '{}'.", key);
+    }
+    LUISA_VERBOSE_WITH_LOCATION("Compiling kernel '{}'.", key);
+    auto handle = _compile_kernel(kernel);
+    if (auto blob = _serialize_kernel(handle); !blob.empty()) { _context->store_cache(key, blob); }
+    return handle;
+}
+
+size_t Device::compiled_kernel_count() noexcept {
+    std::scoped_lock lock{_kernel_cache_mutex};
+    return std::count_if(_kernel_cache.cbegin(), _kernel_cache.cend(), [](auto &&item) noexcept {
+        return item.second.wait_for(std::chrono::seconds{0}) == std::future_status::ready;
+    });
+}
+
+}// namespace luisa::compute
@@ -7,22 +7,112 @@
 #include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <future>
+#include <vector>
+#include <optional>
+#include <filesystem>
+#include <string_view>
+#include <unordered_map>
 
 #include <core/memory.h>
+#include <core/mapped_file.h>
+#include <runtime/pixel_format.h>
+#include <runtime/latency_histogram.h>
+#include <runtime/compile_service.h>
+#include <runtime/stream.h>
 
 namespace luisa::compute {
 
+class Function;
+class FunctionBuilder;
+class Context;
+
 class Device {
 
 protected:
     // for buffer
     template<typename T> friend class Buffer;
+    friend class BufferHeap;
+    friend class TransientHeap;
     virtual void _dispose_buffer(uint64_t handle) noexcept = 0;
     [[nodiscard]] virtual uint64_t _create_buffer(size_t size_bytes) noexcept = 0;
     [[nodiscard]] virtual uint64_t _create_buffer_with_data(size_t size_bytes, const void *data) noexcept = 0;
+    // by default, reads the range in chunks on a helper thread, overlapping the reads with
+    // uploads through a double-buffered staging area; host-memory backends may map the file
+    [[nodiscard]] virtual uint64_t _create_buffer_from_file(
+        const std::filesystem::path &path, size_t offset_bytes, size_t size_bytes) noexcept;
+
+    // for texture
+    friend class Texture;
+    [[nodiscard]] virtual uint64_t _create_texture(
+        PixelFormat format, uint32_t dimension,
+        uint32_t width, uint32_t height, uint32_t depth,
+        uint32_t mipmap_levels) noexcept = 0;
+    virtual void _dispose_texture(uint64_t handle) noexcept = 0;
+
+    // for bindless array
+    friend class BindlessArray;
+    friend class CompositeDevice;
+    [[nodiscard]] virtual uint64_t _create_bindless_array(size_t size) noexcept = 0;
+    virtual void _dispose_bindless_array(uint64_t handle) noexcept = 0;
+
+    // for kernel, the returned pipeline handle must not refer to the function after compilation;
+    // kernels may be compiled concurrently on background workers
+    [[nodiscard]] virtual uint64_t _compile_kernel(Function kernel) noexcept = 0;
+
+    // a cheap-to-build pipeline for dispatches issued while the real one is still compiling,
+    // e.g. an interpreter; without one, such dispatches wait for the compilation to finish
+    [[nodiscard]] virtual std::optional<uint64_t> _compile_fallback_kernel(Function kernel) noexcept;
+
+    // for the persistent kernel cache, the tag identifies the backend and its compiler
+    // version, and is empty if the backend does not support persisting kernels
+    [[nodiscard]] virtual std::string_view _kernel_cache_tag() const noexcept { return {}; }
+    [[nodiscard]] virtual std::vector<std::byte> _serialize_kernel(uint64_t) noexcept { return {}; }
+    [[nodiscard]] virtual std::optional<uint64_t> _load_kernel(MappedFile) noexcept { return std::nullopt; }
+
+    // the workers compile_async queues onto, or null to compile on the calling thread
+    [[nodiscard]] virtual CompileService *_compile_service() noexcept { return nullptr; }
+
+    explicit Device(Context *context = nullptr) noexcept : _context{context} {}
+
+private:
+    Context *_context;
+    std::mutex _kernel_cache_mutex;
+    std::unordered_map<uint64_t, std::shared_future<uint64_t>> _kernel_cache;
+    LatencyHistogram _compile_latency;
+    LatencyHistogram _compile_queue_latency;
+    std::atomic<Profiler *> _profiler{nullptr};
+    uint32_t _profiler_lane{0u};
+
+private:
+    [[nodiscard]] uint64_t _compile_or_load_kernel(Function kernel, uint64_t hash) noexcept;
+    [[nodiscard]] uint64_t _compile_or_load_kernel_untimed(Function kernel, uint64_t hash) noexcept;
 
 public:
+    static constexpr auto file_upload_chunk_size = static_cast<size_t>(16u * 1024u * 1024u);
+
+public:
+    virtual ~Device() noexcept { set_profiler(nullptr); }
+    [[nodiscard]] auto context() const noexcept { return _context; }
+    [[nodiscard]] virtual std::unique_ptr<Stream> create_stream() noexcept = 0;
+
+    // compiles the kernel, or returns the pipeline compiled for a structurally identical one
+    [[nodiscard]] uint64_t compile(Function kernel) noexcept;
+    // queues the compilation onto background workers, sharing the future with identical kernels
+    [[nodiscard]] std::shared_future<uint64_t> compile_async(std::shared_ptr<const FunctionBuilder> kernel) noexcept;
+    [[nodiscard]] std::optional<uint64_t> compile_fallback(Function kernel) noexcept;
+    [[nodiscard]] size_t compiled_kernel_count() noexcept;
+
+    // time spent compiling or loading each pipeline, and time async requests waited in the queue
+    [[nodiscard]] const auto &compile_latency() const noexcept { return _compile_latency; }
+    [[nodiscard]] const auto &compile_queue_latency() const noexcept { return _compile_queue_latency; }
 
+    // records kernel compilations on a lane of the profiler, or stops recording if null
+    void set_profiler(Profiler *profiler, std::string name = "compiler") noexcept;
+    [[nodiscard]] auto profiler() const noexcept { return _profiler.load(std::memory_order_acquire); }
 };
 
 }
@@ -4,22 +4,348 @@
 
 #pragma once
 
+#include <array>
+#include <tuple>
+#include <string>
+#include <memory>
+#include <vector>
+#include <future>
+#include <cstring>
+#include <optional>
+#include <algorithm>
+#include <unordered_map>
+
+#include <core/concepts.h>
+#include <runtime/device.h>
+#include <runtime/buffer.h>
+#include <runtime/texture.h>
+#include <runtime/bindless_array.h>
+#include <runtime/argument_layout.h>
+#include <ast/function_builder.h>
+#include <dsl/expr.h>
+
 namespace luisa::compute {
 
+namespace detail {
+class KernelInvoke;
+}
+
 template<typename... Args>
-class Kernel {
+class Kernel;
+
+class CompositeStream;
+
+// Arguments are packed into a single block as described by the kernel's
+// ArgumentLayout. Small blocks are stored inline so that launching a kernel
+// does not allocate.
+class KernelLaunchCommand {
+
+public:
+    static constexpr auto inline_argument_capacity = static_cast<size_t>(256u);
 
 private:
+    uint64_t _handle;
+    uint3 _dispatch_size;
+    uint3 _block_size;
+    uint3 _block_offset;
+    uint3 _block_count;
+    size_t _argument_size;
+    std::unique_ptr<std::byte[]> _heap_arguments;
+    alignas(ArgumentLayout::alignment) std::array<std::byte, inline_argument_capacity> _inline_arguments;
 
+private:
+    friend class detail::KernelInvoke;
+    friend class CompositeStream;
+    KernelLaunchCommand(uint64_t handle, size_t argument_size) noexcept
+        : _handle{handle},
+          _dispatch_size{},
+          _block_size{},
+          _block_offset{},
+          _block_count{},
+          _argument_size{argument_size} {
+        if (argument_size > inline_argument_capacity) { _heap_arguments = std::make_unique<std::byte[]>(argument_size); }
+    }
+    [[nodiscard]] std::byte *_arguments() noexcept {
+        return _heap_arguments == nullptr ? _inline_arguments.data() : _heap_arguments.get();
+    }
+    void _set_dispatch(uint3 dispatch_size, uint3 block_size) noexcept {
+        _dispatch_size = dispatch_size;
+        _block_size = block_size;
+        _block_offset = uint3{0u, 0u, 0u};
+        _block_count = (dispatch_size + block_size - uint3{1u, 1u, 1u}) / block_size;
+    }
 
 public:
+    KernelLaunchCommand(KernelLaunchCommand &&another) noexcept
+        : _handle{another._handle},
+          _dispatch_size{another._dispatch_size},
+          _block_size{another._block_size},
+          _block_offset{another._block_offset},
+          _block_count{another._block_count},
+          _argument_size{another._argument_size},
+          _heap_arguments{std::move(another._heap_arguments)} {
+        if (_heap_arguments == nullptr) { std::memcpy(_inline_arguments.data(), another._inline_arguments.data(), _argument_size); }
+    }
+    KernelLaunchCommand &operator=(KernelLaunchCommand &&) noexcept = delete;
+
+    [[nodiscard]] auto handle() const noexcept { return _handle; }
+    [[nodiscard]] auto dispatch_size() const noexcept { return _dispatch_size; }
+    [[nodiscard]] auto block_size() const noexcept { return _block_size; }
+    // the range of blocks to run, all of them unless the launch is a partition of a larger one
+    [[nodiscard]] auto block_offset() const noexcept { return _block_offset; }
+    [[nodiscard]] auto block_count() const noexcept { return _block_count; }
+    [[nodiscard]] std::span<const std::byte> arguments() const noexcept {
+        return {_heap_arguments == nullptr ? _inline_arguments.data() : _heap_arguments.get(), _argument_size};
+    }
+};
+
+namespace detail {
 
+class KernelInvoke {
 
+private:
+    const ArgumentLayout *_layout;
+    KernelLaunchCommand _command;
+    size_t _argument_index;
+
+private:
+    [[nodiscard]] std::byte *_next(Variable::Tag tag) noexcept {
+        auto entries = _layout->entries();
+        if (_argument_index >= entries.size()) { LUISA_ERROR_WITH_LOCATION("Too many kernel arguments."); }
+        auto &&e = entries[_argument_index++];
+        if (e.variable.tag() != tag) {
+            LUISA_ERROR_WITH_LOCATION("Invalid kernel argument #{} (tag {}, expected {}).",
+                                      _argument_index - 1u, static_cast<uint32_t>(tag), static_cast<uint32_t>(e.variable.tag()));
+        }
+        return _command._arguments() + e.offset;
+    }
+
+public:
+    KernelInvoke(uint64_t handle, const ArgumentLayout &layout) noexcept
+        : _layout{&layout},
+          _command{handle, layout.size()},
+          _argument_index{layout.capture_count()} { layout.encode_captures(_command._arguments()); }
+
+    template<typename T>
+    KernelInvoke &operator<<(BufferView<T> buffer) noexcept {
+        ArgumentLayout::encode_buffer(_next(Variable::Tag::BUFFER), buffer.handle(), buffer.offset_bytes());
+        return *this;
+    }
+
+    KernelInvoke &operator<<(TextureView texture) noexcept {
+        ArgumentLayout::encode_texture(_next(Variable::Tag::TEXTURE), texture.handle(), texture.level());
+        return *this;
+    }
+
+    KernelInvoke &operator<<(const BindlessArray &array) noexcept {
+        ArgumentLayout::encode_bindless_array(_next(Variable::Tag::BINDLESS_ARRAY), array.handle());
+        return *this;
+    }
+
+    template<typename T>
+    KernelInvoke &operator<<(const T &uniform) noexcept {
+        std::memcpy(_next(Variable::Tag::UNIFORM), &uniform, sizeof(T));
+        return *this;
+    }
+
+    [[nodiscard]] auto dispatch(uint3 dispatch_size, uint3 block_size) &&noexcept {
+        if (_argument_index != _layout->entries().size()) {
+            LUISA_ERROR_WITH_LOCATION("Missing kernel arguments ({} of {} given).", _argument_index, _layout->entries().size());
+        }
+        _command._set_dispatch(dispatch_size, block_size);
+        return std::move(_command);
+    }
+    [[nodiscard]] auto dispatch(uint32_t size) &&noexcept {
+        return std::move(*this).dispatch(uint3{size, 1u, 1u}, uint3{256u, 1u, 1u});
+    }
+    [[nodiscard]] auto dispatch(uint2 size) &&noexcept {
+        return std::move(*this).dispatch(uint3{size.x, size.y, 1u}, uint3{16u, 16u, 1u});
+    }
+    [[nodiscard]] auto dispatch(uint3 size) &&noexcept {
+        return std::move(*this).dispatch(size, uint3{8u, 8u, 4u});
+    }
 };
 
-template<typename Ret, typename... Args>
+// kernel and callable arguments are traced as explicit arguments of the function
+template<typename T>
+[[nodiscard]] inline auto make_argument(FunctionBuilder *f) noexcept {
+    if constexpr (dsl::detail::is_buffer_view_v<T>) {
+        return dsl::Expr<T>{f->ref(f->buffer(Type::of<T>()))};
+    } else if constexpr (std::is_same_v<T, BindlessArray>) {
+        return dsl::Expr<T>{f->ref(f->bindless_array())};
+    } else {
+        return dsl::Expr<T>{f->ref(f->uniform(Type::of<T>()))};
+    }
+}
+
+template<typename T>
+using launch_argument_t = std::conditional_t<std::is_same_v<T, BindlessArray>, const BindlessArray &, T>;
+
+// appends a gradient buffer for each float buffer argument, see FunctionBuilder::differentiate
+template<typename K, typename... Args>
+struct GradientKernel {
+    using type = K;
+};
+
+template<typename... T, typename First, typename... Rest>
+struct GradientKernel<Kernel<T...>, First, Rest...>
+    : GradientKernel<std::conditional_t<std::is_same_v<First, BufferView<float>>, Kernel<T..., BufferView<float>>, Kernel<T...>>, Rest...> {};
+
+}// namespace detail
+
+enum struct CompileMode : uint32_t {
+    BLOCKING,// compile when the kernel is defined
+    ASYNC    // compile on background workers, dispatching through the fallback pipeline until ready
+};
+
+template<typename... Args>
+class Kernel : public concepts::Noncopyable {
+
+private:
+    template<typename...>
+    friend class Kernel;
+
+    Device *_device;
+    std::shared_ptr<FunctionBuilder> _builder;
+    std::unique_ptr<ArgumentLayout> _layout;
+    std::shared_future<uint64_t> _pipeline;
+    std::optional<uint64_t> _fallback;
+    CompileMode _mode;
+    std::unique_ptr<std::unordered_map<std::string, Kernel>> _variants;
+
+private:
+    Kernel(Device *device, std::shared_ptr<FunctionBuilder> builder, CompileMode mode) noexcept
+        : _device{device},
+          _builder{std::move(builder)},
+          _mode{mode} { _compile(); }
+
+    void _compile() noexcept {
+        _layout = std::make_unique<ArgumentLayout>(function());
+        if (_mode == CompileMode::ASYNC) {
+            _pipeline = _device->compile_async(_builder);
+            if (!ready()) { _fallback = _device->compile_fallback(function()); }
+        } else {
+            std::promise<uint64_t> promise;
+            promise.set_value(_device->compile(function()));
+            _pipeline = promise.get_future().share();
+        }
+    }
+
+public:
+    template<typename Def>
+    requires std::invocable<Def, dsl::Expr<Args>...>
+    Kernel(Device *device, Def &&def, CompileMode mode = CompileMode::BLOCKING) noexcept
+        : _device{device},
+          _builder{std::make_shared<FunctionBuilder>(Function::Tag::KERNEL)},
+          _mode{mode} {
+        auto f = _builder.get();
+        f->define([f, &def] {
+            std::tuple<dsl::Expr<Args>...> args{detail::make_argument<Args>(f)...};
+            std::apply(std::forward<Def>(def), args);
+        });
+        _compile();
+    }
+
+    Kernel(Kernel &&) noexcept = default;
+    Kernel &operator=(Kernel &&) noexcept = default;
+
+    [[nodiscard]] auto device() const noexcept { return _device; }
+    [[nodiscard]] auto function() const noexcept { return Function{*_builder}; }
+    [[nodiscard]] auto ready() const noexcept { return _pipeline.wait_for(std::chrono::seconds{0}) == std::future_status::ready; }
+    // waits for the compilation to finish
+    [[nodiscard]] auto handle() const noexcept { return _pipeline.get(); }
+    [[nodiscard]] auto fallback_handle() const noexcept { return _fallback; }
+
+    // Returns the variant with the current host values of the given captured uniforms
+    // baked in as literals. Variants are cached by value, so specializing on values seen
+    // before neither re-traces nor recompiles. Not thread-safe.
+    template<typename... T>
+    [[nodiscard]] const Kernel &specialize(const T &...uniforms) noexcept {
+        std::vector<Variable> variables;
+        std::string key;
+        auto find = [&](const void *data, size_t size) noexcept {
+            auto captured = function().captured_uniforms();
+            auto binding = std::find_if(captured.begin(), captured.end(), [data](auto &&b) noexcept { return b.data == data; });
+            if (binding == captured.end()) { LUISA_ERROR_WITH_LOCATION("Specializing on a value that is not a captured uniform."); }
+            auto uid = binding->variable.uid();
+            variables.emplace_back(binding->variable);
+            key.append(reinterpret_cast<const char *>(&uid), sizeof(uid))
+                .append(static_cast<const char *>(data), size);
+        };
+        (find(&uniforms, sizeof(T)), ...);
+        if (_variants == nullptr) { _variants = std::make_unique<std::unordered_map<std::string, Kernel>>(); }
+        if (auto iter = _variants->find(key); iter != _variants->end()) { return iter->second; }
+        Kernel variant{_device, FunctionBuilder::specialize(function(), variables), _mode};
+        return _variants->emplace(std::move(key), std::move(variant)).first->second;
+    }
+    // a new kernel with its for loops of constant trip counts of up to max_trip_count iterations unrolled
+    [[nodiscard]] Kernel unrolled(uint32_t max_trip_count = FunctionBuilder::max_unrolled_trip_count) const noexcept {
+        return Kernel{_device, FunctionBuilder::unroll(function(), max_trip_count), _mode};
+    }
+    // a new kernel with small branches assigning to locals converted to selects
+    [[nodiscard]] Kernel if_converted(uint32_t max_cost = 8u) const noexcept {
+        return Kernel{_device, FunctionBuilder::if_convert(function(), max_cost), _mode};
+    }
+    // the reverse-mode gradient kernel, taking the arguments of this kernel followed by a gradient buffer
+    // for each BufferView<float> argument: the adjoints of the outputs in, the gradients of the inputs out
+    [[nodiscard]] auto gradient(uint32_t recompute_cost = 8u) const noexcept {
+        using Gradient = typename detail::GradientKernel<Kernel, Args...>::type;
+        return Gradient{_device, FunctionBuilder::differentiate(function(), recompute_cost), _mode};
+    }
+    [[nodiscard]] auto variant_count() const noexcept { return _variants == nullptr ? 0u : _variants->size(); }
+
+    [[nodiscard]] auto operator()(detail::launch_argument_t<Args>... args) const noexcept {
+        auto handle = !_fallback || ready() ? _pipeline.get() : *_fallback;
+        detail::KernelInvoke invoke{handle, *_layout};
+        (invoke << ... << args);
+        return invoke;
+    }
+};
+
+template<typename T>
 class Callable {
+    static_assert(always_false<T>, "Callables should be declared as Callable<Ret(Args...)>.");
+};
+
+// Callables are traced once and called from kernels or other callables. They
+// may not capture resources or uniforms: pass them in as arguments instead.
+template<typename Ret, typename... Args>
+class Callable<Ret(Args...)> {
+
+private:
+    std::shared_ptr<FunctionBuilder> _builder;
+
+public:
+    template<typename Def>
+    requires std::invocable<Def, dsl::Expr<Args>...>
+    Callable(Def &&def) noexcept
+        : _builder{std::make_shared<FunctionBuilder>(Function::Tag::DEVICE)} {
+        auto f = _builder.get();
+        f->define([f, &def] {
+            std::tuple<dsl::Expr<Args>...> args{detail::make_argument<Args>(f)...};
+            if constexpr (std::is_same_v<Ret, void>) {
+                std::apply(std::forward<Def>(def), args);
+            } else {
+                dsl::Expr<Ret> ret{std::apply(std::forward<Def>(def), args)};
+                f->return_(ret.expression());
+            }
+        });
+        if (!f->captured_buffers().empty() || !f->captured_textures().empty() ||
+            !f->captured_bindless_arrays().empty() || !f->captured_uniforms().empty()) {
+            LUISA_ERROR_WITH_LOCATION("Callables may not capture resources or uniforms.");
+        }
+    }
+
+    [[nodiscard]] auto function() const noexcept { return Function{*_builder}; }
 
+    auto operator()(dsl::Expr<Args>... args) const noexcept {
+        auto f = FunctionBuilder::current();
+        if constexpr (std::is_same_v<Ret, void>) {
+            f->void_(f->call(nullptr, _builder, {args.expression()...}));
+        } else {
+            return dsl::Expr<Ret>{f->call(Type::of<Ret>(), _builder, {args.expression()...})};
+        }
+    }
 };
 
 }// namespace luisa::compute
@@ -0,0 +1,47 @@
+//
+// Created by Mike Smith on 2021/3/8.
+//
+
+#include <bit>
+#include <cmath>
+#include <algorithm>
+
+#include <runtime/latency_histogram.h>
+
+namespace luisa::compute {
+
+void LatencyHistogram::record(std::chrono::nanoseconds latency) noexcept {
+    auto us = static_cast<uint64_t>(std::max(std::chrono::duration_cast<Duration>(latency).count(), Duration::rep{0}));
+    auto index = std::min(static_cast<uint32_t>(std::bit_width(us)), bucket_count - 1u);
+    _buckets[index].fetch_add(1u, std::memory_order_relaxed);
+    _count.fetch_add(1u, std::memory_order_relaxed);
+    _total.fetch_add(us, std::memory_order_relaxed);
+    auto old_max = _max.load(std::memory_order_relaxed);
+    while (old_max < us && !_max.compare_exchange_weak(old_max, us, std::memory_order_relaxed)) {}
+}
+
+void LatencyHistogram::reset() noexcept {
+    for (auto &&b : _buckets) { b.store(0u); }
+    _count.store(0u);
+    _total.store(0u);
+    _max.store(0u);
+}
+
+LatencyHistogram::Duration LatencyHistogram::mean() const noexcept {
+    auto n = count();
+    return n == 0u ? Duration{0} : Duration{_total.load() / n};
+}
+
+LatencyHistogram::Duration LatencyHistogram::quantile(double q) const noexcept {
+    auto n = count();
+    if (n == 0u) { return Duration{0}; }
+    auto rank = static_cast<uint64_t>(std::ceil(std::clamp(q, 0.0, 1.0) * static_cast<double>(n)));
+    auto seen = static_cast<uint64_t>(0u);
+    for (auto i = 0u; i < bucket_count; i++) {
+        seen += bucket(i);
+        if (seen >= std::max(rank, uint64_t{1u})) { return std::min(bucket_upper_bound(i), max()); }
+    }
+    return max();
+}
+
+}// namespace luisa::compute
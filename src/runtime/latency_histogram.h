@@ -0,0 +1,44 @@
+//
+// Created by Mike Smith on 2021/3/8.
+//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+
+#include <core/concepts.h>
+
+namespace luisa::compute {
+
+// Lock-free histogram over power-of-two microsecond buckets: bucket i counts
+// samples in [2^(i-1), 2^i) us, with bucket 0 holding everything below 1us.
+class LatencyHistogram : public concepts::Noncopyable {
+
+public:
+    static constexpr auto bucket_count = 32u;
+    using Duration = std::chrono::microseconds;
+
+private:
+    std::array<std::atomic<uint64_t>, bucket_count> _buckets{};
+    std::atomic<uint64_t> _count{0u};
+    std::atomic<uint64_t> _total{0u};
+    std::atomic<uint64_t> _max{0u};
+
+public:
+    void record(std::chrono::nanoseconds latency) noexcept;
+    void reset() noexcept;
+
+    [[nodiscard]] auto count() const noexcept { return _count.load(); }
+    [[nodiscard]] auto total() const noexcept { return Duration{_total.load()}; }
+    [[nodiscard]] auto max() const noexcept { return Duration{_max.load()}; }
+    [[nodiscard]] Duration mean() const noexcept;
+    [[nodiscard]] auto bucket(uint32_t index) const noexcept { return _buckets[index].load(); }
+    [[nodiscard]] static Duration bucket_upper_bound(uint32_t index) noexcept { return Duration{1ull << index}; }
+
+    // upper bound of the bucket holding the q-th quantile, q in [0, 1]
+    [[nodiscard]] Duration quantile(double q) const noexcept;
+};
+
+}// namespace luisa::compute
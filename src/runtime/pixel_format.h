@@ -0,0 +1,97 @@
+//
+// Created by Mike Smith on 2021/3/4.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace luisa::compute {
+
+enum struct PixelFormat : uint32_t {
+
+    R8U,
+    RG8U,
+    RGBA8U,
+
+    R8UNorm,
+    RG8UNorm,
+    RGBA8UNorm,
+
+    R32I,
+    RG32I,
+    RGBA32I,
+
+    R32U,
+    RG32U,
+    RGBA32U,
+
+    R32F,
+    RG32F,
+    RGBA32F
+};
+
+// how texels are stored in memory
+enum struct PixelStorage : uint32_t {
+    UINT8,
+    UNORM8,
+    INT32,
+    UINT32,
+    FLOAT32
+};
+
+[[nodiscard]] constexpr auto pixel_format_channel_count(PixelFormat format) noexcept {
+    switch (format) {
+        case PixelFormat::R8U:
+        case PixelFormat::R8UNorm:
+        case PixelFormat::R32I:
+        case PixelFormat::R32U:
+        case PixelFormat::R32F: return 1u;
+        case PixelFormat::RG8U:
+        case PixelFormat::RG8UNorm:
+        case PixelFormat::RG32I:
+        case PixelFormat::RG32U:
+        case PixelFormat::RG32F: return 2u;
+        default: return 4u;
+    }
+}
+
+[[nodiscard]] constexpr auto pixel_format_storage(PixelFormat format) noexcept {
+    switch (format) {
+        case PixelFormat::R8U:
+        case PixelFormat::RG8U:
+        case PixelFormat::RGBA8U: return PixelStorage::UINT8;
+        case PixelFormat::R8UNorm:
+        case PixelFormat::RG8UNorm:
+        case PixelFormat::RGBA8UNorm: return PixelStorage::UNORM8;
+        case PixelFormat::R32I:
+        case PixelFormat::RG32I:
+        case PixelFormat::RGBA32I: return PixelStorage::INT32;
+        case PixelFormat::R32U:
+        case PixelFormat::RG32U:
+        case PixelFormat::RGBA32U: return PixelStorage::UINT32;
+        default: return PixelStorage::FLOAT32;
+    }
+}
+
+[[nodiscard]] constexpr auto pixel_storage_channel_size(PixelStorage storage) noexcept {
+    return storage == PixelStorage::UINT8 || storage == PixelStorage::UNORM8 ? 1u : 4u;
+}
+
+[[nodiscard]] constexpr auto pixel_format_size(PixelFormat format) noexcept {
+    return pixel_storage_channel_size(pixel_format_storage(format)) * pixel_format_channel_count(format);
+}
+
+// scalar type of the 4-component vector returned by texture reads in kernels
+[[nodiscard]] constexpr std::string_view pixel_format_read_type(PixelFormat format) noexcept {
+    using namespace std::string_view_literals;
+    switch (pixel_format_storage(format)) {
+        case PixelStorage::UINT8:
+        case PixelStorage::UINT32: return "uint"sv;
+        case PixelStorage::INT32: return "int"sv;
+        default: return "float"sv;
+    }
+}
+
+}// namespace luisa::compute
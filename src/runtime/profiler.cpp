@@ -0,0 +1,265 @@
+//
+// Created by Mike Smith on 2021/3/14.
+//
+
+#include <fstream>
+#include <algorithm>
+
+#include <core/logging.h>
+#include <runtime/buffer.h>
+#include <runtime/texture.h>
+#include <runtime/bindless_array.h>
+#include <runtime/kernel.h>
+#include <runtime/stream.h>
+#include <runtime/device.h>
+#include <runtime/profiler.h>
+
+namespace luisa::compute {
+
+std::string_view to_string(Profiler::EventKind kind) noexcept {
+    using namespace std::string_view_literals;
+    switch (kind) {
+        case Profiler::EventKind::BUFFER_UPLOAD: return "buffer upload"sv;
+        case Profiler::EventKind::BUFFER_DOWNLOAD: return "buffer download"sv;
+        case Profiler::EventKind::BUFFER_COPY: return "buffer copy"sv;
+        case Profiler::EventKind::TEXTURE_UPLOAD: return "texture upload"sv;
+        case Profiler::EventKind::TEXTURE_DOWNLOAD: return "texture download"sv;
+        case Profiler::EventKind::TEXTURE_COPY: return "texture copy"sv;
+        case Profiler::EventKind::BINDLESS_ARRAY_UPDATE: return "bindless array update"sv;
+        case Profiler::EventKind::KERNEL_LAUNCH: return "kernel launch"sv;
+        case Profiler::EventKind::KERNEL_COMPILE: return "kernel compile"sv;
+    }
+    return "unknown"sv;
+}
+
+Profiler::Profiler() noexcept : _origin{std::chrono::steady_clock::now()} {}
+
+Profiler::~Profiler() noexcept {
+    std::vector<Stream *> streams;
+    std::vector<Device *> devices;
+    {
+        std::scoped_lock lock{_mutex};
+        streams.swap(_streams);
+        devices.swap(_devices);
+    }
+    for (auto stream : streams) { stream->_profiler = nullptr; }
+    for (auto device : devices) { device->set_profiler(nullptr); }
+}
+
+void Profiler::_track(Device *device) noexcept {
+    std::scoped_lock lock{_mutex};
+    if (std::find(_devices.cbegin(), _devices.cend(), device) == _devices.cend()) { _devices.emplace_back(device); }
+}
+
+void Profiler::_forget(Device *device) noexcept {
+    std::scoped_lock lock{_mutex};
+    std::erase(_devices, device);
+}
+
+Profiler::Duration Profiler::now() const noexcept {
+    return std::chrono::duration_cast<Duration>(std::chrono::steady_clock::now() - _origin);
+}
+
+uint32_t Profiler::add_lane(std::string name) noexcept {
+    std::scoped_lock lock{_mutex};
+    _lanes.emplace_back(std::move(name));
+    return static_cast<uint32_t>(_lanes.size() - 1u);
+}
+
+uint32_t Profiler::attach(Stream &stream, std::string name) noexcept {
+    if (stream._profiler != nullptr) {
+        LUISA_WARNING_WITH_LOCATION("Stream is already attached to a profiler, re-attaching.");
+        stream._profiler->detach(stream);
+    }
+    auto lane = add_lane(std::move(name));
+    std::scoped_lock lock{_mutex};
+    _streams.emplace_back(&stream);
+    stream._profiler = this;
+    stream._profiler_lane = lane;
+    return lane;
+}
+
+void Profiler::detach(Stream &stream) noexcept {
+    std::scoped_lock lock{_mutex};
+    if (auto iter = std::find(_streams.begin(), _streams.end(), &stream); iter != _streams.end()) {
+        _streams.erase(iter);
+        stream._profiler = nullptr;
+    }
+}
+
+void Profiler::name_kernel(uint64_t handle, std::string name) noexcept {
+    std::scoped_lock lock{_mutex};
+    _kernel_names[handle] = std::move(name);
+}
+
+std::string Profiler::kernel_name(uint64_t handle) const noexcept {
+    std::scoped_lock lock{_mutex};
+    if (auto iter = _kernel_names.find(handle); iter != _kernel_names.cend()) { return iter->second; }
+    return fmt::format("kernel {:016x}", handle);
+}
+
+void Profiler::_record(EventKind kind, uint32_t lane, uint64_t handle, uint64_t amount, uint3 dispatch_size, Duration begin) noexcept {
+    auto end = now();
+    std::scoped_lock lock{_mutex};
+    _events.emplace_back(Event{kind, lane, handle, amount, dispatch_size, begin, end});
+}
+
+void Profiler::record(uint32_t lane, const BufferUploadCommand &command, Duration begin) noexcept {
+    _record(EventKind::BUFFER_UPLOAD, lane, command.handle(), command.size(), uint3{}, begin);
+}
+
+void Profiler::record(uint32_t lane, const BufferDownloadCommand &command, Duration begin) noexcept {
+    _record(EventKind::BUFFER_DOWNLOAD, lane, command.handle(), command.size(), uint3{}, begin);
+}
+
+void Profiler::record(uint32_t lane, const BufferCopyCommand &command, Duration begin) noexcept {
+    _record(EventKind::BUFFER_COPY, lane, command.dst_handle(), command.size(), uint3{}, begin);
+}
+
+// texture commands do not carry the pixel format, so textures are measured in texels
+void Profiler::record(uint32_t lane, const TextureUploadCommand &command, Duration begin) noexcept {
+    auto size = command.size();
+    _record(EventKind::TEXTURE_UPLOAD, lane, command.handle(), static_cast<uint64_t>(size.x) * size.y * size.z, uint3{}, begin);
+}
+
+void Profiler::record(uint32_t lane, const TextureDownloadCommand &command, Duration begin) noexcept {
+    auto size = command.size();
+    _record(EventKind::TEXTURE_DOWNLOAD, lane, command.handle(), static_cast<uint64_t>(size.x) * size.y * size.z, uint3{}, begin);
+}
+
+void Profiler::record(uint32_t lane, const TextureCopyCommand &command, Duration begin) noexcept {
+    auto size = command.size();
+    _record(EventKind::TEXTURE_COPY, lane, command.dst_handle(), static_cast<uint64_t>(size.x) * size.y * size.z, uint3{}, begin);
+}
+
+void Profiler::record(uint32_t lane, const BindlessArrayUpdateCommand &command, Duration begin) noexcept {
+    _record(EventKind::BINDLESS_ARRAY_UPDATE, lane, command.handle(), command.modifications().size(), uint3{}, begin);
+}
+
+void Profiler::record(uint32_t lane, const KernelLaunchCommand &command, Duration begin) noexcept {
+    _record(EventKind::KERNEL_LAUNCH, lane, command.handle(), command.arguments().size(), command.dispatch_size(), begin);
+}
+
+void Profiler::record_compilation(uint32_t lane, uint64_t handle, Duration begin) noexcept {
+    _record(EventKind::KERNEL_COMPILE, lane, handle, 0u, uint3{}, begin);
+}
+
+void Profiler::clear() noexcept {
+    std::scoped_lock lock{_mutex};
+    _events.clear();
+}
+
+std::vector<Profiler::Event> Profiler::events() const noexcept {
+    std::scoped_lock lock{_mutex};
+    return _events;
+}
+
+std::vector<Profiler::KernelProfile> Profiler::kernel_profiles() const noexcept {
+    std::vector<KernelProfile> profiles;
+    std::unordered_map<uint64_t, size_t> indices;
+    for (auto &&event : events()) {
+        if (event.kind != EventKind::KERNEL_LAUNCH) { continue; }
+        auto [iter, first] = indices.try_emplace(event.handle, profiles.size());
+        if (first) { profiles.emplace_back(KernelProfile{event.handle, kernel_name(event.handle), 0u, {}, Duration::max(), {}}); }
+        auto &&profile = profiles[iter->second];
+        profile.launch_count++;
+        profile.total += event.duration();
+        profile.min = std::min(profile.min, event.duration());
+        profile.max = std::max(profile.max, event.duration());
+    }
+    std::sort(profiles.begin(), profiles.end(), [](auto &&lhs, auto &&rhs) noexcept { return lhs.total > rhs.total; });
+    return profiles;
+}
+
+Profiler::TransferProfile Profiler::transfer_profile(EventKind kind) const noexcept {
+    TransferProfile profile{0u, 0u, {}};
+    std::scoped_lock lock{_mutex};
+    for (auto &&event : _events) {
+        if (event.kind != kind) { continue; }
+        profile.command_count++;
+        profile.amount += event.amount;
+        profile.total += event.duration();
+    }
+    return profile;
+}
+
+Profiler::Duration Profiler::total_time(EventKind kind) const noexcept {
+    return transfer_profile(kind).total;
+}
+
+namespace detail {
+
+[[nodiscard]] static std::string json_escape(std::string_view s) noexcept {
+    std::string escaped;
+    escaped.reserve(s.size());
+    for (auto c : s) {
+        switch (c) {
+            case '"': escaped.append("\\\""); break;
+            case '\\': escaped.append("\\\\"); break;
+            case '\n': escaped.append("\\n"); break;
+            case '\t': escaped.append("\\t"); break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20u) {
+                    escaped.append(fmt::format("\\u{:04x}", static_cast<uint32_t>(c)));
+                } else {
+                    escaped.push_back(c);
+                }
+        }
+    }
+    return escaped;
+}
+
+}// namespace detail
+
+std::string Profiler::chrome_trace() const noexcept {
+    auto events = this->events();
+    std::vector<std::string> lanes;
+    {
+        std::scoped_lock lock{_mutex};
+        lanes = _lanes;
+    }
+    std::string trace{R"({"displayTimeUnit":"ns","traceEvents":[)"};
+    auto first = true;
+    auto separate = [&] {
+        if (!first) { trace.push_back(','); }
+        first = false;
+    };
+    for (auto i = 0u; i < lanes.size(); i++) {
+        separate();
+        trace.append(fmt::format(
+            R"({{"name":"thread_name","ph":"M","pid":0,"tid":{},"args":{{"name":"{}"}}}})",
+            i, detail::json_escape(lanes[i])));
+    }
+    auto us = [](Duration d) noexcept { return static_cast<double>(d.count()) * 1e-3; };
+    for (auto &&event : events) {
+        separate();
+        auto kernel = event.kind == EventKind::KERNEL_LAUNCH || event.kind == EventKind::KERNEL_COMPILE;
+        auto name = kernel ? detail::json_escape(kernel_name(event.handle)) : std::string{to_string(event.kind)};
+        trace.append(fmt::format(
+            R"({{"name":"{}","cat":"{}","ph":"X","pid":0,"tid":{},"ts":{:.3f},"dur":{:.3f},"args":{{"handle":"{:016x}")",
+            name, to_string(event.kind), event.lane, us(event.begin), us(event.duration()), event.handle));
+        if (event.kind == EventKind::KERNEL_LAUNCH) {
+            trace.append(fmt::format(
+                R"(,"dispatch_size":[{},{},{}],"argument_bytes":{})",
+                event.dispatch_size.x, event.dispatch_size.y, event.dispatch_size.z, event.amount));
+        } else if (event.kind != EventKind::KERNEL_COMPILE) {
+            trace.append(fmt::format(R"(,"amount":{})", event.amount));
+        }
+        trace.append("}}");
+    }
+    trace.append("]}");
+    return trace;
+}
+
+bool Profiler::export_chrome_trace(const std::filesystem::path &path) const noexcept {
+    std::ofstream file{path, std::ios::binary};
+    if (!file) {
+        LUISA_WARNING_WITH_LOCATION("Failed to open '{}' for writing the trace.", path.string());
+        return false;
+    }
+    auto trace = chrome_trace();
+    file.write(trace.data(), static_cast<std::streamsize>(trace.size()));
+    return static_cast<bool>(file);
+}
+
+}// namespace luisa::compute
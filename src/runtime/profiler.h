@@ -0,0 +1,133 @@
+//
+// Created by Mike Smith on 2021/3/14.
+//
+
+#pragma once
+
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <unordered_map>
+
+#include <core/concepts.h>
+#include <core/data_types.h>
+
+namespace luisa::compute {
+
+class Stream;
+class Device;
+class BufferCopyCommand;
+class BufferUploadCommand;
+class BufferDownloadCommand;
+class TextureCopyCommand;
+class TextureUploadCommand;
+class TextureDownloadCommand;
+class BindlessArrayUpdateCommand;
+class KernelLaunchCommand;
+
+// Collects begin/end timestamps of the commands dispatched to attached streams and of
+// kernel compilations on devices it is set on. Timestamps are taken on the host around
+// each dispatch, which brackets execution for backends whose streams run synchronously.
+// Streams detach themselves when destroyed, and the profiler detaches the streams
+// and devices that outlive it.
+class Profiler : public concepts::Noncopyable {
+
+public:
+    using Duration = std::chrono::nanoseconds;
+
+    enum struct EventKind : uint32_t {
+        BUFFER_UPLOAD,
+        BUFFER_DOWNLOAD,
+        BUFFER_COPY,
+        TEXTURE_UPLOAD,
+        TEXTURE_DOWNLOAD,
+        TEXTURE_COPY,
+        BINDLESS_ARRAY_UPDATE,
+        KERNEL_LAUNCH,
+        KERNEL_COMPILE
+    };
+    static constexpr auto event_kind_count = 9u;
+
+    struct Event {
+        EventKind kind;
+        uint32_t lane;
+        uint64_t handle; // kernel or destination resource
+        uint64_t amount; // bytes for buffers, texels for textures, slots for bindless arrays
+        uint3 dispatch_size;
+        Duration begin;// since the profiler was created
+        Duration end;
+        [[nodiscard]] auto duration() const noexcept { return end - begin; }
+    };
+
+    struct KernelProfile {
+        uint64_t handle;
+        std::string name;
+        size_t launch_count;
+        Duration total;
+        Duration min;
+        Duration max;
+        [[nodiscard]] auto mean() const noexcept { return launch_count == 0u ? Duration{0} : total / static_cast<Duration::rep>(launch_count); }
+    };
+
+    struct TransferProfile {
+        size_t command_count;
+        uint64_t amount;
+        Duration total;
+        [[nodiscard]] auto throughput() const noexcept {// amount per second
+            return total.count() == 0 ? 0.0 : static_cast<double>(amount) * 1e9 / static_cast<double>(total.count());
+        }
+    };
+
+private:
+    std::chrono::steady_clock::time_point _origin;
+    mutable std::mutex _mutex;
+    std::vector<Event> _events;
+    std::vector<std::string> _lanes;
+    std::vector<Stream *> _streams;
+    std::vector<Device *> _devices;
+    std::unordered_map<uint64_t, std::string> _kernel_names;
+
+private:
+    friend class Device;
+    void _track(Device *device) noexcept;
+    void _forget(Device *device) noexcept;
+    void _record(EventKind kind, uint32_t lane, uint64_t handle, uint64_t amount, uint3 dispatch_size, Duration begin) noexcept;
+
+public:
+    Profiler() noexcept;
+    ~Profiler() noexcept;
+    [[nodiscard]] Duration now() const noexcept;
+
+    // each attached stream and each device gets its own lane, i.e. a thread in the trace
+    [[nodiscard]] uint32_t add_lane(std::string name) noexcept;
+    uint32_t attach(Stream &stream, std::string name) noexcept;
+    void detach(Stream &stream) noexcept;
+    void name_kernel(uint64_t handle, std::string name) noexcept;
+    [[nodiscard]] std::string kernel_name(uint64_t handle) const noexcept;
+
+    void record(uint32_t lane, const BufferUploadCommand &command, Duration begin) noexcept;
+    void record(uint32_t lane, const BufferDownloadCommand &command, Duration begin) noexcept;
+    void record(uint32_t lane, const BufferCopyCommand &command, Duration begin) noexcept;
+    void record(uint32_t lane, const TextureUploadCommand &command, Duration begin) noexcept;
+    void record(uint32_t lane, const TextureDownloadCommand &command, Duration begin) noexcept;
+    void record(uint32_t lane, const TextureCopyCommand &command, Duration begin) noexcept;
+    void record(uint32_t lane, const BindlessArrayUpdateCommand &command, Duration begin) noexcept;
+    void record(uint32_t lane, const KernelLaunchCommand &command, Duration begin) noexcept;
+    void record_compilation(uint32_t lane, uint64_t handle, Duration begin) noexcept;
+
+    void clear() noexcept;
+    [[nodiscard]] std::vector<Event> events() const noexcept;
+    [[nodiscard]] std::vector<KernelProfile> kernel_profiles() const noexcept;
+    [[nodiscard]] TransferProfile transfer_profile(EventKind kind) const noexcept;
+    [[nodiscard]] Duration total_time(EventKind kind) const noexcept;
+
+    // in the Trace Event Format read by chrome://tracing and Perfetto
+    [[nodiscard]] std::string chrome_trace() const noexcept;
+    bool export_chrome_trace(const std::filesystem::path &path) const noexcept;
+};
+
+[[nodiscard]] std::string_view to_string(Profiler::EventKind kind) noexcept;
+
+}// namespace luisa::compute
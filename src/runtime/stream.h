@@ -6,22 +6,45 @@
 
 #include <utility>
 
+#include <runtime/profiler.h>
+
 namespace luisa::compute {
 
 class Stream {
 
+private:
+    friend class Profiler;
+    Profiler *_profiler{nullptr};
+    uint32_t _profiler_lane{0u};
+
 private:
     virtual void _dispatch(const class BufferCopyCommand &) = 0;
     virtual void _dispatch(const class BufferUploadCommand &) = 0;
     virtual void _dispatch(const class BufferDownloadCommand &) = 0;
+    virtual void _dispatch(const class TextureCopyCommand &) = 0;
+    virtual void _dispatch(const class TextureUploadCommand &) = 0;
+    virtual void _dispatch(const class TextureDownloadCommand &) = 0;
+    virtual void _dispatch(const class BindlessArrayUpdateCommand &) = 0;
+    virtual void _dispatch(const class KernelLaunchCommand &) = 0;
 
 public:
+    virtual ~Stream() noexcept {
+        if (_profiler != nullptr) { _profiler->detach(*this); }
+    }
+
     template<typename Cmd>
     Stream &operator<<(Cmd &&cmd) {
-        _dispatch(std::forward<Cmd>(cmd));
+        if (_profiler == nullptr) [[likely]] {
+            _dispatch(std::forward<Cmd>(cmd));
+        } else {
+            auto begin = _profiler->now();
+            _dispatch(cmd);
+            _profiler->record(_profiler_lane, cmd, begin);
+        }
         return *this;
     }
-    
+
+    [[nodiscard]] auto profiler() const noexcept { return _profiler; }
 };
 
 }// namespace luisa::compute
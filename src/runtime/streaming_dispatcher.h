@@ -0,0 +1,131 @@
+//
+// Created by Mike Smith on 2021/3/13.
+//
+
+#pragma once
+
+#include <span>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <semaphore>
+
+#include <core/logging.h>
+#include <core/concepts.h>
+#include <runtime/buffer.h>
+
+namespace luisa::compute {
+
+struct StreamingStatistics {
+    size_t chunk_count{0u};
+    size_t uploaded_bytes{0u};
+    size_t downloaded_bytes{0u};
+    double seconds{0.0};
+    // time each stage spent busy, which add up to more than seconds when they overlap
+    double upload_seconds{0.0};
+    double compute_seconds{0.0};
+    double download_seconds{0.0};
+    [[nodiscard]] auto bandwidth() const noexcept {// bytes per second over both directions
+        return seconds == 0.0 ? 0.0 : static_cast<double>(uploaded_bytes + downloaded_bytes) / seconds;
+    }
+    [[nodiscard]] auto overlap() const noexcept {
+        return seconds == 0.0 ? 0.0 : (upload_seconds + compute_seconds + download_seconds) / seconds;
+    }
+};
+
+// Tiles an element-wise dispatch over host arrays too large for the device, e.g.
+// memory-mapped files. Chunks rotate through `depth` pairs of device buffers, and
+// uploads, kernel runs and downloads each run on their own stream and thread, so
+// that chunk i + 1 is uploaded and chunk i - 1 downloaded while chunk i computes.
+template<typename In, typename Out>
+class StreamingDispatcher : public concepts::Noncopyable {
+
+private:
+    Device *_device;
+    size_t _chunk_size;
+    std::vector<Buffer<In>> _inputs;
+    std::vector<Buffer<Out>> _outputs;
+    std::unique_ptr<Stream> _upload_stream;
+    std::unique_ptr<Stream> _compute_stream;
+    std::unique_ptr<Stream> _download_stream;
+
+public:
+    StreamingDispatcher(Device *device, size_t chunk_size, uint32_t depth = 3u) noexcept
+        : _device{device}, _chunk_size{chunk_size},
+          _upload_stream{device->create_stream()},
+          _compute_stream{device->create_stream()},
+          _download_stream{device->create_stream()} {
+        if (chunk_size == 0u || depth < 2u) {
+            LUISA_ERROR_WITH_LOCATION("Invalid streaming chunk size {} or depth {}.", chunk_size, depth);
+        }
+        _inputs.reserve(depth);
+        _outputs.reserve(depth);
+        for (auto i = 0u; i < depth; i++) {
+            _inputs.emplace_back(device, chunk_size);
+            _outputs.emplace_back(device, chunk_size);
+        }
+    }
+
+    [[nodiscard]] auto device() const noexcept { return _device; }
+    [[nodiscard]] auto chunk_size() const noexcept { return _chunk_size; }
+    [[nodiscard]] auto depth() const noexcept { return static_cast<uint32_t>(_inputs.size()); }
+
+    // launch(input, output, offset, count) makes the command for the chunk of elements
+    // [offset, offset + count), with input and output viewing the chunk on the device
+    template<typename Launch>
+    StreamingStatistics run(std::span<const In> input, std::span<Out> output, Launch &&launch) {
+        if (output.size() < input.size()) {
+            LUISA_ERROR_WITH_LOCATION("Output with {} elements is smaller than input with {}.", output.size(), input.size());
+        }
+        using clock = std::chrono::steady_clock;
+        auto seconds = [](clock::time_point t0) noexcept { return std::chrono::duration<double>(clock::now() - t0).count(); };
+        auto depth = static_cast<ptrdiff_t>(_inputs.size());
+        auto chunk_count = (input.size() + _chunk_size - 1u) / _chunk_size;
+        auto chunk = [&](size_t c) noexcept { return std::make_pair(c * _chunk_size, std::min(_chunk_size, input.size() - c * _chunk_size)); };
+
+        StreamingStatistics statistics;
+        statistics.chunk_count = chunk_count;
+        std::counting_semaphore<> free_slots{depth};
+        std::counting_semaphore<> uploaded{0};
+        std::counting_semaphore<> computed{0};
+        auto start = clock::now();
+        std::thread uploader{[&] {
+            for (auto c = static_cast<size_t>(0u); c < chunk_count; c++) {
+                free_slots.acquire();
+                auto t0 = clock::now();
+                auto [offset, count] = chunk(c);
+                *_upload_stream << _inputs[c % depth].view().subview(0u, count).upload(input.data() + offset);
+                statistics.upload_seconds += seconds(t0);
+                uploaded.release();
+            }
+        }};
+        std::thread computer{[&] {
+            for (auto c = static_cast<size_t>(0u); c < chunk_count; c++) {
+                uploaded.acquire();
+                auto t0 = clock::now();
+                auto [offset, count] = chunk(c);
+                *_compute_stream << launch(_inputs[c % depth].view().subview(0u, count),
+                                           _outputs[c % depth].view().subview(0u, count),
+                                           offset, count);
+                statistics.compute_seconds += seconds(t0);
+                computed.release();
+            }
+        }};
+        for (auto c = static_cast<size_t>(0u); c < chunk_count; c++) {
+            computed.acquire();
+            auto t0 = clock::now();
+            auto [offset, count] = chunk(c);
+            *_download_stream << _outputs[c % depth].view().subview(0u, count).download(output.data() + offset);
+            statistics.download_seconds += seconds(t0);
+            free_slots.release();
+        }
+        uploader.join();
+        computer.join();
+        statistics.seconds = seconds(start);
+        statistics.uploaded_bytes = input.size_bytes();
+        statistics.downloaded_bytes = input.size() * sizeof(Out);
+        return statistics;
+    }
+};
+
+}// namespace luisa::compute
@@ -4,10 +4,224 @@
 
 #pragma once
 
+#include <algorithm>
+
+#include <core/logging.h>
+#include <core/concepts.h>
+#include <core/data_types.h>
+#include <runtime/device.h>
+#include <runtime/pixel_format.h>
+
 namespace luisa::compute {
 
-class Texture {
+class TextureUploadCommand {
+
+private:
+    uint64_t _handle;
+    uint32_t _level;
+    uint3 _offset;
+    uint3 _size;
+    const void *_data;
+
+private:
+    friend class TextureView;
+    friend class CompositeStream;
+    TextureUploadCommand(uint64_t handle, uint32_t level, uint3 offset, uint3 size, const void *data) noexcept
+        : _handle{handle}, _level{level}, _offset{offset}, _size{size}, _data{data} {}
+
+public:
+    [[nodiscard]] auto handle() const noexcept { return _handle; }
+    [[nodiscard]] auto level() const noexcept { return _level; }
+    [[nodiscard]] auto offset() const noexcept { return _offset; }
+    [[nodiscard]] auto size() const noexcept { return _size; }
+    [[nodiscard]] auto data() const noexcept { return _data; }
+};
+
+class TextureDownloadCommand {
+
+private:
+    uint64_t _handle;
+    uint32_t _level;
+    uint3 _offset;
+    uint3 _size;
+    void *_data;
+
+private:
+    friend class TextureView;
+    friend class CompositeStream;
+    TextureDownloadCommand(uint64_t handle, uint32_t level, uint3 offset, uint3 size, void *data) noexcept
+        : _handle{handle}, _level{level}, _offset{offset}, _size{size}, _data{data} {}
+
+public:
+    [[nodiscard]] auto handle() const noexcept { return _handle; }
+    [[nodiscard]] auto level() const noexcept { return _level; }
+    [[nodiscard]] auto offset() const noexcept { return _offset; }
+    [[nodiscard]] auto size() const noexcept { return _size; }
+    [[nodiscard]] auto data() const noexcept { return _data; }
+};
+
+class TextureCopyCommand {
+
+private:
+    uint64_t _src_handle;
+    uint64_t _dst_handle;
+    uint32_t _src_level;
+    uint32_t _dst_level;
+    uint3 _size;
+
+private:
+    friend class TextureView;
+    friend class CompositeStream;
+    TextureCopyCommand(uint64_t src, uint64_t dst, uint32_t src_level, uint32_t dst_level, uint3 size) noexcept
+        : _src_handle{src}, _dst_handle{dst}, _src_level{src_level}, _dst_level{dst_level}, _size{size} {}
+
+public:
+    [[nodiscard]] auto src_handle() const noexcept { return _src_handle; }
+    [[nodiscard]] auto dst_handle() const noexcept { return _dst_handle; }
+    [[nodiscard]] auto src_level() const noexcept { return _src_level; }
+    [[nodiscard]] auto dst_level() const noexcept { return _dst_level; }
+    [[nodiscard]] auto size() const noexcept { return _size; }
+};
+
+// a single mip level of a texture
+class TextureView {
+
+private:
+    Device *_device;
+    uint64_t _handle;
+    PixelFormat _format;
+    uint32_t _dimension;
+    uint32_t _level;
+    uint3 _size;
+
+private:
+    friend class Texture;
+    TextureView(Device *device, uint64_t handle, PixelFormat format, uint32_t dimension, uint32_t level, uint3 size) noexcept
+        : _device{device}, _handle{handle}, _format{format}, _dimension{dimension}, _level{level}, _size{size} {}
+
+    void _check_region(uint3 offset, uint3 size) const noexcept {
+        for (auto i = 0u; i < 3u; i++) {
+            if (offset[i] + size[i] > _size[i]) {
+                LUISA_ERROR_WITH_LOCATION(
+                    "Region (offset = ({}, {}, {}), size = ({}, {}, {})) overflows texture level {} with size ({}, {}, {}).",
+                    offset.x, offset.y, offset.z, size.x, size.y, size.z, _level, _size.x, _size.y, _size.z);
+            }
+        }
+    }
+
+public:
+    [[nodiscard]] auto device() const noexcept { return _device; }
+    [[nodiscard]] auto handle() const noexcept { return _handle; }
+    [[nodiscard]] auto format() const noexcept { return _format; }
+    [[nodiscard]] auto dimension() const noexcept { return _dimension; }
+    [[nodiscard]] auto level() const noexcept { return _level; }
+    [[nodiscard]] auto size() const noexcept { return _size; }
+    [[nodiscard]] auto pixel_count() const noexcept { return static_cast<size_t>(_size.x) * _size.y * _size.z; }
+    [[nodiscard]] auto size_bytes() const noexcept { return pixel_count() * pixel_format_size(_format); }
+
+    // host data is tightly packed in row-major (x fastest) order
+    [[nodiscard]] auto upload(uint3 offset, uint3 size, const void *data) const noexcept {
+        _check_region(offset, size);
+        return TextureUploadCommand{_handle, _level, offset, size, data};
+    }
+    [[nodiscard]] auto upload(const void *data) const noexcept { return upload(uint3{0u}, _size, data); }
+
+    [[nodiscard]] auto download(uint3 offset, uint3 size, void *data) const noexcept {
+        _check_region(offset, size);
+        return TextureDownloadCommand{_handle, _level, offset, size, data};
+    }
+    [[nodiscard]] auto download(void *data) const noexcept { return download(uint3{0u}, _size, data); }
+
+    [[nodiscard]] auto copy(TextureView source) const noexcept {
+        if (source.device() != _device) {
+            LUISA_ERROR_WITH_LOCATION("Incompatible texture views created on different devices.");
+        }
+        if (source.format() != _format || source.dimension() != _dimension ||
+            source.size().x != _size.x || source.size().y != _size.y || source.size().z != _size.z) {
+            LUISA_ERROR_WITH_LOCATION("Incompatible texture views with different formats or sizes.");
+        }
+        return TextureCopyCommand{source.handle(), _handle, source.level(), _level, _size};
+    }
+};
+
+class Texture : public concepts::Noncopyable {
+
+private:
+    Device *_device;
+    uint64_t _handle;
+    PixelFormat _format;
+    uint32_t _dimension;
+    uint32_t _mip_levels;
+    uint3 _size;
+
+private:
+    Texture(Device *device, PixelFormat format, uint32_t dimension, uint3 size, uint32_t mip_levels) noexcept
+        : _device{device},
+          _handle{},
+          _format{format},
+          _dimension{dimension},
+          _mip_levels{std::clamp(mip_levels, 1u, max_mip_levels(size))},
+          _size{size} {
+        if (size.x == 0u || size.y == 0u || size.z == 0u) { LUISA_ERROR_WITH_LOCATION("Creating empty texture."); }
+        _handle = device->_create_texture(format, dimension, size.x, size.y, size.z, _mip_levels);
+    }
+
+public:
+    Texture(Device *device, PixelFormat format, uint2 size, uint32_t mip_levels = 1u) noexcept
+        : Texture{device, format, 2u, uint3{size.x, size.y, 1u}, mip_levels} {}
+
+    Texture(Device *device, PixelFormat format, uint3 size, uint32_t mip_levels = 1u) noexcept
+        : Texture{device, format, 3u, size, mip_levels} {}
+
+    Texture(Texture &&another) noexcept
+        : _device{another._device},
+          _handle{another._handle},
+          _format{another._format},
+          _dimension{another._dimension},
+          _mip_levels{another._mip_levels},
+          _size{another._size} { another._device = nullptr; }
+
+    Texture &operator=(Texture &&rhs) noexcept {
+        if (&rhs != this) {
+            if (_device != nullptr) { _device->_dispose_texture(_handle); }
+            _device = rhs._device;
+            _handle = rhs._handle;
+            _format = rhs._format;
+            _dimension = rhs._dimension;
+            _mip_levels = rhs._mip_levels;
+            _size = rhs._size;
+            rhs._device = nullptr;
+        }
+        return *this;
+    }
+
+    ~Texture() noexcept {
+        if (_device != nullptr /* not moved */) { _device->_dispose_texture(_handle); }
+    }
+
+    [[nodiscard]] static uint32_t max_mip_levels(uint3 size) noexcept {
+        auto levels = 1u;
+        for (auto s = std::max({size.x, size.y, size.z}); s > 1u; s >>= 1u) { levels++; }
+        return levels;
+    }
+
+    [[nodiscard]] static uint3 mip_level_size(uint3 size, uint32_t level) noexcept {
+        return uint3{std::max(size.x >> level, 1u), std::max(size.y >> level, 1u), std::max(size.z >> level, 1u)};
+    }
+
+    [[nodiscard]] auto device() const noexcept { return _device; }
+    [[nodiscard]] auto handle() const noexcept { return _handle; }
+    [[nodiscard]] auto format() const noexcept { return _format; }
+    [[nodiscard]] auto dimension() const noexcept { return _dimension; }
+    [[nodiscard]] auto mip_levels() const noexcept { return _mip_levels; }
+    [[nodiscard]] auto size() const noexcept { return _size; }
 
+    [[nodiscard]] auto view(uint32_t level = 0u) const noexcept {
+        if (level >= _mip_levels) {
+            LUISA_ERROR_WITH_LOCATION("Invalid mip level {} for texture with {} levels.", level, _mip_levels);
+        }
+        return TextureView{_device, _handle, _format, _dimension, level, mip_level_size(_size, level)};
+    }
 };
 
-}
+}// namespace luisa::compute
@@ -0,0 +1,130 @@
+//
+// Created by Mike Smith on 2021/3/3.
+//
+
+#include <algorithm>
+#include <numeric>
+
+#include <runtime/transient_heap.h>
+
+namespace luisa::compute {
+
+TransientHeap::~TransientHeap() noexcept {
+    if (_capacity != 0u) { _device->_dispose_buffer(_handle); }
+}
+
+uint32_t TransientHeap::_create(size_t size_bytes) noexcept {
+    if (_allocated) { LUISA_ERROR_WITH_LOCATION("Creating transient buffer after allocation; call reset() first."); }
+    auto index = static_cast<uint32_t>(_records.size());
+    _records.emplace_back(Record{size_bytes, 0u, unused, unused});
+    return index;
+}
+
+void TransientHeap::_validate(uint32_t index, uint32_t batch) const noexcept {
+    if (batch != _batch) { LUISA_ERROR_WITH_LOCATION("Transient buffer #{} belongs to batch {}, but the heap is at batch {}.", index, batch, _batch); }
+    if (index >= _records.size()) { LUISA_ERROR_WITH_LOCATION("Invalid transient buffer #{} (only {} created).", index, _records.size()); }
+}
+
+void TransientHeap::_use(uint32_t index, uint32_t batch, uint32_t pass) noexcept {
+    if (_allocated) { LUISA_ERROR_WITH_LOCATION("Recording transient buffer usage after allocation; call reset() first."); }
+    _validate(index, batch);
+    auto &&r = _records[index];
+    if (r.first_pass == unused) {
+        r.first_pass = pass;
+        r.last_pass = pass;
+    } else {
+        r.first_pass = std::min(r.first_pass, pass);
+        r.last_pass = std::max(r.last_pass, pass);
+    }
+}
+
+const TransientHeap::Record &TransientHeap::_placed(uint32_t index, uint32_t batch) const noexcept {
+    if (!_allocated) { LUISA_ERROR_WITH_LOCATION("Transient buffer #{} accessed before allocation.", index); }
+    _validate(index, batch);
+    auto &&r = _records[index];
+    if (r.first_pass == unused) { LUISA_ERROR_WITH_LOCATION("Transient buffer #{} is never used and has no storage.", index); }
+    return r;
+}
+
+void TransientHeap::allocate() noexcept {
+
+    if (_allocated) { LUISA_ERROR_WITH_LOCATION("Transient heap already allocated."); }
+    auto lifetimes_overlap = [](const Record &a, const Record &b) noexcept {
+        return a.first_pass <= b.last_pass && b.first_pass <= a.last_pass;
+    };
+    auto ranges_overlap = [](const Record &a, const Record &b) noexcept {
+        return a.offset_bytes < b.offset_bytes + b.size_bytes && b.offset_bytes < a.offset_bytes + a.size_bytes;
+    };
+
+    // greedy by size: place the largest buffers first, each at the lowest
+    // offset that does not collide with a placed buffer alive at the same time
+    std::vector<uint32_t> order;
+    for (auto i = 0u; i < _records.size(); i++) {
+        if (_records[i].first_pass != unused) { order.emplace_back(i); }
+    }
+    std::stable_sort(order.begin(), order.end(), [this](auto lhs, auto rhs) noexcept {
+        return _records[lhs].size_bytes > _records[rhs].size_bytes;
+    });
+    std::vector<uint32_t> placed;
+    std::vector<const Record *> conflicts;
+    _footprint = 0u;
+    for (auto index : order) {
+        auto &&record = _records[index];
+        conflicts.clear();
+        for (auto p : placed) {
+            if (lifetimes_overlap(record, _records[p])) { conflicts.emplace_back(&_records[p]); }
+        }
+        std::sort(conflicts.begin(), conflicts.end(), [](auto lhs, auto rhs) noexcept {
+            return lhs->offset_bytes < rhs->offset_bytes;
+        });
+        auto offset = static_cast<size_t>(0u);
+        for (auto c : conflicts) {
+            if (offset + record.size_bytes <= c->offset_bytes) { break; }
+            offset = std::max(offset, (c->offset_bytes + c->size_bytes + alignment - 1u) / alignment * alignment);
+        }
+        record.offset_bytes = offset;
+        _footprint = std::max(_footprint, offset + record.size_bytes);
+        placed.emplace_back(index);
+    }
+
+    _barriers.clear();
+    for (auto after : placed) {
+        for (auto before : placed) {
+            auto &&a = _records[before];
+            auto &&b = _records[after];
+            if (a.last_pass < b.first_pass && ranges_overlap(a, b)) {
+                _barriers.emplace_back(AliasBarrier{b.first_pass, before, after});
+            }
+        }
+    }
+    std::stable_sort(_barriers.begin(), _barriers.end(), [](auto &&lhs, auto &&rhs) noexcept {
+        return lhs.pass < rhs.pass;
+    });
+
+    if (_footprint > _capacity) {
+        if (_capacity != 0u) { _device->_dispose_buffer(_handle); }
+        _capacity = (_footprint + alignment - 1u) / alignment * alignment;
+        _handle = _device->_create_buffer(_capacity);
+        LUISA_VERBOSE_WITH_LOCATION(
+            "Grew transient heap to {} bytes (handle = {}).",
+            _capacity, _handle);
+    }
+    _allocated = true;
+}
+
+void TransientHeap::reset() noexcept {
+    _records.clear();
+    _barriers.clear();
+    _footprint = 0u;
+    _batch++;
+    _allocated = false;
+}
+
+TransientHeap::Statistics TransientHeap::statistics() const noexcept {
+    auto naive = std::accumulate(_records.cbegin(), _records.cend(), static_cast<size_t>(0u), [](auto s, auto &&r) noexcept {
+        return r.first_pass == unused ? s : s + (r.size_bytes + alignment - 1u) / alignment * alignment;
+    });
+    return Statistics{_records.size(), naive, _footprint, _capacity};
+}
+
+}// namespace luisa::compute
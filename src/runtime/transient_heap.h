@@ -0,0 +1,118 @@
+//
+// Created by Mike Smith on 2021/3/3.
+//
+
+#pragma once
+
+#include <span>
+#include <vector>
+#include <limits>
+
+#include <core/logging.h>
+#include <core/concepts.h>
+#include <runtime/buffer.h>
+
+namespace luisa::compute {
+
+template<typename T>
+class TransientBuffer {
+
+private:
+    uint32_t _index;
+    uint32_t _batch;
+    size_t _size;
+
+private:
+    friend class TransientHeap;
+    TransientBuffer(uint32_t index, uint32_t batch, size_t size) noexcept
+        : _index{index}, _batch{batch}, _size{size} {}
+
+public:
+    [[nodiscard]] auto index() const noexcept { return _index; }
+    [[nodiscard]] auto batch() const noexcept { return _batch; }
+    [[nodiscard]] auto size() const noexcept { return _size; }
+    [[nodiscard]] auto size_bytes() const noexcept { return _size * sizeof(T); }
+};
+
+// Places short-lived buffers of one command batch into a single backing
+// buffer. Each buffer is marked with the passes that use it; buffers whose
+// [first, last] pass intervals do not overlap may share memory.
+class TransientHeap : public concepts::Noncopyable {
+
+public:
+    static constexpr auto alignment = static_cast<size_t>(256u);
+
+    struct AliasBarrier {
+        uint32_t pass;  // first pass of `after`
+        uint32_t before;// buffer whose memory is being reused
+        uint32_t after; // buffer taking over the memory
+    };
+
+    struct Statistics {
+        size_t buffer_count;
+        size_t naive_bytes;   // footprint without aliasing
+        size_t aliased_bytes; // footprint of the computed placement
+        size_t capacity_bytes;// size of the backing buffer
+    };
+
+private:
+    static constexpr auto unused = std::numeric_limits<uint32_t>::max();
+
+    struct Record {
+        size_t size_bytes;
+        size_t offset_bytes;
+        uint32_t first_pass;
+        uint32_t last_pass;
+    };
+
+private:
+    Device *_device;
+    uint64_t _handle{};
+    size_t _capacity{0u};
+    size_t _footprint{0u};
+    std::vector<Record> _records;
+    std::vector<AliasBarrier> _barriers;
+    uint32_t _batch{0u};
+    bool _allocated{false};
+
+private:
+    [[nodiscard]] uint32_t _create(size_t size_bytes) noexcept;
+    void _validate(uint32_t index, uint32_t batch) const noexcept;
+    void _use(uint32_t index, uint32_t batch, uint32_t pass) noexcept;
+    [[nodiscard]] const Record &_placed(uint32_t index, uint32_t batch) const noexcept;
+
+public:
+    explicit TransientHeap(Device *device) noexcept : _device{device} {}
+    TransientHeap(TransientHeap &&) noexcept = delete;
+    TransientHeap &operator=(TransientHeap &&) noexcept = delete;
+    ~TransientHeap() noexcept;
+
+    template<typename T>
+    [[nodiscard]] auto create(size_t size) noexcept {
+        static_assert(alignof(T) <= alignment);
+        return TransientBuffer<T>{_create(size * sizeof(T)), _batch, size};
+    }
+
+    template<typename T>
+    void use(TransientBuffer<T> buffer, uint32_t pass) noexcept { _use(buffer.index(), buffer.batch(), pass); }
+
+    // lifetime analysis and placement, (re)creates the backing buffer if it is too small
+    void allocate() noexcept;
+
+    template<typename T>
+    [[nodiscard]] auto view(TransientBuffer<T> buffer) const noexcept {
+        auto &&record = _placed(buffer.index(), buffer.batch());
+        return BufferView<T>{_device, _handle, record.offset_bytes, buffer.size()};
+    }
+
+    // pairs that need an aliasing barrier before `after` is first touched
+    [[nodiscard]] std::span<const AliasBarrier> alias_barriers() const noexcept { return _barriers; }
+
+    // forget the recorded buffers, keeping the backing memory for the next batch;
+    // buffers created before the reset are rejected afterwards
+    void reset() noexcept;
+
+    [[nodiscard]] Statistics statistics() const noexcept;
+};
+
+}// namespace luisa::compute
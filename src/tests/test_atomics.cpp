@@ -0,0 +1,160 @@
+//
+// Created by Mike Smith on 2021/3/16.
+//
+
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <vector>
+
+#include <core/logging.h>
+#include <runtime/buffer.h>
+#include <runtime/kernel.h>
+#include <dsl/syntax.h>
+#include <backends/cpu/cpu_device.h>
+
+int main() {
+
+    using namespace luisa;
+    using namespace luisa::compute;
+    using namespace luisa::compute::dsl;
+
+    cpu::CPUDevice device;
+    auto stream = device.create_stream();
+
+    // every read-modify-write on a few contended elements
+    static constexpr auto n = 1000u;
+    Kernel<BufferView<uint>, BufferView<int>, BufferView<float>, BufferView<uint>> rmw{
+        &device, [](Expr<BufferView<uint>> u, Expr<BufferView<int>> s, Expr<BufferView<float>> x, Expr<BufferView<uint>> old) noexcept {
+            auto f = FunctionBuilder::current();
+            auto i = dispatch_id()[0u];
+            Expr<int> si{f->cast(Type::of<int>(), CastOp::STATIC, i.expression())};
+            static_cast<void>(atomic_fetch_add(u[0u], 1u));
+            static_cast<void>(atomic_fetch_sub(u[1u], 2u));
+            static_cast<void>(atomic_fetch_or(u[2u], Expr<uint>{1u} << (i % 32u)));
+            static_cast<void>(atomic_fetch_xor(u[3u], i));
+            static_cast<void>(atomic_fetch_and(u[4u], ((Expr<uint>{1u} << (i % 32u)) ^ ~0u) | 1u));
+            static_cast<void>(atomic_fetch_min(s[0u], si - 500));
+            static_cast<void>(atomic_fetch_max(s[1u], si));
+            static_cast<void>(atomic_fetch_add(x[0u], 0.5f));
+            static_cast<void>(atomic_fetch_max(x[1u], Expr<float>{f->cast(Type::of<float>(), CastOp::STATIC, i.expression())}));
+            old[i] = atomic_compare_exchange(u[5u], Expr<uint>{0u}, i + 1u);
+            static_cast<void>(atomic_exchange(u[6u], i));
+        }};
+    std::vector<uint> u(8u, 0u);
+    u[1] = 2u * n;
+    u[4] = ~0u;
+    std::vector<int> s{0, -1};
+    std::vector<float> x{0.0f, -1.0f};
+    std::vector<uint> old(n);
+    Buffer<uint> u_buffer{&device, u.size()};
+    Buffer<int> s_buffer{&device, s.size()};
+    Buffer<float> x_buffer{&device, x.size()};
+    Buffer<uint> old_buffer{&device, n};
+    *stream << u_buffer.view().upload(u.data())
+            << s_buffer.view().upload(s.data())
+            << x_buffer.view().upload(x.data())
+            << rmw(u_buffer, s_buffer, x_buffer, old_buffer).dispatch(n)
+            << u_buffer.view().download(u.data())
+            << s_buffer.view().download(s.data())
+            << x_buffer.view().download(x.data())
+            << old_buffer.view().download(old.data());
+    auto xor_all = 0u;
+    for (auto i = 0u; i < n; i++) { xor_all ^= i; }
+    auto winners = std::count(old.cbegin(), old.cend(), 0u);
+    LUISA_INFO("add = {}, sub = {}, or = {:08x}, xor = {} (expected {}), and = {:08x}",
+               u[0], u[1], u[2], u[3], xor_all, u[4]);
+    LUISA_INFO("int min = {}, int max = {}, float add = {}, float max = {}",
+               s[0], s[1], x[0], x[1]);
+    LUISA_INFO("compare-exchange winners = {} (value {}), exchange left {} < {}: {}",
+               winners, u[5], u[6], n, u[6] < n);
+
+    // histograms over a skewed input, where half of the values fall into a single bin
+    static constexpr auto bins = 256u;
+    static constexpr auto count = 1u << 20u;
+    static constexpr auto block_size = 256u;
+    static constexpr auto blocks = 64u;
+    static constexpr auto threads = block_size * blocks;
+    std::vector<uint> values(count);
+    std::mt19937 random{42u};
+    for (auto &&v : values) { v = random() % 2u == 0u ? 7u : static_cast<uint>(random()); }
+    std::vector<uint> expected(bins, 0u);
+    for (auto v : values) { expected[v % bins]++; }
+    Buffer<uint> value_buffer{&device, count};
+    Buffer<uint> histogram_buffer{&device, bins};
+    Buffer<uint> partial_buffer{&device, bins * blocks};
+    *stream << value_buffer.view().upload(values.data());
+
+    // each thread strides over the input; when privatized, blocks count into their own
+    // copy of the histogram, so contended atomics stay within a block (and a worker)
+    auto histogram_def = [](bool privatized) noexcept {
+        return [privatized](Expr<BufferView<uint>> values, Expr<BufferView<uint>> histogram) noexcept {
+            auto f = FunctionBuilder::current();
+            auto u = Type::of<uint>();
+            auto b = Type::of<bool>();
+            auto i = dispatch_id()[0u];
+            auto base = privatized ? Expr<uint>{block_id()[0u] * bins} : Expr<uint>{0u};
+            auto k = f->ref(f->local(u, {i.expression()}));
+            f->while_(f->binary(b, BinaryOp::LESS, k, f->literal(count)), f->scope([&] {
+                auto bin = values[Expr<uint>{k}] % bins;
+                static_cast<void>(atomic_fetch_add(histogram[base + bin], 1u));
+                f->assign(AssignOp::ADD_ASSIGN, k, f->literal(threads));
+            }));
+        };
+    };
+    Kernel<BufferView<uint>, BufferView<uint>> global_histogram{&device, histogram_def(false)};
+    Kernel<BufferView<uint>, BufferView<uint>> private_histogram{&device, histogram_def(true)};
+    // privatized into shared memory, with one thread per bin to clear and flush the block's copy
+    static_assert(bins == block_size);
+    Kernel<BufferView<uint>, BufferView<uint>> shared_histogram{&device, [](Expr<BufferView<uint>> values, Expr<BufferView<uint>> histogram) noexcept {
+        auto f = FunctionBuilder::current();
+        auto u = Type::of<uint>();
+        auto b = Type::of<bool>();
+        auto local = shared<std::array<uint, bins>>();
+        auto tid = thread_id()[0u];
+        local[tid] = Expr<uint>{0u};
+        sync_block();
+        auto k = f->ref(f->local(u, {dispatch_id()[0u].expression()}));
+        f->while_(f->binary(b, BinaryOp::LESS, k, f->literal(count)), f->scope([&] {
+            static_cast<void>(atomic_fetch_add(local[values[Expr<uint>{k}] % bins], 1u));
+            f->assign(AssignOp::ADD_ASSIGN, k, f->literal(threads));
+        }));
+        sync_block();
+        static_cast<void>(atomic_fetch_add(histogram[tid], local[tid]));
+    }};
+    Kernel<BufferView<uint>, BufferView<uint>> merge{&device, [](Expr<BufferView<uint>> partial, Expr<BufferView<uint>> histogram) noexcept {
+        auto f = FunctionBuilder::current();
+        auto u = Type::of<uint>();
+        auto b = Type::of<bool>();
+        auto bin = dispatch_id()[0u];
+        auto sum = f->ref(f->local(u, {f->literal(0u)}));
+        auto block = f->ref(f->local(u, {f->literal(0u)}));
+        f->while_(f->binary(b, BinaryOp::LESS, block, f->literal(blocks)), f->scope([&] {
+            f->assign(AssignOp::ADD_ASSIGN, sum, partial[Expr<uint>{block} * bins + bin].expression());
+            f->assign(AssignOp::ADD_ASSIGN, block, f->literal(1u));
+        }));
+        histogram[bin] = Expr<uint>{sum};
+    }};
+
+    std::vector<uint> zeros(bins * blocks, 0u);
+    std::vector<uint> histogram(bins);
+    auto run = [&](const char *name, auto &&dispatch) {
+        *stream << histogram_buffer.view().upload(zeros.data())
+                << partial_buffer.view().upload(zeros.data());
+        auto t0 = std::chrono::steady_clock::now();
+        dispatch();
+        auto t1 = std::chrono::steady_clock::now();
+        *stream << histogram_buffer.view().download(histogram.data());
+        auto ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        LUISA_INFO("{} histogram: {} ms ({:.1f} M values/s), matches host: {}",
+                   name, ms, count / ms * 1e-3, histogram == expected);
+    };
+    for (auto round = 0u; round < 2u; round++) {
+        run("global", [&] { *stream << global_histogram(value_buffer, histogram_buffer).dispatch(threads); });
+        run("privatized", [&] {
+            *stream << private_histogram(value_buffer, partial_buffer).dispatch(threads)
+                    << merge(partial_buffer, histogram_buffer).dispatch(bins);
+        });
+        run("shared", [&] { *stream << shared_histogram(value_buffer, histogram_buffer).dispatch(threads); });
+    }
+}
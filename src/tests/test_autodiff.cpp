@@ -0,0 +1,129 @@
+//
+// Created by Mike Smith on 2021/3/23.
+//
+
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#include <core/logging.h>
+#include <runtime/buffer.h>
+#include <runtime/kernel.h>
+#include <dsl/syntax.h>
+#include <backends/cpu/cpu_device.h>
+
+using namespace luisa;
+using namespace luisa::compute;
+using namespace luisa::compute::dsl;
+
+template<typename T>
+[[nodiscard]] auto call(const Type *type, CallOp op, Expr<T> x) noexcept {
+    return FunctionBuilder::current()->call(type, op, {x.expression()});
+}
+
+static constexpr auto weight_count = 4u;
+
+// the loss of a single element on the host, in double precision for finite differences
+[[nodiscard]] double shade(double v, const double *w) noexcept {
+    auto acc = 0.0;
+    for (auto k = 0u; k < weight_count; k++) { acc = acc * 0.5 + std::sin(v * w[k]); }
+    acc = v > 0.5 ? acc * v : std::sqrt(acc * acc + 1.0);
+    return std::sqrt(v * v + acc * acc + 1.0) + std::exp(-v * v);
+}
+
+int main() {
+
+    cpu::CPUDevice device;
+    auto stream = device.create_stream();
+
+    // a loop, a branch, transcendental functions and vectors, with weights shared by all threads
+    Kernel<BufferView<float>, BufferView<float>, BufferView<float>> forward{
+        &device, [](Expr<BufferView<float>> x, Expr<BufferView<float>> w, Expr<BufferView<float>> y) noexcept {
+            auto f = Type::of<float>();
+            auto i = dispatch_id().x();
+            Var v = x[i];
+            Var<float> acc;
+            for_(0u, weight_count, [&](Expr<uint> k) noexcept {
+                acc = acc * 0.5f + Expr<float>{call(f, CallOp::SIN, v * w[k])};
+            });
+            if_(v > 0.5f, [&] {
+                acc = acc * v;
+            }).else_([&] {
+                acc = Expr<float>{call(f, CallOp::SQRT, acc * acc + 1.0f)};
+            });
+            Var<float3> d{v, acc, 1.0f};
+            y[i] = Expr<float>{call(f, CallOp::LENGTH, Expr<float3>{d})} + Expr<float>{call(f, CallOp::EXP, -v * v)};
+        }};
+
+    static constexpr auto n = 1u << 16u;
+    std::vector<float> x(n), y(n), dy(n), dx(n), w{0.8f, -1.3f, 2.1f, 0.4f}, dw(weight_count);
+    for (auto i = 0u; i < n; i++) {
+        x[i] = static_cast<float>(i) / static_cast<float>(n) * 2.0f - 1.0f;
+        dy[i] = static_cast<float>(i % 5u + 1u) * 0.25f;
+    }
+    Buffer<float> x_buffer{&device, n};
+    Buffer<float> w_buffer{&device, weight_count};
+    Buffer<float> y_buffer{&device, n};
+    Buffer<float> dx_buffer{&device, n};
+    Buffer<float> dw_buffer{&device, weight_count};
+    Buffer<float> dy_buffer{&device, n};
+    *stream << x_buffer.view().upload(x.data())
+            << w_buffer.view().upload(w.data())
+            << dy_buffer.view().upload(dy.data())
+            << forward(x_buffer, w_buffer, y_buffer).dispatch(n)
+            << y_buffer.view().download(y.data());
+
+    // gradients of sum(dy * y) by central differences, away from the jump of the branch
+    double wd[weight_count];
+    std::transform(w.cbegin(), w.cend(), wd, [](auto x) noexcept { return static_cast<double>(x); });
+    static constexpr auto h = 1e-4;
+    std::vector<double> expected_dx(n);
+    double expected_dw[weight_count]{};
+    for (auto i = 0u; i < n; i++) {
+        auto v = static_cast<double>(x[i]);
+        expected_dx[i] = dy[i] * (shade(v + h, wd) - shade(v - h, wd)) / (2.0 * h);
+        for (auto k = 0u; k < weight_count; k++) {
+            auto plus = wd[k] + h;
+            auto minus = wd[k] - h;
+            std::swap(wd[k], plus);
+            auto above = shade(v, wd);
+            wd[k] = minus;
+            auto below = shade(v, wd);
+            wd[k] = plus;
+            expected_dw[k] += dy[i] * (above - below) / (2.0 * h);
+        }
+    }
+
+    auto check = [&](const char *name, auto &&gradient) {
+        std::vector<float> zeros(n, 0.0f);
+        *stream << dx_buffer.view().upload(zeros.data())
+                << dw_buffer.view().upload(zeros.data());
+        auto t0 = std::chrono::steady_clock::now();
+        *stream << gradient(x_buffer, w_buffer, y_buffer, dx_buffer, dw_buffer, dy_buffer).dispatch(n);
+        auto t1 = std::chrono::steady_clock::now();
+        *stream << dx_buffer.view().download(dx.data())
+                << dw_buffer.view().download(dw.data());
+        auto max_dx_error = 0.0;
+        for (auto i = 0u; i < n; i++) {
+            if (std::abs(x[i] - 0.5f) < 1e-3f) { continue; }
+            max_dx_error = std::max(max_dx_error, std::abs(dx[i] - expected_dx[i]) / std::max(1.0, std::abs(expected_dx[i])));
+        }
+        auto max_dw_error = 0.0;
+        for (auto k = 0u; k < weight_count; k++) {
+            max_dw_error = std::max(max_dw_error, std::abs(dw[k] - expected_dw[k]) / std::max(1.0, std::abs(expected_dw[k])));
+        }
+        LUISA_INFO("{}: {} ms, dx[100] = {} (expected {}), dw[2] = {} (expected {}), max relative errors: dx = {}, dw = {}",
+                   name, std::chrono::duration<double, std::milli>(t1 - t0).count(),
+                   dx[100], expected_dx[100], dw[2], expected_dw[2], max_dx_error, max_dw_error);
+    };
+    // checkpointing every value, the default trade-off, and recomputing everything but loads
+    auto stored = forward.gradient(0u);
+    auto balanced = forward.gradient();
+    auto recomputed = forward.gradient(1000u);
+    for (auto round = 0u; round < 2u; round++) {
+        check("checkpointed", stored);
+        check("balanced", balanced);
+        check("recomputed", recomputed);
+    }
+}
@@ -0,0 +1,52 @@
+//
+// Created by Mike Smith on 2021/3/15.
+//
+
+#include <cmath>
+#include <vector>
+
+#include <core/logging.h>
+#include <ast/call_op.h>
+#include <runtime/buffer.h>
+#include <runtime/kernel.h>
+#include <dsl/syntax.h>
+#include <backends/cpu/cpu_device.h>
+
+int main() {
+
+    using namespace luisa;
+    using namespace luisa::compute;
+    using namespace luisa::compute::dsl;
+
+    for (auto op : {CallOp::SIN, CallOp::DOT, CallOp::MAKE_VECTOR, CallOp::TEXTURE_WRITE}) {
+        auto &&info = call_op_info(op);
+        LUISA_INFO("{}: {}, arity = {}, pure = {}, side effects = {}, cost = {}",
+                   info.name, info.signature, info.arity, info.pure, info.side_effects, info.cost);
+    }
+    LUISA_INFO("Lookup: make_float3 -> {}, rsqrt -> {}, callable -> {}",
+               to_string(*call_op_from_name("make_float3")), to_string(*call_op_from_name("rsqrt")),
+               call_op_from_name("callable").has_value());
+
+    cpu::CPUDevice device;
+    auto stream = device.create_stream();
+    static constexpr auto n = 1024u;
+    Buffer<float> buffer{&device, n};
+    Kernel<BufferView<float>> kernel{&device, [](Expr<BufferView<float>> out) noexcept {
+        auto f = FunctionBuilder::current();
+        auto i = dispatch_id()[0u];
+        Expr<float> x{f->cast(Type::of<float>(), CastOp::STATIC, i.expression())};
+        Expr<float> s{f->call(Type::of<float>(), CallOp::SQRT, {x.expression()})};
+        Expr<float3> v{f->call(Type::of<float3>(), CallOp::MAKE_VECTOR, {s.expression(), x.expression(), f->literal(1.0f)})};
+        Expr<float> d{f->call(Type::of<float>(), CallOp::DOT, {v.expression(), v.expression()})};
+        out[i] = Expr<float>{f->call(Type::of<float>(), "max", {d.expression(), f->literal(2.0f)})};
+    }};
+    std::vector<float> result(n);
+    *stream << kernel(buffer).dispatch(n)
+            << buffer.view().download(result.data());
+    auto max_error = 0.0f;
+    for (auto i = 0u; i < n; i++) {
+        auto x = static_cast<float>(i);
+        max_error = std::max(max_error, std::abs(result[i] - std::max(x + x * x + 1.0f, 2.0f)) / std::max(1.0f, result[i]));
+    }
+    LUISA_INFO("result[3] = {}, max relative error = {}", result[3], max_error);
+}
@@ -0,0 +1,76 @@
+//
+// Created by Mike Smith on 2021/3/10.
+//
+
+#include <vector>
+
+#include <core/logging.h>
+#include <runtime/buffer.h>
+#include <runtime/kernel.h>
+#include <runtime/composite_device.h>
+#include <dsl/syntax.h>
+#include <backends/cpu/cpu_device.h>
+
+int main() {
+
+    using namespace luisa;
+    using namespace luisa::compute;
+    using namespace luisa::compute::dsl;
+
+    cpu::CPUDevice children[3];
+    CompositeDevice device{{&children[0], &children[1], &children[2]}};
+    auto stream = device.create_stream();
+
+    static constexpr auto n = 10000u;
+    std::vector<uint> x(n);
+    for (auto i = 0u; i < n; i++) { x[i] = i; }
+    Buffer<uint> x_buffer{&device, n};
+    Buffer<uint> y_buffer{&device, n};
+    *stream << x_buffer.view().upload(x.data());
+
+    // each partition writes its own range of y
+    Kernel<BufferView<uint>, BufferView<uint>, uint> scale{&device, [](Expr<BufferView<uint>> x, Expr<BufferView<uint>> y, Expr<uint> a) noexcept {
+        auto i = dispatch_id()[0u];
+        y[i] = x[i] * a + 1u;
+    }};
+    // reads across partition boundaries, so the previous launch must have been gathered
+    Kernel<BufferView<uint>, BufferView<uint>> rotate{&device, [](Expr<BufferView<uint>> y, Expr<BufferView<uint>> x) noexcept {
+        auto i = dispatch_id()[0u];
+        x[i] = y[(i + 1u) % n];
+    }};
+    std::vector<uint> y(n);
+    *stream << scale(x_buffer, y_buffer, 3u).dispatch(n)
+            << rotate(y_buffer, x_buffer).dispatch(n)
+            << y_buffer.view().download(y.data())
+            << x_buffer.view().download(x.data());
+    auto mismatches = 0u;
+    for (auto i = 0u; i < n; i++) {
+        if (y[i] != i * 3u + 1u || x[i] != (i + 1u) % n * 3u + 1u) { mismatches++; }
+    }
+    LUISA_INFO("1D: y[9999] = {}, x[9999] = {}, mismatches = {}", y[n - 1u], x[n - 1u], mismatches);
+
+    // 2D dispatches are split along y
+    static constexpr auto width = 100u;
+    static constexpr auto height = 70u;
+    Buffer<uint> image{&device, width * height};
+    Kernel<BufferView<uint>> checker{&device, [](Expr<BufferView<uint>> image) noexcept {
+        auto p = dispatch_id();
+        image[p[1u] * width + p[0u]] = p[0u] * 1000u + p[1u];
+    }};
+    std::vector<uint> pixels(width * height);
+    *stream << checker(image).dispatch(uint2{width, height})
+            << image.view().download(pixels.data());
+    mismatches = 0u;
+    for (auto y = 0u; y < height; y++) {
+        for (auto x = 0u; x < width; x++) {
+            if (pixels[y * width + x] != x * 1000u + y) { mismatches++; }
+        }
+    }
+    LUISA_INFO("2D: pixel (99, 69) = {}, mismatches = {}", pixels.back(), mismatches);
+    LUISA_INFO("kernels compiled per child: {}, {}, {}",
+               children[0].compiled_kernel_count(), children[1].compiled_kernel_count(), children[2].compiled_kernel_count());
+    // only the buffers a kernel writes are gathered after its launches
+    LUISA_INFO("gathered arguments: scale = {} (expected 1), rotate = {} (expected 1), checker = {} (expected 1)",
+               device.kernel(scale.handle()).written.size(), device.kernel(rotate.handle()).written.size(),
+               device.kernel(checker.handle()).written.size());
+}
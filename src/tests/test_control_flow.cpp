@@ -0,0 +1,129 @@
+//
+// Created by Mike Smith on 2021/3/21.
+//
+
+#include <cmath>
+#include <vector>
+
+#include <core/logging.h>
+#include <runtime/buffer.h>
+#include <runtime/kernel.h>
+#include <dsl/syntax.h>
+#include <backends/cpu/cpu_device.h>
+
+using namespace luisa;
+using namespace luisa::compute;
+using namespace luisa::compute::dsl;
+
+struct Particle {
+    float3 position;
+    float3 velocity;
+    float mass;
+    uint bounces;
+};
+
+LUISA_STRUCT(Particle, position, velocity, mass, bounces)
+
+int main() {
+
+    cpu::CPUDevice device;
+    auto stream = device.create_stream();
+
+    // particles falling onto the ground through struct members and vector components
+    static constexpr auto n = 1024u;
+    static constexpr auto dt = 0.01f;
+    static constexpr auto steps = 200u;
+    Kernel<BufferView<Particle>> simulate{&device, [](Expr<BufferView<Particle>> particles) noexcept {
+        auto i = dispatch_id().x();
+        Var p = particles[i];
+        for_(0u, steps, [&](Expr<uint>) noexcept {
+            p.velocity().y() -= 9.8f * dt;
+            p.position() += p.velocity() * dt;
+            if_(p.position().y() < 0.0f, [&] {
+                p.position().y() = -p.position().y();
+                p.velocity() = p.velocity() * float3{1.0f, -0.5f, 1.0f};
+                p.bounces() += 1u;
+            });
+        });
+        particles[i] = p;
+    }};
+    std::vector<Particle> particles(n);
+    for (auto i = 0u; i < n; i++) {
+        particles[i] = Particle{float3{0.0f, 1.0f + static_cast<float>(i % 10u), 0.0f},
+                               float3{static_cast<float>(i % 3u), 0.0f, 1.0f}, 1.0f, 0u};
+    }
+    auto expected = particles;
+    for (auto &&p : expected) {
+        for (auto s = 0u; s < steps; s++) {
+            p.velocity.y -= 9.8f * dt;
+            p.position += p.velocity * dt;
+            if (p.position.y < 0.0f) {
+                p.position.y = -p.position.y;
+                p.velocity = p.velocity * float3{1.0f, -0.5f, 1.0f};
+                p.bounces += 1u;
+            }
+        }
+    }
+    Buffer<Particle> particle_buffer{&device, n};
+    *stream << particle_buffer.view().upload(particles.data())
+            << simulate(particle_buffer).dispatch(n)
+            << particle_buffer.view().download(particles.data());
+    auto particle_mismatches = 0u;
+    for (auto i = 0u; i < n; i++) {
+        auto &&p = particles[i];
+        auto &&q = expected[i];
+        if (p.bounces != q.bounces || std::abs(p.position.y - q.position.y) > 1e-3f || std::abs(p.position.x - q.position.x) > 1e-3f) {
+            particle_mismatches++;
+        }
+    }
+    LUISA_INFO("particles: p[9] = ({}, {}, {}) after {} bounces, mismatches: {}",
+               particles[9].position.x, particles[9].position.y, particles[9].position.z, particles[9].bounces, particle_mismatches);
+
+    // locals, while loops, elif chains, switches and swizzles
+    Kernel<BufferView<uint>, BufferView<float4>> classify{&device, [](Expr<BufferView<uint>> out, Expr<BufferView<float4>> v) noexcept {
+        auto i = dispatch_id().x();
+        Var x = i + 1u;
+        Var<uint> length;
+        while_(x != 1u, [&] {
+            if_(x % 2u == 0u, [&] { x = x / 2u; }).else_([&] { x = x * 3u + 1u; });
+            length += 1u;
+        });
+        Var<uint> kind;
+        if_(length < 10u, [&] { kind = 0u; })
+            .elif_(length < 50u, [&] { kind = 1u; })
+            .else_([&] { kind = 2u; });
+        Var<uint> parity;
+        switch_(i % 4u)
+            .case_(0u, [&] { parity = 10u; })
+            .case_(2u, [&] { parity = 20u; })
+            .default_([&] { parity = 30u; });
+        out[i] = length * 100u + kind * 10u + parity / 10u;
+        Var<float4> f{float2{1.0f, 2.0f}, 3.0f, Expr<float>{FunctionBuilder::current()->cast(Type::of<float>(), CastOp::STATIC, i.expression())}};
+        v[i] = Var<float4>{f.swizzle<3, 2>(), f.swizzle<1, 0>()};
+    }};
+    std::vector<uint> classes(n);
+    std::vector<float4> vectors(n);
+    Buffer<uint> class_buffer{&device, n};
+    Buffer<float4> vector_buffer{&device, n};
+    *stream << classify(class_buffer, vector_buffer).dispatch(n)
+            << class_buffer.view().download(classes.data())
+            << vector_buffer.view().download(vectors.data());
+    auto class_mismatches = 0u;
+    for (auto i = 0u; i < n; i++) {
+        auto x = i + 1u;
+        auto length = 0u;
+        while (x != 1u) {
+            x = x % 2u == 0u ? x / 2u : x * 3u + 1u;
+            length++;
+        }
+        auto kind = length < 10u ? 0u : (length < 50u ? 1u : 2u);
+        auto parity = i % 4u == 0u ? 1u : (i % 4u == 2u ? 2u : 3u);
+        auto &&v = vectors[i];
+        if (classes[i] != length * 100u + kind * 10u + parity ||
+            v.x != static_cast<float>(i) || v.y != 3.0f || v.z != 2.0f || v.w != 1.0f) {
+            class_mismatches++;
+        }
+    }
+    LUISA_INFO("classification: out[26] = {}, v[7] = ({}, {}, {}, {}), mismatches: {}",
+               classes[26], vectors[7].x, vectors[7].y, vectors[7].z, vectors[7].w, class_mismatches);
+}
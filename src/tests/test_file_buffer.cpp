@@ -0,0 +1,69 @@
+//
+// Created by Mike Smith on 2021/3/12.
+//
+
+#include <vector>
+#include <chrono>
+#include <numeric>
+#include <fstream>
+#include <filesystem>
+
+#include <core/logging.h>
+#include <runtime/buffer.h>
+#include <runtime/kernel.h>
+#include <runtime/composite_device.h>
+#include <dsl/syntax.h>
+#include <backends/cpu/cpu_device.h>
+
+int main() {
+
+    using namespace luisa;
+    using namespace luisa::compute;
+    using namespace luisa::compute::dsl;
+
+    // spans more than one upload chunk
+    static constexpr auto n = 5u * 1024u * 1024u;
+    static constexpr auto offset = 1000u;
+    auto path = std::filesystem::temp_directory_path() / "luisa-test-file-buffer.bin";
+    std::vector<uint> data(n);
+    std::iota(data.begin(), data.end(), 0u);
+    {
+        std::ofstream file{path, std::ios::binary};
+        file.write(reinterpret_cast<const char *>(data.data()), n * sizeof(uint));
+    }
+
+    cpu::CPUDevice device;
+    cpu::CPUDevice children[2];
+    CompositeDevice composite{{&children[0], &children[1]}};
+
+    for (auto d : {static_cast<Device *>(&device), static_cast<Device *>(&composite)}) {
+        auto stream = d->create_stream();
+        auto t0 = std::chrono::high_resolution_clock::now();
+        Buffer<uint> buffer{d, path, offset};
+        auto t1 = std::chrono::high_resolution_clock::now();
+        Kernel<BufferView<uint>> twice{d, [](Expr<BufferView<uint>> x) noexcept {
+            auto i = dispatch_id()[0u];
+            x[i] = x[i] * 2u;
+        }};
+        auto size = n - offset;
+        std::vector<uint> result(size);
+        *stream << twice(buffer).dispatch(size)
+                << buffer.view().download(result.data());
+        auto mismatches = 0u;
+        for (auto i = 0u; i < size; i++) {
+            if (result[i] != (i + offset) * 2u) { mismatches++; }
+        }
+        LUISA_INFO("{}: loaded {} elements in {} ms, result[0] = {}, mismatches = {}",
+                   d == &device ? "mapped" : "chunked", size,
+                   std::chrono::duration<double, std::milli>(t1 - t0).count(), result[0], mismatches);
+    }
+
+    // writes through the mapping must not reach the file
+    std::vector<uint> reloaded(n);
+    {
+        std::ifstream file{path, std::ios::binary};
+        file.read(reinterpret_cast<char *>(reloaded.data()), n * sizeof(uint));
+    }
+    LUISA_INFO("File unchanged: {}", reloaded == data);
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,142 @@
+//
+// Created by Mike Smith on 2021/3/19.
+//
+
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#include <core/logging.h>
+#include <runtime/buffer.h>
+#include <runtime/kernel.h>
+#include <dsl/syntax.h>
+#include <backends/cpu/cpu_device.h>
+
+int main() {
+
+    using namespace luisa;
+    using namespace luisa::compute;
+    using namespace luisa::compute::dsl;
+
+    cpu::CPUDevice device;
+    auto stream = device.create_stream();
+
+    // trip counts of constant loops, counting up, down and with strides
+    FunctionBuilder counted{Function::Tag::KERNEL};
+    counted.define([&] {
+        auto f = &counted;
+        auto b = Type::of<bool>();
+        auto trip_count = [f, b](auto begin, BinaryOp op, auto end, auto step) noexcept {
+            using T = decltype(begin);
+            auto v = f->for_variable(Type::of<T>());
+            auto cond = f->binary(b, op, f->ref(v), f->literal(end));
+            return ForStmt::trip_count(v, f->literal(begin), cond, f->literal(step));
+        };
+        auto show = [](auto n) noexcept { return n ? std::to_string(*n) : std::string{"unknown"}; };
+        LUISA_INFO("trip counts: [0, 16) = {}, [0, 16] = {}, [3, 10) by 3 = {}, (10, 0] by -2 = {}, [5, 5) = {}, != by 4 = {}, != by 3 = {}, "
+                   "wrapping <= max = {}, wrapping < max by 2 = {}",
+                   show(trip_count(0u, BinaryOp::LESS, 16u, 1u)),
+                   show(trip_count(0u, BinaryOp::LESS_EQUAL, 16u, 1u)),
+                   show(trip_count(3, BinaryOp::LESS, 10, 3)),
+                   show(trip_count(10, BinaryOp::GREATER, 0, -2)),
+                   show(trip_count(5, BinaryOp::LESS, 5, 1)),
+                   show(trip_count(0, BinaryOp::NOT_EQUAL, 16, 4)),
+                   show(trip_count(0, BinaryOp::NOT_EQUAL, 16, 3)),
+                   show(trip_count(0u, BinaryOp::LESS_EQUAL, ~0u, 1u)),
+                   show(trip_count(0u, BinaryOp::LESS, ~0u, 2u)));
+    });
+
+    // continued iterations still step, and breaks leave the loop
+    Kernel<BufferView<uint>> skip{&device, [](Expr<BufferView<uint>> out) noexcept {
+        auto f = FunctionBuilder::current();
+        auto i = dispatch_id()[0u];
+        auto sum = f->ref(f->local(Type::of<uint>(), {f->literal(0u)}));
+        for_(0u, 100u, [&](Expr<uint> k) noexcept {
+            f->if_((k % 3u == 0u).expression(), f->scope([&] { f->continue_(); }));
+            f->if_((k > i).expression(), f->scope([&] { f->break_(); }));
+            f->assign(AssignOp::ADD_ASSIGN, sum, k.expression());
+        });
+        out[i] = Expr<uint>{sum};
+    }};
+    static constexpr auto skip_count = 64u;
+    std::vector<uint> skipped(skip_count);
+    Buffer<uint> skip_buffer{&device, skip_count};
+    *stream << skip(skip_buffer).dispatch(skip_count)
+            << skip_buffer.view().download(skipped.data());
+    auto skip_mismatches = 0u;
+    for (auto i = 0u; i < skip_count; i++) {
+        auto expected = 0u;
+        for (auto k = 0u; k <= i; k++) {
+            if (k % 3u != 0u) { expected += k; }
+        }
+        if (skipped[i] != expected) { skip_mismatches++; }
+    }
+    LUISA_INFO("continue and break: sums[10] = {}, mismatches: {}", skipped[10], skip_mismatches);
+
+    // hints: a single iteration is kept as a loop with unroll_never and unrolled by default,
+    // full unrolls are capped by the size of the unrolled body, and up_to raises the trip count limit
+    Kernel<BufferView<uint>> hinted{&device, [](Expr<BufferView<uint>> out) noexcept {
+        for_(0u, 1u, [&](Expr<uint> k) noexcept { out[k] = 1u; }, ForStmt::unroll_never);
+        for_(1u, 2u, [&](Expr<uint> k) noexcept { out[k] = 2u; });
+        for_(0u, 2048u, [&](Expr<uint> k) noexcept { out[k] = 3u; }, ForStmt::unroll_full);
+        for_(2u, 34u, [&](Expr<uint> k) noexcept { out[k] = 4u; }, LoopUnroll::up_to(32u));
+    }};
+    auto loops = [](auto &&kernel) noexcept {
+        auto statements = kernel.function().body()->statements();
+        return std::count_if(statements.begin(), statements.end(), [](auto s) noexcept {
+            return dynamic_cast<const ForStmt *>(s) != nullptr;
+        });
+    };
+    LUISA_INFO("unroll hints: loops before = {} (expected 4), after = {} (expected 2)", loops(hinted), loops(hinted.unrolled()));
+
+    // per-thread 4x4 matrix products with the classic triple loop, rolled and unrolled
+    static constexpr auto n = 1u << 16u;
+    Kernel<BufferView<float>, BufferView<float>, BufferView<float>> product{
+        &device, [](Expr<BufferView<float>> a, Expr<BufferView<float>> b, Expr<BufferView<float>> c) noexcept {
+            auto f = FunctionBuilder::current();
+            auto base = dispatch_id()[0u] * 16u;
+            for_(0u, 4u, [&](Expr<uint> row) noexcept {
+                for_(0u, 4u, [&](Expr<uint> col) noexcept {
+                    auto sum = f->ref(f->local(Type::of<float>(), {f->literal(0.0f)}));
+                    for_(0u, 4u, [&](Expr<uint> k) noexcept {
+                        f->assign(AssignOp::ADD_ASSIGN, sum, (a[base + row * 4u + k] * b[base + k * 4u + col]).expression());
+                    });
+                    c[base + row * 4u + col] = Expr<float>{sum};
+                });
+            });
+        }};
+    auto unrolled = product.unrolled();
+    std::vector<float> a(n * 16u), b(n * 16u), c(n * 16u), expected(n * 16u);
+    for (auto i = 0u; i < n * 16u; i++) {
+        a[i] = static_cast<float>(i % 13u) * 0.25f;
+        b[i] = static_cast<float>(i % 7u) - 3.0f;
+    }
+    for (auto m = 0u; m < n; m++) {
+        for (auto row = 0u; row < 4u; row++) {
+            for (auto col = 0u; col < 4u; col++) {
+                auto sum = 0.0f;
+                for (auto k = 0u; k < 4u; k++) { sum += a[m * 16u + row * 4u + k] * b[m * 16u + k * 4u + col]; }
+                expected[m * 16u + row * 4u + col] = sum;
+            }
+        }
+    }
+    Buffer<float> a_buffer{&device, n * 16u};
+    Buffer<float> b_buffer{&device, n * 16u};
+    Buffer<float> c_buffer{&device, n * 16u};
+    *stream << a_buffer.view().upload(a.data())
+            << b_buffer.view().upload(b.data());
+    auto run = [&](const char *name, auto &&kernel) {
+        *stream << kernel(a_buffer, b_buffer, c_buffer).dispatch(n);// warm up
+        auto t0 = std::chrono::steady_clock::now();
+        for (auto round = 0u; round < 4u; round++) { *stream << kernel(a_buffer, b_buffer, c_buffer).dispatch(n); }
+        auto t1 = std::chrono::steady_clock::now();
+        *stream << c_buffer.view().download(c.data());
+        auto max_error = 0.0f;
+        for (auto i = 0u; i < n * 16u; i++) { max_error = std::max(max_error, std::abs(c[i] - expected[i])); }
+        LUISA_INFO("{} 4x4 products: {} ms per dispatch, max error = {}",
+                   name, std::chrono::duration<double, std::milli>(t1 - t0).count() / 4.0, max_error);
+    };
+    run("rolled", product);
+    run("unrolled", unrolled);
+}
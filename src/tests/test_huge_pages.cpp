@@ -0,0 +1,59 @@
+//
+// Created by Mike Smith on 2021/3/12.
+//
+
+#include <vector>
+#include <chrono>
+
+#include <core/logging.h>
+#include <core/memory.h>
+#include <core/huge_pages.h>
+#include <runtime/buffer.h>
+#include <runtime/kernel.h>
+#include <dsl/syntax.h>
+#include <backends/cpu/cpu_device.h>
+
+int main() {
+
+    using namespace luisa;
+    using namespace luisa::compute;
+    using namespace luisa::compute::dsl;
+    using namespace luisa::compute::cpu;
+
+    static constexpr auto n = 16u * 1024u * 1024u;
+    std::vector<float> x(n, 1.0f);
+    std::vector<float> y(n);
+    for (auto mode : {HugePageMode::NONE, HugePageMode::TRANSPARENT, HugePageMode::EXPLICIT_2M}) {
+        reset_huge_page_statistics();
+        CPUDevice device{nullptr, {.huge_pages = mode}};
+        auto stream = device.create_stream();
+        Buffer<float> x_buffer{&device, n};
+        Buffer<float> y_buffer{&device, n};
+        Kernel<BufferView<float>, BufferView<float>, float> saxpy{&device, [](Expr<BufferView<float>> x, Expr<BufferView<float>> y, Expr<float> a) noexcept {
+            auto i = dispatch_id()[0u];
+            y[i] = a * x[i] + y[i];
+        }};
+        *stream << x_buffer.view().upload(x.data())
+                << y_buffer.view().upload(x.data())
+                << saxpy(x_buffer, y_buffer, 2.0f).dispatch(n);
+        auto t0 = std::chrono::high_resolution_clock::now();
+        for (auto i = 0u; i < 10u; i++) { *stream << saxpy(x_buffer, y_buffer, 2.0f).dispatch(n); }
+        auto t1 = std::chrono::high_resolution_clock::now();
+        *stream << y_buffer.view().download(y.data());
+        auto statistics = huge_page_statistics();
+        LUISA_INFO(
+            "Huge pages {}: y[0] = {}, hit rate = {} ({} explicit, {} transparent, {} fallbacks), "
+            "resident huge bytes = {} / {}, 10 dispatches in {} ms",
+            static_cast<uint>(mode), y[0], statistics.hit_rate(),
+            statistics.explicit_hits, statistics.transparent_hits, statistics.fallbacks,
+            huge_page_resident_bytes(CPUDevice::buffer(y_buffer.view().handle())), n * sizeof(float),
+            std::chrono::duration<double, std::milli>(t1 - t0).count());
+    }
+
+    reset_huge_page_statistics();
+    Arena arena{HugePageMode::TRANSPARENT};
+    for (auto i = 0u; i < 100000u; i++) { *arena.create<uint64_t>(i) += 1u; }
+    auto big = arena.allocate<float>(1024u * 1024u);
+    big[1024u * 1024u - 1u] = 1.0f;
+    LUISA_INFO("Arena: total size = {}, hit rate = {}", arena.total_size(), huge_page_statistics().hit_rate());
+}
@@ -0,0 +1,181 @@
+//
+// Created by Mike Smith on 2021/3/6.
+//
+
+#include <vector>
+
+#include <core/logging.h>
+#include <runtime/buffer.h>
+#include <runtime/kernel.h>
+#include <dsl/syntax.h>
+#include <backends/cpu/cpu_device.h>
+
+int main() {
+
+    using namespace luisa;
+    using namespace luisa::compute;
+    using namespace luisa::compute::dsl;
+
+    cpu::CPUDevice device;
+    auto stream = device.create_stream();
+
+    static constexpr auto n = 1000u;
+    std::vector<float> x(n);
+    std::vector<float> y(n);
+    for (auto i = 0u; i < n; i++) {
+        x[i] = static_cast<float>(i);
+        y[i] = 1.0f;
+    }
+    Buffer<float> x_buffer{&device, n};
+    Buffer<float> y_buffer{&device, n};
+    *stream << x_buffer.view().upload(x.data())
+            << y_buffer.view().upload(y.data());
+
+    Callable<float(float, float)> scale_add = [](Expr<float> a, Expr<float> x) noexcept {
+        return a * x + 1.0f;
+    };
+
+    auto saxpy_def = [&](Expr<BufferView<float>> x, Expr<BufferView<float>> y, Expr<float> a) noexcept {
+        auto i = dispatch_id()[0u];
+        y[i] = scale_add(a, x[i]) + y[i];
+    };
+    Kernel<BufferView<float>, BufferView<float>, float> saxpy{&device, saxpy_def};
+    Kernel<BufferView<float>, BufferView<float>, float> another_saxpy{&device, saxpy_def};
+    LUISA_INFO("saxpy handles equal: {}, compiled kernels: {}",
+               saxpy.handle() == another_saxpy.handle(), device.compiled_kernel_count());
+
+    *stream << saxpy(x_buffer, y_buffer, 2.0f).dispatch(n)
+            << y_buffer.view().download(y.data());
+    auto mismatches = 0u;
+    for (auto i = 0u; i < n; i++) {
+        if (y[i] != 2.0f * static_cast<float>(i) + 2.0f) { mismatches++; }
+    }
+    LUISA_INFO("saxpy: y[10] = {}, y[999] = {}, mismatches: {}", y[10], y[999], mismatches);
+
+    // control flow through the raw builder: while, if/else, break, continue, switch and early return
+    Kernel<BufferView<uint>, uint> collatz{&device, [](Expr<BufferView<uint>> steps, Expr<uint> count) noexcept {
+        auto f = FunctionBuilder::current();
+        auto u = Type::of<uint>();
+        auto b = Type::of<bool>();
+        auto i = dispatch_id()[0u];
+        f->if_(f->binary(b, BinaryOp::GREATER_EQUAL, i.expression(), count.expression()), f->scope([f] { f->return_(); }));
+        auto value = f->ref(f->local(u, {(i + 1u).expression()}));
+        auto step = f->ref(f->local(u, {f->literal(0u)}));
+        auto bonus = f->ref(f->local(u, {f->literal(0u)}));
+        f->while_(f->literal(true), f->scope([&] {
+            f->if_(f->binary(b, BinaryOp::EQUAL, value, f->literal(1u)), f->scope([f] { f->break_(); }));
+            f->if_(
+                f->binary(b, BinaryOp::EQUAL, f->binary(u, BinaryOp::BIT_AND, value, f->literal(1u)), f->literal(0u)),
+                f->scope([&] { f->assign(AssignOp::SHR_ASSIGN, value, f->literal(1u)); }),
+                f->scope([&] {
+                    f->assign(AssignOp::ASSIGN, value, f->binary(u, BinaryOp::ADD, f->binary(u, BinaryOp::MUL, value, f->literal(3u)), f->literal(1u)));
+                }));
+            f->assign(AssignOp::ADD_ASSIGN, step, f->literal(1u));
+            f->if_(f->binary(b, BinaryOp::NOT_EQUAL, f->binary(u, BinaryOp::MOD, step, f->literal(4u)), f->literal(0u)), f->scope([f] { f->continue_(); }));
+            f->switch_(f->binary(u, BinaryOp::MOD, value, f->literal(3u)), f->scope([&] {
+                f->case_(f->literal(0u), f->scope([&] {
+                    f->assign(AssignOp::ADD_ASSIGN, bonus, f->literal(1u));
+                    f->break_();
+                }));
+                f->default_(f->scope([&] { f->assign(AssignOp::ADD_ASSIGN, bonus, f->literal(100u)); }));
+            }));
+        }));
+        steps[i] = Expr<uint>{f->binary(u, BinaryOp::ADD, f->binary(u, BinaryOp::MUL, step, f->literal(1000u)), bonus)};
+    }};
+
+    auto collatz_host = [](uint32_t v) noexcept {
+        auto step = 0u;
+        auto bonus = 0u;
+        while (v != 1u) {
+            v = (v & 1u) == 0u ? v >> 1u : v * 3u + 1u;
+            if (++step % 4u != 0u) { continue; }
+            bonus += v % 3u == 0u ? 1u : 100u;
+        }
+        return step * 1000u + bonus;
+    };
+
+    static constexpr auto m = 300u;
+    std::vector<uint> steps(m + 16u, 12345u);
+    Buffer<uint> steps_buffer{&device, steps.size()};
+    *stream << steps_buffer.view().upload(steps.data())
+            << collatz(steps_buffer, m).dispatch(static_cast<uint>(steps.size()))
+            << steps_buffer.view().download(steps.data());
+    mismatches = 0u;
+    for (auto i = 0u; i < m; i++) {
+        if (steps[i] != collatz_host(i + 1u)) { mismatches++; }
+    }
+    LUISA_INFO("collatz: steps[26] = {} (expected {}), mismatches: {}, untouched tail: {}",
+               steps[26], collatz_host(27u), mismatches, steps[m] == 12345u && steps.back() == 12345u);
+
+    // captured buffers are encoded once per kernel, captured uniforms whenever a launch is encoded
+    auto offset = 0.0f;
+    Kernel<uint> fill{&device, [&](Expr<uint> index) noexcept {
+        auto f = FunctionBuilder::current();
+        Expr<BufferView<float>> y{f->ref(f->buffer_binding(y_buffer.view()))};
+        Expr<float> o{f->ref(f->uniform_binding(&offset))};
+        y[index] = o;
+    }};
+    auto launch = fill(3u).dispatch(1u);
+    LUISA_INFO("fill: argument block size = {}", launch.arguments().size());
+    offset = 42.0f;
+    *stream << fill(4u).dispatch(1u)
+            << std::move(launch)
+            << y_buffer.view().download(y.data());
+    LUISA_INFO("fill: y[3] = {}, y[4] = {}", y[3], y[4]);
+    LUISA_INFO("compiled kernels: {}", device.compiled_kernel_count());
+
+    // variants compiled on background workers; the CPU backend has no fallback, so launches wait
+    std::vector<Kernel<BufferView<float>>> variants;
+    for (auto v = 0u; v < 8u; v++) {
+        variants.emplace_back(&device, [v](Expr<BufferView<float>> y) noexcept {
+            auto i = dispatch_id()[0u];
+            y[i] = y[i] * static_cast<float>(v + 1u);
+        }, CompileMode::ASYNC);
+    }
+    for (auto &&v : variants) { *stream << v(y_buffer).dispatch(n); }
+    *stream << y_buffer.view().download(y.data());
+    LUISA_INFO("async variants: y[10] = {} (expected {}), compiled kernels: {}",
+               y[10], (2.0f * 10.0f + 2.0f) * 40320.0f, device.compiled_kernel_count());
+    auto &&latency = device.compile_latency();
+    LUISA_INFO("compile latency: count = {}, mean = {}us, p50 <= {}us, p99 <= {}us, max = {}us, queued p99 <= {}us",
+               latency.count(), latency.mean().count(), latency.quantile(0.5).count(),
+               latency.quantile(0.99).count(), latency.max().count(),
+               device.compile_queue_latency().quantile(0.99).count());
+
+    // specializing on captured uniforms folds the loop bound and removes the disabled branch
+    auto iterations = 5u;
+    auto squared = false;
+    Kernel<BufferView<uint>> accumulate{&device, [&](Expr<BufferView<uint>> out) noexcept {
+        auto f = FunctionBuilder::current();
+        auto u = Type::of<uint>();
+        auto b = Type::of<bool>();
+        auto i = dispatch_id()[0u];
+        auto count = f->ref(f->uniform_binding(&iterations));
+        auto square = f->ref(f->uniform_binding(&squared));
+        auto sum = f->ref(f->local(u, {f->literal(0u)}));
+        auto k = f->ref(f->local(u, {f->literal(0u)}));
+        f->while_(f->binary(b, BinaryOp::LESS, k, f->binary(u, BinaryOp::MUL, count, f->literal(2u))), f->scope([&] {
+            f->if_(square,
+                   f->scope([&] { f->assign(AssignOp::ADD_ASSIGN, sum, f->binary(u, BinaryOp::MUL, k, k)); }),
+                   f->scope([&] { f->assign(AssignOp::ADD_ASSIGN, sum, k); }));
+            f->assign(AssignOp::ADD_ASSIGN, k, f->literal(1u));
+        }));
+        out[i] = Expr<uint>{f->binary(u, BinaryOp::ADD, sum, i.expression())};
+    }};
+    std::vector<uint> generic(16u), specialized(16u);
+    Buffer<uint> out_buffer{&device, 16u};
+    auto kernel_count = device.compiled_kernel_count();
+    for (auto s : {false, true, false}) {
+        squared = s;
+        auto &&variant = accumulate.specialize(iterations, squared);
+        *stream << accumulate(out_buffer).dispatch(16u)
+                << out_buffer.view().download(generic.data())
+                << variant(out_buffer).dispatch(16u)
+                << out_buffer.view().download(specialized.data());
+        LUISA_INFO("specialized (squared = {}): out[3] = {}, matches generic: {}, captured uniforms: {}, argument block: {} -> {} bytes",
+                   s, specialized[3], specialized == generic, variant.function().captured_uniforms().size(),
+                   accumulate(out_buffer).dispatch(16u).arguments().size(), variant(out_buffer).dispatch(16u).arguments().size());
+    }
+    LUISA_INFO("specialization: variants = {}, new pipelines = {}",
+               accumulate.variant_count(), device.compiled_kernel_count() - kernel_count);
+}
@@ -0,0 +1,71 @@
+//
+// Created by Mike Smith on 2021/3/7.
+//
+
+#include <vector>
+#include <filesystem>
+
+#include <core/logging.h>
+#include <runtime/context.h>
+#include <runtime/buffer.h>
+#include <runtime/kernel.h>
+#include <dsl/syntax.h>
+#include <backends/cpu/cpu_device.h>
+
+int main() {
+
+    using namespace luisa;
+    using namespace luisa::compute;
+    using namespace luisa::compute::dsl;
+
+    auto cache_directory = std::filesystem::temp_directory_path() / "luisa-compute-test-kernel-cache";
+    std::filesystem::remove_all(cache_directory);
+
+    auto square_def = [](Expr<BufferView<uint>> x) noexcept {
+        auto i = dispatch_id()[0u];
+        x[i] = x[i] * x[i] + 1u;
+    };
+
+    static constexpr auto n = 256u;
+    auto run = [&](cpu::CPUDevice &device) noexcept {
+        Kernel<BufferView<uint>> square{&device, square_def};
+        std::vector<uint> x(n);
+        for (auto i = 0u; i < n; i++) { x[i] = i; }
+        Buffer<uint> buffer{&device, n};
+        auto stream = device.create_stream();
+        *stream << buffer.view().upload(x.data())
+                << square(buffer).dispatch(n)
+                << buffer.view().download(x.data());
+        auto mismatches = 0u;
+        for (auto i = 0u; i < n; i++) {
+            if (x[i] != i * i + 1u) { mismatches++; }
+        }
+        return mismatches;
+    };
+
+    Context context{cache_directory};
+    {
+        cpu::CPUDevice cold{&context};
+        auto mismatches = run(cold);
+        LUISA_INFO("cold start: mismatches = {}, hits = {}, misses = {}",
+                   mismatches, context.cache_hit_count(), context.cache_miss_count());
+    }
+    {
+        // a fresh device compiles nothing and maps the stored kernel instead
+        cpu::CPUDevice warm{&context};
+        auto mismatches = run(warm);
+        LUISA_INFO("warm start: mismatches = {}, hits = {}, misses = {}",
+                   mismatches, context.cache_hit_count(), context.cache_miss_count());
+    }
+
+    // entries beyond the capacity are evicted least-recently-used first
+    auto tiny_directory = cache_directory / "tiny";
+    Context tiny{tiny_directory, 1u};
+    cpu::CPUDevice device{&tiny};
+    auto mismatches = run(device);
+    auto entries = std::distance(std::filesystem::directory_iterator{tiny_directory}, {});
+    LUISA_INFO("tiny cache: mismatches = {}, evictions = {}, entries = {}",
+               mismatches, tiny.cache_eviction_count(), entries);
+
+    std::filesystem::remove_all(cache_directory);
+}
@@ -0,0 +1,68 @@
+//
+// Created by Mike Smith on 2021/3/11.
+//
+
+#include <vector>
+#include <numeric>
+
+#include <core/logging.h>
+#include <runtime/buffer.h>
+#include <runtime/kernel.h>
+#include <dsl/syntax.h>
+#include <backends/cpu/cpu_device.h>
+
+int main() {
+
+    using namespace luisa;
+    using namespace luisa::compute;
+    using namespace luisa::compute::dsl;
+    using namespace luisa::compute::cpu;
+
+    auto &&topology = NumaTopology::current();
+    for (auto node = 0u; node < topology.node_count(); node++) {
+        LUISA_INFO("NUMA node {}: {} CPU(s)", node, topology.cpus(node).size());
+    }
+
+    // touch every page and report where it landed
+    static constexpr auto size = 16u * 1024u * 1024u;
+    static constexpr auto page_size = 4096u;
+    for (auto policy : {NumaPolicy::DEFAULT, NumaPolicy::LOCAL, NumaPolicy::INTERLEAVE, NumaPolicy::BIND, NumaPolicy::BLOCKED}) {
+        CPUAllocator allocator{policy, topology.node_count() - 1u};
+        auto p = static_cast<std::byte *>(allocator.allocate(size, CPUDevice::buffer_alignment));
+        std::vector<uint> pages(topology.node_count(), 0u);
+        auto unknown = 0u;
+        for (auto offset = 0u; offset < size; offset += page_size) {
+            p[offset] = std::byte{1};
+            if (auto node = NumaTopology::node_of(p + offset); node >= 0 && static_cast<uint>(node) < pages.size()) {
+                pages[node]++;
+            } else {
+                unknown++;
+            }
+        }
+        LUISA_INFO("Policy {}: pages per node = [{}], unknown = {}", static_cast<uint>(policy), fmt::join(pages, ", "), unknown);
+        allocator.free(p);
+    }
+
+    CPUDevice device{nullptr, {.numa_policy = NumaPolicy::BLOCKED, .pin_workers = true}};
+    LUISA_INFO("Thread pool: {} worker(s), {} node-local range(s)", device.thread_pool().size(), device.thread_pool().range_count());
+    auto stream = device.create_stream();
+
+    static constexpr auto n = 1000000u;
+    std::vector<uint> x(n);
+    std::iota(x.begin(), x.end(), 0u);
+    Buffer<uint> x_buffer{&device, n};
+    Buffer<uint> y_buffer{&device, n};
+    Kernel<BufferView<uint>, BufferView<uint>> square{&device, [](Expr<BufferView<uint>> x, Expr<BufferView<uint>> y) noexcept {
+        auto i = dispatch_id()[0u];
+        y[i] = x[i] * x[i];
+    }};
+    std::vector<uint> y(n);
+    *stream << x_buffer.view().upload(x.data())
+            << square(x_buffer, y_buffer).dispatch(n)
+            << y_buffer.view().download(y.data());
+    auto mismatches = 0u;
+    for (auto i = 0u; i < n; i++) {
+        if (y[i] != i * i) { mismatches++; }
+    }
+    LUISA_INFO("y[1000] = {}, mismatches = {}", y[1000], mismatches);
+}
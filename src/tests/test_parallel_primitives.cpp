@@ -0,0 +1,124 @@
+//
+// Created by Mike Smith on 2021/3/24.
+//
+
+#include <array>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+
+#include <core/logging.h>
+#include <runtime/buffer.h>
+#include <dsl/parallel_primitives.h>
+#include <backends/cpu/cpu_device.h>
+
+using namespace luisa;
+using namespace luisa::compute;
+using namespace luisa::compute::dsl;
+
+// usage: test_parallel_primitives [log2 of the largest size, 22 by default and up to 30 for 1G elements]
+int main(int argc, char *argv[]) {
+
+    auto max_log2_size = argc > 1 ? std::clamp(std::stoi(argv[1]), 10, 30) : 22;
+    auto capacity = static_cast<size_t>(1u) << max_log2_size;
+
+    cpu::CPUDevice device;
+    auto stream = device.create_stream();
+    LUISA_INFO("{} workers, sizes from 1K to {} elements", device.thread_pool().size(), capacity);
+
+    DeviceReduce<uint> sum{&device, capacity};
+    DeviceReduce<float> max{&device, capacity, ReduceOp::MAX};
+    DeviceScan<uint> scan{&device, capacity};
+    DeviceRadixSort<uint> sort{&device, capacity};
+    DeviceCompaction<uint> compact{&device, capacity, [](Expr<uint> x) noexcept { return x % 3u == 0u; }};
+
+    Buffer<uint> keys{&device, capacity};
+    Buffer<uint> values{&device, capacity};
+    Buffer<uint> output{&device, capacity};
+    Buffer<float> floats{&device, capacity};
+    Buffer<uint> scalars{&device, 2u};
+    Buffer<float> float_scalar{&device, 1u};
+
+    using clock = std::chrono::steady_clock;
+    auto timed = [](auto &&f) noexcept {
+        auto t0 = clock::now();
+        f();
+        return std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+    };
+    for (auto log2_size = 10; log2_size <= max_log2_size; log2_size += 2) {
+        auto n = static_cast<size_t>(1u) << log2_size;
+        std::vector<uint> host_keys(n);
+        std::vector<float> host_floats(n);
+        for (auto i = 0u; i < n; i++) {
+            host_keys[i] = (i * 2654435761u) ^ (i >> 7u);
+            host_floats[i] = static_cast<float>(host_keys[i] % 100003u) * 0.25f;
+        }
+        // a few bits of the keys, so that plenty of keys are equal and stability matters
+        std::vector<uint> host_pair_keys(n);
+        std::transform(host_keys.cbegin(), host_keys.cend(), host_pair_keys.begin(), [](auto k) noexcept { return k & 0x00f0f00fu; });
+        std::vector<uint> host_values(n);
+        std::iota(host_values.begin(), host_values.end(), 0u);
+        auto key_view = keys.view().subview(0u, n);
+        auto value_view = values.view().subview(0u, n);
+        auto output_view = output.view().subview(0u, n);
+        auto float_view = floats.view().subview(0u, n);
+        *stream << key_view.upload(host_keys.data())
+                << float_view.upload(host_floats.data());
+
+        std::array<uint, 2u> results{};
+        auto float_result = 0.0f;
+        auto reduce_ms = timed([&] { sum(*stream, key_view, scalars.view().subview(0u, 1u)); });
+        max(*stream, float_view, float_scalar.view());
+        *stream << scalars.view().subview(0u, 1u).download(results.data())
+                << float_scalar.view().download(&float_result);
+        auto reduce_ok = results[0] == std::accumulate(host_keys.cbegin(), host_keys.cend(), 0u) &&
+                         float_result == *std::max_element(host_floats.cbegin(), host_floats.cend());
+
+        std::vector<uint> scanned(n), expected(n);
+        auto scan_ms = timed([&] { scan.exclusive(*stream, key_view, output_view); });
+        *stream << output_view.download(scanned.data());
+        std::exclusive_scan(host_keys.cbegin(), host_keys.cend(), expected.begin(), 0u);
+        auto scan_ok = scanned == expected;
+
+        std::vector<uint> compacted(n);
+        auto compact_ms = timed([&] { compact(*stream, key_view, output_view, scalars.view().subview(1u, 1u)); });
+        *stream << scalars.view().subview(1u, 1u).download(results.data() + 1u)
+                << output_view.download(compacted.data());
+        expected.clear();
+        std::copy_if(host_keys.cbegin(), host_keys.cend(), std::back_inserter(expected), [](auto x) noexcept { return x % 3u == 0u; });
+        compacted.resize(results[1]);
+        auto compact_ok = compacted == expected;
+
+        std::vector<uint> sorted(n);
+        auto sort_ms = timed([&] { sort.sort(*stream, key_view); });
+        *stream << key_view.download(sorted.data());
+        expected = host_keys;
+        std::sort(expected.begin(), expected.end());
+        auto sort_ok = sorted == expected;
+
+        std::vector<uint> sorted_values(n);
+        *stream << key_view.upload(host_pair_keys.data())
+                << value_view.upload(host_values.data());
+        auto pairs_ms = timed([&] { sort.sort(*stream, key_view, value_view); });
+        *stream << key_view.download(sorted.data())
+                << value_view.download(sorted_values.data());
+        std::stable_sort(host_values.begin(), host_values.end(), [&](auto a, auto b) noexcept { return host_pair_keys[a] < host_pair_keys[b]; });
+        auto pairs_ok = sorted_values == host_values &&
+                        std::all_of(host_values.cbegin(), host_values.cend(), [&, i = 0u](auto v) mutable noexcept {
+                            return sorted[i++] == host_pair_keys[v];
+                        });
+
+        auto rate = [n](double ms) noexcept { return static_cast<double>(n) / ms * 1e-3; };
+        LUISA_INFO("n = {:>10}: reduce {:.3f} ms ({:.1f} M/s), scan {:.3f} ms ({:.1f} M/s), compact {:.3f} ms ({:.1f} M/s), "
+                   "sort {:.3f} ms ({:.1f} M/s), sort pairs {:.3f} ms ({:.1f} M/s), all correct: {}",
+                   n, reduce_ms, rate(reduce_ms), scan_ms, rate(scan_ms), compact_ms, rate(compact_ms),
+                   sort_ms, rate(sort_ms), pairs_ms, rate(pairs_ms),
+                   reduce_ok && scan_ok && compact_ok && sort_ok && pairs_ok);
+        if (!(reduce_ok && scan_ok && compact_ok && sort_ok && pairs_ok)) {
+            LUISA_WARNING("Mismatches: reduce = {}, scan = {}, compact = {}, sort = {}, sort pairs = {}",
+                          !reduce_ok, !scan_ok, !compact_ok, !sort_ok, !pairs_ok);
+        }
+    }
+}
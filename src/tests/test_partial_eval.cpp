@@ -0,0 +1,80 @@
+//
+// Created by Mike Smith on 2021/3/22.
+//
+
+#include <cmath>
+#include <vector>
+
+#include <core/logging.h>
+#include <runtime/buffer.h>
+#include <runtime/kernel.h>
+#include <dsl/syntax.h>
+#include <backends/cpu/cpu_device.h>
+
+using namespace luisa;
+using namespace luisa::compute;
+using namespace luisa::compute::dsl;
+
+// written once for both modes: floats on the host, Expr<float> in kernels
+template<typename T>
+[[nodiscard]] T falloff(T x, uint octaves) noexcept {
+    return octaves == 0u ? x * 0.0f : x + falloff(x, octaves - 1u) * 0.5f;
+}
+
+int main() {
+
+    cpu::CPUDevice device;
+    auto stream = device.create_stream();
+
+    // arithmetic on values known at trace time is done on the host and leaves a single literal
+    FunctionBuilder scratch{Function::Tag::KERNEL};
+    scratch.define([] {
+        auto folded = falloff(Expr<float>{0.75f}, 6u);
+        auto cast = Expr<int>{FunctionBuilder::current()->cast(Type::of<int>(), CastOp::STATIC, (Expr<float>{7.9f} * 2.0f).expression())};
+        LUISA_INFO("host-known falloff: {} (host: {}), cast: {}, comparison: {}, short-circuit: {}",
+                   folded.host_value().value_or(-1.0f), falloff(0.75f, 6u),
+                   cast.host_value().value_or(-1),
+                   (Expr<uint>{3u} * 5u > 14u).host_value().value_or(false),
+                   (Expr<bool>{false} && dispatch_id()[0u] == 0u).host_value().has_value());
+    });
+
+    // parameters passed as plain numbers become literals, and branches on them are resolved while tracing
+    static constexpr auto n = 1u << 16u;
+    static constexpr auto octaves = 6u;
+    auto gain = 1.5f;
+    auto clamped = true;
+    Kernel<BufferView<float>, BufferView<float>> traced{
+        &device, [&](Expr<BufferView<float>> in, Expr<BufferView<float>> out) noexcept {
+            auto i = dispatch_id()[0u];
+            auto scale = falloff(Expr<float>{gain}, octaves) / static_cast<float>(octaves);
+            auto x = in[i] * scale;
+            if_(Expr<bool>{clamped} && scale > 0.0f, [&] {
+                out[i] = select(x > 1.0f, Expr<float>{1.0f}, x);
+            }).else_([&] {
+                out[i] = x;
+            });
+            while_(Expr<uint>{octaves} < 4u, [&] { out[i] = 0.0f; });
+        }};
+    auto scale = falloff(gain, octaves) / static_cast<float>(octaves);
+    Kernel<BufferView<float>, BufferView<float>> handwritten{
+        &device, [scale](Expr<BufferView<float>> in, Expr<BufferView<float>> out) noexcept {
+            auto i = dispatch_id()[0u];
+            auto x = in[i] * scale;
+            out[i] = select(x > 1.0f, Expr<float>{1.0f}, x);
+        }};
+    LUISA_INFO("traced kernel matches the handwritten one: {}",
+               traced.function().hash() == handwritten.function().hash());
+
+    std::vector<float> input(n), output(n);
+    for (auto i = 0u; i < n; i++) { input[i] = static_cast<float>(i) / static_cast<float>(n) * 4.0f; }
+    Buffer<float> in_buffer{&device, n};
+    Buffer<float> out_buffer{&device, n};
+    *stream << in_buffer.view().upload(input.data())
+            << traced(in_buffer, out_buffer).dispatch(n)
+            << out_buffer.view().download(output.data());
+    auto mismatches = 0u;
+    for (auto i = 0u; i < n; i++) {
+        if (output[i] != std::min(input[i] * scale, 1.0f)) { mismatches++; }
+    }
+    LUISA_INFO("partially evaluated kernel: out[100] = {}, mismatches: {}", output[100], mismatches);
+}
@@ -0,0 +1,64 @@
+//
+// Created by Mike Smith on 2021/3/14.
+//
+
+#include <vector>
+#include <filesystem>
+
+#include <core/logging.h>
+#include <runtime/buffer.h>
+#include <runtime/kernel.h>
+#include <runtime/profiler.h>
+#include <dsl/syntax.h>
+#include <backends/cpu/cpu_device.h>
+
+int main() {
+
+    using namespace luisa;
+    using namespace luisa::compute;
+    using namespace luisa::compute::dsl;
+
+    Profiler profiler;
+    cpu::CPUDevice device;
+    device.set_profiler(&profiler);
+    auto stream = device.create_stream();
+    profiler.attach(*stream, "main stream");
+
+    static constexpr auto n = 1024u * 1024u;
+    std::vector<float> x(n, 1.0f);
+    Buffer<float> x_buffer{&device, n};
+    Buffer<float> y_buffer{&device, n};
+    Kernel<BufferView<float>, BufferView<float>> square{&device, [](Expr<BufferView<float>> x, Expr<BufferView<float>> y) noexcept {
+        auto i = dispatch_id()[0u];
+        y[i] = x[i] * x[i];
+    }};
+    Kernel<BufferView<float>, float> scale{&device, [](Expr<BufferView<float>> x, Expr<float> a) noexcept {
+        auto i = dispatch_id()[0u];
+        x[i] = x[i] * a;
+    }};
+    profiler.name_kernel(square.handle(), "square");
+    profiler.name_kernel(scale.handle(), "scale");
+
+    *stream << x_buffer.view().upload(x.data());
+    for (auto i = 0u; i < 5u; i++) {
+        *stream << square(x_buffer, y_buffer).dispatch(n)
+                << scale(y_buffer, 0.5f).dispatch(n)
+                << x_buffer.view().copy(y_buffer);
+    }
+    *stream << y_buffer.view().download(x.data());
+
+    for (auto &&kernel : profiler.kernel_profiles()) {
+        LUISA_INFO("Kernel '{}': {} launches, total = {} us, mean = {} us, min = {} us, max = {} us",
+                   kernel.name, kernel.launch_count, kernel.total.count() / 1000, kernel.mean().count() / 1000,
+                   kernel.min.count() / 1000, kernel.max.count() / 1000);
+    }
+    for (auto kind : {Profiler::EventKind::BUFFER_UPLOAD, Profiler::EventKind::BUFFER_DOWNLOAD, Profiler::EventKind::BUFFER_COPY}) {
+        auto transfer = profiler.transfer_profile(kind);
+        LUISA_INFO("{}: {} commands, {} bytes, {} GB/s", to_string(kind), transfer.command_count, transfer.amount, transfer.throughput() * 1e-9);
+    }
+    LUISA_INFO("Compilations: {}, x[0] = {}", profiler.transfer_profile(Profiler::EventKind::KERNEL_COMPILE).command_count, x[0]);
+
+    auto path = std::filesystem::temp_directory_path() / "luisa-test-profiler.json";
+    auto exported = profiler.export_chrome_trace(path);
+    LUISA_INFO("Exported {} events to '{}': {}", profiler.events().size(), path.string(), exported);
+}
@@ -2,8 +2,13 @@
 // Created by Mike Smith on 2021/2/15.
 //
 
+#include <thread>
+
 #include <core/data_types.h>
 #include <runtime/buffer.h>
+#include <runtime/kernel.h>
+#include <runtime/transient_heap.h>
+#include <ast/function.h>
 
 namespace luisa::compute {
 
@@ -23,15 +28,47 @@ struct BufferAccess<Index> {
 
 class FakeDevice : public Device {
     
+    uint64_t _handle_counter{0u};
+    
     void _dispose_buffer(uint64_t handle) noexcept override {}
     
     uint64_t _create_buffer(size_t byte_size) noexcept override {
-        return 0;
+        return _handle_counter++;
     }
     
     uint64_t _create_buffer_with_data(size_t size_bytes, const void *data) noexcept override {
-        return 0;
+        return _handle_counter++;
+    }
+    
+    uint64_t _create_texture(PixelFormat, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t) noexcept override {
+        return _handle_counter++;
+    }
+    
+    void _dispose_texture(uint64_t handle) noexcept override {}
+    
+    uint64_t _create_bindless_array(size_t) noexcept override {
+        return _handle_counter++;
+    }
+    
+    void _dispose_bindless_array(uint64_t handle) noexcept override {}
+
+    uint64_t _compile_kernel(Function) noexcept override {
+        // pretend to be a slow optimizing compiler
+        std::this_thread::sleep_for(std::chrono::milliseconds{50});
+        return _handle_counter++;
     }
+
+    std::optional<uint64_t> _compile_fallback_kernel(Function) noexcept override {
+        return fallback_handle;
+    }
+
+    CompileService *_compile_service() noexcept override { return &_compile_workers; }
+
+    CompileService _compile_workers;
+
+public:
+    static constexpr auto fallback_handle = ~0ull;
+    std::unique_ptr<Stream> create_stream() noexcept override { return nullptr; }
 };
 
 }// namespace luisa::compute
@@ -63,4 +100,65 @@ int main() {
     std::span s{vector};
     Buffer another_buffer{&device, vector};
     static_assert(std::is_same_v<decltype(another_buffer), Buffer<float2>>);
+    
+    BufferHeap heap{&device, 1024u * 1024u};
+    {
+        std::vector<Buffer<float>> small_buffers;
+        for (auto i = 0u; i < 1000u; i++) { small_buffers.emplace_back(heap, 100u + i % 7u); }
+        Buffer<float4> large_buffer{heap, 1024u * 1024u};
+        auto stats = heap.statistics();
+        LUISA_INFO(
+            "blocks = {}, dedicated = {}, allocations = {}, reserved = {}, requested = {}, allocated = {}, "
+            "largest free = {}, internal fragmentation = {}, external fragmentation = {}",
+            stats.block_count, stats.dedicated_count, stats.allocation_count, stats.reserved_bytes,
+            stats.requested_bytes, stats.allocated_bytes, stats.largest_free_bytes,
+            stats.internal_fragmentation, stats.external_fragmentation);
+        auto hv = small_buffers[3].view();
+        LUISA_INFO("small buffer #3: handle = {}, offset = {}", hv.handle(), hv.offset_bytes());
+        for (auto i = 0u; i < small_buffers.size(); i += 2u) { small_buffers[i] = Buffer<float>{heap, 16u}; }
+        stats = heap.statistics();
+        LUISA_INFO("after churn: blocks = {}, allocations = {}, external fragmentation = {}",
+                   stats.block_count, stats.allocation_count, stats.external_fragmentation);
+    }
+    auto stats = heap.statistics();
+    LUISA_INFO("after release: blocks = {}, allocations = {}, allocated = {}",
+               stats.block_count, stats.allocation_count, stats.allocated_bytes);
+    
+    // a three-pass pipeline: gbuffer -> lighting -> tonemap
+    TransientHeap transient{&device};
+    auto gbuffer = transient.create<float4>(1920u * 1080u);
+    auto lighting = transient.create<float4>(1920u * 1080u);
+    auto ldr = transient.create<uint>(1920u * 1080u);
+    transient.use(gbuffer, 0u);
+    transient.use(gbuffer, 1u);
+    transient.use(lighting, 1u);
+    transient.use(lighting, 2u);
+    transient.use(ldr, 2u);
+    transient.allocate();
+    auto transient_stats = transient.statistics();
+    LUISA_INFO("transient: buffers = {}, naive = {}, aliased = {}, capacity = {}",
+               transient_stats.buffer_count, transient_stats.naive_bytes,
+               transient_stats.aliased_bytes, transient_stats.capacity_bytes);
+    LUISA_INFO("gbuffer offset = {}, lighting offset = {}, ldr offset = {}",
+               transient.view(gbuffer).offset_bytes(),
+               transient.view(lighting).offset_bytes(),
+               transient.view(ldr).offset_bytes());
+    for (auto &&barrier : transient.alias_barriers()) {
+        LUISA_INFO("alias barrier at pass {}: #{} -> #{}", barrier.pass, barrier.before, barrier.after);
+    }
+    transient.reset();
+    
+    // dispatches issued while the kernel compiles go through the fallback pipeline
+    Kernel<uint> async_kernel{&device, [](dsl::Expr<uint>) noexcept {}, CompileMode::ASYNC};
+    auto early = async_kernel(1u).dispatch(1u);
+    LUISA_INFO("async kernel: ready = {}, early launch uses fallback = {}",
+               async_kernel.ready(), early.handle() == FakeDevice::fallback_handle);
+    auto handle = async_kernel.handle();
+    auto late = async_kernel(1u).dispatch(1u);
+    LUISA_INFO("async kernel: ready = {}, late launch uses compiled pipeline = {}",
+               async_kernel.ready(), late.handle() == handle);
+    LUISA_INFO("compile latency: count = {}, p50 <= {}us, max = {}us",
+               device.compile_latency().count(),
+               device.compile_latency().quantile(0.5).count(),
+               device.compile_latency().max().count());
 }
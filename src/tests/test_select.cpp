@@ -0,0 +1,95 @@
+//
+// Created by Mike Smith on 2021/3/20.
+//
+
+#include <chrono>
+#include <vector>
+
+#include <core/logging.h>
+#include <runtime/buffer.h>
+#include <runtime/kernel.h>
+#include <dsl/syntax.h>
+#include <backends/cpu/cpu_device.h>
+
+int main() {
+
+    using namespace luisa;
+    using namespace luisa::compute;
+    using namespace luisa::compute::dsl;
+
+    cpu::CPUDevice device;
+    auto stream = device.create_stream();
+
+    // component-wise selects with vector masks and scalar selects broadcast over vectors
+    static constexpr auto n = 1024u;
+    Kernel<BufferView<float4>, BufferView<float4>, BufferView<float4>> masked{
+        &device, [](Expr<BufferView<float4>> a, Expr<BufferView<float4>> b, Expr<BufferView<float4>> out) noexcept {
+            auto i = dispatch_id()[0u];
+            auto x = a[i];
+            auto y = b[i];
+            auto larger = select(x > y, x, y);
+            out[i] = select(i % 2u == 0u, larger, larger * -1.0f);
+        }};
+    std::vector<float4> a(n), b(n), out(n);
+    for (auto i = 0u; i < n; i++) {
+        auto x = static_cast<float>(i);
+        a[i] = float4{x, -x, static_cast<float>(i % 7u), 1.0f};
+        b[i] = float4{-x, x, 3.0f, 1.5f};
+    }
+    Buffer<float4> a_buffer{&device, n};
+    Buffer<float4> b_buffer{&device, n};
+    Buffer<float4> out_buffer{&device, n};
+    *stream << a_buffer.view().upload(a.data())
+            << b_buffer.view().upload(b.data())
+            << masked(a_buffer, b_buffer, out_buffer).dispatch(n)
+            << out_buffer.view().download(out.data());
+    auto mismatches = 0u;
+    for (auto i = 0u; i < n; i++) {
+        auto larger = select(a[i] > b[i], a[i], b[i]);
+        auto expected = i % 2u == 0u ? larger : larger * -1.0f;
+        if (out[i].x != expected.x || out[i].y != expected.y || out[i].z != expected.z || out[i].w != expected.w) { mismatches++; }
+    }
+    LUISA_INFO("vector masks: out[5] = ({}, {}, {}, {}), mismatches: {}",
+               out[5].x, out[5].y, out[5].z, out[5].w, mismatches);
+
+    // divergent collatz steps, branching or if-converted to selects
+    static constexpr auto count = 1u << 16u;
+    static constexpr auto steps = 64u;
+    Kernel<BufferView<uint>> collatz{&device, [](Expr<BufferView<uint>> x) noexcept {
+        auto f = FunctionBuilder::current();
+        auto u = Type::of<uint>();
+        auto i = dispatch_id()[0u];
+        auto v = f->ref(f->local(u, {x[i].expression()}));
+        for_(0u, steps, [&](Expr<uint>) noexcept {
+            Expr<uint> value{v};
+            f->if_(((value & 1u) == 1u).expression(), f->scope([&] {
+                f->assign(AssignOp::ASSIGN, v, (value * 3u + 1u).expression());
+            }), f->scope([&] {
+                f->assign(AssignOp::SHR_ASSIGN, v, f->literal(1u));
+            }));
+        });
+        x[i] = Expr<uint>{v};
+    }};
+    auto converted = collatz.if_converted();
+    LUISA_INFO("if-converted kernel differs: {}", collatz.function().hash() != converted.function().hash());
+    std::vector<uint> input(count), expected(count), result(count);
+    for (auto i = 0u; i < count; i++) {
+        auto v = input[i] = i * 2654435761u % 100000u + 1u;
+        for (auto s = 0u; s < steps; s++) { v = v % 2u == 1u ? v * 3u + 1u : v >> 1u; }
+        expected[i] = v;
+    }
+    Buffer<uint> x_buffer{&device, count};
+    auto run = [&](const char *name, auto &&kernel) {
+        *stream << x_buffer.view().upload(input.data());
+        auto t0 = std::chrono::steady_clock::now();
+        *stream << kernel(x_buffer).dispatch(count);
+        auto t1 = std::chrono::steady_clock::now();
+        *stream << x_buffer.view().download(result.data());
+        LUISA_INFO("{} collatz: {} ms, matches host: {}",
+                   name, std::chrono::duration<double, std::milli>(t1 - t0).count(), result == expected);
+    };
+    for (auto round = 0u; round < 2u; round++) {
+        run("branching", collatz);
+        run("if-converted", converted);
+    }
+}
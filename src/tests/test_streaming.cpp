@@ -0,0 +1,57 @@
+//
+// Created by Mike Smith on 2021/3/13.
+//
+
+#include <vector>
+#include <fstream>
+#include <numeric>
+#include <filesystem>
+
+#include <core/logging.h>
+#include <core/mapped_file.h>
+#include <runtime/kernel.h>
+#include <runtime/streaming_dispatcher.h>
+#include <dsl/syntax.h>
+#include <backends/cpu/cpu_device.h>
+
+int main() {
+
+    using namespace luisa;
+    using namespace luisa::compute;
+    using namespace luisa::compute::dsl;
+
+    static constexpr auto n = 8u * 1024u * 1024u + 123u;
+    auto path = std::filesystem::temp_directory_path() / "luisa-test-streaming.bin";
+    {
+        std::vector<uint> data(n);
+        std::iota(data.begin(), data.end(), 0u);
+        std::ofstream file{path, std::ios::binary};
+        file.write(reinterpret_cast<const char *>(data.data()), n * sizeof(uint));
+    }
+    MappedFile file{path};
+    std::span input{reinterpret_cast<const uint *>(file.data()), file.size() / sizeof(uint)};
+
+    cpu::CPUDevice device;
+    Kernel<BufferView<uint>, BufferView<uint>, uint> transform{&device, [](Expr<BufferView<uint>> in, Expr<BufferView<uint>> out, Expr<uint> offset) noexcept {
+        auto i = dispatch_id()[0u];
+        out[i] = in[i] * 3u + offset;
+    }};
+
+    std::vector<uint> output(n);
+    for (auto depth : {2u, 3u}) {
+        StreamingDispatcher<uint, uint> dispatcher{&device, 1024u * 1024u, depth};
+        auto statistics = dispatcher.run(input, output, [&](BufferView<uint> in, BufferView<uint> out, size_t offset, size_t count) noexcept {
+            return transform(in, out, static_cast<uint>(offset)).dispatch(static_cast<uint>(count));
+        });
+        auto mismatches = 0u;
+        for (auto i = 0u; i < n; i++) {
+            auto chunk_offset = i / dispatcher.chunk_size() * dispatcher.chunk_size();
+            if (output[i] != i * 3u + chunk_offset) { mismatches++; }
+        }
+        LUISA_INFO("Depth {}: {} chunks in {} ms, {} GB/s, overlap = {}x (upload {} ms, compute {} ms, download {} ms), mismatches = {}",
+                   depth, statistics.chunk_count, statistics.seconds * 1e3, statistics.bandwidth() * 1e-9, statistics.overlap(),
+                   statistics.upload_seconds * 1e3, statistics.compute_seconds * 1e3, statistics.download_seconds * 1e3, mismatches);
+    }
+    file = {};
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,123 @@
+//
+// Created by Mike Smith on 2021/3/17.
+//
+
+#include <cmath>
+#include <chrono>
+#include <vector>
+
+#include <core/logging.h>
+#include <runtime/buffer.h>
+#include <runtime/kernel.h>
+#include <dsl/syntax.h>
+#include <backends/cpu/cpu_device.h>
+
+int main() {
+
+    using namespace luisa;
+    using namespace luisa::compute;
+    using namespace luisa::compute::dsl;
+
+    cpu::CPUDevice device;
+    auto stream = device.create_stream();
+
+    // tree reduction in shared memory, halving the active threads between barriers
+    static constexpr auto block_size = 256u;
+    static constexpr auto n = 100000u;
+    static constexpr auto block_count = (n + block_size - 1u) / block_size;
+    Kernel<BufferView<float>, BufferView<float>> reduce{&device, [](Expr<BufferView<float>> x, Expr<BufferView<float>> sums) noexcept {
+        auto f = FunctionBuilder::current();
+        auto u = Type::of<uint>();
+        auto b = Type::of<bool>();
+        auto tile = shared<std::array<float, block_size>>();
+        auto tid = thread_id()[0u];
+        auto i = dispatch_id()[0u];
+        f->if_(f->binary(b, BinaryOp::LESS, i.expression(), f->literal(n)), f->scope([&] { tile[tid] = x[i]; }));
+        sync_block();
+        auto stride = f->ref(f->local(u, {f->literal(block_size / 2u)}));
+        f->while_(f->binary(b, BinaryOp::GREATER, stride, f->literal(0u)), f->scope([&] {
+            f->if_(f->binary(b, BinaryOp::LESS, tid.expression(), stride), f->scope([&] {
+                tile[tid] += tile[tid + Expr<uint>{stride}];
+            }));
+            sync_block();
+            f->assign(AssignOp::SHR_ASSIGN, stride, f->literal(1u));
+        }));
+        f->if_(f->binary(b, BinaryOp::EQUAL, tid.expression(), f->literal(0u)), f->scope([&] {
+            sums[block_id()[0u]] = tile[0u];
+        }));
+    }};
+    std::vector<float> x(n);
+    for (auto i = 0u; i < n; i++) { x[i] = static_cast<float>(i % 100u); }
+    std::vector<float> sums(block_count);
+    Buffer<float> x_buffer{&device, n};
+    Buffer<float> sum_buffer{&device, block_count};
+    *stream << x_buffer.view().upload(x.data())
+            << reduce(x_buffer, sum_buffer).dispatch(n)
+            << sum_buffer.view().download(sums.data());
+    auto mismatches = 0u;
+    for (auto block = 0u; block < block_count; block++) {
+        auto expected = 0.0f;
+        for (auto i = block * block_size; i < std::min((block + 1u) * block_size, n); i++) { expected += x[i]; }
+        if (sums[block] != expected) { mismatches++; }
+    }
+    LUISA_INFO("reduction: {} blocks, sums[0] = {}, last = {}, mismatches: {}",
+               block_count, sums[0], sums.back(), mismatches);
+
+    // tiled matrix multiplication, each block stages a tile of a and b in shared memory
+    static constexpr auto tile_size = 16u;
+    static constexpr auto m = 128u;
+    Kernel<BufferView<float>, BufferView<float>, BufferView<float>> matmul{
+        &device, [](Expr<BufferView<float>> a, Expr<BufferView<float>> b, Expr<BufferView<float>> c) noexcept {
+            auto f = FunctionBuilder::current();
+            auto u = Type::of<uint>();
+            auto t = Type::of<float>();
+            auto bt = Type::of<bool>();
+            auto a_tile = shared<std::array<float, tile_size * tile_size>>();
+            auto b_tile = shared<std::array<float, tile_size * tile_size>>();
+            auto tx = thread_id()[0u];
+            auto ty = thread_id()[1u];
+            auto col = dispatch_id()[0u];
+            auto row = dispatch_id()[1u];
+            auto sum = f->ref(f->local(t, {f->literal(0.0f)}));
+            auto base = f->ref(f->local(u, {f->literal(0u)}));
+            f->while_(f->binary(bt, BinaryOp::LESS, base, f->literal(m)), f->scope([&] {
+                Expr<uint> k0{base};
+                a_tile[ty * tile_size + tx] = a[row * m + k0 + tx];
+                b_tile[ty * tile_size + tx] = b[(k0 + ty) * m + col];
+                sync_block();
+                auto k = f->ref(f->local(u, {f->literal(0u)}));
+                f->while_(f->binary(bt, BinaryOp::LESS, k, f->literal(tile_size)), f->scope([&] {
+                    Expr<uint> kk{k};
+                    f->assign(AssignOp::ADD_ASSIGN, sum, (a_tile[ty * tile_size + kk] * b_tile[kk * tile_size + tx]).expression());
+                    f->assign(AssignOp::ADD_ASSIGN, k, f->literal(1u));
+                }));
+                sync_block();
+                f->assign(AssignOp::ADD_ASSIGN, base, f->literal(tile_size));
+            }));
+            c[row * m + col] = Expr<float>{sum};
+        }};
+    std::vector<float> a(m * m), b(m * m), c(m * m);
+    for (auto i = 0u; i < m * m; i++) {
+        a[i] = static_cast<float>(i % 7u) - 3.0f;
+        b[i] = static_cast<float>(i % 5u) * 0.5f;
+    }
+    Buffer<float> a_buffer{&device, m * m};
+    Buffer<float> b_buffer{&device, m * m};
+    Buffer<float> c_buffer{&device, m * m};
+    *stream << a_buffer.view().upload(a.data())
+            << b_buffer.view().upload(b.data());
+    auto t0 = std::chrono::steady_clock::now();
+    *stream << matmul(a_buffer, b_buffer, c_buffer).dispatch(uint3{m, m, 1u}, uint3{tile_size, tile_size, 1u});
+    auto t1 = std::chrono::steady_clock::now();
+    *stream << c_buffer.view().download(c.data());
+    auto max_error = 0.0f;
+    for (auto row = 0u; row < m; row++) {
+        for (auto col = 0u; col < m; col++) {
+            auto expected = 0.0f;
+            for (auto k = 0u; k < m; k++) { expected += a[row * m + k] * b[k * m + col]; }
+            max_error = std::max(max_error, std::abs(c[row * m + col] - expected));
+        }
+    }
+    LUISA_INFO("tiled matmul {}x{}: {} ms, c[0] = {}, max error = {}",
+               m, m, std::chrono::duration<double, std::milli>(t1 - t0).count(), c[0], max_error);
+}
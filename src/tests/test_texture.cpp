@@ -0,0 +1,104 @@
+//
+// Created by Mike Smith on 2021/3/4.
+//
+
+#include <vector>
+
+#include <core/logging.h>
+#include <runtime/buffer.h>
+#include <runtime/texture.h>
+#include <runtime/bindless_array.h>
+#include <ast/function_builder.h>
+#include <backends/cpu/cpu_device.h>
+
+int main() {
+
+    using namespace luisa;
+    using namespace luisa::compute;
+
+    cpu::CPUDevice device;
+    auto stream = device.create_stream();
+
+    Texture texture{&device, PixelFormat::RGBA8UNorm, uint2{37u, 23u}, 3u};
+    LUISA_INFO("mip levels = {}, level 2 size = ({}, {})",
+               texture.mip_levels(), texture.view(2u).size().x, texture.view(2u).size().y);
+
+    std::vector<uchar4> pixels(texture.view().pixel_count());
+    for (auto i = 0u; i < pixels.size(); i++) {
+        pixels[i] = uchar4{static_cast<uchar>(i), static_cast<uchar>(i >> 8u), static_cast<uchar>(0u), static_cast<uchar>(255u)};
+    }
+    std::vector<uchar4> downloaded(pixels.size());
+    *stream << texture.view().upload(pixels.data())
+            << texture.view().download(downloaded.data());
+    auto mismatches = 0u;
+    for (auto i = 0u; i < pixels.size(); i++) {
+        if (pixels[i].x != downloaded[i].x || pixels[i].y != downloaded[i].y) { mismatches++; }
+    }
+    LUISA_INFO("round-trip mismatches: {}", mismatches);
+
+    auto cpu_texture = cpu::CPUDevice::texture(texture.handle());
+    LUISA_INFO("texel offsets: (1, 0) -> {}, (0, 1) -> {}, (1, 1) -> {}, (8, 0) -> {}",
+               cpu_texture->texel_offset(0u, uint3{1u, 0u, 0u}),
+               cpu_texture->texel_offset(0u, uint3{0u, 1u, 0u}),
+               cpu_texture->texel_offset(0u, uint3{1u, 1u, 0u}),
+               cpu_texture->texel_offset(0u, uint3{8u, 0u, 0u}));
+    auto texel = cpu_texture->read<float>(0u, uint3{5u, 1u, 0u});
+    LUISA_INFO("texel (5, 1) = ({}, {}, {}, {})", texel.x, texel.y, texel.z, texel.w);
+    cpu_texture->write<float>(1u, uint3{3u, 2u, 0u}, float4{0.5f, 0.25f, 1.0f, 1.0f});
+    texel = cpu_texture->read<float>(1u, uint3{3u, 2u, 0u});
+    LUISA_INFO("level 1 texel (3, 2) = ({}, {}, {}, {})", texel.x, texel.y, texel.z, texel.w);
+
+    Texture volume{&device, PixelFormat::R32F, uint3{16u, 16u, 16u}};
+    Texture another_volume{&device, PixelFormat::R32F, uint3{16u, 16u, 16u}};
+    std::vector<float> voxels(volume.view().pixel_count());
+    for (auto i = 0u; i < voxels.size(); i++) { voxels[i] = static_cast<float>(i); }
+    std::vector<float> copied(voxels.size());
+    *stream << volume.view().upload(voxels.data())
+            << another_volume.view().copy(volume.view())
+            << another_volume.view().download(copied.data());
+    LUISA_INFO("volume voxel (3, 5, 7) = {}", copied[(7u * 16u + 5u) * 16u + 3u]);
+
+    std::vector<float> data(1024u);
+    for (auto i = 0u; i < data.size(); i++) { data[i] = static_cast<float>(i); }
+    Buffer<float> buffer{&device, 1024u};
+    Buffer<float> another_buffer{&device, 1024u};
+    std::vector<float> result(1024u);
+    *stream << buffer.view().upload(data.data())
+            << another_buffer.view().copy(buffer.view())
+            << another_buffer.view().subview(512u, 512u).download(result.data());
+    LUISA_INFO("buffer[512] = {}, buffer[1023] = {}", result[0], result[511]);
+
+    BindlessArray bindless{&device, 16u};
+    bindless.emplace(0u, buffer.view())
+        .emplace(1u, another_buffer.view().subview(512u, 512u))
+        .emplace(3u, texture.view(1u));
+    auto first_update = bindless.update();
+    bindless.emplace(1u, buffer.view().subview(256u, 768u)).remove(3u);
+    auto second_update = bindless.update();
+    LUISA_INFO("bindless updates: {} slots, then {} slots",
+               first_update.modifications().size(), second_update.modifications().size());
+    *stream << first_update;
+    auto cpu_bindless = cpu::CPUDevice::bindless_array(bindless.handle());
+    LUISA_INFO("bindless slot 1 = {}, slot 3 texture size = ({}, {})",
+               reinterpret_cast<const float *>(cpu_bindless->buffer(1u))[0],
+               cpu_bindless->texture(3u)->size(cpu_bindless->slot(3u).level).x,
+               cpu_bindless->texture(3u)->size(cpu_bindless->slot(3u).level).y);
+    *stream << second_update;
+    LUISA_INFO("bindless slot 1 = {}, slot 3 holds texture: {}",
+               reinterpret_cast<const float *>(cpu_bindless->buffer(1u))[0],
+               cpu_bindless->slot(3u).texture != nullptr);
+
+    FunctionBuilder f{Function::Tag::KERNEL};
+    f.define([&] {
+        auto heap = f.ref(f.bindless_array_binding(bindless));
+        auto tid = f.ref(f.thread_id());
+        auto slot = f.literal(1u);
+        auto x = f.bindless_buffer_read(Type::of<float>(), heap, slot, f.member(Type::of<uint>(), tid, 0u));
+        f.bindless_buffer_write(heap, f.literal(0u), f.literal(0u), x);
+        // two views of the same buffer at different offsets are bound separately
+        std::ignore = f.buffer_binding(buffer.view());
+        std::ignore = f.buffer_binding(buffer.view().subview(256u, 768u));
+    });
+    LUISA_INFO("captured bindless arrays: {}, captured buffers: {}",
+               f.captured_bindless_arrays().size(), f.captured_buffers().size());
+}
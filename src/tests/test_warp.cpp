@@ -0,0 +1,136 @@
+//
+// Created by Mike Smith on 2021/3/18.
+//
+
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#include <core/logging.h>
+#include <runtime/buffer.h>
+#include <runtime/kernel.h>
+#include <dsl/syntax.h>
+#include <backends/cpu/cpu_device.h>
+
+int main() {
+
+    using namespace luisa;
+    using namespace luisa::compute;
+    using namespace luisa::compute::dsl;
+
+    cpu::CPUDevice device;
+    auto stream = device.create_stream();
+
+    // votes, shuffles and scans of a single partially active warp
+    Kernel<BufferView<uint>> probe{&device, [](Expr<BufferView<uint>> out) noexcept {
+        auto f = FunctionBuilder::current();
+        auto b = Type::of<bool>();
+        auto i = dispatch_id()[0u];
+        f->if_(f->binary(b, BinaryOp::LESS, i.expression(), f->literal(20u)), f->scope([&] {
+            auto lane = warp_lane_id();
+            auto odd = (lane & 1u) == 1u;
+            out[i * 8u + 0u] = warp_size();
+            out[i * 8u + 1u] = warp_active_ballot(odd);
+            out[i * 8u + 2u] = Expr<uint>{f->cast(Type::of<uint>(), CastOp::STATIC, warp_active_all(lane < 20u).expression())};
+            out[i * 8u + 3u] = Expr<uint>{f->cast(Type::of<uint>(), CastOp::STATIC, warp_active_any(lane == 31u).expression())};
+            out[i * 8u + 4u] = warp_read_lane(lane * 10u, (lane + 1u) % 20u);
+            out[i * 8u + 5u] = warp_read_first_active_lane(lane + 100u);
+            out[i * 8u + 6u] = warp_prefix_sum(lane);
+            out[i * 8u + 7u] = warp_inclusive_sum(lane) + warp_active_sum(Expr<uint>{1000u});
+        }));
+    }};
+    std::vector<uint> out(32u * 8u);
+    Buffer<uint> out_buffer{&device, out.size()};
+    *stream << probe(out_buffer).dispatch(32u)
+            << out_buffer.view().download(out.data());
+    LUISA_INFO("warp size = {}, ballot = {:08x}, all = {}, any = {}",
+               out[0], out[1], out[2], out[3]);
+    LUISA_INFO("lane 5: shuffled = {}, broadcast = {}, exclusive = {}, inclusive + total = {}",
+               out[5 * 8 + 4], out[5 * 8 + 5], out[5 * 8 + 6], out[5 * 8 + 7]);
+
+    // stream compaction: each warp reserves its slots with a single atomic
+    static constexpr auto n = 1u << 18u;
+    Kernel<BufferView<uint>, BufferView<uint>, BufferView<uint>> compact{
+        &device, [](Expr<BufferView<uint>> input, Expr<BufferView<uint>> output, Expr<BufferView<uint>> counter) noexcept {
+            auto f = FunctionBuilder::current();
+            auto u = Type::of<uint>();
+            auto i = dispatch_id()[0u];
+            auto x = input[i];
+            auto keep = Expr<uint>{f->cast(u, CastOp::STATIC, (x % 3u == 0u).expression())};
+            auto offset = warp_prefix_sum(keep);
+            auto total = warp_active_sum(keep);
+            auto base = f->ref(f->local(u, {f->literal(0u)}));
+            f->if_((warp_lane_id() == 0u).expression(), f->scope([&] {
+                f->assign(AssignOp::ASSIGN, base, atomic_fetch_add(counter[0u], total).expression());
+            }));
+            auto slot = warp_read_first_active_lane(Expr<uint>{base}) + offset;
+            f->if_(keep.expression(), f->scope([&] { output[slot] = x; }));
+        }};
+    std::vector<uint> input(n);
+    for (auto i = 0u; i < n; i++) { input[i] = i * 2654435761u; }
+    std::vector<uint> output(n);
+    std::vector<uint> counter{0u};
+    Buffer<uint> input_buffer{&device, n};
+    Buffer<uint> output_buffer{&device, n};
+    Buffer<uint> counter_buffer{&device, 1u};
+    *stream << input_buffer.view().upload(input.data())
+            << counter_buffer.view().upload(counter.data())
+            << compact(input_buffer, output_buffer, counter_buffer).dispatch(n)
+            << counter_buffer.view().download(counter.data())
+            << output_buffer.view().download(output.data());
+    std::vector<uint> expected;
+    std::copy_if(input.cbegin(), input.cend(), std::back_inserter(expected), [](auto x) noexcept { return x % 3u == 0u; });
+    output.resize(counter[0]);
+    std::sort(output.begin(), output.end());
+    std::sort(expected.begin(), expected.end());
+    LUISA_INFO("compaction: kept {} of {} (expected {}), matches host: {}",
+               counter[0], n, expected.size(), output == expected);
+
+    // block sums with a shared-memory tree against warp sums combined in shared memory
+    static constexpr auto block_size = 256u;
+    static constexpr auto warp_count = block_size / 32u;
+    Kernel<BufferView<uint>, BufferView<uint>> tree_sum{&device, [](Expr<BufferView<uint>> x, Expr<BufferView<uint>> sums) noexcept {
+        auto f = FunctionBuilder::current();
+        auto u = Type::of<uint>();
+        auto b = Type::of<bool>();
+        auto tile = shared<std::array<uint, block_size>>();
+        auto tid = thread_id()[0u];
+        tile[tid] = x[dispatch_id()[0u]];
+        sync_block();
+        auto stride = f->ref(f->local(u, {f->literal(block_size / 2u)}));
+        f->while_(f->binary(b, BinaryOp::GREATER, stride, f->literal(0u)), f->scope([&] {
+            f->if_(f->binary(b, BinaryOp::LESS, tid.expression(), stride), f->scope([&] {
+                tile[tid] += tile[tid + Expr<uint>{stride}];
+            }));
+            sync_block();
+            f->assign(AssignOp::SHR_ASSIGN, stride, f->literal(1u));
+        }));
+        f->if_((tid == 0u).expression(), f->scope([&] { sums[block_id()[0u]] = tile[0u]; }));
+    }};
+    Kernel<BufferView<uint>, BufferView<uint>> warp_sum{&device, [](Expr<BufferView<uint>> x, Expr<BufferView<uint>> sums) noexcept {
+        auto f = FunctionBuilder::current();
+        auto partial = shared<std::array<uint, warp_count>>();
+        auto tid = thread_id()[0u];
+        auto s = warp_active_sum(x[dispatch_id()[0u]]);
+        f->if_((warp_lane_id() == 0u).expression(), f->scope([&] { partial[tid / 32u] = s; }));
+        sync_block();
+        f->if_((tid < 32u).expression(), f->scope([&] {
+            auto t = warp_active_sum(partial[tid % warp_count] * Expr<uint>{f->cast(Type::of<uint>(), CastOp::STATIC, (tid < warp_count).expression())});
+            f->if_((tid == 0u).expression(), f->scope([&] { sums[block_id()[0u]] = t; }));
+        }));
+    }};
+    static constexpr auto block_count = n / block_size;
+    std::vector<uint> tree(block_count), warp(block_count);
+    Buffer<uint> sum_buffer{&device, block_count};
+    auto time = [&](auto &&kernel, std::vector<uint> &result) {
+        auto t0 = std::chrono::steady_clock::now();
+        *stream << kernel(input_buffer, sum_buffer).dispatch(n);
+        auto t1 = std::chrono::steady_clock::now();
+        *stream << sum_buffer.view().download(result.data());
+        return std::chrono::duration<double, std::milli>(t1 - t0).count();
+    };
+    auto tree_ms = time(tree_sum, tree);
+    auto warp_ms = time(warp_sum, warp);
+    LUISA_INFO("block sums: shared-memory tree = {} ms, warp sums = {} ms, results match: {}",
+               tree_ms, warp_ms, tree == warp);
+}